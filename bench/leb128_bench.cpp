@@ -0,0 +1,188 @@
+//
+//  leb128_bench.cpp
+//  machofile
+//
+//  Compares the leb128.h decoders with a plain byte at a time loop on
+//  value distributions like those of the LINKEDIT opcode streams and the
+//  export trie.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/time.h>
+
+#include <random>
+#include <vector>
+
+#include "leb128.h"
+
+using namespace rotg;
+
+typedef struct distribution {
+    const char* name;
+    bool        is_signed;
+    // upper bounds (exclusive) of the magnitude, and how often out of 100 each is used
+    uint64_t    limits[4];
+    int         weights[4];
+} distribution_t;
+
+static const distribution_t kDistributions[] = {
+    { "ordinals/counts",    false, { 1ULL << 7, 0, 0, 0 },                                  { 100, 0, 0, 0 } },
+    { "segment offsets",    false, { 1ULL << 7, 1ULL << 14, 1ULL << 21, 0 },                { 20, 50, 30, 0 } },
+    { "linkedit mix",       false, { 1ULL << 7, 1ULL << 14, 1ULL << 21, 1ULL << 35 },       { 70, 20, 8, 2 } },
+    { "addresses",          false, { 1ULL << 32, 1ULL << 36, 0, 0 },                       { 50, 50, 0, 0 } },
+    { "addends",            true,  { 1ULL << 6, 1ULL << 13, 1ULL << 31, 0 },                { 80, 15, 5, 0 } },
+};
+
+static double now_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void encode_uleb128(std::vector<uint8_t>& out, uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+}
+
+static void encode_sleb128(std::vector<uint8_t>& out, int64_t value)
+{
+    bool more;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        more = !((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0));
+        out.push_back(more ? byte | 0x80 : byte);
+    } while (more);
+}
+
+/* The decoders as they were: one byte per iteration */
+static const uint8_t* loop_uleb128(const uint8_t* p, const uint8_t* end, uint64_t& result)
+{
+    result = 0;
+    unsigned bit = 0;
+    uint8_t byte;
+    do {
+        if (p >= end || bit >= 64) {
+            return NULL;
+        }
+        byte = *p++;
+        result |= (uint64_t)(byte & 0x7f) << bit;
+        bit += 7;
+    } while (byte & 0x80);
+    return p;
+}
+
+static const uint8_t* loop_sleb128(const uint8_t* p, const uint8_t* end, int64_t& result)
+{
+    uint64_t value = 0;
+    unsigned bit = 0;
+    uint8_t byte;
+    do {
+        if (p >= end || bit >= 64) {
+            return NULL;
+        }
+        byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << bit;
+        bit += 7;
+    } while (byte & 0x80);
+    if (bit < 64 && (byte & 0x40) != 0) {
+        value |= ~0ULL << bit;
+    }
+    result = (int64_t)value;
+    return p;
+}
+
+template <typename Value, typename Decoder>
+static double time_decoder(const std::vector<uint8_t>& stream, size_t count, int rounds, Decoder decode, uint64_t* checksum)
+{
+    const uint8_t* begin = stream.data();
+    const uint8_t* end = begin + stream.size();
+    uint64_t sum = 0;
+
+    double start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        const uint8_t* p = begin;
+        while (p != NULL && p < end) {
+            Value value;
+            p = decode(p, end, value);
+            sum += (uint64_t)value;
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    *checksum = sum;
+    return elapsed * 1e9 / ((double)count * rounds);
+}
+
+int main(int argc, const char * argv[])
+{
+    size_t count = 1000000;
+    int rounds = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            count = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-c values] [-r rounds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%-18s %8s %12s %12s %8s\n", "distribution", "bytes/v", "loop ns/v", "fast ns/v", "speedup");
+
+    std::mt19937_64 rng(1);
+
+    for (size_t d = 0; d < sizeof(kDistributions) / sizeof(kDistributions[0]); d++) {
+        const distribution_t& dist = kDistributions[d];
+
+        std::vector<uint8_t> stream;
+        for (size_t i = 0; i < count; i++) {
+            int pick = (int)(rng() % 100);
+            size_t bucket = 0;
+            while (bucket < 3 && pick >= dist.weights[bucket]) {
+                pick -= dist.weights[bucket];
+                bucket++;
+            }
+
+            uint64_t magnitude = rng() % dist.limits[bucket];
+            if (dist.is_signed) {
+                int64_t value = (rng() & 1) ? -(int64_t)magnitude : (int64_t)magnitude;
+                encode_sleb128(stream, value);
+            } else {
+                encode_uleb128(stream, magnitude);
+            }
+        }
+
+        uint64_t loopSum;
+        uint64_t fastSum;
+        double loop;
+        double fast;
+
+        if (dist.is_signed) {
+            loop = time_decoder<int64_t>(stream, count, rounds, loop_sleb128, &loopSum);
+            fast = time_decoder<int64_t>(stream, count, rounds, read_sleb128, &fastSum);
+        } else {
+            loop = time_decoder<uint64_t>(stream, count, rounds, loop_uleb128, &loopSum);
+            fast = time_decoder<uint64_t>(stream, count, rounds, read_uleb128, &fastSum);
+        }
+
+        if (loopSum != fastSum) {
+            fprintf(stderr, "%s: decoders disagree\n", dist.name);
+            return 2;
+        }
+
+        printf("%-18s %8.2f %12.2f %12.2f %7.2fx\n", dist.name, (double)stream.size() / count, loop, fast, loop / fast);
+    }
+
+    return 0;
+}
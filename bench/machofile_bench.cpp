@@ -0,0 +1,415 @@
+//
+//  machofile_bench.cpp
+//  machofile
+//
+//  Measures MachOFile::parse_file throughput over every regular file
+//  found below a directory, and how often the parse calls operator new.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "machofile.h"
+#include "bind_table.h"
+#include "sha.h"
+#include "thread_pool.h"
+
+using namespace rotg;
+
+/* Every operator new in the process goes through here, so allocations can be counted */
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+typedef struct bench_file {
+    std::string path;
+    uint64_t    size;
+} bench_file_t;
+
+typedef std::vector<bench_file_t> bench_files_t;
+
+static double now_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void collect_files(const std::string& dir, bench_files_t& files)
+{
+    DIR* d = opendir(dir.c_str());
+    if (d == NULL) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        std::string path = dir + "/" + entry->d_name;
+
+        struct stat stbuf;
+        if (lstat(path.c_str(), &stbuf) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(stbuf.st_mode)) {
+            collect_files(path, files);
+        } else if (S_ISREG(stbuf.st_mode) && stbuf.st_size > 0) {
+            bench_file_t file;
+            file.path = path;
+            file.size = stbuf.st_size;
+            files.push_back(file);
+        }
+    }
+
+    closedir(d);
+}
+
+/* Counts binds without keeping them */
+class BindCounter : public BindVisitor
+{
+public:
+    BindCounter()
+        : m_count(0)
+    {
+    }
+
+    bool visit_bind(const bind_action_t& /*action*/) {
+        m_count++;
+        return true;
+    }
+
+    bool visit_bind_run(const bind_action_t& /*action*/, uint64_t count, uint64_t /*stride*/) {
+        m_count += count;
+        return true;
+    }
+
+    uint64_t getCount() const {
+        return m_count;
+    }
+
+private:
+    uint64_t m_count;
+};
+
+/* Counts rebased pointers from the runs, never expanding them */
+class RebaseCounter : public RebaseVisitor
+{
+public:
+    RebaseCounter()
+        : m_count(0)
+    {
+    }
+
+    bool visit_run(const rebase_run_t& run) {
+        m_count += run.count;
+        return true;
+    }
+
+    uint64_t getCount() const {
+        return m_count;
+    }
+
+private:
+    uint64_t m_count;
+};
+
+typedef struct fixup_counts {
+    uint64_t    binds;
+    uint64_t    rebases;
+} fixup_counts_t;
+
+static bool count_binds(const MachOFile& machoFile, fixup_counts_t* counts)
+{
+    BindCounter counter;
+    RebaseCounter rebases;
+    bool success = machoFile.visit_binds(NodeTypeBind, counter)
+                && machoFile.visit_binds(NodeTypeWeakBind, counter)
+                && machoFile.visit_binds(NodeTypeLazyBind, counter)
+                && machoFile.visit_rebases(rebases);
+
+    counts->binds += counter.getCount();
+    counts->rebases += rebases.getCount();
+    return success;
+}
+
+typedef struct bind_table_stats {
+    uint64_t    binds;
+    uint64_t    records;
+    uint64_t    bytes;      // held by the tables
+    uint64_t    actions;    // bind_action_t bytes for the same binds
+} bind_table_stats_t;
+
+static bool build_bind_tables(const MachOFile& machoFile, bind_table_stats_t* stats)
+{
+    static const BindNodeType nodeTypes[] = {NodeTypeBind, NodeTypeWeakBind, NodeTypeLazyBind};
+
+    bool success = true;
+    for (size_t i = 0; i < sizeof(nodeTypes) / sizeof(nodeTypes[0]); i++) {
+        BindTable table;
+        success = table.build(machoFile, nodeTypes[i]) && success;
+
+        stats->binds += table.getBindCount();
+        stats->records += table.getRecords().size();
+        stats->bytes += table.getMemoryUsage();
+        stats->actions += table.getBindCount() * sizeof(bind_action_t);
+    }
+
+    return success;
+}
+
+typedef struct signature_stats {
+    uint64_t    images;     // signed ones
+    uint64_t    pages;
+    uint64_t    bad_pages;
+    uint64_t    bytes;      // hashed
+} signature_stats_t;
+
+/* Checks the pages against the directory the loader would use, unsigned images pass */
+static bool verify_signature(const MachOFile& machoFile, signature_stats_t* stats)
+{
+    CodeSignature signature = machoFile.getCodeSignature();
+    if (signature.empty()) {
+        return true;
+    }
+
+    const code_directory_t* directory = signature.init() ? signature.getBestCodeDirectory() : NULL;
+    if (directory == NULL) {
+        return false;
+    }
+
+    std::vector<uint32_t> badPages;
+    bool success = machoFile.verify_code_pages(*directory, badPages);
+
+    stats->images++;
+    stats->pages += directory->nCodeSlots;
+    stats->bad_pages += badPages.size();
+    stats->bytes += directory->codeLimit;
+    return success;
+}
+
+// binds != NULL also counts the binds and rebases of the file (or of each slice), tables != NULL builds their BindTables,
+// signatures != NULL verifies their code signatures
+static bool parse_one(MachOFile& machoFile, const char* path, fixup_counts_t* binds, bind_table_stats_t* tables, signature_stats_t* signatures)
+{
+    if (!machoFile.parse_file(path)) {
+        return false;
+    }
+
+    /* Universal files only enumerate their slices, parse them too */
+    bool parsed = true;
+    if (machoFile.isUniversal()) {
+        macho_files_t slices;
+        parsed = machoFile.parse_slices(slices, machoFile.getThreadPool());
+        
+        macho_files_t::iterator iter;
+        for (iter = slices.begin(); iter != slices.end(); iter++) {
+            if (binds != NULL && *iter != NULL) {
+                parsed = count_binds(**iter, binds) && parsed;
+            }
+            if (tables != NULL && *iter != NULL) {
+                parsed = build_bind_tables(**iter, tables) && parsed;
+            }
+            if (signatures != NULL && *iter != NULL) {
+                parsed = verify_signature(**iter, signatures) && parsed;
+            }
+            delete *iter;
+        }
+    } else {
+        if (binds != NULL) {
+            parsed = count_binds(machoFile, binds) && parsed;
+        }
+        if (tables != NULL) {
+            parsed = build_bind_tables(machoFile, tables) && parsed;
+        }
+        if (signatures != NULL) {
+            parsed = verify_signature(machoFile, signatures) && parsed;
+        }
+    }
+
+    return parsed;
+}
+
+static void usage(const char* progname)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-l | -H] [-R] [-j threads] [-B] [-T] [-C] <directory>\n"
+                    "  -l  lazy mode, leave symbols, binds and exports undecoded\n"
+                    "  -H  headers only, pread the load commands and map nothing\n"
+                    "  -R  reuse one MachOFile, reset() between files\n"
+                    "  -j  decode slices and large export tries, and hash code pages, on a pool of threads\n"
+                    "  -B  count binds and rebases with visit_binds()/visit_rebases() on a lazy parse instead of decoding them\n"
+                    "  -T  build a compact BindTable per bind stream on a lazy parse, report its size\n"
+                    "  -C  verify the code signature pages on a lazy parse, report the hashing rate\n", progname);
+}
+
+int main(int argc, const char * argv[])
+{
+    int iterations = 1;
+    uint32_t options = ParseOptionNone;
+    bool reuse = false;
+    int threads = 0;
+    bool countBinds = false;
+    bool bindTables = false;
+    bool signatures = false;
+    const char* root = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0) {
+            options |= ParseOptionLazyLinkedit;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            options |= ParseOptionHeadersOnly;
+        } else if (strcmp(argv[i], "-R") == 0) {
+            reuse = true;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-B") == 0) {
+            countBinds = true;
+            options |= ParseOptionLazyLinkedit;
+        } else if (strcmp(argv[i], "-T") == 0) {
+            bindTables = true;
+            options |= ParseOptionLazyLinkedit;
+        } else if (strcmp(argv[i], "-C") == 0) {
+            signatures = true;
+            options |= ParseOptionLazyLinkedit;
+        } else if (root == NULL) {
+            root = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (root == NULL || iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bench_files_t files;
+    collect_files(root, files);
+    if (files.empty()) {
+        fprintf(stderr, "no files found under %s\n", root);
+        return 1;
+    }
+
+    uint64_t totalFiles = 0;
+    uint64_t totalParsed = 0;
+    uint64_t totalBytes = 0;
+    fixup_counts_t totalBinds = { 0, 0 };
+    fixup_counts_t* binds = countBinds ? &totalBinds : NULL;
+    bind_table_stats_t tableStats = { 0, 0, 0, 0 };
+    bind_table_stats_t* tables = bindTables ? &tableStats : NULL;
+    signature_stats_t signatureStats = { 0, 0, 0, 0 };
+    signature_stats_t* verify = signatures ? &signatureStats : NULL;
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 0) {
+        pool.reset(new ThreadPool(threads));
+    }
+
+    MachOFile shared(options);
+    shared.setThreadPool(pool.get());
+
+    double start = now_seconds();
+    uint64_t startAllocations = g_allocations.load();
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        bench_files_t::const_iterator iter;
+        for (iter = files.begin(); iter != files.end(); iter++) {
+            bool parsed;
+            if (reuse) {
+                parsed = parse_one(shared, iter->path.c_str(), binds, tables, verify);
+                shared.reset();
+            } else {
+                MachOFile machoFile(options);
+                machoFile.setThreadPool(pool.get());
+                parsed = parse_one(machoFile, iter->path.c_str(), binds, tables, verify);
+            }
+
+            if (parsed) {
+                totalParsed++;
+            }
+
+            totalFiles++;
+            totalBytes += iter->size;
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+    uint64_t allocations = g_allocations.load() - startAllocations;
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+
+    printf("Files     : %llu (%llu parsed as Mach-O)\n", (unsigned long long)totalFiles, (unsigned long long)totalParsed);
+    printf("Bytes     : %llu\n", (unsigned long long)totalBytes);
+    printf("Time      : %.3f s\n", elapsed);
+    printf("Files/sec : %.1f\n", totalFiles / elapsed);
+    printf("MB/sec    : %.1f\n", totalBytes / elapsed / (1024.0 * 1024.0));
+    if (countBinds) {
+        printf("Binds     : %llu\n", (unsigned long long)totalBinds.binds);
+        printf("Rebases   : %llu\n", (unsigned long long)totalBinds.rebases);
+    }
+    if (bindTables) {
+        printf("Tables    : %llu binds in %llu records, %llu bytes (%llu as bind_action_t)\n",
+               (unsigned long long)tableStats.binds, (unsigned long long)tableStats.records,
+               (unsigned long long)tableStats.bytes, (unsigned long long)tableStats.actions);
+    }
+    if (signatures) {
+        printf("Signed    : %llu images, %llu pages, %llu modified\n", (unsigned long long)signatureStats.images,
+               (unsigned long long)signatureStats.pages, (unsigned long long)signatureStats.bad_pages);
+        printf("Hashed    : %.1f MB/sec (%s)\n", signatureStats.bytes / elapsed / (1024.0 * 1024.0), sha_implementation());
+    }
+    printf("Allocs    : %llu operator new (%.1f per file)\n", (unsigned long long)allocations, (double)allocations / totalFiles);
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+//
+//  address_index.cpp
+//  machofile
+//
+
+#include <algorithm>
+
+#include "address_index.h"
+#include "machofile.h"
+
+namespace rotg {
+
+    static bool address_less(const address_symbol_t& lhs, const address_symbol_t& rhs) {
+        return lhs.address < rhs.address;
+    }
+
+    static bool address_equal(const address_symbol_t& lhs, const address_symbol_t& rhs) {
+        return lhs.address == rhs.address;
+    }
+
+    AddressIndex::AddressIndex()
+        : m_limit(UINT64_MAX)
+        , m_next(0)
+    {
+    }
+
+    void AddressIndex::build(const MachOFile& file)
+    {
+        m_symbols.clear();
+
+        /* Defined symbols first, so they survive the de-duplication below */
+        const SymbolTable& symbols = file.getSymtabCommandInfo().symbols;
+        for (size_t i = 0; i < symbols.size(); i++) {
+            uint8_t type = symbols.type(i);
+            if ((type & N_STAB) == 0 && (type & N_TYPE) == N_SECT) {
+                address_symbol_t symbol = {symbols.value(i), symbols.name(i)};
+                m_symbols.push_back(symbol);
+            }
+        }
+
+        /* Re-exports and absolute or thread local values are not code or data addresses */
+        const export_actions_t& actions = file.getDyldInfoCommandInfo().loader_info.export_info.actions;
+        export_actions_t::const_iterator iter;
+        for (iter = actions.begin(); iter != actions.end(); iter++) {
+            if ((iter->flags & EXPORT_SYMBOL_FLAGS_REEXPORT) != 0 ||
+                (iter->flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) != EXPORT_SYMBOL_FLAGS_KIND_REGULAR) {
+                continue;
+            }
+
+            address_symbol_t symbol = {iter->address, iter->symbolName};
+            m_symbols.push_back(symbol);
+        }
+
+        std::stable_sort(m_symbols.begin(), m_symbols.end(), address_less);
+        m_symbols.erase(std::unique(m_symbols.begin(), m_symbols.end(), address_equal), m_symbols.end());
+
+        /* Nothing maps past the last mapped segment (__PAGEZERO maps nothing) */
+        m_limit = UINT64_MAX;
+        const segment_infos_t& segments = file.getSegmentInfos();
+        if (!segments.empty()) {
+            m_limit = 0;
+            segment_infos_t::const_iterator seg_iter;
+            for (seg_iter = segments.begin(); seg_iter != segments.end(); seg_iter++) {
+                if (seg_iter->initprot != 0 && seg_iter->vmaddr + seg_iter->vmsize > m_limit) {
+                    m_limit = seg_iter->vmaddr + seg_iter->vmsize;
+                }
+            }
+        }
+
+        size_t count = m_symbols.size();
+        m_keys.assign(count + 1, 0);
+        m_ranks.assign(count + 1, 0);
+        m_next = 0;
+        layout(1);
+    }
+
+    /* In-order walk of the implicit tree hands out the sorted keys */
+    void AddressIndex::layout(size_t node)
+    {
+        if (node > m_symbols.size()) {
+            return;
+        }
+
+        layout(2 * node);
+        m_keys[node] = m_symbols[m_next].address;
+        m_ranks[node] = (uint32_t)m_next;
+        m_next++;
+        layout(2 * node + 1);
+    }
+
+    const address_symbol_t* AddressIndex::lookup(uint64_t address, uint64_t* offset) const
+    {
+        size_t count = m_symbols.size();
+        if (count == 0 || address >= m_limit) {
+            return NULL;
+        }
+
+        /* Branch free descent: go right while the key is <= address */
+        const uint64_t* keys = m_keys.data();
+        size_t node = 1;
+        while (node <= count) {
+#if defined(__GNUC__)
+            __builtin_prefetch(keys + 16 * node);
+#endif
+            node = 2 * node + (keys[node] <= address);
+        }
+
+        /* Undo the trailing right turns and the last left turn: the first key > address */
+        node >>= __builtin_ffsll(~(long long)node);
+
+        size_t upper = node == 0 ? count : m_ranks[node];
+        if (upper == 0) {
+            return NULL;
+        }
+
+        const address_symbol_t* symbol = &m_symbols[upper - 1];
+        if (offset != NULL) {
+            *offset = address - symbol->address;
+        }
+
+        return symbol;
+    }
+
+}
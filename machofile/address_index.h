@@ -0,0 +1,62 @@
+//
+//  address_index.h
+//  machofile
+//
+//  Address to symbol lookup for symbolication. Defined symtab symbols and
+//  exports are merged into one sorted table, and the addresses are laid
+//  out in Eytzinger (breadth first) order so a lookup walks down a
+//  implicit binary tree whose top levels stay in cache.
+//
+
+#ifndef rotg_address_index_h
+#define rotg_address_index_h
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace rotg {
+
+    class MachOFile;
+
+    typedef struct address_symbol {
+        uint64_t    address;
+        const char* name;       // points into the MachOFile, valid while it is
+    } address_symbol_t;
+
+    class AddressIndex
+    {
+    public:
+        AddressIndex();
+
+        // Index the defined (N_SECT) symbols and regular exports of file,
+        // which must stay alive while the index is used. One name per
+        // address is kept, symtab names win over export names.
+        void build(const MachOFile& file);
+
+        // Symbol at or below address and the distance to it, NULL when the
+        // address is below the first symbol or past the end of the image.
+        const address_symbol_t* lookup(uint64_t address, uint64_t* offset) const;
+
+        size_t size() const {
+            return m_symbols.size();
+        }
+
+        // Sorted by address
+        const std::vector<address_symbol_t>& getSymbols() const {
+            return m_symbols;
+        }
+
+    private:
+        void layout(size_t node);
+
+        std::vector<address_symbol_t>   m_symbols;  // sorted by address
+        std::vector<uint64_t>           m_keys;     // Eytzinger order, 1-based
+        std::vector<uint32_t>           m_ranks;    // m_symbols index of each key
+        uint64_t                        m_limit;    // end of the image
+        size_t                          m_next;     // layout() cursor
+    };
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+//
+//  arena.cpp
+//  machofile
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+namespace rotg {
+
+    /* Blocks double from the initial size up to this, larger requests get a block of their own */
+    static const size_t kMaxBlockSize = 1024 * 1024;
+
+    Arena::Arena(size_t blockSize)
+        : m_block_size(blockSize)
+        , m_first(NULL)
+        , m_current(NULL)
+        , m_cursor(0)
+        , m_limit(0)
+        , m_reserved(0)
+        , m_block_count(0)
+    {
+    }
+
+    Arena::~Arena()
+    {
+        arena_block_t* block = m_first;
+        while (block != NULL) {
+            arena_block_t* next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+
+    void Arena::use_block(arena_block_t* block)
+    {
+        m_current = block;
+        m_cursor = (uintptr_t)(block + 1);
+        m_limit = m_cursor + block->size;
+    }
+
+    void* Arena::allocate_slow(size_t size, size_t alignment)
+    {
+        /* Blocks kept by reset() come first */
+        while (m_current != NULL && m_current->next != NULL) {
+            use_block(m_current->next);
+
+            uintptr_t ptr = (m_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            if (ptr <= m_limit && size <= m_limit - ptr) {
+                m_cursor = ptr + size;
+                return (void*)ptr;
+            }
+        }
+
+        size_t needed = size + alignment;
+        if (needed < size) {
+            throw std::bad_alloc();
+        }
+
+        size_t blockSize = m_block_size;
+        if (blockSize < needed) {
+            blockSize = needed;
+        }
+
+        arena_block_t* block = (arena_block_t*)malloc(sizeof(arena_block_t) + blockSize);
+        if (block == NULL) {
+            throw std::bad_alloc();
+        }
+
+        block->next = NULL;
+        block->size = blockSize;
+
+        if (m_current == NULL) {
+            m_first = block;
+        } else {
+            m_current->next = block;
+        }
+
+        m_reserved += blockSize;
+        m_block_count++;
+
+        if (m_block_size < kMaxBlockSize) {
+            m_block_size *= 2;
+        }
+
+        use_block(block);
+
+        uintptr_t ptr = (m_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        m_cursor = ptr + size;
+        return (void*)ptr;
+    }
+
+    const char* Arena::copy_string(const char* str, size_t length)
+    {
+        char* copy = (char*)allocate(length + 1, 1);
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+        return copy;
+    }
+
+    void Arena::reset()
+    {
+        if (m_first == NULL) {
+            return;
+        }
+
+        use_block(m_first);
+    }
+
+}
@@ -0,0 +1,143 @@
+//
+//  arena.h
+//  machofile
+//
+//  Monotonic memory for parse results. Allocations bump a pointer through
+//  a chain of blocks and are released all at once, when the arena goes
+//  away or by reset(), which keeps the blocks for the next file.
+//
+
+#ifndef rotg_arena_h
+#define rotg_arena_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <type_traits>
+
+namespace rotg {
+
+    class Arena
+    {
+    public:
+        explicit Arena(size_t blockSize = 16 * 1024);
+        ~Arena();
+
+        void* allocate(size_t size, size_t alignment = sizeof(void*)) {
+            uintptr_t ptr = (m_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            if (m_cursor != 0 && ptr <= m_limit && size <= m_limit - ptr) {
+                m_cursor = ptr + size;
+                return (void*)ptr;
+            }
+
+            return allocate_slow(size, alignment);
+        }
+
+        // Construct a T in the arena. Its destructor never runs, so T may only
+        // own memory that comes from this arena as well.
+        template <typename T>
+        T* make() {
+            return new (allocate(sizeof(T), alignof(T))) T();
+        }
+
+        // NUL terminated copy of length bytes of str
+        const char* copy_string(const char* str, size_t length);
+
+        // Forget every allocation; the blocks are kept and handed out again
+        void reset();
+
+        size_t getBytesReserved() const {
+            return m_reserved;
+        }
+
+        size_t getBlockCount() const {
+            return m_block_count;
+        }
+
+    private:
+        Arena(const Arena&);                // declare only, do not allow copy
+        Arena& operator=(const Arena&);     // declare only, do not allow assign
+
+        typedef struct arena_block {
+            struct arena_block* next;
+            size_t              size;       // usable bytes after the header
+        } arena_block_t;
+
+        void* allocate_slow(size_t size, size_t alignment);
+        void use_block(arena_block_t* block);
+
+        size_t          m_block_size;       // size of the next new block, grows up to a cap
+        arena_block_t*  m_first;
+        arena_block_t*  m_current;
+        uintptr_t       m_cursor;
+        uintptr_t       m_limit;
+        size_t          m_reserved;
+        size_t          m_block_count;
+    };
+
+    // Standard allocator on top of an Arena, for the parse result containers.
+    // Without an arena (default constructed) it falls back to the heap.
+    template <typename T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T value_type;
+
+        // containers adopt the arena of whatever they are assigned from
+        typedef std::true_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        ArenaAllocator()
+            : m_arena(NULL)
+        {
+        }
+
+        ArenaAllocator(Arena* arena)
+            : m_arena(arena)
+        {
+        }
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other)
+            : m_arena(other.getArena())
+        {
+        }
+
+        T* allocate(size_t count) {
+            if (m_arena != NULL) {
+                return (T*)m_arena->allocate(count * sizeof(T), alignof(T));
+            }
+
+            return (T*)::operator new(count * sizeof(T));
+        }
+
+        void deallocate(T* ptr, size_t /*count*/) {
+            /* arena memory goes back with the arena */
+            if (m_arena == NULL) {
+                ::operator delete(ptr);
+            }
+        }
+
+        Arena* getArena() const {
+            return m_arena;
+        }
+
+    private:
+        Arena* m_arena;
+    };
+
+    template <typename T, typename U>
+    inline bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+        return lhs.getArena() == rhs.getArena();
+    }
+
+    template <typename T, typename U>
+    inline bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+        return lhs.getArena() != rhs.getArena();
+    }
+
+}
+
+#endif
@@ -0,0 +1,736 @@
+//
+//  batch_scanner.cpp
+//  machofile
+//
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include <dirent.h>
+#include <err.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <exception>
+
+#include "batch_scanner.h"
+
+namespace rotg {
+
+    static uint64_t monotonic_nanoseconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    /* Depth-first walk that holds one sorted directory listing per level,
+       so the visiting order is deterministic and memory does not grow
+       with the size of the tree. */
+    class DirectoryWalker
+    {
+    public:
+        explicit DirectoryWalker(const char* root)
+            : m_root(root)
+            , m_started(false)
+        {
+        }
+
+        bool next(std::string& path, struct stat& stbuf)
+        {
+            if (!m_started) {
+                m_started = true;
+
+                if (stat(m_root.c_str(), &stbuf) != 0) {
+                    return false;
+                }
+
+                if (S_ISREG(stbuf.st_mode)) {
+                    path = m_root;
+                    return true;
+                }
+
+                if (S_ISDIR(stbuf.st_mode)) {
+                    push(m_root);
+                }
+            }
+
+            while (!m_frames.empty()) {
+                frame_t& frame = m_frames.back();
+                if (frame.index >= frame.names.size()) {
+                    m_frames.pop_back();
+                    continue;
+                }
+
+                std::string child = frame.dir + "/" + frame.names[frame.index++];
+
+                if (lstat(child.c_str(), &stbuf) != 0) {
+                    continue;
+                }
+
+                if (S_ISDIR(stbuf.st_mode)) {
+                    push(child);
+                } else if (S_ISREG(stbuf.st_mode)) {
+                    path = child;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        typedef struct frame {
+            std::string                 dir;
+            std::vector<std::string>    names;
+            size_t                      index;
+        } frame_t;
+
+        void push(const std::string& dir)
+        {
+            DIR* d = opendir(dir.c_str());
+            if (d == NULL) {
+                return;
+            }
+
+            frame_t frame;
+            frame.dir = dir;
+            frame.index = 0;
+
+            struct dirent* entry;
+            while ((entry = readdir(d)) != NULL) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                    continue;
+                }
+                frame.names.push_back(entry->d_name);
+            }
+            closedir(d);
+
+            std::sort(frame.names.begin(), frame.names.end());
+            m_frames.push_back(frame);
+        }
+
+        std::string         m_root;
+        bool                m_started;
+        std::vector<frame_t> m_frames;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    static const char* filetype_name(uint32_t filetype)
+    {
+        switch (filetype) {
+            case MH_OBJECT:         return "object";
+            case MH_EXECUTE:        return "execute";
+            case MH_FVMLIB:         return "fvmlib";
+            case MH_CORE:           return "core";
+            case MH_PRELOAD:        return "preload";
+            case MH_DYLIB:          return "dylib";
+            case MH_DYLINKER:       return "dylinker";
+            case MH_BUNDLE:         return "bundle";
+            case MH_DYLIB_STUB:     return "dylib_stub";
+            case MH_DSYM:           return "dsym";
+            case MH_KEXT_BUNDLE:    return "kext_bundle";
+            case MH_FILESET:        return "fileset";
+        }
+
+        return "unknown";
+    }
+
+    static bool is_macho_magic(const macho_input_t& input)
+    {
+        if (input.length < sizeof(uint32_t)) {
+            return false;
+        }
+
+        uint32_t magic;
+        memcpy(&magic, input.data, sizeof(magic));
+
+        switch (magic) {
+            case MH_MAGIC:
+            case MH_CIGAM:
+            case MH_MAGIC_64:
+            case MH_CIGAM_64:
+            case FAT_MAGIC:
+            case FAT_CIGAM:
+                return true;
+        }
+
+        return false;
+    }
+
+    /* An inventory line up to the dylib list, which the caller appends */
+    static void format_headers_line(const std::string& path, const arch_info_t* archInfo, uint32_t filetype, const std::string& uuid,
+                                    uint32_t versionCmd, uint32_t platform, uint32_t minos, uint32_t cryptid, std::string& out)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "\t%s\t%s\tuuid=%s\tplatform=%s\tminos=%u.%u.%u\tencrypted=%u\tdylibs=",
+                 archInfo ? archInfo->name : "unknown",
+                 filetype_name(filetype),
+                 uuid.empty() ? "-" : uuid.c_str(),
+                 versionCmd ? get_platform_name(platform) : "-",
+                 minos >> 16, (minos >> 8) & 0xff, minos & 0xff,
+                 cryptid);
+
+        out += path;
+        out += line;
+    }
+
+    static void format_image_line(const std::string& path, const arch_info_t* archInfo, uint32_t filetype, uint32_t ncmds,
+                                  size_t dylibs, size_t symbols, size_t binds, size_t exports, std::string& out)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "\t%s\t%s\tcmds=%u\tdylibs=%zu\tsymbols=%zu\tbinds=%zu\texports=%zu\n",
+                 archInfo ? archInfo->name : "unknown",
+                 filetype_name(filetype),
+                 ncmds, dylibs, symbols, binds, exports);
+
+        out += path;
+        out += line;
+    }
+
+    static void format_headers(MachOFile& machoFile, const std::string& path, std::string& out)
+    {
+        const struct mach_header* header = machoFile.getHeader();
+        const version_min_info_t& version = machoFile.getVersionMinInfo();
+
+        format_headers_line(path, machoFile.getArchInfo(), machoFile.read32(header->filetype), machoFile.getUUIDString(),
+                            version.cmd_type, version.platform, version.minos, machoFile.getEncryptionInfo().cryptid, out);
+
+        /* dependencies and run paths as comma separated lists */
+        const dylib_command_infos_t& dylibs = machoFile.getDylibCommandInfos();
+        bool first = true;
+        dylib_command_infos_t::const_iterator dylib_iter;
+        for (dylib_iter = dylibs.begin(); dylib_iter != dylibs.end(); dylib_iter++) {
+            if ((*dylib_iter)->cmd_type == LC_ID_DYLIB) {
+                continue;
+            }
+            if (!first) {
+                out += ',';
+            }
+            out += (*dylib_iter)->libname;
+            first = false;
+        }
+
+        out += "\trpaths=";
+
+        const runpath_additions_infos_t& rpaths = machoFile.getRunpathAdditionsInfos();
+        runpath_additions_infos_t::const_iterator rpath_iter;
+        for (rpath_iter = rpaths.begin(); rpath_iter != rpaths.end(); rpath_iter++) {
+            if (rpath_iter != rpaths.begin()) {
+                out += ',';
+            }
+            out += rpath_iter->path;
+        }
+
+        out += '\n';
+    }
+
+    // what an image's line reports of its LINKEDIT
+    typedef struct image_counts {
+        size_t      symbols;
+        uint64_t    binds;
+        uint64_t    exports;
+    } image_counts_t;
+
+    /* Counts one bind stream, a DO_BIND_ULEB_TIMES_SKIPPING_ULEB run in one step, keeping no binds */
+    class BindCounter : public BindVisitor
+    {
+    public:
+        explicit BindCounter(const MachOFile& file)
+            : m_file(file)
+            , m_count(0)
+            , m_overflowed(false)
+        {
+        }
+
+        bool visit_bind(const bind_action_t& /*action*/) {
+            m_count++;
+            return true;
+        }
+
+        /* Refused where BindCollector refuses it, so the scan fails the files a full decode fails */
+        bool visit_bind_run(const bind_action_t& action, uint64_t count, uint64_t /*stride*/) {
+            if (!m_file.bind_run_fits(action, count)) {
+                warnx("Bind run of %llu binds larger than its segment", (unsigned long long)count);
+                m_overflowed = true;
+                return false;
+            }
+
+            m_count += count;
+            return true;
+        }
+
+        uint64_t count() const {
+            return m_count;
+        }
+
+        bool overflowed() const {
+            return m_overflowed;
+        }
+
+    private:
+        const MachOFile&    m_file;
+        uint64_t            m_count;
+        bool                m_overflowed;
+    };
+
+    /* The line does not report rebases; walking them checks the stream as a full decode does */
+    class RebaseChecker : public RebaseVisitor
+    {
+    public:
+        bool visit_run(const rebase_run_t& /*run*/) {
+            return true;
+        }
+    };
+
+    /* Read the LINKEDIT of a lazily parsed image for its line. Binds and exports are
+       counted, not kept, so memory does not grow with them. False if it is malformed. */
+    static bool count_image(const MachOFile& machoFile, image_counts_t* counts)
+    {
+        memset(counts, 0, sizeof(*counts));
+
+        /* Nothing below the load commands was read */
+        if (machoFile.getParseOptions() & ParseOptionHeadersOnly) {
+            return true;
+        }
+
+        if (!machoFile.decode_symbols()) {
+            return false;
+        }
+        counts->symbols = machoFile.getSymtabCommandInfo().symbols.size();
+
+        RebaseChecker rebases;
+        if (!machoFile.visit_rebases(rebases)) {
+            return false;
+        }
+
+        const BindNodeType nodeTypes[] = { NodeTypeBind, NodeTypeWeakBind, NodeTypeLazyBind };
+        for (size_t s = 0; s < sizeof(nodeTypes) / sizeof(nodeTypes[0]); s++) {
+            BindCounter binds(machoFile);
+            if (!machoFile.visit_binds(nodeTypes[s], binds) || binds.overflowed()) {
+                return false;
+            }
+            counts->binds += binds.count();
+        }
+
+        return machoFile.count_exports(&counts->exports);
+    }
+
+    static void format_image(MachOFile& machoFile, const image_counts_t& counts, const std::string& path, std::string& out)
+    {
+        /* Nothing below the load commands was read */
+        if (machoFile.getParseOptions() & ParseOptionHeadersOnly) {
+            format_headers(machoFile, path, out);
+            return;
+        }
+
+        const struct mach_header* header = machoFile.getHeader();
+
+        format_image_line(path, machoFile.getArchInfo(), machoFile.read32(header->filetype), machoFile.read32(header->ncmds),
+                          machoFile.getDylibCommandInfos().size(), counts.symbols, (size_t)counts.binds, (size_t)counts.exports, out);
+    }
+
+    /* The same lines as format_image(), from a cache entry read in place */
+    static void format_cached_image(const parse_cache_entry_t* entry, const parse_cache_image_t& image, const std::string& path, std::string& out)
+    {
+        const arch_info_t* archInfo = get_arch_info(image.cputype, image.cpusubtype);
+
+        if (!(entry->parse_options & ParseOptionHeadersOnly)) {
+            format_image_line(path, archInfo, image.filetype, image.ncmds, image.dylibs.count,
+                              image.symbols.count, (size_t)image.bind_count, image.exports.count, out);
+            return;
+        }
+
+        std::string uuid = image.has_uuid ? MachOFile::format_uuid(image.uuid) : std::string();
+        format_headers_line(path, archInfo, image.filetype, uuid, image.version_cmd, image.platform, image.minos, image.cryptid, out);
+
+        const parse_cache_dylib_t* dylibs = ParseCache::table<parse_cache_dylib_t>(entry, image.dylibs);
+        bool first = true;
+        for (uint32_t i = 0; i < image.dylibs.count; i++) {
+            if (dylibs[i].cmd_type == LC_ID_DYLIB) {
+                continue;
+            }
+            if (!first) {
+                out += ',';
+            }
+            out += ParseCache::string(entry, dylibs[i].name);
+            first = false;
+        }
+
+        out += "\trpaths=";
+
+        const parse_cache_rpath_t* rpaths = ParseCache::table<parse_cache_rpath_t>(entry, image.rpaths);
+        for (uint32_t i = 0; i < image.rpaths.count; i++) {
+            if (i != 0) {
+                out += ',';
+            }
+            out += ParseCache::string(entry, rpaths[i].path);
+        }
+
+        out += '\n';
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    void BatchScanner::default_options(batch_options_t* options)
+    {
+        options->threads = 0;
+        options->max_in_flight = 0;
+        options->prefault = true;
+        options->parse_options = ParseOptionNone;
+        options->cache_path = NULL;
+    }
+
+    BatchScanner::BatchScanner(const batch_options_t& options)
+        : m_options(options)
+        , m_pool(options.threads)
+    {
+        m_options.threads = m_pool.size();
+        if (m_options.max_in_flight == 0) {
+            m_options.max_in_flight = 4 * m_options.threads;
+        }
+
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+    BatchScanner::~BatchScanner()
+    {
+    }
+
+    bool BatchScanner::process_cached(batch_slot_t* slot, batch_counters_t* counters)
+    {
+        uint64_t start = monotonic_nanoseconds();
+
+        const parse_cache_entry_t* entry = m_cache.find(slot->key, m_options.parse_options);
+        if (entry == NULL) {
+            return false;
+        }
+
+        slot->cached = entry;
+
+        switch (entry->status) {
+            case ParseCacheNotMachO:
+                counters->files_skipped++;
+                break;
+
+            case ParseCacheMalformed:
+                counters->files_failed++;
+                slot->output = slot->path + "\terror: malformed Mach-O\n";
+                break;
+
+            default: {
+                const parse_cache_image_t* images = ParseCache::images(entry);
+                for (uint32_t i = 0; i < entry->images.count; i++) {
+                    format_cached_image(entry, images[i], slot->path, slot->output);
+                }
+            } break;
+        }
+
+        counters->cache.files++;
+        counters->cache.bytes += slot->size;
+        counters->cache.nanoseconds += monotonic_nanoseconds() - start;
+        return true;
+    }
+
+    void BatchScanner::process(batch_slot_t* slot, batch_counters_t* counters, MachOFile& machoFile)
+    {
+        /* cache: a file unchanged since it was cached is not opened at all */
+        if (m_options.cache_path != NULL && process_cached(slot, counters)) {
+            return;
+        }
+
+        /* read: open, map and (optionally) fault in the file */
+        uint64_t start = monotonic_nanoseconds();
+
+        bool loaded = machoFile.load_file(slot->path.c_str());
+        bool isMachO = loaded && is_macho_magic(machoFile.getInput());
+
+        if (isMachO && m_options.prefault) {
+            const macho_input_t& input = machoFile.getInput();
+            const volatile uint8_t* bytes = (const volatile uint8_t*)input.data;
+            uint8_t sum = 0;
+            for (size_t offset = 0; offset < input.length; offset += 4096) {
+                sum += bytes[offset];
+            }
+            (void)sum;
+        }
+
+        uint64_t readDone = monotonic_nanoseconds();
+        counters->read.files++;
+        counters->read.bytes += slot->size;
+        counters->read.nanoseconds += readDone - start;
+
+        if (!isMachO) {
+            if (loaded) {
+                counters->files_skipped++;
+                if (m_options.cache_path != NULL) {
+                    ParseCache::encode_status(slot->key, ParseCacheNotMachO, m_options.parse_options, slot->entry);
+                }
+            } else {
+                counters->files_failed++;
+                slot->output = slot->path + "\terror: cannot read\n";
+            }
+            return;
+        }
+
+        /* parse: the file itself and, for universal files, each slice */
+        bool parsed = machoFile.parse_macho(&machoFile.getInput());
+
+        macho_files_t slices;
+        if (parsed && machoFile.isUniversal()) {
+            parsed = machoFile.parse_slices(slices, &m_pool);
+        }
+
+        /* The parse is lazy: the symbols, binds and exports of each image are read here */
+        image_counts_t counts;
+        std::vector<image_counts_t> sliceCounts;
+        if (parsed && machoFile.isUniversal()) {
+            macho_files_t::iterator iter;
+            for (iter = slices.begin(); iter != slices.end() && parsed; iter++) {
+                parsed = count_image(**iter, &counts);
+                sliceCounts.push_back(counts);
+            }
+        } else if (parsed) {
+            parsed = count_image(machoFile, &counts);
+        }
+
+        uint64_t parseDone = monotonic_nanoseconds();
+        counters->parse.files++;
+        counters->parse.bytes += slot->size;
+        counters->parse.nanoseconds += parseDone - readDone;
+
+        /* format */
+        if (!parsed) {
+            counters->files_failed++;
+            slot->output = slot->path + "\terror: malformed Mach-O\n";
+        } else if (machoFile.isUniversal()) {
+            for (size_t i = 0; i < slices.size(); i++) {
+                format_image(*slices[i], sliceCounts[i], slot->path, slot->output);
+            }
+        } else {
+            format_image(machoFile, counts, slot->path, slot->output);
+        }
+
+        /* The next scan gets this file from the cache, failed parses included */
+        if (m_options.cache_path != NULL) {
+            if (!parsed) {
+                ParseCache::encode_status(slot->key, ParseCacheMalformed, m_options.parse_options, slot->entry);
+            } else {
+                ParseCache::encode(slot->key, machoFile, slices, slot->entry);
+            }
+        }
+
+        macho_files_t::iterator iter;
+        for (iter = slices.begin(); iter != slices.end(); iter++) {
+            delete *iter;
+        }
+
+        uint64_t formatDone = monotonic_nanoseconds();
+        counters->format.files++;
+        counters->format.bytes += slot->output.size();
+        counters->format.nanoseconds += formatDone - parseDone;
+    }
+
+    void BatchScanner::emit(batch_slot_t* slot, FILE* output, ParseCacheWriter* cacheWriter)
+    {
+        uint64_t start = monotonic_nanoseconds();
+
+        if (!slot->output.empty()) {
+            fwrite(slot->output.data(), 1, slot->output.size(), output);
+        }
+
+        /* The new cache keeps the files of this scan, in walk order */
+        if (cacheWriter != NULL) {
+            if (slot->cached != NULL) {
+                cacheWriter->add(slot->cached);
+            } else if (!slot->entry.empty()) {
+                cacheWriter->add(slot->entry);
+            }
+        }
+
+        m_stats.write.files++;
+        m_stats.write.bytes += slot->output.size();
+        m_stats.write.nanoseconds += monotonic_nanoseconds() - start;
+
+        /* Drop the buffers so memory stays flat across the scan */
+        std::string().swap(slot->output);
+        std::string().swap(slot->path);
+        std::string().swap(slot->entry);
+    }
+
+    bool BatchScanner::scan(const char* root, FILE* output)
+    {
+        uint64_t start = monotonic_nanoseconds();
+
+        size_t window = m_options.max_in_flight;
+        m_slots.assign(window, batch_slot_t());
+        m_counters.assign(window, batch_counters_t());
+        memset(&m_counters[0], 0, window * sizeof(batch_counters_t));
+
+        m_files.clear();
+        m_files.reserve(window);
+        for (size_t i = 0; i < window; i++) {
+            m_files.emplace_back(m_options.parse_options | ParseOptionLazyLinkedit);
+        }
+
+        /* Entries of the old cache are written to the new one from its mapping, it stays open until then */
+        ParseCacheWriter* cacheWriter = NULL;
+        if (m_options.cache_path != NULL) {
+            m_cache.open(m_options.cache_path);
+            cacheWriter = new ParseCacheWriter(m_options.cache_path, m_cache);
+        }
+
+        DirectoryWalker walker(root);
+
+        uint64_t submitted = 0;
+        uint64_t emitted = 0;
+        bool walking = true;
+
+        while (true) {
+            /* Feed the pipeline until the window is full */
+            while (walking && submitted - emitted < window) {
+                std::string path;
+                struct stat stbuf;
+                if (!walker.next(path, stbuf)) {
+                    walking = false;
+                    break;
+                }
+
+                size_t index = submitted % window;
+                batch_slot_t* slot = &m_slots[index];
+                batch_counters_t* counters = &m_counters[index];
+                MachOFile* machoFile = &m_files[index];
+                slot->path.swap(path);
+                slot->size = stbuf.st_size;
+                ParseCache::make_key(stbuf, &slot->key);
+                slot->cached = NULL;
+                slot->entry.clear();
+                slot->output.clear();
+                slot->ready = false;
+
+                m_pool.submit([this, slot, counters, machoFile]() {
+                    /* A file that makes the parser throw fails on its own, the scan goes on */
+                    try {
+                        process(slot, counters, *machoFile);
+                    } catch (const std::exception& e) {
+                        warnx("%s: %s", slot->path.c_str(), e.what());
+                        counters->files_failed++;
+                        slot->output = slot->path + "\terror: malformed Mach-O\n";
+                        slot->cached = NULL;
+                        slot->entry.clear();
+                    }
+
+                    /* Unmap now, the parse buffers stay warm for the next file of this slot */
+                    machoFile->reset();
+
+                    std::lock_guard<std::mutex> guard(m_lock);
+                    slot->ready = true;
+                    m_slot_ready.notify_all();
+                });
+
+                submitted++;
+            }
+
+            if (emitted == submitted) {
+                break;
+            }
+
+            /* Emit strictly in walk order */
+            batch_slot_t* slot = &m_slots[emitted % window];
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+                while (!slot->ready) {
+                    m_slot_ready.wait(lock);
+                }
+            }
+
+            emit(slot, output, cacheWriter);
+            emitted++;
+        }
+
+        m_pool.wait();
+
+        bool cacheWritten = true;
+        if (cacheWriter != NULL) {
+            uint64_t writeStart = monotonic_nanoseconds();
+            cacheWritten = cacheWriter->finish();
+            m_stats.write.nanoseconds += monotonic_nanoseconds() - writeStart;
+
+            if (!cacheWritten) {
+                warnx("Cannot write the parse cache %s", m_options.cache_path);
+            }
+
+            delete cacheWriter;
+            m_cache.close();
+        }
+
+        /* Merge the per-slot counters */
+        std::vector<batch_counters_t>::const_iterator iter;
+        for (iter = m_counters.begin(); iter != m_counters.end(); iter++) {
+            m_stats.cache.files += iter->cache.files;
+            m_stats.cache.bytes += iter->cache.bytes;
+            m_stats.cache.nanoseconds += iter->cache.nanoseconds;
+            m_stats.read.files += iter->read.files;
+            m_stats.read.bytes += iter->read.bytes;
+            m_stats.read.nanoseconds += iter->read.nanoseconds;
+            m_stats.parse.files += iter->parse.files;
+            m_stats.parse.bytes += iter->parse.bytes;
+            m_stats.parse.nanoseconds += iter->parse.nanoseconds;
+            m_stats.format.files += iter->format.files;
+            m_stats.format.bytes += iter->format.bytes;
+            m_stats.format.nanoseconds += iter->format.nanoseconds;
+            m_stats.files_failed += iter->files_failed;
+            m_stats.files_skipped += iter->files_skipped;
+        }
+
+        m_stats.threads = m_options.threads;
+        m_stats.wall_nanoseconds += monotonic_nanoseconds() - start;
+
+        fflush(output);
+
+        return m_stats.files_failed == 0 && cacheWritten;
+    }
+
+    static void print_stage(FILE* out, const char* name, const batch_stage_stats_t& stage, uint64_t totalBusy)
+    {
+        double seconds = stage.nanoseconds / 1e9;
+        double share = totalBusy ? (100.0 * stage.nanoseconds / totalBusy) : 0.0;
+        double rate = seconds > 0 ? stage.files / seconds : 0.0;
+        double mbps = seconds > 0 ? stage.bytes / seconds / (1024.0 * 1024.0) : 0.0;
+
+        fprintf(out, "%-8s %10" PRIu64 " %12.3f %7.1f%% %12.1f %10.1f\n", name, stage.files, seconds, share, rate, mbps);
+    }
+
+    void BatchScanner::printStats(FILE* out) const
+    {
+        uint64_t totalBusy = m_stats.cache.nanoseconds + m_stats.read.nanoseconds + m_stats.parse.nanoseconds
+                           + m_stats.format.nanoseconds + m_stats.write.nanoseconds;
+
+        fprintf(out, "%-8s %10s %12s %8s %12s %10s\n", "Stage", "Files", "Busy (s)", "Share", "Files/s", "MB/s");
+        if (m_options.cache_path != NULL) {
+            print_stage(out, "cache", m_stats.cache, totalBusy);
+        }
+        print_stage(out, "read", m_stats.read, totalBusy);
+        print_stage(out, "parse", m_stats.parse, totalBusy);
+        print_stage(out, "format", m_stats.format, totalBusy);
+        print_stage(out, "write", m_stats.write, totalBusy);
+
+        double wall = m_stats.wall_nanoseconds / 1e9;
+        if (wall <= 0) {
+            wall = 1e-9;
+        }
+
+        /* Files answered from the cache count as scanned */
+        uint64_t files = m_stats.cache.files + m_stats.read.files;
+        uint64_t bytes = m_stats.cache.bytes + m_stats.read.bytes;
+
+        fprintf(out, "Wall     %" PRIu64 " files (%" PRIu64 " skipped, %" PRIu64 " failed) in %.3f s on %zu threads: %.1f files/s, %.1f MB/s\n",
+                files, m_stats.files_skipped, m_stats.files_failed, wall, m_stats.threads,
+                files / wall, bytes / wall / (1024.0 * 1024.0));
+    }
+
+}
@@ -0,0 +1,116 @@
+//
+//  batch_scanner.h
+//  machofile
+//
+//  Scans a directory tree with a pool of MachOFile workers. Files flow
+//  through a bounded read -> parse -> format pipeline and results are
+//  written in directory walk order, whatever order the workers finish in.
+//  With a parse cache, files whose stat has not changed are formatted from
+//  their cache entry without being opened, and the cache is rewritten with
+//  the files of the scan when anything changed.
+//
+
+#ifndef rotg_batch_scanner_h
+#define rotg_batch_scanner_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "machofile.h"
+#include "parse_cache.h"
+#include "thread_pool.h"
+
+namespace rotg {
+
+    typedef struct batch_options {
+        size_t  threads;        // worker threads, 0 = one per cpu
+        size_t  max_in_flight;  // files between walk and output, 0 = 4 per thread
+        bool    prefault;       // touch every page in the read stage so I/O is accounted there
+        uint32_t parse_options; // ParseOptions for every file, headers-only prints an inventory line
+        const char* cache_path; // parse cache to answer unchanged files from and refresh, NULL for none
+    } batch_options_t;
+
+    typedef struct batch_stage_stats {
+        uint64_t files;
+        uint64_t bytes;
+        uint64_t nanoseconds;   // busy time, summed over all threads
+    } batch_stage_stats_t;
+
+    typedef struct batch_stats {
+        batch_stage_stats_t cache;          // files answered from the parse cache, never read
+        batch_stage_stats_t read;
+        batch_stage_stats_t parse;
+        batch_stage_stats_t format;
+        batch_stage_stats_t write;
+        uint64_t            files_failed;
+        uint64_t            files_skipped;  // not a Mach-O file
+        uint64_t            wall_nanoseconds;
+        size_t              threads;
+    } batch_stats_t;
+
+    class BatchScanner
+    {
+    public:
+        explicit BatchScanner(const batch_options_t& options);
+        ~BatchScanner();
+
+        // Scan every regular file below root (or root itself) and write one
+        // line per Mach-O image to output.
+        bool scan(const char* root, FILE* output);
+
+        const batch_stats_t& getStats() const {
+            return m_stats;
+        }
+
+        void printStats(FILE* out) const;
+
+        static void default_options(batch_options_t* options);
+
+    private:
+        BatchScanner(const BatchScanner&);              // declare only, do not allow copy
+        BatchScanner& operator=(const BatchScanner&);   // declare only, do not allow assign
+
+        typedef struct batch_slot {
+            std::string                 path;
+            uint64_t                    size;
+            parse_cache_key_t           key;
+            const parse_cache_entry_t*  cached;     // the entry the output came from, NULL if the file was parsed
+            std::string                 entry;      // the parse encoded for the new cache
+            std::string                 output;
+            bool                        ready;
+        } batch_slot_t;
+
+        typedef struct batch_counters {
+            batch_stage_stats_t cache;
+            batch_stage_stats_t read;
+            batch_stage_stats_t parse;
+            batch_stage_stats_t format;
+            uint64_t            files_failed;
+            uint64_t            files_skipped;
+        } batch_counters_t;
+
+        void process(batch_slot_t* slot, batch_counters_t* counters, MachOFile& machoFile);
+        bool process_cached(batch_slot_t* slot, batch_counters_t* counters);
+        void emit(batch_slot_t* slot, FILE* output, ParseCacheWriter* cacheWriter);
+
+        batch_options_t                 m_options;
+        ThreadPool                      m_pool;
+
+        std::vector<batch_slot_t>       m_slots;
+        std::mutex                      m_lock;
+        std::condition_variable         m_slot_ready;
+
+        std::vector<batch_counters_t>   m_counters;     // one per in-flight slot, merged at the end
+        std::vector<MachOFile>          m_files;        // one per in-flight slot, reset() between files
+        ParseCache                      m_cache;        // the cache as the scan found it, read only while it runs
+        batch_stats_t                   m_stats;
+    };
+
+}
+
+#endif
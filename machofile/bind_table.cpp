@@ -0,0 +1,222 @@
+//
+//  bind_table.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "bind_table.h"
+#include "name_index.h"
+
+namespace rotg {
+
+    /* Feeds a decoded stream to BindTable::add() and add_run() */
+    class BindTableBuilder : public BindVisitor
+    {
+    public:
+        explicit BindTableBuilder(BindTable* table)
+            : m_table(table)
+        {
+        }
+
+        bool visit_bind(const bind_action_t& action) {
+            m_table->add(action);
+            return true;
+        }
+
+        bool visit_bind_run(const bind_action_t& action, uint64_t count, uint64_t stride) {
+            m_table->add_run(action, count, stride);
+            return true;
+        }
+
+    private:
+        BindTable* m_table;
+    };
+
+    static uint64_t target_hash(const char* name, int64_t libOrdinal, int64_t addend)
+    {
+        uint64_t hash = hash_name(name, strlen(name));
+        hash ^= (uint64_t)libOrdinal * 0x9E3779B97F4A7C15ULL;
+        hash ^= (uint64_t)addend * 0xC2B2AE3D27D4EB4FULL;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    BindTable::BindTable()
+        : m_bind_count(0)
+        , m_node_type(NodeTypeBind)
+        , m_ptr_size(sizeof(uint64_t))
+    {
+    }
+
+    bool BindTable::build(const MachOFile& file, BindNodeType nodeType)
+    {
+        clear();
+        m_node_type = nodeType;
+        m_ptr_size = file.is64bit() ? sizeof(uint64_t) : sizeof(uint32_t);
+
+        BindTableBuilder builder(this);
+        bool success = file.visit_binds(nodeType, builder);
+
+        finish();
+        return success;
+    }
+
+    void BindTable::add(const bind_action_t& action)
+    {
+        m_bind_count++;
+
+        const char* name = action.symbolName != NULL ? action.symbolName : "";
+        uint32_t target = intern(name, (int64_t)action.libOrdinal, action.addend);
+        uint8_t type = (uint8_t)action.type;
+        uint8_t flags = (uint8_t)action.flags;
+
+        /* Same target further on: start a run, or extend one whose stride it keeps */
+        if (!m_records.empty()) {
+            bind_record_t& last = m_records.back();
+            if (last.target == target && last.type == type && last.flags == flags && action.address > last.address) {
+                uint64_t delta = action.address - last.address;
+
+                if (last.count == 1 && delta <= UINT32_MAX) {
+                    last.stride = (uint32_t)delta;
+                    last.count = 2;
+                    return;
+                }
+
+                if (last.count > 1 && last.count < UINT32_MAX && delta == (uint64_t)last.count * last.stride) {
+                    last.count++;
+                    return;
+                }
+            }
+        }
+
+        bind_record_t record;
+        record.address = action.address;
+        record.target = target;
+        record.count = 1;
+        record.stride = 0;
+        record.type = type;
+        record.flags = flags;
+
+        m_records.push_back(record);
+    }
+
+    void BindTable::add_run(const bind_action_t& action, uint64_t count, uint64_t stride)
+    {
+        bind_action_t bind = action;
+
+        while (count > 0) {
+            /* The first bind goes through add(), which may fold it into the last record */
+            add(bind);
+            count--;
+            bind.address += stride;
+
+            /* Then that record takes as much of the rest of the run as its 32-bit fields hold */
+            bind_record_t& last = m_records.back();
+            if (count == 0 || stride > UINT32_MAX || (last.count > 1 && last.stride != stride)) {
+                continue;
+            }
+
+            uint64_t taken = std::min<uint64_t>(count, UINT32_MAX - last.count);
+            if (taken == 0) {
+                continue;
+            }
+
+            last.stride = (uint32_t)stride;
+            last.count += (uint32_t)taken;
+            m_bind_count += taken;
+            count -= taken;
+            bind.address += taken * stride;
+        }
+    }
+
+    uint32_t BindTable::intern(const char* name, int64_t libOrdinal, int64_t addend)
+    {
+        /* Keep the index at most half full */
+        if (2 * (m_targets.size() + 1) > m_index.size()) {
+            grow_index();
+        }
+
+        size_t mask = m_index.size() - 1;
+        size_t slot = (size_t)target_hash(name, libOrdinal, addend) & mask;
+
+        while (m_index[slot] != 0) {
+            const bind_target_t& target = m_targets[m_index[slot] - 1];
+            if (target.libOrdinal == (int32_t)libOrdinal && target.addend == addend && strcmp(&m_names[target.name], name) == 0) {
+                return m_index[slot] - 1;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        bind_target_t target;
+        target.name = (uint32_t)m_names.size();
+        target.libOrdinal = (int32_t)libOrdinal;
+        target.addend = addend;
+
+        m_names.insert(m_names.end(), name, name + strlen(name) + 1);
+        m_targets.push_back(target);
+        m_index[slot] = (uint32_t)m_targets.size();
+
+        return (uint32_t)m_targets.size() - 1;
+    }
+
+    void BindTable::grow_index()
+    {
+        size_t capacity = m_index.empty() ? 16 : 2 * m_index.size();
+        m_index.assign(capacity, 0);
+
+        size_t mask = capacity - 1;
+        for (size_t i = 0; i < m_targets.size(); i++) {
+            const bind_target_t& target = m_targets[i];
+            size_t slot = (size_t)target_hash(&m_names[target.name], target.libOrdinal, target.addend) & mask;
+            while (m_index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            m_index[slot] = (uint32_t)i + 1;
+        }
+    }
+
+    void BindTable::finish()
+    {
+        std::vector<uint32_t>().swap(m_index);
+
+        m_records.shrink_to_fit();
+        m_targets.shrink_to_fit();
+        m_names.shrink_to_fit();
+    }
+
+    void BindTable::clear()
+    {
+        m_records.clear();
+        m_targets.clear();
+        m_names.clear();
+        m_index.clear();
+        m_bind_count = 0;
+    }
+
+    void BindTable::expand(const bind_record_t& record, uint32_t index, bind_action_t* action) const
+    {
+        const bind_target_t& target = m_targets[record.target];
+
+        action->address = record.address + (uint64_t)index * record.stride;
+        action->type = record.type;
+        action->symbolName = name(target);
+        action->flags = record.flags;
+        action->addend = target.addend;
+        action->libOrdinal = (uint64_t)(int64_t)target.libOrdinal;
+        action->nodeType = m_node_type;
+        action->location = 0;
+        action->ptrSize = m_ptr_size;
+    }
+
+    size_t BindTable::getMemoryUsage() const
+    {
+        return m_records.capacity() * sizeof(bind_record_t)
+             + m_targets.capacity() * sizeof(bind_target_t)
+             + m_names.capacity()
+             + m_index.capacity() * sizeof(uint32_t);
+    }
+
+}
@@ -0,0 +1,108 @@
+//
+//  bind_table.h
+//  machofile
+//
+//  Compact copy of one bind stream, for keeping the binds of many images
+//  resident. A run of binds of the same target at a fixed stride (what
+//  BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB produces) is one 24 byte
+//  record; the target (name, library ordinal, addend) is an index into a
+//  table of distinct targets whose names share one string pool. The table
+//  owns all of it, so it outlives the MachOFile it was built from.
+//
+
+#ifndef rotg_bind_table_h
+#define rotg_bind_table_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "machofile.h"
+
+namespace rotg {
+
+    typedef struct bind_record {
+        uint64_t    address;    // of the first bind
+        uint32_t    target;     // index into getTargets()
+        uint32_t    count;      // binds in the run
+        uint32_t    stride;     // bytes from one bind to the next, 0 for a single bind
+        uint8_t     type;       // BIND_TYPE_*
+        uint8_t     flags;      // BIND_SYMBOL_FLAGS_*
+    } bind_record_t;
+
+    typedef struct bind_target {
+        uint32_t    name;       // offset into the string pool
+        int32_t     libOrdinal; // negative for the BIND_SPECIAL_DYLIB_* ordinals
+        int64_t     addend;
+    } bind_target_t;
+
+    class BindTable
+    {
+    public:
+        BindTable();
+
+        // Decode the nodeType stream of file. False if it is malformed.
+        bool build(const MachOFile& file, BindNodeType nodeType);
+
+        // Append one bind, folding it into the last record when it continues its run
+        void add(const bind_action_t& action);
+
+        // Append count binds stride bytes apart from action.address. The run costs a
+        // record (more only past 32-bit counts or strides), not a call per bind.
+        void add_run(const bind_action_t& action, uint64_t count, uint64_t stride);
+
+        // Release the build-time index and the spare capacity
+        void finish();
+
+        void clear();
+
+        BindNodeType getNodeType() const {
+            return m_node_type;
+        }
+
+        uint32_t getPtrSize() const {
+            return m_ptr_size;
+        }
+
+        const std::vector<bind_record_t>& getRecords() const {
+            return m_records;
+        }
+
+        const std::vector<bind_target_t>& getTargets() const {
+            return m_targets;
+        }
+
+        const char* name(const bind_target_t& target) const {
+            return &m_names[target.name];
+        }
+
+        // Binds, with every run expanded
+        uint64_t getBindCount() const {
+            return m_bind_count;
+        }
+
+        // The index'th bind of record as a bind_action_t; location is not kept and comes back 0
+        void expand(const bind_record_t& record, uint32_t index, bind_action_t* action) const;
+
+        // Bytes held, including spare capacity
+        size_t getMemoryUsage() const;
+
+    private:
+        uint32_t intern(const char* name, int64_t libOrdinal, int64_t addend);
+        void grow_index();
+
+        std::vector<bind_record_t>  m_records;
+        std::vector<bind_target_t>  m_targets;
+        std::vector<char>           m_names;
+        uint64_t                    m_bind_count;
+        BindNodeType                m_node_type;
+        uint32_t                    m_ptr_size;
+
+        // target index + 1 by (name, ordinal, addend), 0 = empty; only while building
+        std::vector<uint32_t>       m_index;
+    };
+
+}
+
+#endif
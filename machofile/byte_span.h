@@ -0,0 +1,94 @@
+//
+//  byte_span.h
+//  machofile
+//
+//  A bounded view of part of the input. A range is checked once, when it
+//  is cut out of the span holding it, and reads inside it are unchecked
+//  from then on. The opcode streams walk a span as a (p, end) cursor, with
+//  read_cstring() next to read_uleb128() for the strings embedded in them.
+//
+
+#ifndef rotg_byte_span_h
+#define rotg_byte_span_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace rotg {
+
+    class ByteSpan
+    {
+    public:
+        ByteSpan()
+            : m_start(NULL)
+            , m_size(0)
+        {
+        }
+
+        ByteSpan(const void* start, size_t size)
+            : m_start((const uint8_t*)start)
+            , m_size(start != NULL ? size : 0)
+        {
+        }
+
+        const uint8_t* data() const { return m_start; }
+        const uint8_t* end() const { return m_start + m_size; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        // Whether [offset, offset + length) is inside the span. Neither sum can overflow.
+        bool contains(uint64_t offset, uint64_t length) const {
+            return offset <= m_size && length <= m_size - offset;
+        }
+
+        // Cut [offset, offset + length) out of the span, false if it does not fit
+        bool slice(uint64_t offset, uint64_t length, ByteSpan* span) const {
+            if (!contains(offset, length)) {
+                return false;
+            }
+
+            *span = ByteSpan(m_start + offset, (size_t)length);
+            return true;
+        }
+
+        // count records of T at offset, NULL if they do not fit
+        template <typename T>
+        const T* array(uint64_t offset, uint64_t count) const {
+            if (m_start == NULL || offset > m_size || count > (m_size - offset) / sizeof(T)) {
+                return NULL;
+            }
+
+            return (const T*)(m_start + offset);
+        }
+
+        // The string at offset, NULL if the span ends before its NUL
+        const char* cstring(uint64_t offset) const {
+            if (offset >= m_size || memchr(m_start + offset, '\0', m_size - offset) == NULL) {
+                return NULL;
+            }
+
+            return (const char*)m_start + offset;
+        }
+
+    private:
+        const uint8_t*  m_start;
+        size_t          m_size;
+    };
+
+    // Read the string at p. Returns the byte after its NUL, or NULL if there
+    // is none before end.
+    static inline const uint8_t* read_cstring(const uint8_t* p, const uint8_t* end, const char*& result)
+    {
+        const uint8_t* nul = (const uint8_t*)memchr(p, '\0', end - p);
+        if (nul == NULL) {
+            return NULL;
+        }
+
+        result = (const char*)p;
+        return nul + 1;
+    }
+
+}
+
+#endif
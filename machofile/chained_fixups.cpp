@@ -0,0 +1,387 @@
+//
+//  chained_fixups.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include "macho_types.h"
+#include "chained_fixups.h"
+
+namespace rotg {
+
+    /* Size of dyld_chained_starts_in_segment up to page_start */
+    static const size_t kStartsInSegmentSize = 22;
+
+    /* The payload and the chained pointers are little endian and not always aligned */
+    static inline uint16_t load_le16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    static inline uint32_t load_le32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline uint64_t load_le64(const uint8_t* p)
+    {
+        return (uint64_t)load_le32(p) | ((uint64_t)load_le32(p + 4) << 32);
+    }
+
+    static inline int64_t sign_extend(uint64_t value, unsigned bits)
+    {
+        uint64_t sign = 1ULL << (bits - 1);
+        return (int64_t)((value ^ sign) - sign);
+    }
+
+    ChainedFixups::ChainedFixups()
+        : m_start(NULL)
+        , m_size(0)
+        , m_starts(NULL)
+        , m_imports(NULL)
+        , m_symbols(NULL)
+        , m_symbols_size(0)
+        , m_segment_count(0)
+        , m_import_count(0)
+        , m_import_format(0)
+        , m_symbols_terminated(false)
+    {
+    }
+
+    ChainedFixups::ChainedFixups(const uint8_t* start, size_t size)
+        : m_start(start)
+        , m_size(start != NULL ? size : 0)
+        , m_starts(NULL)
+        , m_imports(NULL)
+        , m_symbols(NULL)
+        , m_symbols_size(0)
+        , m_segment_count(0)
+        , m_import_count(0)
+        , m_import_format(0)
+        , m_symbols_terminated(false)
+    {
+    }
+
+    bool ChainedFixups::init()
+    {
+        if (m_size < sizeof(struct dyld_chained_fixups_header)) {
+            return false;
+        }
+
+        uint32_t version = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, fixups_version));
+        uint32_t startsOffset = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, starts_offset));
+        uint32_t importsOffset = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, imports_offset));
+        uint32_t symbolsOffset = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, symbols_offset));
+        uint32_t importCount = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, imports_count));
+        uint32_t importFormat = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, imports_format));
+        uint32_t symbolsFormat = load_le32(m_start + offsetof(struct dyld_chained_fixups_header, symbols_format));
+
+        /* Compressed symbol names are not used by any linker */
+        if (version != 0 || symbolsFormat != 0) {
+            return false;
+        }
+
+        uint64_t importSize;
+        switch (importFormat) {
+            case DYLD_CHAINED_IMPORT:           importSize = 4; break;
+            case DYLD_CHAINED_IMPORT_ADDEND:    importSize = 8; break;
+            case DYLD_CHAINED_IMPORT_ADDEND64:  importSize = 16; break;
+            default:
+                return false;
+        }
+
+        if ((uint64_t)startsOffset + sizeof(uint32_t) > m_size) {
+            return false;
+        }
+
+        uint32_t segmentCount = load_le32(m_start + startsOffset);
+        if ((uint64_t)startsOffset + sizeof(uint32_t) * (1 + (uint64_t)segmentCount) > m_size) {
+            return false;
+        }
+
+        if ((uint64_t)importsOffset + importCount * importSize > m_size || symbolsOffset > m_size) {
+            return false;
+        }
+
+        m_starts = m_start + startsOffset;
+        m_imports = m_start + importsOffset;
+        m_symbols = (const char*)m_start + symbolsOffset;
+        m_symbols_size = m_size - symbolsOffset;
+        m_segment_count = segmentCount;
+        m_import_count = importCount;
+        m_import_format = importFormat;
+        m_symbols_terminated = m_symbols_size != 0 && m_symbols[m_symbols_size - 1] == '\0';
+
+        return true;
+    }
+
+    bool ChainedFixups::read_segment(uint32_t index, chained_segment_t* segment) const
+    {
+        memset(segment, 0, sizeof(*segment));
+
+        if (index >= m_segment_count) {
+            return false;
+        }
+
+        uint32_t infoOffset = load_le32(m_starts + sizeof(uint32_t) * (1 + (uint64_t)index));
+        if (infoOffset == 0) {
+            return true;
+        }
+
+        uint64_t offset = (uint64_t)(m_starts - m_start) + infoOffset;
+        if (offset + kStartsInSegmentSize > m_size) {
+            return false;
+        }
+
+        const uint8_t* p = m_start + offset;
+        uint32_t size = load_le32(p + offsetof(struct dyld_chained_starts_in_segment, size));
+        uint16_t pageCount = load_le16(p + offsetof(struct dyld_chained_starts_in_segment, page_count));
+        if (offset + size > m_size || kStartsInSegmentSize + sizeof(uint16_t) * (uint64_t)pageCount > size) {
+            return false;
+        }
+
+        segment->segmentOffset = load_le64(p + offsetof(struct dyld_chained_starts_in_segment, segment_offset));
+        segment->maxValidPointer = load_le32(p + offsetof(struct dyld_chained_starts_in_segment, max_valid_pointer));
+        segment->pageSize = load_le16(p + offsetof(struct dyld_chained_starts_in_segment, page_size));
+        segment->pointerFormat = load_le16(p + offsetof(struct dyld_chained_starts_in_segment, pointer_format));
+        segment->pageCount = pageCount;
+        segment->pageStarts = p + kStartsInSegmentSize;
+        segment->end = p + size;
+
+        return segment->pageSize != 0 || pageCount == 0;
+    }
+
+    bool ChainedFixups::read_import(uint32_t index, chained_import_t* import) const
+    {
+        if (index >= m_import_count) {
+            return false;
+        }
+
+        uint64_t nameOffset;
+        switch (m_import_format) {
+            case DYLD_CHAINED_IMPORT:
+            case DYLD_CHAINED_IMPORT_ADDEND: {
+                const uint8_t* p = m_imports + (m_import_format == DYLD_CHAINED_IMPORT ? 4 : 8) * (uint64_t)index;
+                uint32_t value = load_le32(p);
+
+                /* Ordinals above 0xF0 are the negative BIND_SPECIAL_DYLIB_* ones */
+                uint32_t ordinal = value & 0xFF;
+                import->libOrdinal = ordinal > 0xF0 ? (int8_t)ordinal : (int64_t)ordinal;
+                import->weakImport = (value >> 8) & 1;
+                import->addend = m_import_format == DYLD_CHAINED_IMPORT ? 0 : (int32_t)load_le32(p + 4);
+                nameOffset = value >> 9;
+            } break;
+
+            case DYLD_CHAINED_IMPORT_ADDEND64: {
+                const uint8_t* p = m_imports + 16 * (uint64_t)index;
+                uint64_t value = load_le64(p);
+
+                uint32_t ordinal = value & 0xFFFF;
+                import->libOrdinal = ordinal > 0xFFF0 ? (int16_t)ordinal : (int64_t)ordinal;
+                import->weakImport = (value >> 16) & 1;
+                import->addend = (int64_t)load_le64(p + 8);
+                nameOffset = value >> 32;
+            } break;
+
+            default:
+                return false;
+        }
+
+        /* When the pool ends with a NUL every name in it is terminated */
+        if (nameOffset >= m_symbols_size ||
+            (!m_symbols_terminated && memchr(m_symbols + nameOffset, '\0', m_symbols_size - nameOffset) == NULL)) {
+            return false;
+        }
+
+        import->name = m_symbols + nameOffset;
+        return true;
+    }
+
+    /* Decode the pointer at p into fixup, false in *isPointer for the plain values some
+       32-bit chains carry. Returns the next field. Format is a constant, so each walk_chain
+       instance keeps only its own case. */
+    template <uint16_t Format>
+    static inline uint64_t decode_pointer(const chained_segment_t& segment, const uint8_t* p, uint64_t baseAddress,
+                                          chained_fixup_t* fixup, bool* isPointer)
+    {
+        switch (Format) {
+            case DYLD_CHAINED_PTR_ARM64E:
+            case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+            case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+            case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+            case DYLD_CHAINED_PTR_ARM64E_FIRMWARE: {
+                uint64_t value = load_le64(p);
+                bool auth = (value >> 63) & 1;
+                fixup->bind = (value >> 62) & 1;
+
+                if (fixup->bind) {
+                    fixup->target = value & (Format == DYLD_CHAINED_PTR_ARM64E_USERLAND24 ? 0xFFFFFF : 0xFFFF);
+                    fixup->addend = auth ? 0 : sign_extend((value >> 32) & 0x7FFFF, 19);
+                } else if (auth) {
+                    fixup->target = baseAddress + (value & 0xFFFFFFFF);
+                } else {
+                    /* Plain arm64e and firmware rebases hold the address, the others an offset */
+                    uint64_t target = value & 0x7FFFFFFFFFFULL;
+                    if (Format != DYLD_CHAINED_PTR_ARM64E && Format != DYLD_CHAINED_PTR_ARM64E_FIRMWARE) {
+                        target += baseAddress;
+                    }
+                    fixup->target = target | (((value >> 43) & 0xFF) << 56);
+                }
+
+                return (value >> 51) & 0x7FF;
+            }
+
+            case DYLD_CHAINED_PTR_64:
+            case DYLD_CHAINED_PTR_64_OFFSET: {
+                uint64_t value = load_le64(p);
+                fixup->bind = (value >> 63) & 1;
+
+                if (fixup->bind) {
+                    fixup->target = value & 0xFFFFFF;
+                    fixup->addend = (value >> 24) & 0xFF;
+                } else {
+                    uint64_t target = value & 0xFFFFFFFFFULL;
+                    if (Format == DYLD_CHAINED_PTR_64_OFFSET) {
+                        target += baseAddress;
+                    }
+                    fixup->target = target | (((value >> 36) & 0xFF) << 56);
+                }
+
+                return (value >> 51) & 0xFFF;
+            }
+
+            case DYLD_CHAINED_PTR_64_KERNEL_CACHE:
+            case DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE: {
+                /* Rebases only, to an offset */
+                uint64_t value = load_le64(p);
+                fixup->target = baseAddress + (value & 0x3FFFFFFF);
+                return (value >> 51) & 0xFFF;
+            }
+
+            case DYLD_CHAINED_PTR_32: {
+                uint32_t value = load_le32(p);
+                fixup->bind = (value >> 31) & 1;
+
+                if (fixup->bind) {
+                    fixup->target = value & 0xFFFFF;
+                    fixup->addend = (value >> 20) & 0x3F;
+                } else {
+                    /* Targets above the limit are plain values kept in the chain, not pointers */
+                    fixup->target = value & 0x3FFFFFF;
+                    *isPointer = fixup->target <= segment.maxValidPointer;
+                }
+
+                return (value >> 26) & 0x1F;
+            }
+
+            case DYLD_CHAINED_PTR_32_CACHE: {
+                uint32_t value = load_le32(p);
+                fixup->target = baseAddress + (value & 0x3FFFFFFF);
+                return (value >> 30) & 0x3;
+            }
+
+            default: {
+                /* DYLD_CHAINED_PTR_32_FIRMWARE */
+                uint32_t value = load_le32(p);
+                fixup->target = value & 0x3FFFFFF;
+                return (value >> 26) & 0x3F;
+            }
+        }
+    }
+
+    /* Follow one chain from offset in page; every pointer holds the count of Strides to the next */
+    template <uint16_t Format, uint32_t Stride, uint32_t PointerSize>
+    static bool walk_chain(const chained_segment_t& segment, uint64_t pageOffset, const uint8_t* page, size_t length,
+                           uint32_t offset, uint64_t baseAddress, chained_fixups_t& fixups)
+    {
+        for (;;) {
+            if ((uint64_t)offset + PointerSize > length) {
+                return false;
+            }
+
+            /* Decoded in place: copying a fixup built on the stack costs more than the decoding */
+            fixups.resize(fixups.size() + 1);
+            chained_fixup_t& fixup = fixups.back();
+            fixup.offset = pageOffset + offset;
+
+            bool isPointer = true;
+            uint64_t next = decode_pointer<Format>(segment, page + offset, baseAddress, &fixup, &isPointer);
+
+            if (!isPointer) {
+                fixups.pop_back();
+            }
+
+            if (next == 0) {
+                return true;
+            }
+
+            offset += (uint32_t)next * Stride;
+        }
+    }
+
+    static bool walk_chain(const chained_segment_t& segment, uint64_t pageOffset, const uint8_t* page, size_t length,
+                           uint32_t offset, uint64_t baseAddress, chained_fixups_t& fixups)
+    {
+        switch (segment.pointerFormat) {
+#define WALK_CHAIN(format, stride, pointerSize) \
+            case format: \
+                return walk_chain<format, stride, pointerSize>(segment, pageOffset, page, length, offset, baseAddress, fixups);
+
+            WALK_CHAIN(DYLD_CHAINED_PTR_ARM64E, 8, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_ARM64E_USERLAND, 8, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_ARM64E_USERLAND24, 8, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_ARM64E_KERNEL, 4, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_ARM64E_FIRMWARE, 4, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_64, 4, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_64_OFFSET, 4, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_64_KERNEL_CACHE, 4, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE, 1, 8)
+            WALK_CHAIN(DYLD_CHAINED_PTR_32, 4, 4)
+            WALK_CHAIN(DYLD_CHAINED_PTR_32_CACHE, 4, 4)
+            WALK_CHAIN(DYLD_CHAINED_PTR_32_FIRMWARE, 4, 4)
+
+#undef WALK_CHAIN
+            default:
+                return false;
+        }
+    }
+
+    bool ChainedFixups::walk_page(const chained_segment_t& segment, uint32_t pageIndex, const uint8_t* page, size_t length,
+                                  uint64_t baseAddress, chained_fixups_t& fixups)
+    {
+        if (pageIndex >= segment.pageCount) {
+            return false;
+        }
+
+        uint64_t pageOffset = (uint64_t)pageIndex * segment.pageSize;
+        uint16_t start = load_le16(segment.pageStarts + sizeof(uint16_t) * pageIndex);
+        if (start == DYLD_CHAINED_PTR_START_NONE) {
+            return true;
+        }
+
+        if ((start & DYLD_CHAINED_PTR_START_MULTI) == 0) {
+            return walk_chain(segment, pageOffset, page, length, start, baseAddress, fixups);
+        }
+
+        /* Several chains, listed after the page starts; the last one is marked */
+        const uint8_t* p = segment.pageStarts + sizeof(uint16_t) * (start & ~DYLD_CHAINED_PTR_START_MULTI);
+        for (;;) {
+            if (p + sizeof(uint16_t) > segment.end) {
+                return false;
+            }
+
+            uint16_t chain = load_le16(p);
+            if (!walk_chain(segment, pageOffset, page, length, chain & ~DYLD_CHAINED_PTR_START_LAST, baseAddress, fixups)) {
+                return false;
+            }
+
+            if (chain & DYLD_CHAINED_PTR_START_LAST) {
+                return true;
+            }
+
+            p += sizeof(uint16_t);
+        }
+    }
+
+}
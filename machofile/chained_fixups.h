@@ -0,0 +1,102 @@
+//
+//  chained_fixups.h
+//  machofile
+//
+//  Reads the LC_DYLD_CHAINED_FIXUPS payload in place. Instead of opcode
+//  streams, every rebase and bind is stored in the pointer it fixes up,
+//  and each pointer holds the distance to the next one on its page; the
+//  payload only lists where each page's chain starts and the imports the
+//  binds refer to. Pages are independent, so they can be walked in any
+//  order, or concurrently.
+//
+
+#ifndef rotg_chained_fixups_h
+#define rotg_chained_fixups_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace rotg {
+
+    typedef struct chained_import {
+        const char* name;
+        int64_t     libOrdinal;     // negative for the BIND_SPECIAL_DYLIB_* ordinals
+        int64_t     addend;
+        bool        weakImport;
+    } chained_import_t;
+
+    // The page starts of one segment
+    typedef struct chained_segment {
+        uint64_t        segmentOffset;      // vm offset from the image base
+        uint32_t        maxValidPointer;
+        uint16_t        pageSize;
+        uint16_t        pointerFormat;      // DYLD_CHAINED_PTR_*
+        uint16_t        pageCount;
+        const uint8_t*  pageStarts;         // pageCount uint16_t, then the DYLD_CHAINED_PTR_START_MULTI lists
+        const uint8_t*  end;
+    } chained_segment_t;
+
+    typedef struct chained_fixup {
+        uint64_t    offset;     // of the pointer from the start of its segment
+        uint64_t    target;     // rebase: vmaddr it points to, bind: import index
+        int64_t     addend;     // bind: added to the import's own addend
+        bool        bind;
+    } chained_fixup_t;
+
+    typedef std::vector<chained_fixup_t> chained_fixups_t;
+
+    class ChainedFixups
+    {
+    public:
+        ChainedFixups();
+
+        // The caller has bounds checked size bytes at start, which must stay
+        // mapped while the fixups are used
+        ChainedFixups(const uint8_t* start, size_t size);
+
+        bool empty() const {
+            return m_size == 0;
+        }
+
+        // Check the header and the tables it points to, false if they are malformed.
+        // Nothing else may be used before it succeeds.
+        bool init();
+
+        uint32_t getSegmentCount() const {
+            return m_segment_count;
+        }
+
+        uint32_t getImportCount() const {
+            return m_import_count;
+        }
+
+        // Page starts of segment index (as counted by the LC_SEGMENT* commands);
+        // pageCount is 0 when it has no fixups. False if they are malformed.
+        bool read_segment(uint32_t index, chained_segment_t* segment) const;
+
+        bool read_import(uint32_t index, chained_import_t* import) const;
+
+        // Append the fixups of page pageIndex of segment, whose bytes are page
+        // up to length, to fixups. baseAddress turns the rebase targets of the
+        // formats that store an offset into addresses.
+        static bool walk_page(const chained_segment_t& segment, uint32_t pageIndex, const uint8_t* page, size_t length,
+                              uint64_t baseAddress, chained_fixups_t& fixups);
+
+    private:
+        const uint8_t*  m_start;
+        size_t          m_size;
+        const uint8_t*  m_starts;           // dyld_chained_starts_in_image
+        const uint8_t*  m_imports;
+        const char*     m_symbols;
+        size_t          m_symbols_size;
+        uint32_t        m_segment_count;
+        uint32_t        m_import_count;
+        uint32_t        m_import_format;
+        bool            m_symbols_terminated;
+    };
+
+}
+
+#endif
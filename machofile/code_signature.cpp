@@ -0,0 +1,317 @@
+//
+//  code_signature.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "macho_types.h"
+#include "code_signature.h"
+#include "sha.h"
+
+namespace rotg {
+
+    /* Size of CS_SuperBlob up to index, of a CS_BlobIndex, and of the first CS_CodeDirectory version */
+    static const size_t kSuperBlobSize = 12;
+    static const size_t kBlobIndexSize = 8;
+    static const size_t kCodeDirectorySize = offsetof(struct CS_CodeDirectory, scatterOffset);
+
+    /* Largest digest of the hash types verify_pages() knows */
+    static const size_t kMaxDigestSize = kSHA256DigestSize;
+
+    /* The signature is big endian and not always aligned */
+    static inline uint32_t load_be32(const uint8_t* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static inline uint64_t load_be64(const uint8_t* p)
+    {
+        return ((uint64_t)load_be32(p) << 32) | load_be32(p + 4);
+    }
+
+    /* Digest size of hashType, 0 for the types hash() does not know */
+    static size_t digest_size(uint8_t hashType)
+    {
+        switch (hashType) {
+            case CS_HASHTYPE_SHA1:
+            case CS_HASHTYPE_SHA256_TRUNCATED:
+                return kSHA1DigestSize;
+            case CS_HASHTYPE_SHA256:
+                return kSHA256DigestSize;
+            default:
+                return 0;
+        }
+    }
+
+    /* Truncated types keep the first digest_size() bytes */
+    static void hash(uint8_t hashType, const uint8_t* data, size_t size, uint8_t digest[kMaxDigestSize])
+    {
+        if (hashType == CS_HASHTYPE_SHA1) {
+            sha1(data, size, digest);
+        } else {
+            sha256(data, size, digest);
+        }
+    }
+
+    /* Stronger hashes rank higher, the way the kernel picks a directory */
+    static int hash_rank(uint8_t hashType)
+    {
+        switch (hashType) {
+            case CS_HASHTYPE_SHA1:
+                return 1;
+            case CS_HASHTYPE_SHA256_TRUNCATED:
+                return 2;
+            case CS_HASHTYPE_SHA256:
+                return 3;
+            default:
+                return 0;
+        }
+    }
+
+    static bool slotLess(const code_directory_t& a, const code_directory_t& b)
+    {
+        return a.slot < b.slot;
+    }
+
+    CodeSignature::CodeSignature()
+        : m_start(NULL)
+        , m_size(0)
+        , m_count(0)
+    {
+    }
+
+    CodeSignature::CodeSignature(const uint8_t* start, size_t size)
+        : m_start(start)
+        , m_size(start != NULL ? size : 0)
+        , m_count(0)
+    {
+    }
+
+    bool CodeSignature::init()
+    {
+        m_directories.clear();
+        m_count = 0;
+
+        if (m_size < kSuperBlobSize) {
+            return false;
+        }
+
+        uint32_t magic = load_be32(m_start + offsetof(struct CS_SuperBlob, magic));
+        uint32_t length = load_be32(m_start + offsetof(struct CS_SuperBlob, length));
+        uint32_t count = load_be32(m_start + offsetof(struct CS_SuperBlob, count));
+
+        if (magic != CSMAGIC_EMBEDDED_SIGNATURE || length < kSuperBlobSize || length > m_size) {
+            return false;
+        }
+
+        if (count > (length - kSuperBlobSize) / kBlobIndexSize) {
+            return false;
+        }
+
+        /* The linker pads the payload past the super blob */
+        m_size = length;
+
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* index = m_start + kSuperBlobSize + i * kBlobIndexSize;
+            uint32_t type = load_be32(index + offsetof(struct CS_BlobIndex, type));
+            uint32_t offset = load_be32(index + offsetof(struct CS_BlobIndex, offset));
+
+            if (offset > length - 8) {
+                return false;
+            }
+
+            uint32_t blobLength = load_be32(m_start + offset + 4);
+            if (blobLength < 8 || blobLength > length - offset) {
+                return false;
+            }
+
+            if (type == CSSLOT_CODEDIRECTORY ||
+                (type >= CSSLOT_ALTERNATE_CODEDIRECTORIES && type < CSSLOT_ALTERNATE_CODEDIRECTORIES + CSSLOT_ALTERNATE_CODEDIRECTORY_MAX)) {
+                code_directory_t directory;
+                if (!read_code_directory(type, m_start + offset, blobLength, &directory)) {
+                    m_directories.clear();
+                    return false;
+                }
+                m_directories.push_back(directory);
+            }
+        }
+
+        /* There is nothing to check a signature without one against */
+        if (m_directories.empty()) {
+            return false;
+        }
+
+        std::sort(m_directories.begin(), m_directories.end(), slotLess);
+        m_count = count;
+        return true;
+    }
+
+    bool CodeSignature::read_code_directory(uint32_t slot, const uint8_t* start, uint32_t length, code_directory_t* directory) const
+    {
+        if (length < kCodeDirectorySize || load_be32(start) != CSMAGIC_CODEDIRECTORY) {
+            return false;
+        }
+
+        uint32_t hashOffset = load_be32(start + offsetof(struct CS_CodeDirectory, hashOffset));
+        uint32_t identOffset = load_be32(start + offsetof(struct CS_CodeDirectory, identOffset));
+
+        directory->start = start;
+        directory->length = length;
+        directory->slot = slot;
+        directory->version = load_be32(start + offsetof(struct CS_CodeDirectory, version));
+        directory->flags = load_be32(start + offsetof(struct CS_CodeDirectory, flags));
+        directory->hashType = start[offsetof(struct CS_CodeDirectory, hashType)];
+        directory->hashSize = start[offsetof(struct CS_CodeDirectory, hashSize)];
+        directory->platform = start[offsetof(struct CS_CodeDirectory, platform)];
+        directory->pageShift = start[offsetof(struct CS_CodeDirectory, pageSize)];
+        directory->nSpecialSlots = load_be32(start + offsetof(struct CS_CodeDirectory, nSpecialSlots));
+        directory->nCodeSlots = load_be32(start + offsetof(struct CS_CodeDirectory, nCodeSlots));
+        directory->codeLimit = load_be32(start + offsetof(struct CS_CodeDirectory, codeLimit));
+        directory->scatterOffset = 0;
+        directory->identifier = NULL;
+        directory->teamID = NULL;
+        directory->execSegBase = 0;
+        directory->execSegLimit = 0;
+        directory->execSegFlags = 0;
+
+        /* Later versions append fields, the length says which are there */
+        if (directory->version >= CS_SUPPORTSSCATTER && length >= offsetof(struct CS_CodeDirectory, teamOffset)) {
+            directory->scatterOffset = load_be32(start + offsetof(struct CS_CodeDirectory, scatterOffset));
+        }
+
+        if (directory->version >= CS_SUPPORTSTEAMID && length >= offsetof(struct CS_CodeDirectory, spare3)) {
+            uint32_t teamOffset = load_be32(start + offsetof(struct CS_CodeDirectory, teamOffset));
+            if (teamOffset != 0) {
+                if (teamOffset >= length || memchr(start + teamOffset, '\0', length - teamOffset) == NULL) {
+                    return false;
+                }
+                directory->teamID = (const char*)start + teamOffset;
+            }
+        }
+
+        if (directory->version >= CS_SUPPORTSCODELIMIT64 && length >= offsetof(struct CS_CodeDirectory, execSegBase)) {
+            uint64_t codeLimit64 = load_be64(start + offsetof(struct CS_CodeDirectory, codeLimit64));
+            if (codeLimit64 != 0) {
+                directory->codeLimit = codeLimit64;
+            }
+        }
+
+        if (directory->version >= CS_SUPPORTSEXECSEG && length >= sizeof(struct CS_CodeDirectory)) {
+            directory->execSegBase = load_be64(start + offsetof(struct CS_CodeDirectory, execSegBase));
+            directory->execSegLimit = load_be64(start + offsetof(struct CS_CodeDirectory, execSegLimit));
+            directory->execSegFlags = load_be64(start + offsetof(struct CS_CodeDirectory, execSegFlags));
+        }
+
+        if (identOffset >= length || memchr(start + identOffset, '\0', length - identOffset) == NULL) {
+            return false;
+        }
+        directory->identifier = (const char*)start + identOffset;
+
+        /* The special slots sit right before hashOffset, the code slots from it */
+        uint64_t specialSize = (uint64_t)directory->nSpecialSlots * directory->hashSize;
+        uint64_t codeSize = (uint64_t)directory->nCodeSlots * directory->hashSize;
+        if (specialSize > hashOffset || hashOffset + codeSize > length) {
+            return false;
+        }
+        directory->hashes = start + hashOffset;
+
+        /* One slot per page up to the code limit */
+        uint64_t pages;
+        if (directory->pageShift == 0) {
+            pages = directory->codeLimit != 0 ? 1 : 0;
+        } else if (directory->pageShift < 32) {
+            uint64_t pageSize = 1ULL << directory->pageShift;
+            pages = (directory->codeLimit + pageSize - 1) >> directory->pageShift;
+        } else {
+            return false;
+        }
+
+        return pages == directory->nCodeSlots;
+    }
+
+    const code_directory_t* CodeSignature::getBestCodeDirectory() const
+    {
+        const code_directory_t* best = NULL;
+
+        code_directories_t::const_iterator iter;
+        for (iter = m_directories.begin(); iter != m_directories.end(); iter++) {
+            if (can_verify(*iter) && (best == NULL || hash_rank(iter->hashType) > hash_rank(best->hashType))) {
+                best = &*iter;
+            }
+        }
+
+        return best;
+    }
+
+    const uint8_t* CodeSignature::find_blob(uint32_t slot, size_t* size) const
+    {
+        for (uint32_t i = 0; i < m_count; i++) {
+            const uint8_t* index = m_start + kSuperBlobSize + i * kBlobIndexSize;
+            if (load_be32(index + offsetof(struct CS_BlobIndex, type)) == slot) {
+                uint32_t offset = load_be32(index + offsetof(struct CS_BlobIndex, offset));
+                *size = load_be32(m_start + offset + 4);
+                return m_start + offset;
+            }
+        }
+
+        return NULL;
+    }
+
+    bool CodeSignature::can_verify(const code_directory_t& directory)
+    {
+        size_t size = digest_size(directory.hashType);
+        return size != 0 && size == directory.hashSize && directory.scatterOffset == 0;
+    }
+
+    bool CodeSignature::verify_pages(const code_directory_t& directory, const uint8_t* image, size_t size,
+                                     uint32_t first, uint32_t last, std::vector<uint32_t>& badPages)
+    {
+        if (!can_verify(directory) || directory.codeLimit > size || first > last || last > directory.nCodeSlots) {
+            return false;
+        }
+
+        uint64_t pageSize = directory.pageShift != 0 ? 1ULL << directory.pageShift : directory.codeLimit;
+        uint8_t digest[kMaxDigestSize];
+
+        for (uint32_t page = first; page < last; page++) {
+            uint64_t offset = page * pageSize;
+            uint64_t length = std::min(pageSize, directory.codeLimit - offset);
+
+            hash(directory.hashType, image + offset, length, digest);
+            if (memcmp(digest, directory.hashes + (size_t)page * directory.hashSize, directory.hashSize) != 0) {
+                badPages.push_back(page);
+            }
+        }
+
+        return true;
+    }
+
+    bool CodeSignature::verify_special_slots(const code_directory_t& directory, std::vector<uint32_t>& badSlots) const
+    {
+        if (!can_verify(directory)) {
+            return false;
+        }
+
+        uint8_t digest[kMaxDigestSize];
+
+        /* Special slot n holds the hash of the blob of type n */
+        for (uint32_t slot = 1; slot <= directory.nSpecialSlots; slot++) {
+            size_t size;
+            const uint8_t* blob = find_blob(slot, &size);
+            if (blob == NULL) {
+                continue;
+            }
+
+            hash(directory.hashType, blob, size, digest);
+            if (memcmp(digest, directory.hashes - (size_t)slot * directory.hashSize, directory.hashSize) != 0) {
+                badSlots.push_back(slot);
+            }
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,103 @@
+//
+//  code_signature.h
+//  machofile
+//
+//  Reads the LC_CODE_SIGNATURE payload in place: a SuperBlob indexing the
+//  code directories, requirements and entitlements. A code directory holds
+//  one hash per page of the image up to its code limit, and hashes of the
+//  other blobs in negative "special" slots. Signatures made for older
+//  systems carry a SHA-1 directory with a SHA-256 one as an alternate.
+//  Every page is hashed on its own, so they can be checked in any order,
+//  or concurrently.
+//
+
+#ifndef rotg_code_signature_h
+#define rotg_code_signature_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace rotg {
+
+    typedef struct code_directory {
+        const uint8_t*  start;          // the CS_CodeDirectory blob
+        uint32_t        length;
+        uint32_t        slot;           // CSSLOT_CODEDIRECTORY or CSSLOT_ALTERNATE_CODEDIRECTORIES + n
+        uint32_t        version;
+        uint32_t        flags;
+        uint8_t         hashType;       // CS_HASHTYPE_*
+        uint8_t         hashSize;
+        uint8_t         platform;
+        uint8_t         pageShift;      // 0 hashes the whole code limit as one page
+        uint32_t        nSpecialSlots;
+        uint32_t        nCodeSlots;
+        uint64_t        codeLimit;      // bytes of the image that are hashed, from its start
+        uint32_t        scatterOffset;  // not 0 for scattered pages, which are not supported
+        const uint8_t*  hashes;         // code slot 0, special slot n is n hashes before it
+        const char*     identifier;
+        const char*     teamID;         // NULL when there is none
+        uint64_t        execSegBase;
+        uint64_t        execSegLimit;
+        uint64_t        execSegFlags;
+    } code_directory_t;
+
+    typedef std::vector<code_directory_t> code_directories_t;
+
+    class CodeSignature
+    {
+    public:
+        CodeSignature();
+
+        // The caller has bounds checked size bytes at start, which must stay
+        // mapped while the signature is used
+        CodeSignature(const uint8_t* start, size_t size);
+
+        bool empty() const {
+            return m_size == 0;
+        }
+
+        // Check the super blob and the code directories it indexes, false if
+        // they are malformed. Nothing else may be used before it succeeds.
+        bool init();
+
+        // In slot order, the primary one first
+        const code_directories_t& getCodeDirectories() const {
+            return m_directories;
+        }
+
+        // The directory with the strongest hash this code can check, NULL if there is none
+        const code_directory_t* getBestCodeDirectory() const;
+
+        // The blob in slot (CSSLOT_*) of the super blob, NULL if there is none
+        const uint8_t* find_blob(uint32_t slot, size_t* size) const;
+
+        // Whether verify_pages() knows the hash type of directory
+        static bool can_verify(const code_directory_t& directory);
+
+        // Hash pages [first, last) of the image, size bytes starting with its
+        // mach header, and append the indices of those that do not match
+        // their code slot to badPages. False if directory cannot be checked
+        // or covers more than size bytes.
+        static bool verify_pages(const code_directory_t& directory, const uint8_t* image, size_t size,
+                                 uint32_t first, uint32_t last, std::vector<uint32_t>& badPages);
+
+        // Compare the special slots of the blobs this signature carries
+        // (requirements, entitlements) with their hashes, appending the
+        // slot numbers that do not match to badSlots. Slots for files
+        // outside the image, such as the Info.plist, are skipped.
+        bool verify_special_slots(const code_directory_t& directory, std::vector<uint32_t>& badSlots) const;
+
+    private:
+        bool read_code_directory(uint32_t slot, const uint8_t* start, uint32_t length, code_directory_t* directory) const;
+
+        const uint8_t*      m_start;
+        size_t              m_size;
+        uint32_t            m_count;        // blob indexes
+        code_directories_t  m_directories;
+    };
+
+}
+
+#endif
@@ -0,0 +1,263 @@
+//
+//  export_trie.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "macho_types.h"
+#include "export_trie.h"
+#include "leb128.h"
+
+namespace rotg {
+
+    typedef struct trie_frame {
+        uint64_t    offset;     // node
+        size_t      depth;      // characters of the names matched above it
+        size_t      lo;         // names[lo, hi) share those characters
+        size_t      hi;
+    } trie_frame_t;
+
+    ExportTrie::ExportTrie()
+        : m_start(NULL)
+        , m_size(0)
+    {
+    }
+
+    ExportTrie::ExportTrie(const uint8_t* start, size_t size)
+        : m_start(start)
+        , m_size(start != NULL ? size : 0)
+    {
+    }
+
+    bool ExportTrie::read_node(uint64_t offset, export_trie_node_t* node) const
+    {
+        if (offset >= m_size) {
+            return false;
+        }
+
+        const uint8_t* end = m_start + m_size;
+        const uint8_t* p = m_start + offset;
+        uint64_t terminalSize;
+        p = read_uleb128(p, end, terminalSize);
+        if (p == NULL || terminalSize >= (uint64_t)(end - p)) {
+            return false;
+        }
+
+        node->terminal = terminalSize != 0 ? p : NULL;
+        node->terminal_end = p + terminalSize;
+        node->child_count = p[terminalSize];
+        node->edges = p + terminalSize + 1;
+
+        return true;
+    }
+
+    bool ExportTrie::read_edge(const uint8_t*& p, const char** label, size_t* length, uint64_t* child) const
+    {
+        const uint8_t* end = m_start + m_size;
+        const uint8_t* nul = (const uint8_t*)memchr(p, 0, end - p);
+        if (nul == NULL || nul == p) {
+            return false;
+        }
+
+        *label = (const char*)p;
+        *length = nul - p;
+        p = nul + 1;
+
+        p = read_uleb128(p, end, *child);
+        return p != NULL;
+    }
+
+    bool ExportTrie::read_terminal(const export_trie_node_t& node, export_symbol_t* symbol)
+    {
+        const uint8_t* p = node.terminal;
+        const uint8_t* end = node.terminal_end;
+
+        if (p == NULL) {
+            return false;
+        }
+
+        p = read_uleb128(p, end, symbol->flags);
+        if (p == NULL) {
+            return false;
+        }
+
+        symbol->offset = 0;
+        symbol->other = 0;
+        symbol->importName = NULL;
+
+        if (symbol->flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+            p = read_uleb128(p, end, symbol->other);
+            if (p == NULL || memchr(p, 0, end - p) == NULL) {
+                return false;
+            }
+            symbol->importName = (const char*)p;
+            return true;
+        }
+
+        p = read_uleb128(p, end, symbol->offset);
+        if (p == NULL) {
+            return false;
+        }
+
+        if (symbol->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
+            return read_uleb128(p, end, symbol->other) != NULL;
+        }
+
+        return true;
+    }
+
+    bool ExportTrie::count(uint64_t* count) const
+    {
+        *count = 0;
+
+        std::vector<uint64_t> stack(1, 0);
+
+        /* Every node takes at least two bytes, more visits than bytes means a cycle */
+        size_t visits = 0;
+
+        while (!stack.empty()) {
+            uint64_t offset = stack.back();
+            stack.pop_back();
+
+            if (++visits > m_size) {
+                return false;
+            }
+
+            export_trie_node_t node;
+            if (!read_node(offset, &node)) {
+                return false;
+            }
+
+            if (node.terminal != NULL) {
+                export_symbol_t symbol;
+                if (!read_terminal(node, &symbol)) {
+                    return false;
+                }
+                (*count)++;
+            }
+
+            const uint8_t* p = node.edges;
+            for (uint8_t i = 0; i < node.child_count; i++) {
+                const char* label;
+                size_t length;
+                uint64_t child;
+                if (!read_edge(p, &label, &length, &child)) {
+                    return false;
+                }
+                stack.push_back(child);
+            }
+        }
+
+        return true;
+    }
+
+    bool ExportTrie::lookup(const char* name, export_symbol_t* symbol) const
+    {
+        if (empty()) {
+            return false;
+        }
+
+        uint64_t offset = 0;
+
+        /* Labels are never empty, so every step consumes part of name and a cyclic trie cannot loop */
+        for (;;) {
+            export_trie_node_t node;
+            if (!read_node(offset, &node)) {
+                return false;
+            }
+
+            if (*name == '\0') {
+                return read_terminal(node, symbol);
+            }
+
+            const uint8_t* p = node.edges;
+            bool matched = false;
+
+            for (uint8_t i = 0; i < node.child_count; i++) {
+                const char* label;
+                size_t length;
+                uint64_t child;
+                if (!read_edge(p, &label, &length, &child)) {
+                    return false;
+                }
+
+                if (strncmp(name, label, length) == 0) {
+                    name += length;
+                    offset = child;
+                    matched = true;
+                    break;
+                }
+            }
+
+            if (!matched) {
+                return false;
+            }
+        }
+    }
+
+    size_t ExportTrie::lookup_sorted(const char* const* names, size_t count, export_symbol_t* symbols, bool* found) const
+    {
+        std::fill(found, found + count, false);
+
+        if (empty() || count == 0) {
+            return 0;
+        }
+
+        size_t resolved = 0;
+
+        std::vector<trie_frame_t> stack;
+        trie_frame_t root = { 0, 0, 0, count };
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            trie_frame_t frame = stack.back();
+            stack.pop_back();
+
+            export_trie_node_t node;
+            if (!read_node(frame.offset, &node)) {
+                continue;
+            }
+
+            /* A name that ends at this node sorts before the ones that go on */
+            size_t lo = frame.lo;
+            while (lo < frame.hi && names[lo][frame.depth] == '\0') {
+                if (read_terminal(node, &symbols[lo])) {
+                    found[lo] = true;
+                    resolved++;
+                }
+                lo++;
+            }
+
+            /* The names below each edge are a contiguous run of names[lo, hi) */
+            const uint8_t* p = node.edges;
+            for (uint8_t i = 0; i < node.child_count && lo < frame.hi; i++) {
+                const char* label;
+                size_t length;
+                uint64_t child;
+                if (!read_edge(p, &label, &length, &child)) {
+                    break;
+                }
+
+                size_t depth = frame.depth;
+                const char* const* first = std::lower_bound(names + lo, names + frame.hi, label, [depth, length](const char* name, const char* label) {
+                    return strncmp(name + depth, label, length) < 0;
+                });
+                const char* const* last = std::upper_bound(first, names + frame.hi, label, [depth, length](const char* label, const char* name) {
+                    return strncmp(name + depth, label, length) > 0;
+                });
+
+                if (first != last) {
+                    trie_frame_t next = { child, depth + length, (size_t)(first - names), (size_t)(last - names) };
+                    stack.push_back(next);
+                }
+            }
+        }
+
+        return resolved;
+    }
+
+}
@@ -0,0 +1,84 @@
+//
+//  export_trie.h
+//  machofile
+//
+//  Reads an export trie in place: the LC_DYLD_EXPORTS_TRIE data, which
+//  MachOFile::getExportTrie() prefers, or LC_DYLD_INFO export_off/export_size.
+//  A lookup follows only the edge that matches the next characters of the
+//  name at each node, so it costs O(name length) and allocates nothing,
+//  however large the trie is.
+//
+
+#ifndef rotg_export_trie_h
+#define rotg_export_trie_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rotg {
+
+    typedef struct export_symbol {
+        uint64_t    flags;          // EXPORT_SYMBOL_FLAGS_*
+        uint64_t    offset;         // from the image base, 0 for a re-export
+        uint64_t    other;          // re-export: dylib ordinal, stub and resolver: resolver offset
+        const char* importName;     // re-export: name in that dylib ("" = same name), else NULL
+    } export_symbol_t;
+
+    typedef struct export_trie_node {
+        const uint8_t*  terminal;       // terminal info, NULL when no name ends here
+        const uint8_t*  terminal_end;
+        const uint8_t*  edges;          // child_count edges: label, NUL, uleb128 child offset
+        uint8_t         child_count;
+    } export_trie_node_t;
+
+    class ExportTrie
+    {
+    public:
+        ExportTrie();
+
+        // The caller has bounds checked size bytes at start, which must stay
+        // mapped while the trie is used
+        ExportTrie(const uint8_t* start, size_t size);
+
+        bool empty() const {
+            return m_size == 0;
+        }
+
+        const uint8_t* data() const {
+            return m_start;
+        }
+
+        size_t size() const {
+            return m_size;
+        }
+
+        // Terminal info for name, false if it is not exported or the trie is malformed
+        bool lookup(const char* name, export_symbol_t* symbol) const;
+
+        // Resolve count names in strcmp order in one walk: names with a common
+        // prefix share the nodes up to it and every node is read at most once.
+        // found[i] tells whether symbols[i] was filled; returns how many were.
+        size_t lookup_sorted(const char* const* names, size_t count, export_symbol_t* symbols, bool* found) const;
+
+        // Building blocks for walks of the whole trie, all bounds checked.
+        // Node at offset from the start of the trie (the root is at 0).
+        bool read_node(uint64_t offset, export_trie_node_t* node) const;
+
+        // Advance p, which starts at node.edges, over one edge. Labels are never empty.
+        bool read_edge(const uint8_t*& p, const char** label, size_t* length, uint64_t* child) const;
+
+        // Decode the terminal info of a node that has one
+        static bool read_terminal(const export_trie_node_t& node, export_symbol_t* symbol);
+
+        // Names in the trie, read with the checks of a full decode but keeping nothing.
+        // False if the trie is malformed.
+        bool count(uint64_t* count) const;
+
+    private:
+        const uint8_t*  m_start;
+        size_t          m_size;
+    };
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+//
+//  function_starts.cpp
+//  machofile
+//
+
+#include <err.h>
+
+#include <algorithm>
+
+#include "function_starts.h"
+#include "leb128.h"
+#include "machofile.h"
+
+namespace rotg {
+
+    /* 64 starts are four cache lines */
+    static const size_t kBlockSize = 64;
+
+    FunctionStarts::FunctionStarts()
+        : m_text_address(0)
+        , m_text_size(0)
+    {
+    }
+
+    bool FunctionStarts::build(const MachOFile& file)
+    {
+        /* __TEXT is the segment that maps the start of the file, the deltas start from it */
+        uint64_t textAddress = 0;
+        uint64_t textSize = 0;
+
+        const segment_infos_t& segments = file.getSegmentInfos();
+        segment_infos_t::const_iterator iter;
+        for (iter = segments.begin(); iter != segments.end(); iter++) {
+            if (iter->fileoff == 0 && iter->filesize != 0) {
+                textAddress = iter->vmaddr;
+                textSize = iter->vmsize;
+                break;
+            }
+        }
+
+        size_t size = 0;
+        const uint8_t* data = file.getFunctionStartsData(&size);
+        return build(data, size, textAddress, textSize);
+    }
+
+    bool FunctionStarts::build(const uint8_t* data, size_t size, uint64_t textAddress, uint64_t textSize)
+    {
+        m_offsets.clear();
+        m_blocks.clear();
+        m_text_address = textAddress;
+        m_text_size = textSize;
+
+        if (data == NULL || size == 0) {
+            return true;
+        }
+
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+
+        /* Every delta ends in one byte below 0x80, so counting those sizes the table once */
+        size_t count = 0;
+        for (; end - p >= 8; p += 8) {
+            count += __builtin_popcountll(~leb128_load64(p) & 0x8080808080808080ULL);
+        }
+        for (; p < end; p++) {
+            count += *p < 0x80;
+        }
+
+        m_offsets.resize(count);
+        uint32_t* out = m_offsets.data();
+
+        /* Functions are mostly under 16KB apart: one and two byte deltas are decoded
+           inline without a branch on their length, which is close to random */
+        uint64_t offset = 0;
+        p = data;
+        while (p < end) {
+            uint64_t delta;
+            uint64_t second = end - p >= 2 ? p[1] : 0x80;
+            uint64_t more = p[0] >> 7;
+            if ((second & more << 7) == 0) {
+                delta = (p[0] & 0x7f) | ((second << 7) & (0 - more));
+                p += 1 + more;
+            } else {
+                p = read_uleb128(p, end, delta);
+                if (p == NULL) {
+                    warnx("Malformed function starts");
+                    m_offsets.clear();
+                    return false;
+                }
+            }
+
+            /* The list ends with a zero delta, the rest is padding */
+            if (delta == 0) {
+                break;
+            }
+
+            offset += delta;
+            if (offset > UINT32_MAX) {
+                warnx("Function start past 4GB of __TEXT");
+                m_offsets.clear();
+                return false;
+            }
+
+            *out++ = (uint32_t)offset;
+        }
+
+        m_offsets.resize(out - m_offsets.data());
+
+        /* Every kBlockSize-th start, small enough to stay cached while the table is not */
+        for (size_t i = 0; i < m_offsets.size(); i += kBlockSize) {
+            m_blocks.push_back(m_offsets[i]);
+        }
+
+        return true;
+    }
+
+    bool FunctionStarts::function_containing(uint64_t address, uint64_t* start, uint64_t* end) const
+    {
+        if (address < m_text_address) {
+            return false;
+        }
+
+        uint64_t offset = address - m_text_address;
+        if (offset > UINT32_MAX) {
+            return false;
+        }
+
+        /* Find the block first, then the first start above the address in it; the function is the one before */
+        std::vector<uint32_t>::const_iterator block = std::upper_bound(m_blocks.begin(), m_blocks.end(), (uint32_t)offset);
+        if (block == m_blocks.begin()) {
+            return false;
+        }
+
+        size_t first = (block - m_blocks.begin() - 1) * kBlockSize;
+        size_t last = std::min(first + kBlockSize, m_offsets.size());
+        std::vector<uint32_t>::const_iterator next = std::upper_bound(m_offsets.begin() + first + 1, m_offsets.begin() + last, (uint32_t)offset);
+
+        uint64_t limit = next != m_offsets.end() ? *next : m_text_size;
+        if (offset >= limit) {
+            return false;
+        }
+
+        *start = m_text_address + *(next - 1);
+        *end = m_text_address + limit;
+        return true;
+    }
+
+}
@@ -0,0 +1,58 @@
+//
+//  function_starts.h
+//  machofile
+//
+//  Function boundaries from LC_FUNCTION_STARTS, which the linker emits even
+//  for stripped images: a ULEB128 delta from the previous start (the first
+//  one from the start of __TEXT) per function, ended by a zero. The starts
+//  are kept as 32-bit offsets from __TEXT, so a million functions take 4MB,
+//  and a function runs up to the next start.
+//
+
+#ifndef rotg_function_starts_h
+#define rotg_function_starts_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace rotg {
+
+    class MachOFile;
+
+    class FunctionStarts
+    {
+    public:
+        FunctionStarts();
+
+        // Decode the function starts of file, false if they are malformed.
+        // Nothing refers back to file afterwards.
+        bool build(const MachOFile& file);
+
+        // Decode size bytes of deltas from the __TEXT segment at textAddress,
+        // whose vmsize is textSize, the last function ends there.
+        bool build(const uint8_t* data, size_t size, uint64_t textAddress, uint64_t textSize);
+
+        // [start, end) of the function holding address, false when address
+        // is before the first function or past the end of __TEXT.
+        bool function_containing(uint64_t address, uint64_t* start, uint64_t* end) const;
+
+        size_t size() const {
+            return m_offsets.size();
+        }
+
+        uint64_t getStart(size_t index) const {
+            return m_text_address + m_offsets[index];
+        }
+
+    private:
+        std::vector<uint32_t>   m_offsets;          // sorted, from m_text_address
+        std::vector<uint32_t>   m_blocks;           // first offset of each run of kBlockSize
+        uint64_t                m_text_address;
+        uint64_t                m_text_size;
+    };
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+//
+//  leb128.cpp
+//  machofile
+//
+
+#include "leb128.h"
+
+namespace rotg {
+
+    const uint8_t* read_uleb128_slow(const uint8_t* p, const uint8_t* end, uint64_t& result)
+    {
+        uint64_t value = 0;
+        unsigned bit = 0;
+        uint8_t byte;
+
+        do {
+            if (p >= end) {
+                return NULL;
+            }
+
+            byte = *p++;
+            uint64_t slice = byte & 0x7f;
+
+            /* Set bits past bit 63 do not fit */
+            if (bit >= 64 || slice << bit >> bit != slice) {
+                return NULL;
+            }
+
+            value |= slice << bit;
+            bit += 7;
+        } while (byte & 0x80);
+
+        result = value;
+        return p;
+    }
+
+    const uint8_t* read_sleb128_slow(const uint8_t* p, const uint8_t* end, int64_t& result)
+    {
+        uint64_t value = 0;
+        unsigned bit = 0;
+        uint8_t byte;
+
+        do {
+            if (p >= end || bit >= 64) {
+                return NULL;
+            }
+
+            byte = *p++;
+            value |= (uint64_t)(byte & 0x7f) << bit;
+            bit += 7;
+        } while (byte & 0x80);
+
+        /* Sign extend from the last group, in unsigned arithmetic */
+        if (bit < 64 && (byte & 0x40) != 0) {
+            value |= ~0ULL << bit;
+        }
+
+        result = (int64_t)value;
+        return p;
+    }
+
+}
@@ -0,0 +1,112 @@
+//
+//  leb128.h
+//  machofile
+//
+//  ULEB128/SLEB128 decoding for the LINKEDIT opcode streams and the export
+//  trie. Every read is bounded by end. Away from the end of the buffer, a
+//  value is decoded from one 8 byte load: the terminating byte is the
+//  lowest one with its top bit clear, and the 7-bit groups below it are
+//  packed together with three mask-and-shift steps, so there is no loop
+//  and no branch per byte. Values longer than 8 bytes and reads near end
+//  take a checked byte at a time loop.
+//
+
+#ifndef rotg_leb128_h
+#define rotg_leb128_h
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace rotg {
+
+    // Byte at a time versions, for the last bytes of a buffer and values over 56 bits
+    const uint8_t* read_uleb128_slow(const uint8_t* p, const uint8_t* end, uint64_t& result);
+    const uint8_t* read_sleb128_slow(const uint8_t* p, const uint8_t* end, int64_t& result);
+
+    static inline uint64_t leb128_load64(const uint8_t* p)
+    {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return word;
+    }
+
+    // Payload of the first length bytes of word (length 1 to 8), low group first
+    static inline uint64_t leb128_gather(uint64_t word, unsigned length)
+    {
+        if (length < 8) {
+            word &= (1ULL << (8 * length)) - 1;
+        }
+
+#if defined(__BMI2__)
+        return _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL);
+#else
+        word &= 0x7F7F7F7F7F7F7F7FULL;
+        word = (word & 0x007F007F007F007FULL) | ((word & 0x7F007F007F007F00ULL) >> 1);
+        word = (word & 0x00003FFF00003FFFULL) | ((word & 0x3FFF00003FFF0000ULL) >> 2);
+        word = (word & 0x000000000FFFFFFFULL) | ((word & 0x0FFFFFFF00000000ULL) >> 4);
+        return word;
+#endif
+    }
+
+    // Decode the ULEB128 at p. Returns the byte after it, or NULL if it runs
+    // past end or does not fit in 64 bits.
+    static inline const uint8_t* read_uleb128(const uint8_t* p, const uint8_t* end, uint64_t& result)
+    {
+        /* Ordinals, counts and most deltas fit in one byte */
+        if (p < end && *p < 0x80) {
+            result = *p;
+            return p + 1;
+        }
+
+        if (end - p >= 8) {
+            uint64_t word = leb128_load64(p);
+            uint64_t stops = ~word & 0x8080808080808080ULL;
+            if (stops != 0) {
+                unsigned length = (__builtin_ctzll(stops) >> 3) + 1;
+                result = leb128_gather(word, length);
+                return p + length;
+            }
+        }
+
+        return read_uleb128_slow(p, end, result);
+    }
+
+    // Decode the SLEB128 at p, sign extended. Returns the byte after it, or
+    // NULL if it runs past end or is longer than 10 bytes.
+    static inline const uint8_t* read_sleb128(const uint8_t* p, const uint8_t* end, int64_t& result)
+    {
+        if (p < end && *p < 0x80) {
+            result = (int64_t)(*p ^ 0x40) - 0x40;
+            return p + 1;
+        }
+
+        if (end - p >= 8) {
+            uint64_t word = leb128_load64(p);
+            uint64_t stops = ~word & 0x8080808080808080ULL;
+            if (stops != 0) {
+                unsigned length = (__builtin_ctzll(stops) >> 3) + 1;
+                unsigned bits = 7 * length;
+                uint64_t value = leb128_gather(word, length);
+
+                /* bits is at most 56, the shift is defined */
+                uint64_t sign = (value >> (bits - 1)) & 1;
+                value |= (0 - sign) << bits;
+
+                result = (int64_t)value;
+                return p + length;
+            }
+        }
+
+        return read_sleb128_slow(p, end, result);
+    }
+
+}
+
+#endif
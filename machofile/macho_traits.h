@@ -0,0 +1,86 @@
+//
+//  macho_traits.h
+//  machofile
+//
+//  Compile time description of the four kinds of Mach-O image: 32 or 64-bit
+//  words, in host or swapped byte order. MachOFile picks one from the magic
+//  and runs the decoders instantiated for it, so their loops carry no word
+//  size or byte order tests, and the native 64-bit one no swapping at all.
+//
+
+#ifndef rotg_macho_traits_h
+#define rotg_macho_traits_h
+
+#include <stdint.h>
+
+#include "macho_types.h"
+
+namespace rotg {
+
+    template <bool Swap>
+    struct macho_byte_order {
+        static const bool kSwapped = Swap;
+
+        static uint16_t load16(uint16_t value) {
+            return Swap ? swap16(value) : value;
+        }
+
+        static uint32_t load32(uint32_t value) {
+            return Swap ? swap32(value) : value;
+        }
+
+        static uint64_t load64(uint64_t value) {
+            return Swap ? swap64(value) : value;
+        }
+    };
+
+    template <bool Is64>
+    struct macho_layout;
+
+    template <>
+    struct macho_layout<false> {
+        typedef struct mach_header          header_t;
+        typedef struct segment_command      segment_command_t;
+        typedef struct section              section_t;
+        typedef struct nlist                nlist_t;
+        typedef struct dylib_module         dylib_module_t;
+        typedef uint32_t                    word_t;
+
+        static const bool kIs64 = false;
+        static const uint32_t kSegmentCommand = LC_SEGMENT;
+        static const uint32_t kPointerSize = sizeof(uint32_t);
+    };
+
+    template <>
+    struct macho_layout<true> {
+        typedef struct mach_header_64       header_t;
+        typedef struct segment_command_64   segment_command_t;
+        typedef struct section_64           section_t;
+        typedef struct nlist_64             nlist_t;
+        typedef struct dylib_module_64      dylib_module_t;
+        typedef uint64_t                    word_t;
+
+        static const bool kIs64 = true;
+        static const uint32_t kSegmentCommand = LC_SEGMENT_64;
+        static const uint32_t kPointerSize = sizeof(uint64_t);
+    };
+
+    template <bool Is64, bool Swap>
+    struct macho_arch : macho_layout<Is64>, macho_byte_order<Swap> {
+        typedef typename macho_layout<Is64>::word_t word_t;
+
+        // A word sized field (addresses, sizes, n_value) widened to 64 bits
+        static uint64_t load_word(word_t value) {
+            return sizeof(word_t) == sizeof(uint64_t) ? macho_byte_order<Swap>::load64(value)
+                                                      : macho_byte_order<Swap>::load32((uint32_t)value);
+        }
+    };
+
+    typedef macho_arch<false, false>    MachO32;
+    typedef macho_arch<false, true>     MachO32Swapped;
+    typedef macho_arch<true, false>     MachO64;
+    typedef macho_arch<true, true>      MachO64Swapped;
+
+}
+
+#endif
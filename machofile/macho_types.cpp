@@ -0,0 +1,128 @@
+//
+//  macho_types.cpp
+//
+//  Architecture lookup table used in place of NXGetArchInfoFromCpuType.
+//
+
+#include <string.h>
+
+#include "macho_types.h"
+
+namespace rotg {
+
+    static const arch_info_t s_arch_infos[] = {
+        {"i386",      CPU_TYPE_I386,      CPU_SUBTYPE_I386_ALL,    ByteOrderLittleEndian, "Intel 80x86"},
+        {"x86_64",    CPU_TYPE_X86_64,    CPU_SUBTYPE_X86_64_ALL,  ByteOrderLittleEndian, "Intel x86-64"},
+        {"x86_64h",   CPU_TYPE_X86_64,    CPU_SUBTYPE_X86_64_H,    ByteOrderLittleEndian, "Intel x86-64h Haswell"},
+        {"arm",       CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_ALL,     ByteOrderLittleEndian, "ARM"},
+        {"armv4t",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V4T,     ByteOrderLittleEndian, "arm v4t"},
+        {"armv5",     CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V5TEJ,   ByteOrderLittleEndian, "arm v5"},
+        {"xscale",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_XSCALE,  ByteOrderLittleEndian, "arm xscale"},
+        {"armv6",     CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V6,      ByteOrderLittleEndian, "arm v6"},
+        {"armv6m",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V6M,     ByteOrderLittleEndian, "arm v6m"},
+        {"armv7",     CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7,      ByteOrderLittleEndian, "arm v7"},
+        {"armv7f",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7F,     ByteOrderLittleEndian, "arm v7f"},
+        {"armv7s",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7S,     ByteOrderLittleEndian, "arm v7s"},
+        {"armv7k",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7K,     ByteOrderLittleEndian, "arm v7k"},
+        {"armv7m",    CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7M,     ByteOrderLittleEndian, "arm v7m"},
+        {"armv7em",   CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V7EM,    ByteOrderLittleEndian, "arm v7em"},
+        {"armv8",     CPU_TYPE_ARM,       CPU_SUBTYPE_ARM_V8,      ByteOrderLittleEndian, "arm v8"},
+        {"arm64",     CPU_TYPE_ARM64,     CPU_SUBTYPE_ARM64_ALL,   ByteOrderLittleEndian, "ARM64"},
+        {"arm64v8",   CPU_TYPE_ARM64,     CPU_SUBTYPE_ARM64_V8,    ByteOrderLittleEndian, "arm64 v8"},
+        {"arm64e",    CPU_TYPE_ARM64,     CPU_SUBTYPE_ARM64E,      ByteOrderLittleEndian, "arm64e"},
+        {"arm64_32",  CPU_TYPE_ARM64_32,  CPU_SUBTYPE_ARM_V8,      ByteOrderLittleEndian, "arm64_32"},
+        {"ppc",       CPU_TYPE_POWERPC,   CPU_SUBTYPE_POWERPC_ALL, ByteOrderBigEndian,    "PowerPC"},
+        {"ppc64",     CPU_TYPE_POWERPC64, CPU_SUBTYPE_POWERPC_ALL, ByteOrderBigEndian,    "PowerPC 64-bit"},
+        {"m68k",      CPU_TYPE_MC680x0,   1,                       ByteOrderBigEndian,    "Motorola 68K"},
+        {"hppa",      CPU_TYPE_HPPA,      0,                       ByteOrderBigEndian,    "HP-PA"},
+        {"m88k",      CPU_TYPE_MC88000,   0,                       ByteOrderBigEndian,    "Motorola 88K"},
+        {"sparc",     CPU_TYPE_SPARC,     0,                       ByteOrderBigEndian,    "SPARC"},
+        {"i860",      CPU_TYPE_I860,      0,                       ByteOrderBigEndian,    "Intel 860"},
+        {"vax",       CPU_TYPE_VAX,       0,                       ByteOrderLittleEndian, "VAX"},
+    };
+
+    const arch_info_t* get_arch_info(cpu_type_t cputype, cpu_subtype_t cpusubtype)
+    {
+        const size_t count = sizeof(s_arch_infos) / sizeof(s_arch_infos[0]);
+        const arch_info_t* family = NULL;
+
+        /* Capability bits in the high byte do not identify the architecture */
+        cpu_subtype_t subtype = cpusubtype & ~CPU_SUBTYPE_MASK;
+
+        for (size_t i = 0; i < count; i++) {
+            const arch_info_t* info = &s_arch_infos[i];
+            if (info->cputype != cputype) {
+                continue;
+            }
+
+            if (cpusubtype == CPU_SUBTYPE_MULTIPLE || info->cpusubtype == subtype) {
+                return info;
+            }
+
+            if (family == NULL) {
+                family = info;
+            }
+        }
+
+        /* Fall back to the generic entry of the cpu family */
+        return family;
+    }
+
+    const arch_info_t* get_arch_info_by_name(const char* name)
+    {
+        const size_t count = sizeof(s_arch_infos) / sizeof(s_arch_infos[0]);
+
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(s_arch_infos[i].name, name) == 0) {
+                return &s_arch_infos[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    bool get_host_cpu_type(cpu_type_t* cputype, cpu_subtype_t* cpusubtype)
+    {
+#if defined(__x86_64__)
+        *cputype = CPU_TYPE_X86_64;
+        *cpusubtype = CPU_SUBTYPE_X86_64_ALL;
+#elif defined(__i386__)
+        *cputype = CPU_TYPE_I386;
+        *cpusubtype = CPU_SUBTYPE_I386_ALL;
+#elif defined(__aarch64__)
+        *cputype = CPU_TYPE_ARM64;
+        *cpusubtype = CPU_SUBTYPE_ARM64_ALL;
+#elif defined(__arm__)
+        *cputype = CPU_TYPE_ARM;
+        *cpusubtype = CPU_SUBTYPE_ARM_ALL;
+#elif defined(__powerpc64__)
+        *cputype = CPU_TYPE_POWERPC64;
+        *cpusubtype = CPU_SUBTYPE_POWERPC_ALL;
+#elif defined(__powerpc__)
+        *cputype = CPU_TYPE_POWERPC;
+        *cpusubtype = CPU_SUBTYPE_POWERPC_ALL;
+#else
+        return false;
+#endif
+        return true;
+    }
+
+    const char* get_platform_name(uint32_t platform)
+    {
+        switch (platform) {
+            case PLATFORM_MACOS:            return "macos";
+            case PLATFORM_IOS:              return "ios";
+            case PLATFORM_TVOS:             return "tvos";
+            case PLATFORM_WATCHOS:          return "watchos";
+            case PLATFORM_BRIDGEOS:         return "bridgeos";
+            case PLATFORM_MACCATALYST:      return "maccatalyst";
+            case PLATFORM_IOSSIMULATOR:     return "iossimulator";
+            case PLATFORM_TVOSSIMULATOR:    return "tvossimulator";
+            case PLATFORM_WATCHOSSIMULATOR: return "watchossimulator";
+            case PLATFORM_DRIVERKIT:        return "driverkit";
+        }
+
+        return "unknown";
+    }
+
+}
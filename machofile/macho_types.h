@@ -0,0 +1,888 @@
+//
+//  macho_types.h
+//
+//  Portable Mach-O structure and constant definitions. These mirror the
+//  layouts from <mach-o/loader.h>, <mach-o/fat.h>, <mach-o/nlist.h> and
+//  <mach/machine.h> so the parser builds on hosts without the Darwin SDK.
+//
+
+#ifndef rotg_macho_types_h
+#define rotg_macho_types_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int32_t cpu_type_t;
+typedef int32_t cpu_subtype_t;
+typedef int32_t vm_prot_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU types
+
+#define CPU_ARCH_MASK           0xff000000
+#define CPU_ARCH_ABI64          0x01000000
+#define CPU_ARCH_ABI64_32       0x02000000
+
+#define CPU_TYPE_ANY            ((cpu_type_t) -1)
+#define CPU_TYPE_VAX            ((cpu_type_t) 1)
+#define CPU_TYPE_MC680x0        ((cpu_type_t) 6)
+#define CPU_TYPE_X86            ((cpu_type_t) 7)
+#define CPU_TYPE_I386           CPU_TYPE_X86
+#define CPU_TYPE_X86_64         (CPU_TYPE_X86 | CPU_ARCH_ABI64)
+#define CPU_TYPE_MC98000        ((cpu_type_t) 10)
+#define CPU_TYPE_HPPA           ((cpu_type_t) 11)
+#define CPU_TYPE_ARM            ((cpu_type_t) 12)
+#define CPU_TYPE_ARM64          (CPU_TYPE_ARM | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM64_32       (CPU_TYPE_ARM | CPU_ARCH_ABI64_32)
+#define CPU_TYPE_MC88000        ((cpu_type_t) 13)
+#define CPU_TYPE_SPARC          ((cpu_type_t) 14)
+#define CPU_TYPE_I860           ((cpu_type_t) 15)
+#define CPU_TYPE_POWERPC        ((cpu_type_t) 18)
+#define CPU_TYPE_POWERPC64      (CPU_TYPE_POWERPC | CPU_ARCH_ABI64)
+
+#define CPU_SUBTYPE_MASK        0xff000000
+#define CPU_SUBTYPE_LIB64       0x80000000
+#define CPU_SUBTYPE_MULTIPLE    ((cpu_subtype_t) -1)
+
+#define CPU_SUBTYPE_I386_ALL    ((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_X86_ALL     ((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_X86_64_ALL  ((cpu_subtype_t) 3)
+#define CPU_SUBTYPE_X86_64_H    ((cpu_subtype_t) 8)
+
+#define CPU_SUBTYPE_ARM_ALL     ((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_ARM_V4T     ((cpu_subtype_t) 5)
+#define CPU_SUBTYPE_ARM_V6      ((cpu_subtype_t) 6)
+#define CPU_SUBTYPE_ARM_V5TEJ   ((cpu_subtype_t) 7)
+#define CPU_SUBTYPE_ARM_XSCALE  ((cpu_subtype_t) 8)
+#define CPU_SUBTYPE_ARM_V7      ((cpu_subtype_t) 9)
+#define CPU_SUBTYPE_ARM_V7F     ((cpu_subtype_t) 10)
+#define CPU_SUBTYPE_ARM_V7S     ((cpu_subtype_t) 11)
+#define CPU_SUBTYPE_ARM_V7K     ((cpu_subtype_t) 12)
+#define CPU_SUBTYPE_ARM_V8      ((cpu_subtype_t) 13)
+#define CPU_SUBTYPE_ARM_V6M     ((cpu_subtype_t) 14)
+#define CPU_SUBTYPE_ARM_V7M     ((cpu_subtype_t) 15)
+#define CPU_SUBTYPE_ARM_V7EM    ((cpu_subtype_t) 16)
+
+#define CPU_SUBTYPE_ARM64_ALL   ((cpu_subtype_t) 0)
+#define CPU_SUBTYPE_ARM64_V8    ((cpu_subtype_t) 1)
+#define CPU_SUBTYPE_ARM64E      ((cpu_subtype_t) 2)
+
+#define CPU_SUBTYPE_POWERPC_ALL ((cpu_subtype_t) 0)
+
+////////////////////////////////////////////////////////////////////////////////
+// Mach header
+
+struct mach_header {
+    uint32_t        magic;
+    cpu_type_t      cputype;
+    cpu_subtype_t   cpusubtype;
+    uint32_t        filetype;
+    uint32_t        ncmds;
+    uint32_t        sizeofcmds;
+    uint32_t        flags;
+};
+
+#define MH_MAGIC    0xfeedface
+#define MH_CIGAM    0xcefaedfe
+
+struct mach_header_64 {
+    uint32_t        magic;
+    cpu_type_t      cputype;
+    cpu_subtype_t   cpusubtype;
+    uint32_t        filetype;
+    uint32_t        ncmds;
+    uint32_t        sizeofcmds;
+    uint32_t        flags;
+    uint32_t        reserved;
+};
+
+#define MH_MAGIC_64 0xfeedfacf
+#define MH_CIGAM_64 0xcffaedfe
+
+#define MH_OBJECT       0x1
+#define MH_EXECUTE      0x2
+#define MH_FVMLIB       0x3
+#define MH_CORE         0x4
+#define MH_PRELOAD      0x5
+#define MH_DYLIB        0x6
+#define MH_DYLINKER     0x7
+#define MH_BUNDLE       0x8
+#define MH_DYLIB_STUB   0x9
+#define MH_DSYM         0xa
+#define MH_KEXT_BUNDLE  0xb
+#define MH_FILESET      0xc
+
+#define MH_NOUNDEFS     0x1
+#define MH_DYLDLINK     0x4
+#define MH_TWOLEVEL     0x80
+#define MH_PIE          0x200000
+
+////////////////////////////////////////////////////////////////////////////////
+// Universal (fat) header, always big-endian on disk
+
+#define FAT_MAGIC   0xcafebabe
+#define FAT_CIGAM   0xbebafeca
+
+struct fat_header {
+    uint32_t    magic;
+    uint32_t    nfat_arch;
+};
+
+struct fat_arch {
+    cpu_type_t      cputype;
+    cpu_subtype_t   cpusubtype;
+    uint32_t        offset;
+    uint32_t        size;
+    uint32_t        align;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Load commands
+
+struct load_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+};
+
+#define LC_REQ_DYLD 0x80000000
+
+#define LC_SEGMENT                  0x1
+#define LC_SYMTAB                   0x2
+#define LC_SYMSEG                   0x3
+#define LC_THREAD                   0x4
+#define LC_UNIXTHREAD               0x5
+#define LC_LOADFVMLIB               0x6
+#define LC_IDFVMLIB                 0x7
+#define LC_IDENT                    0x8
+#define LC_FVMFILE                  0x9
+#define LC_PREPAGE                  0xa
+#define LC_DYSYMTAB                 0xb
+#define LC_LOAD_DYLIB               0xc
+#define LC_ID_DYLIB                 0xd
+#define LC_LOAD_DYLINKER            0xe
+#define LC_ID_DYLINKER              0xf
+#define LC_PREBOUND_DYLIB           0x10
+#define LC_ROUTINES                 0x11
+#define LC_SUB_FRAMEWORK            0x12
+#define LC_SUB_UMBRELLA             0x13
+#define LC_SUB_CLIENT               0x14
+#define LC_SUB_LIBRARY              0x15
+#define LC_TWOLEVEL_HINTS           0x16
+#define LC_PREBIND_CKSUM            0x17
+#define LC_LOAD_WEAK_DYLIB          (0x18 | LC_REQ_DYLD)
+#define LC_SEGMENT_64               0x19
+#define LC_ROUTINES_64              0x1a
+#define LC_UUID                     0x1b
+#define LC_RPATH                    (0x1c | LC_REQ_DYLD)
+#define LC_CODE_SIGNATURE           0x1d
+#define LC_SEGMENT_SPLIT_INFO       0x1e
+#define LC_REEXPORT_DYLIB           (0x1f | LC_REQ_DYLD)
+#define LC_LAZY_LOAD_DYLIB          0x20
+#define LC_ENCRYPTION_INFO          0x21
+#define LC_DYLD_INFO                0x22
+#define LC_DYLD_INFO_ONLY           (0x22 | LC_REQ_DYLD)
+#define LC_LOAD_UPWARD_DYLIB        (0x23 | LC_REQ_DYLD)
+#define LC_VERSION_MIN_MACOSX       0x24
+#define LC_VERSION_MIN_IPHONEOS     0x25
+#define LC_FUNCTION_STARTS          0x26
+#define LC_DYLD_ENVIRONMENT         0x27
+#define LC_MAIN                     (0x28 | LC_REQ_DYLD)
+#define LC_DATA_IN_CODE             0x29
+#define LC_SOURCE_VERSION           0x2A
+#define LC_DYLIB_CODE_SIGN_DRS      0x2B
+#define LC_ENCRYPTION_INFO_64       0x2C
+#define LC_LINKER_OPTION            0x2D
+#define LC_LINKER_OPTIMIZATION_HINT 0x2E
+#define LC_VERSION_MIN_TVOS         0x2F
+#define LC_VERSION_MIN_WATCHOS      0x30
+#define LC_NOTE                     0x31
+#define LC_BUILD_VERSION            0x32
+#define LC_DYLD_EXPORTS_TRIE        (0x33 | LC_REQ_DYLD)
+#define LC_DYLD_CHAINED_FIXUPS      (0x34 | LC_REQ_DYLD)
+#define LC_FILESET_ENTRY            (0x35 | LC_REQ_DYLD)
+
+union lc_str {
+    uint32_t offset;
+};
+
+struct segment_command {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    char        segname[16];
+    uint32_t    vmaddr;
+    uint32_t    vmsize;
+    uint32_t    fileoff;
+    uint32_t    filesize;
+    vm_prot_t   maxprot;
+    vm_prot_t   initprot;
+    uint32_t    nsects;
+    uint32_t    flags;
+};
+
+struct segment_command_64 {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    char        segname[16];
+    uint64_t    vmaddr;
+    uint64_t    vmsize;
+    uint64_t    fileoff;
+    uint64_t    filesize;
+    vm_prot_t   maxprot;
+    vm_prot_t   initprot;
+    uint32_t    nsects;
+    uint32_t    flags;
+};
+
+struct section {
+    char        sectname[16];
+    char        segname[16];
+    uint32_t    addr;
+    uint32_t    size;
+    uint32_t    offset;
+    uint32_t    align;
+    uint32_t    reloff;
+    uint32_t    nreloc;
+    uint32_t    flags;
+    uint32_t    reserved1;
+    uint32_t    reserved2;
+};
+
+struct section_64 {
+    char        sectname[16];
+    char        segname[16];
+    uint64_t    addr;
+    uint64_t    size;
+    uint32_t    offset;
+    uint32_t    align;
+    uint32_t    reloff;
+    uint32_t    nreloc;
+    uint32_t    flags;
+    uint32_t    reserved1;
+    uint32_t    reserved2;
+    uint32_t    reserved3;
+};
+
+#define SECTION_TYPE                        0x000000ff
+#define SECTION_ATTRIBUTES                  0xffffff00
+
+#define S_REGULAR                           0x0
+#define S_ZEROFILL                          0x1
+#define S_CSTRING_LITERALS                  0x2
+#define S_4BYTE_LITERALS                    0x3
+#define S_8BYTE_LITERALS                    0x4
+#define S_LITERAL_POINTERS                  0x5
+#define S_NON_LAZY_SYMBOL_POINTERS          0x6
+#define S_LAZY_SYMBOL_POINTERS              0x7
+#define S_SYMBOL_STUBS                      0x8
+#define S_MOD_INIT_FUNC_POINTERS            0x9
+#define S_MOD_TERM_FUNC_POINTERS            0xa
+#define S_COALESCED                         0xb
+#define S_GB_ZEROFILL                       0xc
+#define S_INTERPOSING                       0xd
+#define S_16BYTE_LITERALS                   0xe
+#define S_DTRACE_DOF                        0xf
+#define S_LAZY_DYLIB_SYMBOL_POINTERS        0x10
+#define S_THREAD_LOCAL_VARIABLE_POINTERS    0x14
+
+#define S_ATTR_PURE_INSTRUCTIONS            0x80000000
+#define S_ATTR_SOME_INSTRUCTIONS            0x00000400
+
+struct dylib {
+    union lc_str    name;
+    uint32_t        timestamp;
+    uint32_t        current_version;
+    uint32_t        compatibility_version;
+};
+
+struct dylib_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    struct dylib    dylib;
+};
+
+struct sub_framework_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    umbrella;
+};
+
+struct sub_client_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    client;
+};
+
+struct sub_umbrella_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    sub_umbrella;
+};
+
+struct sub_library_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    sub_library;
+};
+
+struct dylinker_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    name;
+};
+
+struct thread_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+};
+
+struct routines_command {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    uint32_t    init_address;
+    uint32_t    init_module;
+    uint32_t    reserved1;
+    uint32_t    reserved2;
+    uint32_t    reserved3;
+    uint32_t    reserved4;
+    uint32_t    reserved5;
+    uint32_t    reserved6;
+};
+
+struct routines_command_64 {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    uint64_t    init_address;
+    uint64_t    init_module;
+    uint64_t    reserved1;
+    uint64_t    reserved2;
+    uint64_t    reserved3;
+    uint64_t    reserved4;
+    uint64_t    reserved5;
+    uint64_t    reserved6;
+};
+
+struct symtab_command {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    uint32_t    symoff;
+    uint32_t    nsyms;
+    uint32_t    stroff;
+    uint32_t    strsize;
+};
+
+struct dysymtab_command {
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    uint32_t    ilocalsym;
+    uint32_t    nlocalsym;
+    uint32_t    iextdefsym;
+    uint32_t    nextdefsym;
+    uint32_t    iundefsym;
+    uint32_t    nundefsym;
+    uint32_t    tocoff;
+    uint32_t    ntoc;
+    uint32_t    modtaboff;
+    uint32_t    nmodtab;
+    uint32_t    extrefsymoff;
+    uint32_t    nextrefsyms;
+    uint32_t    indirectsymoff;
+    uint32_t    nindirectsyms;
+    uint32_t    extreloff;
+    uint32_t    nextrel;
+    uint32_t    locreloff;
+    uint32_t    nlocrel;
+};
+
+#define INDIRECT_SYMBOL_LOCAL   0x80000000
+#define INDIRECT_SYMBOL_ABS     0x40000000
+
+struct dylib_table_of_contents {
+    uint32_t symbol_index;
+    uint32_t module_index;
+};
+
+struct dylib_module {
+    uint32_t module_name;
+    uint32_t iextdefsym;
+    uint32_t nextdefsym;
+    uint32_t irefsym;
+    uint32_t nrefsym;
+    uint32_t ilocalsym;
+    uint32_t nlocalsym;
+    uint32_t iextrel;
+    uint32_t nextrel;
+    uint32_t iinit_iterm;
+    uint32_t ninit_nterm;
+    uint32_t objc_module_info_addr;
+    uint32_t objc_module_info_size;
+};
+
+struct dylib_module_64 {
+    uint32_t module_name;
+    uint32_t iextdefsym;
+    uint32_t nextdefsym;
+    uint32_t irefsym;
+    uint32_t nrefsym;
+    uint32_t ilocalsym;
+    uint32_t nlocalsym;
+    uint32_t iextrel;
+    uint32_t nextrel;
+    uint32_t iinit_iterm;
+    uint32_t ninit_nterm;
+    uint32_t objc_module_info_size;
+    uint64_t objc_module_info_addr;
+};
+
+struct twolevel_hints_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t offset;
+    uint32_t nhints;
+};
+
+struct prebind_cksum_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t cksum;
+};
+
+struct uuid_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint8_t  uuid[16];
+};
+
+struct rpath_command {
+    uint32_t        cmd;
+    uint32_t        cmdsize;
+    union lc_str    path;
+};
+
+struct linkedit_data_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t dataoff;
+    uint32_t datasize;
+};
+
+struct encryption_info_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t cryptoff;
+    uint32_t cryptsize;
+    uint32_t cryptid;
+};
+
+struct encryption_info_command_64 {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t cryptoff;
+    uint32_t cryptsize;
+    uint32_t cryptid;
+    uint32_t pad;
+};
+
+struct version_min_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t version;
+    uint32_t sdk;
+};
+
+struct build_version_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t platform;
+    uint32_t minos;
+    uint32_t sdk;
+    uint32_t ntools;
+};
+
+/* Known values for build_version_command.platform */
+#define PLATFORM_MACOS              1
+#define PLATFORM_IOS                2
+#define PLATFORM_TVOS               3
+#define PLATFORM_WATCHOS            4
+#define PLATFORM_BRIDGEOS           5
+#define PLATFORM_MACCATALYST        6
+#define PLATFORM_IOSSIMULATOR       7
+#define PLATFORM_TVOSSIMULATOR      8
+#define PLATFORM_WATCHOSSIMULATOR   9
+#define PLATFORM_DRIVERKIT          10
+
+struct entry_point_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t entryoff;
+    uint64_t stacksize;
+};
+
+struct source_version_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t version;
+};
+
+struct dyld_info_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t rebase_off;
+    uint32_t rebase_size;
+    uint32_t bind_off;
+    uint32_t bind_size;
+    uint32_t weak_bind_off;
+    uint32_t weak_bind_size;
+    uint32_t lazy_bind_off;
+    uint32_t lazy_bind_size;
+    uint32_t export_off;
+    uint32_t export_size;
+};
+
+#define REBASE_TYPE_POINTER                                 1
+#define REBASE_TYPE_TEXT_ABSOLUTE32                         2
+#define REBASE_TYPE_TEXT_PCREL32                            3
+
+#define REBASE_OPCODE_MASK                                  0xF0
+#define REBASE_IMMEDIATE_MASK                               0x0F
+#define REBASE_OPCODE_DONE                                  0x00
+#define REBASE_OPCODE_SET_TYPE_IMM                          0x10
+#define REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB           0x20
+#define REBASE_OPCODE_ADD_ADDR_ULEB                         0x30
+#define REBASE_OPCODE_ADD_ADDR_IMM_SCALED                   0x40
+#define REBASE_OPCODE_DO_REBASE_IMM_TIMES                   0x50
+#define REBASE_OPCODE_DO_REBASE_ULEB_TIMES                  0x60
+#define REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB               0x70
+#define REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB    0x80
+
+#define BIND_TYPE_POINTER                                   1
+#define BIND_TYPE_TEXT_ABSOLUTE32                           2
+#define BIND_TYPE_TEXT_PCREL32                              3
+
+#define BIND_SPECIAL_DYLIB_SELF                             0
+#define BIND_SPECIAL_DYLIB_MAIN_EXECUTABLE                  -1
+#define BIND_SPECIAL_DYLIB_FLAT_LOOKUP                      -2
+#define BIND_SPECIAL_DYLIB_WEAK_LOOKUP                      -3
+
+#define BIND_SYMBOL_FLAGS_WEAK_IMPORT                       0x1
+#define BIND_SYMBOL_FLAGS_NON_WEAK_DEFINITION               0x8
+
+#define BIND_OPCODE_MASK                                    0xF0
+#define BIND_IMMEDIATE_MASK                                 0x0F
+#define BIND_OPCODE_DONE                                    0x00
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_IMM                   0x10
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB                  0x20
+#define BIND_OPCODE_SET_DYLIB_SPECIAL_IMM                   0x30
+#define BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM           0x40
+#define BIND_OPCODE_SET_TYPE_IMM                            0x50
+#define BIND_OPCODE_SET_ADDEND_SLEB                         0x60
+#define BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB             0x70
+#define BIND_OPCODE_ADD_ADDR_ULEB                           0x80
+#define BIND_OPCODE_DO_BIND                                 0x90
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB                   0xA0
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED             0xB0
+#define BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB        0xC0
+#define BIND_OPCODE_THREADED                                0xD0
+
+#define EXPORT_SYMBOL_FLAGS_KIND_MASK                       0x03
+#define EXPORT_SYMBOL_FLAGS_KIND_REGULAR                    0x00
+#define EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL               0x01
+#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE                   0x02
+#define EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION                 0x04
+#define EXPORT_SYMBOL_FLAGS_REEXPORT                        0x08
+#define EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER               0x10
+
+////////////////////////////////////////////////////////////////////////////////
+// Chained fixups (LC_DYLD_CHAINED_FIXUPS payload)
+
+struct dyld_chained_fixups_header {
+    uint32_t fixups_version;    /* 0 */
+    uint32_t starts_offset;     /* dyld_chained_starts_in_image, from the header */
+    uint32_t imports_offset;
+    uint32_t symbols_offset;
+    uint32_t imports_count;
+    uint32_t imports_format;    /* DYLD_CHAINED_IMPORT* */
+    uint32_t symbols_format;    /* 0 = uncompressed */
+};
+
+struct dyld_chained_starts_in_image {
+    uint32_t seg_count;
+    uint32_t seg_info_offset[1];    /* per segment, from this struct, 0 = no fixups */
+};
+
+struct dyld_chained_starts_in_segment {
+    uint32_t size;
+    uint16_t page_size;
+    uint16_t pointer_format;    /* DYLD_CHAINED_PTR_* */
+    uint64_t segment_offset;    /* vm offset of the segment from the image base */
+    uint32_t max_valid_pointer; /* 32-bit formats: larger rebase targets are not pointers */
+    uint16_t page_count;
+    uint16_t page_start[1];     /* offset of the first fixup in each page, or DYLD_CHAINED_PTR_START_* */
+};
+
+#define DYLD_CHAINED_PTR_START_NONE                         0xFFFF
+#define DYLD_CHAINED_PTR_START_MULTI                        0x8000
+#define DYLD_CHAINED_PTR_START_LAST                         0x8000
+
+#define DYLD_CHAINED_PTR_ARM64E                             1
+#define DYLD_CHAINED_PTR_64                                 2
+#define DYLD_CHAINED_PTR_32                                 3
+#define DYLD_CHAINED_PTR_32_CACHE                           4
+#define DYLD_CHAINED_PTR_32_FIRMWARE                        5
+#define DYLD_CHAINED_PTR_64_OFFSET                          6
+#define DYLD_CHAINED_PTR_ARM64E_KERNEL                      7
+#define DYLD_CHAINED_PTR_64_KERNEL_CACHE                    8
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND                    9
+#define DYLD_CHAINED_PTR_ARM64E_FIRMWARE                    10
+#define DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE                11
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND24                  12
+
+/* Imports are bit fields, decoded by ChainedFixups::read_import() */
+#define DYLD_CHAINED_IMPORT                                 1   /* uint32: lib_ordinal:8 weak_import:1 name_offset:23 */
+#define DYLD_CHAINED_IMPORT_ADDEND                          2   /* the same, then an int32 addend */
+#define DYLD_CHAINED_IMPORT_ADDEND64                        3   /* uint64: lib_ordinal:16 weak_import:1 reserved:15 name_offset:32, then a uint64 addend */
+
+////////////////////////////////////////////////////////////////////////////////
+// Code signature (LC_CODE_SIGNATURE payload), big-endian whatever the image is
+
+#define CSMAGIC_REQUIREMENT                                 0xfade0c00
+#define CSMAGIC_REQUIREMENTS                                0xfade0c01
+#define CSMAGIC_CODEDIRECTORY                               0xfade0c02
+#define CSMAGIC_EMBEDDED_SIGNATURE                          0xfade0cc0
+#define CSMAGIC_DETACHED_SIGNATURE                          0xfade0cc1
+#define CSMAGIC_BLOBWRAPPER                                 0xfade0b01
+#define CSMAGIC_EMBEDDED_ENTITLEMENTS                       0xfade7171
+#define CSMAGIC_EMBEDDED_DER_ENTITLEMENTS                   0xfade7172
+
+#define CSSLOT_CODEDIRECTORY                                0
+#define CSSLOT_INFOSLOT                                     1
+#define CSSLOT_REQUIREMENTS                                 2
+#define CSSLOT_RESOURCEDIR                                  3
+#define CSSLOT_APPLICATION                                  4
+#define CSSLOT_ENTITLEMENTS                                 5
+#define CSSLOT_DER_ENTITLEMENTS                             7
+#define CSSLOT_ALTERNATE_CODEDIRECTORIES                    0x1000
+#define CSSLOT_ALTERNATE_CODEDIRECTORY_MAX                  5
+#define CSSLOT_SIGNATURESLOT                                0x10000
+
+#define CS_HASHTYPE_SHA1                                    1
+#define CS_HASHTYPE_SHA256                                  2
+#define CS_HASHTYPE_SHA256_TRUNCATED                        3   /* the first 20 bytes of SHA-256 */
+#define CS_HASHTYPE_SHA384                                  4
+
+/* CS_CodeDirectory versions that added fields */
+#define CS_SUPPORTSSCATTER                                  0x20100
+#define CS_SUPPORTSTEAMID                                   0x20200
+#define CS_SUPPORTSCODELIMIT64                              0x20300
+#define CS_SUPPORTSEXECSEG                                  0x20400
+
+#define CS_EXECSEG_MAIN_BINARY                              0x1
+
+struct CS_BlobIndex {
+    uint32_t type;      /* CSSLOT_* */
+    uint32_t offset;    /* from the start of the super blob */
+};
+
+struct CS_SuperBlob {
+    uint32_t magic;     /* CSMAGIC_EMBEDDED_SIGNATURE */
+    uint32_t length;    /* of the whole blob */
+    uint32_t count;
+    struct CS_BlobIndex index[1];
+};
+
+struct CS_CodeDirectory {
+    uint32_t magic;             /* CSMAGIC_CODEDIRECTORY */
+    uint32_t length;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t hashOffset;        /* of code slot 0, special slot n is n hashes before it */
+    uint32_t identOffset;
+    uint32_t nSpecialSlots;
+    uint32_t nCodeSlots;
+    uint32_t codeLimit;         /* bytes of the image that are hashed */
+    uint8_t  hashSize;
+    uint8_t  hashType;          /* CS_HASHTYPE_* */
+    uint8_t  platform;
+    uint8_t  pageSize;          /* log2, 0 hashes the image as one page */
+    uint32_t spare2;
+    /* CS_SUPPORTSSCATTER */
+    uint32_t scatterOffset;
+    /* CS_SUPPORTSTEAMID */
+    uint32_t teamOffset;
+    /* CS_SUPPORTSCODELIMIT64 */
+    uint32_t spare3;
+    uint64_t codeLimit64;       /* replaces codeLimit when it is not 0 */
+    /* CS_SUPPORTSEXECSEG */
+    uint64_t execSegBase;
+    uint64_t execSegLimit;
+    uint64_t execSegFlags;      /* CS_EXECSEG_* */
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Symbol table entries
+
+struct nlist {
+    union {
+        uint32_t n_strx;
+    } n_un;
+    uint8_t     n_type;
+    uint8_t     n_sect;
+    int16_t     n_desc;
+    uint32_t    n_value;
+};
+
+struct nlist_64 {
+    union {
+        uint32_t n_strx;
+    } n_un;
+    uint8_t     n_type;
+    uint8_t     n_sect;
+    uint16_t    n_desc;
+    uint64_t    n_value;
+};
+
+#define N_STAB  0xe0
+#define N_PEXT  0x10
+#define N_TYPE  0x0e
+#define N_EXT   0x01
+
+#define N_UNDF  0x0
+#define N_ABS   0x2
+#define N_SECT  0xe
+#define N_PBUD  0xc
+#define N_INDR  0xa
+
+#define NO_SECT     0
+#define MAX_SECT    255
+
+////////////////////////////////////////////////////////////////////////////////
+// x86 thread state (LC_THREAD / LC_UNIXTHREAD payload)
+
+#define x86_THREAD_STATE32      1
+#define x86_FLOAT_STATE32       2
+#define x86_EXCEPTION_STATE32   3
+#define x86_THREAD_STATE64      4
+#define x86_FLOAT_STATE64       5
+#define x86_EXCEPTION_STATE64   6
+#define x86_THREAD_STATE        7
+#define x86_FLOAT_STATE         8
+#define x86_EXCEPTION_STATE     9
+#define x86_DEBUG_STATE32       10
+#define x86_DEBUG_STATE64       11
+#define x86_DEBUG_STATE         12
+#define THREAD_STATE_NONE       13
+
+struct x86_state_hdr {
+    uint32_t flavor;
+    uint32_t count;
+};
+
+struct x86_thread_state32 {
+    uint32_t __eax;
+    uint32_t __ebx;
+    uint32_t __ecx;
+    uint32_t __edx;
+    uint32_t __edi;
+    uint32_t __esi;
+    uint32_t __ebp;
+    uint32_t __esp;
+    uint32_t __ss;
+    uint32_t __eflags;
+    uint32_t __eip;
+    uint32_t __cs;
+    uint32_t __ds;
+    uint32_t __es;
+    uint32_t __fs;
+    uint32_t __gs;
+};
+
+struct x86_thread_state64 {
+    uint64_t __rax;
+    uint64_t __rbx;
+    uint64_t __rcx;
+    uint64_t __rdx;
+    uint64_t __rdi;
+    uint64_t __rsi;
+    uint64_t __rbp;
+    uint64_t __rsp;
+    uint64_t __r8;
+    uint64_t __r9;
+    uint64_t __r10;
+    uint64_t __r11;
+    uint64_t __r12;
+    uint64_t __r13;
+    uint64_t __r14;
+    uint64_t __r15;
+    uint64_t __rip;
+    uint64_t __rflags;
+    uint64_t __cs;
+    uint64_t __fs;
+    uint64_t __gs;
+};
+
+struct x86_thread_state {
+    struct x86_state_hdr tsh;
+    union {
+        struct x86_thread_state32 ts32;
+        struct x86_thread_state64 ts64;
+    } uts;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace rotg {
+
+    /* Byte order helpers (replacement for <libkern/OSByteOrder.h>) */
+
+    inline uint16_t swap16(uint16_t value) {
+        return __builtin_bswap16(value);
+    }
+
+    inline uint32_t swap32(uint32_t value) {
+        return __builtin_bswap32(value);
+    }
+
+    inline uint64_t swap64(uint64_t value) {
+        return __builtin_bswap64(value);
+    }
+
+    inline uint32_t big_to_host32(uint32_t value) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        return value;
+#else
+        return swap32(value);
+#endif
+    }
+
+    /* Convert a fat_arch read from disk (big-endian) to host byte order */
+    inline void fat_arch_to_host(struct fat_arch* arch) {
+        arch->cputype = (cpu_type_t)big_to_host32((uint32_t)arch->cputype);
+        arch->cpusubtype = (cpu_subtype_t)big_to_host32((uint32_t)arch->cpusubtype);
+        arch->offset = big_to_host32(arch->offset);
+        arch->size = big_to_host32(arch->size);
+        arch->align = big_to_host32(arch->align);
+    }
+
+    /* Architecture description (replacement for NXArchInfo) */
+
+    enum ArchByteOrder {ByteOrderUnknown, ByteOrderLittleEndian, ByteOrderBigEndian};
+
+    typedef struct arch_info {
+        const char*     name;
+        cpu_type_t      cputype;
+        cpu_subtype_t   cpusubtype;
+        ArchByteOrder   byteorder;
+        const char*     description;
+    } arch_info_t;
+
+    const arch_info_t* get_arch_info(cpu_type_t cputype, cpu_subtype_t cpusubtype);
+    const arch_info_t* get_arch_info_by_name(const char* name);
+
+    /* cpu type of the machine we are running on, false if it has no Mach-O equivalent */
+    bool get_host_cpu_type(cpu_type_t* cputype, cpu_subtype_t* cpusubtype);
+
+    /* Short name of a PLATFORM_* value, "unknown" if there is none */
+    const char* get_platform_name(uint32_t platform);
+
+}
+
+#endif
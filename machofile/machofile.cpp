@@ -11,22 +11,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <fcntl.h>
 #include <sys/mman.h>
 
 #include <err.h>
 #include <string.h>
 
-#include <libkern/OSAtomic.h>
-#include <mach-o/swap.h>
-
 #include "machofile.h"
+#include "macho_traits.h"
+#include "leb128.h"
+#include "thread_pool.h"
 
 namespace rotg {
     
-    MachOFile::MachOFile()
-        : m_fd(-1)
+    MachOFile::MachOFile(uint32_t options, Arena* arena)
+        : m_owned_arena(arena == NULL ? new Arena() : NULL)
+        , m_arena(arena == NULL ? m_owned_arena.get() : arena)
+        , m_options(options)
+        , m_pool(NULL)
+        , m_fd(-1)
         , m_isInputOwned(false)
+        , m_map_data(NULL)
+        , m_map_length(0)
         , m_header(NULL)
         , m_header64(NULL)
         , m_header_size(0)
@@ -35,125 +43,342 @@ namespace rotg {
         , m_is_universal(false)
         , m_archInfo(NULL)
         , m_is_need_byteswap(false)
+        , m_decoders(NULL)
         , m_string_table(NULL)
+        , m_uuid(NULL)
+        , m_function_starts_cmd(NULL)
+        , m_code_signature_cmd(NULL)
+        , m_symtab_pending(false)
+        , m_dyld_info_pending(false)
+        , m_lazy_failed(false)
     {
         memset(&m_input, 0, sizeof(macho_input_t));
+        memset(&m_version_min_info, 0, sizeof(m_version_min_info));
+        memset(&m_encryption_info, 0, sizeof(m_encryption_info));
+        
+        init_containers();
     }
     
-    MachOFile::~MachOFile()
+    MachOFile::MachOFile(MachOFile&& other)
+        : m_arena(NULL)
+        , m_options(ParseOptionNone)
+        , m_pool(NULL)
+        , m_fd(-1)
+        , m_isInputOwned(false)
+        , m_map_data(NULL)
+        , m_map_length(0)
+        , m_symtab_pending(false)
+        , m_dyld_info_pending(false)
+        , m_lazy_failed(false)
     {
-        segment_command_64_infos_t::iterator s64i_iter;
-        for (s64i_iter = m_segment_command_64_infos.begin(); s64i_iter != m_segment_command_64_infos.end(); s64i_iter++) {
-            delete *s64i_iter;
-        }
-        
-        thread_command_infos_t::iterator tci_iter;
-        for (tci_iter = m_thread_command_infos.begin(); tci_iter != m_thread_command_infos.end(); tci_iter++) {
-            delete *tci_iter;
+        take(other);
+    }
+    
+    MachOFile& MachOFile::operator=(MachOFile&& other)
+    {
+        if (this != &other) {
+            /* Let go of our own results while the arena they live in is still around */
+            release_input();
+            init_containers();
+            
+            take(other);
         }
         
-        dylib_command_infos_t::iterator dli_iter;
-        for (dli_iter = m_dylib_command_infos.begin(); dli_iter != m_dylib_command_infos.end(); dli_iter++) {
-            delete *dli_iter;
+        return *this;
+    }
+    
+    MachOFile::~MachOFile()
+    {
+        /* Parse results are released with the arena, nothing to delete one by one */
+        release_input();
+    }
+    
+    void MachOFile::release_input()
+    {
+        if (m_isInputOwned && (m_map_data != NULL)) {
+            munmap(m_map_data, m_map_length);
         }
         
-        if (m_isInputOwned && (m_input.data) && (m_input.data != MAP_FAILED)) {
-            munmap((void*)m_input.data, m_input.length);
-            m_input.data = NULL;
-        }
+        m_map_data = NULL;
+        m_map_length = 0;
+        m_isInputOwned = false;
+        memset(&m_input, 0, sizeof(macho_input_t));
         
-        if (m_fd > 0) {
+        if (m_fd >= 0) {
             close(m_fd);
             m_fd = -1;
         }
     }
     
-    /* Verify that the given range is within bounds. */
-    const void* MachOFile::macho_read(const void *address, size_t length) {
-        if ((((uint8_t *) address) - ((uint8_t *) m_input.data)) + length > m_input.length) {
-            warnx("Short read parsing Mach-O input");
-            return NULL;
+    void MachOFile::take(MachOFile& other)
+    {
+        m_owned_arena = std::move(other.m_owned_arena);
+        m_arena = other.m_arena;
+        m_options = other.m_options;
+        m_pool = other.m_pool;
+        
+        m_fd = other.m_fd;
+        m_isInputOwned = other.m_isInputOwned;
+        m_map_data = other.m_map_data;
+        m_map_length = other.m_map_length;
+        m_input = other.m_input;
+        
+        m_header = other.m_header;
+        m_header64 = other.m_header64;
+        m_header_size = other.m_header_size;
+        m_fat_header = other.m_fat_header;
+        m_is64bit = other.m_is64bit;
+        m_is_universal = other.m_is_universal;
+        m_archInfo = other.m_archInfo;
+        m_is_need_byteswap = other.m_is_need_byteswap;
+        m_decoders = other.m_decoders;
+        
+        /* The containers take their arena along, the elements stay where they are */
+        m_load_command_infos = std::move(other.m_load_command_infos);
+        m_segment_command_64_infos = std::move(other.m_segment_command_64_infos);
+        m_segment_command_infos = std::move(other.m_segment_command_infos);
+        m_segment_infos = std::move(other.m_segment_infos);
+        m_dyld_info_command_info = std::move(other.m_dyld_info_command_info);
+        m_thread_command_infos = std::move(other.m_thread_command_infos);
+        m_dylib_command_infos = std::move(other.m_dylib_command_infos);
+        m_runpath_additions_infos = std::move(other.m_runpath_additions_infos);
+        m_fat_arch_infos = std::move(other.m_fat_arch_infos);
+        m_symtab_command_info = std::move(other.m_symtab_command_info);
+        m_dysymtab_command_info = std::move(other.m_dysymtab_command_info);
+        m_string_table = other.m_string_table;
+        m_uuid = other.m_uuid;
+        m_function_starts_cmd = other.m_function_starts_cmd;
+        m_code_signature_cmd = other.m_code_signature_cmd;
+        m_version_min_info = other.m_version_min_info;
+        m_encryption_info = other.m_encryption_info;
+        m_section_64s = std::move(other.m_section_64s);
+        m_sections = std::move(other.m_sections);
+        m_segmentInfo = std::move(other.m_segmentInfo);
+        m_export_prefix.swap(other.m_export_prefix);
+        m_export_stack.swap(other.m_export_stack);
+        m_export_arenas.swap(other.m_export_arenas);
+        
+        m_symtab_pending.store(other.m_symtab_pending.load());
+        m_dyld_info_pending.store(other.m_dyld_info_pending.load());
+        m_lazy_failed = other.m_lazy_failed;
+        
+        /* Load commands whose info is a member of the file point at the old object */
+        load_command_infos_t::iterator iter;
+        for (iter = m_load_command_infos.begin(); iter != m_load_command_infos.end(); iter++) {
+            if (iter->cmd_info == &other.m_dyld_info_command_info) {
+                iter->cmd_info = &m_dyld_info_command_info;
+            } else if (iter->cmd_info == &other.m_version_min_info) {
+                iter->cmd_info = &m_version_min_info;
+            } else if (iter->cmd_info == &other.m_encryption_info) {
+                iter->cmd_info = &m_encryption_info;
+            }
         }
         
-        return address;
-    }
-    
-    /* Verify that address + offset + length is within bounds. */
-    const void* MachOFile::macho_offset(const void *address, size_t offset, size_t length) {
-        void *result = ((uint8_t *) address) + offset;
-        return macho_read(result, length);
+        /* other owns nothing now, leave it as a freshly reset file */
+        other.m_fd = -1;
+        other.m_isInputOwned = false;
+        other.m_map_data = NULL;
+        if (!other.m_owned_arena && m_owned_arena) {
+            other.m_owned_arena.reset(new Arena());
+            other.m_arena = other.m_owned_arena.get();
+        }
+        other.reset();
     }
     
-    const void* MachOFile::read_sleb128(const void *address, int64_t& result)
+    void MachOFile::reset()
     {
-        uint8_t *p = ((uint8_t *) address);
-        result = 0;
+        /* Remember how far the containers grew, the next file is probably alike */
+        size_t loadCommands = m_load_command_infos.capacity();
+        size_t segments = m_segment_infos.capacity();
+        size_t segment64s = m_segment_command_64_infos.capacity();
+        size_t segment32s = m_segment_command_infos.capacity();
+        size_t section64s = m_section_64s.capacity();
+        size_t section32s = m_sections.capacity();
+        size_t threads = m_thread_command_infos.capacity();
+        size_t dylibs = m_dylib_command_infos.capacity();
+        size_t rpaths = m_runpath_additions_infos.capacity();
+        size_t fatArchs = m_fat_arch_infos.capacity();
+        size_t symbols = m_symtab_command_info.symbols.capacity();
+        size_t indirectSymbols = m_dysymtab_command_info.indirect_symbols.capacity();
+        
+        dynamic_loader_info_t& loader_info = m_dyld_info_command_info.loader_info;
+        size_t rebaseRuns = loader_info.rebase_runs.capacity();
+        binding_info_t* binding_infos[] = {&loader_info.binding_info, &loader_info.weak_binding_info, &loader_info.lazy_binding_info};
+        const size_t bindingCount = sizeof(binding_infos) / sizeof(binding_infos[0]);
+        size_t bindOpcodes[bindingCount];
+        size_t bindActions[bindingCount];
+        for (size_t i = 0; i < bindingCount; i++) {
+            bindOpcodes[i] = binding_infos[i]->opcodes.capacity();
+            bindActions[i] = binding_infos[i]->actions.capacity();
+        }
+        size_t exportOpcodes = loader_info.export_info.opcodes.capacity();
+        size_t exportActions = loader_info.export_info.actions.capacity();
         
-        int bit = 0;
-        uint8_t byte;
+        release_input();
         
-        do {
-            byte = *p++;
-            result |= ((byte & 0x7f) << bit);
-            bit += 7;
-        } while (byte & 0x80);
+        /* Drop the old contents before their memory is handed out again */
+        init_containers();
         
-        // sign extend negative numbers
-        if ( (byte & 0x40) != 0 )
-        {
-            result |= (-1LL) << bit;
+        std::vector<std::unique_ptr<Arena> >::iterator arena;
+        for (arena = m_export_arenas.begin(); arena != m_export_arenas.end(); arena++) {
+            (*arena)->reset();
         }
         
-        return p;
+        if (m_owned_arena) {
+            m_arena->reset();
+            
+            m_load_command_infos.reserve(loadCommands);
+            m_segment_infos.reserve(segments);
+            m_segment_command_64_infos.reserve(segment64s);
+            m_segment_command_infos.reserve(segment32s);
+            m_section_64s.reserve(section64s);
+            m_sections.reserve(section32s);
+            m_thread_command_infos.reserve(threads);
+            m_dylib_command_infos.reserve(dylibs);
+            m_runpath_additions_infos.reserve(rpaths);
+            m_fat_arch_infos.reserve(fatArchs);
+            m_symtab_command_info.symbols.reserve(symbols);
+            m_dysymtab_command_info.indirect_symbols.reserve(indirectSymbols);
+            loader_info.rebase_runs.reserve(rebaseRuns);
+            for (size_t i = 0; i < bindingCount; i++) {
+                binding_infos[i]->opcodes.reserve(bindOpcodes[i]);
+                binding_infos[i]->actions.reserve(bindActions[i]);
+            }
+            loader_info.export_info.opcodes.reserve(exportOpcodes);
+            loader_info.export_info.actions.reserve(exportActions);
+        }
+        
+        m_header = NULL;
+        m_header64 = NULL;
+        m_header_size = 0;
+        m_fat_header = NULL;
+        m_is64bit = false;
+        m_is_universal = false;
+        m_archInfo = NULL;
+        m_is_need_byteswap = false;
+        m_decoders = NULL;
+        m_string_table = NULL;
+        m_uuid = NULL;
+        m_function_starts_cmd = NULL;
+        m_code_signature_cmd = NULL;
+        memset(&m_version_min_info, 0, sizeof(m_version_min_info));
+        memset(&m_encryption_info, 0, sizeof(m_encryption_info));
+        
+        m_symtab_pending.store(false);
+        m_dyld_info_pending.store(false);
+        m_lazy_failed = false;
     }
     
-    const void* MachOFile::read_uleb128(const void *address, uint64_t& result)
+    /* Point every parse result container at the arena, empty */
+    void MachOFile::init_containers()
     {
-        uint8_t *p = ((uint8_t *) address);
-        result = 0;
+        m_load_command_infos = load_command_infos_t(m_arena);
+        m_segment_command_64_infos = segment_command_64_infos_t(m_arena);
+        m_segment_command_infos = segment_command_infos_t(m_arena);
+        m_segment_infos = segment_infos_t(m_arena);
+        m_thread_command_infos = thread_command_infos_t(m_arena);
+        m_dylib_command_infos = dylib_command_infos_t(m_arena);
+        m_runpath_additions_infos = runpath_additions_infos_t(m_arena);
+        m_fat_arch_infos = fat_arch_infos_t(m_arena);
+        m_section_64s = section_64s_t(m_arena);
+        m_sections = sections_t(m_arena);
+        m_segmentInfo = SegmentInfoMap(std::less<uint64_t>(), m_arena);
+        
+        m_symtab_command_info.cmd_type = 0;
+        m_symtab_command_info.cmd = NULL;
+        m_symtab_command_info.symbols = SymbolTable(m_arena);
+        
+        m_dysymtab_command_info.cmd_type = 0;
+        m_dysymtab_command_info.cmd = NULL;
+        m_dysymtab_command_info.ilocalsym = 0;
+        m_dysymtab_command_info.nlocalsym = 0;
+        m_dysymtab_command_info.iextdefsym = 0;
+        m_dysymtab_command_info.nextdefsym = 0;
+        m_dysymtab_command_info.iundefsym = 0;
+        m_dysymtab_command_info.nundefsym = 0;
+        m_dysymtab_command_info.indirect_symbols = symbol_indices_t(m_arena);
+        m_dysymtab_command_info.indirect_sections = indirect_sections_t(m_arena);
+        m_dysymtab_command_info.toc = dylib_tocs_t(m_arena);
+        m_dysymtab_command_info.modules = dylib_module_infos_t(m_arena);
+        
+        m_dyld_info_command_info.cmd_type = 0;
+        m_dyld_info_command_info.cmd = NULL;
+        m_dyld_info_command_info.chained_fixups_cmd = NULL;
+        m_dyld_info_command_info.exports_trie_cmd = NULL;
+        
+        dynamic_loader_info_t& loader_info = m_dyld_info_command_info.loader_info;
+        loader_info.rebase_runs = rebase_runs_t(m_arena);
+        
+        binding_info_t* binding_infos[] = {&loader_info.binding_info, &loader_info.weak_binding_info, &loader_info.lazy_binding_info};
+        for (size_t i = 0; i < sizeof(binding_infos) / sizeof(binding_infos[0]); i++) {
+            binding_infos[i]->opcodes = bind_opcodes_t(m_arena);
+            binding_infos[i]->actions = bind_actions_t(m_arena);
+        }
         
-        int bit = 0;
+        loader_info.export_info.opcodes = export_opcodes_t(m_arena);
+        loader_info.export_info.actions = export_actions_t(m_arena);
+    }
+    
+    /* Verify that the given range is within bounds. */
+    const void* MachOFile::macho_read(const void *address, size_t length) const {
+        return macho_offset(address, 0, length);
+    }
+    
+    /* Verify that address + offset + length is within bounds, without forming a pointer outside of the input. */
+    const void* MachOFile::macho_offset(const void *address, size_t offset, size_t length) const {
+        ByteSpan input(m_input.data, m_input.length);
+        uint64_t start = (const uint8_t*)address - input.data();
+        if ((const uint8_t*)address < input.data() || !input.contains(start, offset) || !input.contains(start + offset, length)) {
+            warnx("Short read parsing Mach-O input");
+            return NULL;
+        }
         
-        do {
-            uint64_t slice = *p & 0x7f;
-            
-            if (bit >= 64 || slice << bit >> bit != slice)
-                return NULL;
-            else {
-                result |= (slice << bit);
-                bit += 7;
-            }
-        } 
-        while (*p++ & 0x80);
-
-        return p;
+        return input.data() + start + offset;
+    }
+    
+    /* Cut [offset, offset + length) out of the input, so a table or stream is checked once and read unchecked */
+    bool MachOFile::input_span(uint64_t offset, uint64_t length, ByteSpan* span) const {
+        if (!ByteSpan(m_input.data, m_input.length).slice(offset, length, span)) {
+            warnx("Short read parsing Mach-O input");
+            return false;
+        }
+        
+        return true;
     }
     
     bool MachOFile::parse_universal()
     {
-        uint32_t nfat = OSSwapBigToHostInt32(m_fat_header->nfat_arch);
-        const struct fat_arch* archs = (const struct fat_arch*)macho_offset(m_fat_header, sizeof(struct fat_header), sizeof(struct fat_arch));
+        uint32_t nfat = big_to_host32(m_fat_header->nfat_arch);
+        
+        /* Check the whole arch table once */
+        const struct fat_arch* archs = (const struct fat_arch*)macho_offset(m_fat_header, sizeof(struct fat_header), (uint64_t)nfat * sizeof(struct fat_arch));
         if (archs == NULL) {
             return false;
         }
         
         //printf("Architecture Count: %d\n", nfat);
         for (uint32_t i = 0; i < nfat; i++) {
-            const struct fat_arch* arch = (const struct fat_arch*)macho_read(archs + i, sizeof(struct fat_arch));
-            if (arch == NULL)
-                return false;
+            const struct fat_arch* arch = &archs[i];
+            
+            fat_arch_info_t fat_arch_info;
+            fat_arch_info.arch = *arch;
+            fat_arch_to_host(&fat_arch_info.arch);
+            fat_arch_info.ptr = arch;
+            fat_arch_info.input.length = fat_arch_info.arch.size;
+            
+            /* Headers-only slices are read by parse_slices(), nothing to point at yet */
+            if (m_options & ParseOptionHeadersOnly) {
+                fat_arch_info.input.data = NULL;
+                fat_arch_info.input.baseOffset = m_input.baseOffset + fat_arch_info.arch.offset;
+                m_fat_arch_infos.push_back(fat_arch_info);
+                continue;
+            }
             
             /* Fetch a pointer to the architecture's Mach-O header. */
-            size_t length = OSSwapBigToHostInt32(arch->size);
-            const void *data = macho_offset(m_input.data, OSSwapBigToHostInt32(arch->offset), length);
+            const void *data = macho_offset(m_input.data, fat_arch_info.arch.offset, fat_arch_info.arch.size);
             if (data == NULL)
                 return false;
             
-            fat_arch_info_t fat_arch_info;
-            fat_arch_info.arch = *arch;
-            swap_fat_arch(&fat_arch_info.arch, 1, NX_LittleEndian);
-            fat_arch_info.ptr = arch;
-            fat_arch_info.input.length = length;
             fat_arch_info.input.data = data;
             fat_arch_info.input.baseOffset = getOffset(data);
             
@@ -163,43 +388,95 @@ namespace rotg {
         return true;
     }
     
-    bool MachOFile::parse_LC_SEGMENT_64(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    template <typename Arch>
+    bool MachOFile::parse_LC_SEGMENT(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
     {
-        if (cmdsize < sizeof(struct segment_command_64)) {
+        typedef typename Arch::segment_command_t segment_command_t;
+        typedef typename Arch::section_t section_t;
+        
+        /* Only the segments of the image's word size are mapped, the others are left alone */
+        if (cmd_type != Arch::kSegmentCommand) {
+            return true;
+        }
+        
+        if (cmdsize < sizeof(segment_command_t)) {
             warnx("Incorrect cmd size");
             return false;
         }
         
-        const struct segment_command_64* segment_cmd_64 = (const struct segment_command_64*)load_cmd_info->cmd;
-        
-        // preserve segment RVA/size for offset lookup
-        m_segmentInfo[segment_cmd_64->fileoff] = std::make_pair(segment_cmd_64->vmaddr, segment_cmd_64->vmsize);
+        const segment_command_t* segment_cmd = (const segment_command_t*)load_cmd_info->cmd;
+        
+        segment_info_t segment;
+        segment.cmd_type = cmd_type;
+        segment.cmd = load_cmd_info->cmd;
+        segment.segname = segment_cmd->segname;
+        segment.vmaddr = Arch::load_word(segment_cmd->vmaddr);
+        segment.vmsize = Arch::load_word(segment_cmd->vmsize);
+        segment.fileoff = Arch::load_word(segment_cmd->fileoff);
+        segment.filesize = Arch::load_word(segment_cmd->filesize);
+        segment.maxprot = Arch::load32((uint32_t)segment_cmd->maxprot);
+        segment.initprot = Arch::load32((uint32_t)segment_cmd->initprot);
+        segment.nsects = Arch::load32(segment_cmd->nsects);
+        segment.flags = Arch::load32(segment_cmd->flags);
+        
+        /* Bind runs are checked against vmaddr + vmsize, so the segment must end inside the address space */
+        uint64_t addressSpaceEnd = Arch::kPointerSize == sizeof(uint64_t) ? UINT64_MAX : UINT32_MAX;
+        if (segment.vmaddr > addressSpaceEnd || segment.vmsize > addressSpaceEnd - segment.vmaddr) {
+            warnx("Segment past the end of the address space");
+            return false;
+        }
         
-        segment_command_64_info_t* info = new segment_command_64_info_t();
-        if (info == NULL) {
+        /* The section headers follow the command within its cmdsize, nsects may lie */
+        if ((uint64_t)segment.nsects * sizeof(section_t) > cmdsize - sizeof(segment_command_t)) {
+            warnx("Sections past the end of their segment command");
             return false;
         }
         
+        // preserve segment RVA/size for offset lookup
+        m_segmentInfo[segment.fileoff] = std::make_pair(segment.vmaddr, segment.vmsize);
+        m_segment_infos.push_back(segment);
+        
+        load_cmd_info->cmd_info = add_segment_command(cmd_type, segment_cmd, (const section_t*)(segment_cmd + 1), segment.nsects);
+        
+        return true;
+    }
+    
+    segment_command_64_info_t* MachOFile::add_segment_command(uint32_t cmd_type, const struct segment_command_64* cmd, const struct section_64* sections, uint32_t nsects)
+    {
+        segment_command_64_info_t* info = m_arena->make<segment_command_64_info_t>();
         info->cmd_type = cmd_type;
-        info->cmd = segment_cmd_64;
+        info->cmd = cmd;
+        info->section_64s = section_64s_t(m_arena);
+        info->section_64s.reserve(nsects);
         
         m_segment_command_64_infos.push_back(info);
         
         // Section Headers
-        for (uint32_t nsect = 0; nsect < segment_cmd_64->nsects; ++nsect)
-        {
-            const struct section_64* section = (const struct section_64*)macho_offset(segment_cmd_64, sizeof(struct segment_command_64) + nsect * sizeof(struct section_64), sizeof(struct section_64));
-            if (section == NULL) {
-                return false;
-            }
-            
-            info->section_64s.push_back(section);
-            m_section_64s.push_back(section);
+        for (uint32_t nsect = 0; nsect < nsects; ++nsect) {
+            info->section_64s.push_back(&sections[nsect]);
+            m_section_64s.push_back(&sections[nsect]);
         }
         
-        load_cmd_info->cmd_info = info;
+        return info;
+    }
+    
+    segment_command_info_t* MachOFile::add_segment_command(uint32_t cmd_type, const struct segment_command* cmd, const struct section* sections, uint32_t nsects)
+    {
+        segment_command_info_t* info = m_arena->make<segment_command_info_t>();
+        info->cmd_type = cmd_type;
+        info->cmd = cmd;
+        info->sections = sections_t(m_arena);
+        info->sections.reserve(nsects);
+        
+        m_segment_command_infos.push_back(info);
         
-        return true;
+        // Section Headers
+        for (uint32_t nsect = 0; nsect < nsects; ++nsect) {
+            info->sections.push_back(&sections[nsect]);
+            m_sections.push_back(&sections[nsect]);
+        }
+        
+        return info;
     }
     
     bool MachOFile::parse_LC_RPATH(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
@@ -209,15 +486,20 @@ namespace rotg {
             return false;
         }
         
-        /* Fetch the path */
-        size_t pathlen = cmdsize - sizeof(struct rpath_command);
-        const char* pathptr = (const char*)macho_offset(load_cmd_info->cmd, sizeof(struct rpath_command), pathlen);
-        if (pathptr == NULL)
+        const struct rpath_command *rpath_cmd = (const struct rpath_command *)load_cmd_info->cmd;
+        
+        /* Fetch the path, which has to end inside the command */
+        uint32_t pathoff = read32(rpath_cmd->path.offset);
+        const char* pathptr = pathoff >= sizeof(struct rpath_command) ? ByteSpan(rpath_cmd, cmdsize).cstring(pathoff) : NULL;
+        if (pathptr == NULL) {
+            warnx("Malformed path in load command");
             return false;
+        }
+        size_t pathlen = cmdsize - pathoff;
         
         struct runpath_additions_info info;
         info.cmd_type = cmd_type;
-        info.cmd = (struct rpath_command*)load_cmd_info->cmd;
+        info.cmd = rpath_cmd;
         info.path = pathptr;
         info.pathlen = pathlen;
         
@@ -235,18 +517,16 @@ namespace rotg {
         
         const struct dylib_command *dylib_cmd = (const struct dylib_command *)load_cmd_info->cmd;
         
-        /* Extract the install name */
-        size_t namelen = cmdsize - sizeof(struct dylib_command);
-        const char* nameptr = (const char*)macho_offset(load_cmd_info->cmd, sizeof(struct dylib_command), namelen);
+        /* Extract the install name, which has to end inside the command */
+        uint32_t nameoff = read32(dylib_cmd->dylib.name.offset);
+        const char* nameptr = nameoff >= sizeof(struct dylib_command) ? ByteSpan(dylib_cmd, cmdsize).cstring(nameoff) : NULL;
         if (nameptr == NULL) {
+            warnx("Malformed install name in load command");
             return false;
         }
+        size_t namelen = cmdsize - nameoff;
         
-        dylib_command_info_t* dl_info = new dylib_command_info_t();
-        if (dl_info == NULL) {
-            return false;
-        }
-        
+        dylib_command_info_t* dl_info = m_arena->make<dylib_command_info_t>();
         dl_info->cmd_type = cmd_type;
         dl_info->cmd = dylib_cmd;
         dl_info->libname = nameptr;
@@ -258,225 +538,215 @@ namespace rotg {
         return true;
     }
     
-    bool MachOFile::parse_rebase_node(const struct dyld_info_command* dyld_info_cmd, uint64_t baseAddress)
+    bool RebaseCollector::visit_run(const rebase_run_t& run)
+    {
+        /* A single pointer keeps no stride until the next one gives it one */
+        rebase_run_t next = run;
+        if (next.count == 1) {
+            next.stride = 0;
+        }
+        
+        if (!m_runs->empty()) {
+            rebase_run_t& last = m_runs->back();
+            if (last.type == next.type && next.address > last.address) {
+                if (last.count == 1 && (next.count == 1 || next.stride == next.address - last.address)) {
+                    last.stride = next.address - last.address;
+                    last.count += next.count;
+                    return true;
+                }
+                
+                if (last.count > 1 && next.address == last.address + last.count * last.stride
+                    && (next.count == 1 || next.stride == last.stride)) {
+                    last.count += next.count;
+                    return true;
+                }
+            }
+        }
+        
+        m_runs->push_back(next);
+        return true;
+    }
+    
+    bool BindCollector::visit_bind_run(const bind_action_t& action, uint64_t count, uint64_t stride)
     {
-        const uint8_t* ptr = (const uint8_t*)macho_offset(m_input.data, dyld_info_cmd->bind_off, dyld_info_cmd->bind_size);
-        if (ptr == NULL) {
+        /* Every bind of the run is stored, so it must be one the file could hold */
+        if (!m_file.bind_run_fits(action, count)) {
+            warnx("Bind run of %llu binds larger than its segment", (unsigned long long)count);
+            m_overflowed = true;
             return false;
         }
-
-        const uint8_t* endAddress = ptr + dyld_info_cmd->bind_size;
         
-        //const uint8_t* address = base_addr;
-        bool isDone = false;
+        return BindVisitor::visit_bind_run(action, count, stride);
+    }
+    
+    template <typename Arch>
+    bool MachOFile::decode_rebase_stream(uint64_t location, uint32_t length, uint64_t baseAddress, RebaseVisitor& visitor) const
+    {
+        /* The stream is checked once, the opcodes read up to its end */
+        ByteSpan stream;
+        if (!input_span(location, length, &stream)) {
+            return false;
+        }
         
-        while ((ptr < endAddress) && !isDone) {
+        const uint8_t* ptr = stream.data();
+        const uint8_t* endAddress = stream.end();
+        
+        const uint64_t ptrSize = Arch::kPointerSize;
+        uint64_t address = baseAddress;
+        uint32_t type = 0;
+        
+        while (ptr < endAddress) {
             uint8_t opcode = *ptr & REBASE_OPCODE_MASK;
-            //uint8_t immediate = *ptr & REBASE_IMMEDIATE_MASK;
+            uint8_t immediate = *ptr & REBASE_IMMEDIATE_MASK;
+            
+            ptr++;
+            
+            /* Set by the DO_REBASE opcodes */
+            rebase_run_t run;
+            run.count = 0;
             
             switch (opcode) {
                 case REBASE_OPCODE_DONE:
-                    isDone = true;
-                    break;
+                    return true;
                     
                 case REBASE_OPCODE_SET_TYPE_IMM:
-                    /*
                     type = immediate;
-                    
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_SET_TYPE_IMM"
-                                           :[NSString stringWithFormat:@"type (%i)", type]];
-                    */
                     break;
                     
                 case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
                 {
-                    /*
                     uint32_t segmentIndex = immediate;
                     
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB"
-                                           :[NSString stringWithFormat:@"segment (%u)", segmentIndex]];
-                    
-                    uint64_t offset = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"offset (%qi)",offset]];
+                    uint64_t val;
+                    ptr = read_uleb128(ptr, endAddress, val);
+                    if (ptr == NULL) {
+                        return false;
+                    }
                     
-                    if (([self is64bit] == NO && segmentIndex >= segments.size()) ||
-                        ([self is64bit] == YES && segmentIndex >= segments_64.size()))
-                    {
-                        [NSException raise:@"Segment"
-                                    format:@"index is out of range %u", segmentIndex];
+                    if (segmentIndex >= m_segment_infos.size()) {
+                        return false;
                     }
                     
-                    address = ([self is64bit] == NO ? segments.at(segmentIndex)->vmaddr
-                               : segments_64.at(segmentIndex)->vmaddr) + offset;
-                    */
+                    address = m_segment_infos[segmentIndex].vmaddr + val;
                 } break;
                     
                 case REBASE_OPCODE_ADD_ADDR_ULEB:
                 {
-                    /*
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_ADD_ADDR_ULEB"
-                                           :@""];
-                    
-                    uint64_t offset = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"offset (%qi)",offset]];
+                    uint64_t val;
+                    ptr = read_uleb128(ptr, endAddress, val);
+                    if (ptr == NULL) {
+                        return false;
+                    }
                     
-                    address += offset;
-                    */
+                    address += val;
                 } break;
                     
                 case REBASE_OPCODE_ADD_ADDR_IMM_SCALED:
-                {
-                    /*
-                    uint32_t scale = immediate;
-                    
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_ADD_ADDR_IMM_SCALED"
-                                           :[NSString stringWithFormat:@"scale (%u)",scale]];
-                    
-                    address += scale * ptrSize;
-                    */
-                } break;
+                    address += immediate * ptrSize;
+                    break;
                     
                 case REBASE_OPCODE_DO_REBASE_IMM_TIMES:
-                {
-                    /*
-                    uint32_t count = immediate;
-                    
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_DO_REBASE_IMM_TIMES"
-                                           :[NSString stringWithFormat:@"count (%u)",count]];
-                    
-                    [node.details setAttributes:MVUnderlineAttributeName,@"YES",nil];
-                    
-                    for (uint32_t index = 0; index < count; index++)
-                    {
-                        [self rebaseAddress:address type:type node:actionNode location:doRebaseLocation];
-                        address += ptrSize;
-                    }
-                    
-                    doRebaseLocation = NSMaxRange(range);
-                    */
-                    
-                } break;
+                    run.count = immediate;
+                    run.stride = ptrSize;
+                    break;
                     
                 case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
-                {
-                    /*
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_DO_REBASE_ULEB_TIMES"
-                                           :@""];
-                    
-                    uint32_t startNextRebase = NSMaxRange(range);
-                    
-                    uint64_t count = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"count (%qu)",count]];
-                    
-                    [node.details setAttributes:MVUnderlineAttributeName,@"YES",nil];
-                    
-                    for (uint64_t index = 0; index < count; index++)
-                    {
-                        [self rebaseAddress:address type:type node:actionNode location:doRebaseLocation];
-                        address += ptrSize;
+                    ptr = read_uleb128(ptr, endAddress, run.count);
+                    if (ptr == NULL) {
+                        return false;
                     }
-                    
-                    doRebaseLocation = startNextRebase;
-                    */
-                    
-                } break;
+                    run.stride = ptrSize;
+                    break;
                     
                 case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
                 {
-                    /*
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB"
-                                           :@""];
-                    
-                    uint32_t startNextRebase = NSMaxRange(range);
-                    
-                    uint64_t offset = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"offset (%qi)",offset]];
-                    
-                    [node.details setAttributes:MVUnderlineAttributeName,@"YES",nil];
-                    
-                    [self rebaseAddress:address type:type node:actionNode location:doRebaseLocation];
-                    address += ptrSize + offset;
-                    
-                    doRebaseLocation = startNextRebase;
-                    */
-                    
+                    uint64_t val;
+                    ptr = read_uleb128(ptr, endAddress, val);
+                    if (ptr == NULL) {
+                        return false;
+                    }
+                    run.count = 1;
+                    run.stride = ptrSize + val;
                 } break;
                     
-                case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB: 
+                case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
                 {
-                    /*
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB"
-                                           :@""];
-                    
-                    uint32_t startNextRebase = NSMaxRange(range);
-                    
-                    uint64_t count = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"count (%qu)",count]];
-                    
-                    uint64_t skip = [self read_uleb128:range lastReadHex:&lastReadHex];
-                    [node.details appendRow:[NSString stringWithFormat:@"%.8lX", range.location]
-                                           :lastReadHex
-                                           :@"uleb128"
-                                           :[NSString stringWithFormat:@"skip (%qu)",skip]];
-                    
-                    [node.details setAttributes:MVUnderlineAttributeName,@"YES",nil];
-                    
-                    for (uint64_t index = 0; index < count; index++) 
-                    {
-                        [self rebaseAddress:address type:type node:actionNode location:doRebaseLocation];
-                        address += ptrSize + skip;
+                    ptr = read_uleb128(ptr, endAddress, run.count);
+                    if (ptr == NULL) {
+                        return false;
                     }
                     
-                    doRebaseLocation = startNextRebase;
-                    */
-                    
+                    uint64_t skip;
+                    ptr = read_uleb128(ptr, endAddress, skip);
+                    if (ptr == NULL) {
+                        return false;
+                    }
+                    run.stride = ptrSize + skip;
                 } break;
                     
                 default:
                     return false;
-                    break;
             }
             
-            ptr++;
+            if (run.count > 0) {
+                run.address = address;
+                run.type = type;
+                
+                /* A visitor that has seen enough stops the walk, that is not an error */
+                if (!visitor.visit_run(run)) {
+                    return true;
+                }
+                
+                address += run.count * run.stride;
+            }
         }
-
-        return isDone;
+        
+        return true;
+    }
+    
+    bool MachOFile::visit_rebases(RebaseVisitor& visitor) const
+    {
+        const struct dyld_info_command* dyld_info_cmd = m_dyld_info_command_info.cmd;
+        if (dyld_info_cmd == NULL && m_dyld_info_command_info.chained_fixups_cmd == NULL) {
+            return true;
+        }
+        
+        if (m_input.data == NULL) {
+            warnx("Rebase opcodes are not read in headers-only mode");
+            return false;
+        }
+        
+        if (m_dyld_info_command_info.chained_fixups_cmd != NULL) {
+            return (this->*m_decoders->decode_chained_fixups)(&visitor, NULL);
+        }
+        
+        uint32_t offset = read32(dyld_info_cmd->rebase_off);
+        uint32_t size = read32(dyld_info_cmd->rebase_size);
+        if (offset == 0 || size == 0) {
+            return true;
+        }
+        
+        return (this->*m_decoders->decode_rebase_stream)(offset, size, getBaseAddress(), visitor);
     }
     
-    bool MachOFile::parse_binding_node(binding_info_t* binding_info, uint64_t location, uint32_t length, BindNodeType nodeType, uint64_t baseAddress)
+    /* Whether count binds from address, stride bytes apart (ptrSize + skip), all lie in [segmentStart, segmentEnd) */
+    static bool bind_run_in_segment(uint64_t address, uint64_t count, uint64_t skip, uint64_t ptrSize, uint64_t segmentStart, uint64_t segmentEnd)
+    {
+        if (address < segmentStart || address >= segmentEnd || segmentEnd - address < ptrSize) {
+            return false;
+        }
+        
+        if (count <= 1) {
+            return true;
+        }
+        
+        /* The last bind may start at most room bytes past the first, so skip <= room keeps the stride from overflowing */
+        uint64_t room = segmentEnd - address - ptrSize;
+        return skip <= room && count - 1 <= room / (ptrSize + skip);
+    }
+    
+    template <typename Arch>
+    bool MachOFile::decode_bind_stream(uint64_t location, uint32_t length, BindNodeType nodeType, uint64_t baseAddress, BindVisitor& visitor) const
     {
         uint64_t libOrdinal = 0;
         uint32_t type = 0;
@@ -486,17 +756,23 @@ namespace rotg {
         
         uint64_t doBindLocation = location;
         
-        const uint8_t* ptr = (const uint8_t*)macho_offset(m_input.data, location, length);
-        if (ptr == NULL) {
+        /* The stream is checked once, the opcodes read up to its end */
+        ByteSpan stream;
+        if (!input_span(location, length, &stream)) {
             return false;
         }
         
-        const uint8_t* endAddress = ptr + length;
+        const uint8_t* ptr = stream.data();
+        const uint8_t* endAddress = stream.end();
         
-        uint64_t ptrSize = (is64bit() ? sizeof(uint64_t) : sizeof(uint32_t));
+        const uint64_t ptrSize = Arch::kPointerSize;
         uint64_t address = baseAddress;
         bool isDone = false;
         
+        /* Every bind has to land in the segment the last SET_SEGMENT_AND_OFFSET_ULEB chose */
+        uint64_t segmentStart = 0;
+        uint64_t segmentEnd = 0;
+        
         while ((ptr < endAddress) && !isDone) {
             uint8_t opcode = *ptr & REBASE_OPCODE_MASK;
             uint8_t immediate = *ptr & REBASE_IMMEDIATE_MASK;
@@ -508,6 +784,11 @@ namespace rotg {
             
             ptr++;
             
+            /* A visitor that has seen enough stops the walk, that is not an error */
+            if (!visitor.visit_opcode(bind_op)) {
+                return true;
+            }
+            
             switch (opcode)
             {
                 case BIND_OPCODE_DONE:                    
@@ -525,7 +806,7 @@ namespace rotg {
                     break;
                     
                 case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
-                    ptr = (const u_int8_t*)read_uleb128(ptr, libOrdinal);
+                    ptr = read_uleb128(ptr, endAddress, libOrdinal);
                     if (ptr == NULL) {
                         return false;
                     }
@@ -547,8 +828,10 @@ namespace rotg {
                     
                 case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM: {
                     symbolFlags = immediate;
-                    symbolName = (const char*)ptr;
-                    ptr += strlen(symbolName) + 1;
+                    ptr = read_cstring(ptr, endAddress, symbolName);
+                    if (ptr == NULL) {
+                        return false;
+                    }
                 } break;
                     
                 case BIND_OPCODE_SET_TYPE_IMM:
@@ -556,7 +839,7 @@ namespace rotg {
                     break;
                     
                 case BIND_OPCODE_SET_ADDEND_SLEB:
-                    ptr = (const u_int8_t*)read_sleb128(ptr, addend);
+                    ptr = read_sleb128(ptr, endAddress, addend);
                     if (ptr == NULL) {
                         return false;
                     }
@@ -567,28 +850,26 @@ namespace rotg {
                     uint32_t segmentIndex = immediate;
 
                     uint64_t val;
-                    ptr = (const u_int8_t*)read_uleb128(ptr, val);
+                    ptr = read_uleb128(ptr, endAddress, val);
                     if (ptr == NULL) {
                         return false;
                     }
                     
-                    if (is64bit()) {
-                        if (segmentIndex >= m_segment_command_64_infos.size()) {
-                            return false;
-                        }
-                        
-                        address = m_segment_command_64_infos[segmentIndex]->cmd->vmaddr + val;
-                    } else if (is32bit()) {
-                        // TODO: index vs. check size
-                        
-                        // TODO: address = segments.at(segmentIndex)->vmaddr;
+                    if (segmentIndex >= m_segment_infos.size()) {
+                        return false;
                     }
+                    
+                    const segment_info_t& segment = m_segment_infos[segmentIndex];
+                    segmentStart = segment.vmaddr;
+                    segmentEnd = segment.vmaddr + segment.vmsize;
+                    
+                    address = segment.vmaddr + val;
                 } break;
                     
                 case BIND_OPCODE_ADD_ADDR_ULEB:
                 {
                     uint64_t val;
-                    ptr = (const u_int8_t*)read_uleb128(ptr, val);
+                    ptr = read_uleb128(ptr, endAddress, val);
                     if (ptr == NULL) {
                         return false;
                     }
@@ -598,6 +879,11 @@ namespace rotg {
                     
                 case BIND_OPCODE_DO_BIND:
                 {
+                    if (!bind_run_in_segment(address, 1, 0, ptrSize, segmentStart, segmentEnd)) {
+                        warnx("Bind address outside of its segment");
+                        return false;
+                    }
+                    
                     bind_action_t bindAction;
                     bindAction.address = address;
                     bindAction.type = type;
@@ -609,7 +895,9 @@ namespace rotg {
                     bindAction.location = doBindLocation;
                     bindAction.ptrSize = ptrSize;
                     
-                    binding_info->actions.push_back(bindAction);
+                    if (!visitor.visit_bind(bindAction)) {
+                        return true;
+                    }
                     
                     doBindLocation = getOffset((void*)ptr);
 
@@ -621,11 +909,16 @@ namespace rotg {
                     uint64_t startNextBind = getOffset((void*)ptr);
                     
                     uint64_t val;
-                    ptr = (const u_int8_t*)read_uleb128(ptr, val);
+                    ptr = read_uleb128(ptr, endAddress, val);
                     if (ptr == NULL) {
                         return false;
                     }
                     
+                    if (!bind_run_in_segment(address, 1, 0, ptrSize, segmentStart, segmentEnd)) {
+                        warnx("Bind address outside of its segment");
+                        return false;
+                    }
+                    
                     bind_action_t bindAction;
                     bindAction.address = address;
                     bindAction.type = type;
@@ -637,7 +930,9 @@ namespace rotg {
                     bindAction.location = doBindLocation;
                     bindAction.ptrSize = ptrSize;
                     
-                    binding_info->actions.push_back(bindAction);
+                    if (!visitor.visit_bind(bindAction)) {
+                        return true;
+                    }
                     
                     doBindLocation = startNextBind;
                     
@@ -648,6 +943,11 @@ namespace rotg {
                 {
                     uint32_t scale = immediate;
                     
+                    if (!bind_run_in_segment(address, 1, 0, ptrSize, segmentStart, segmentEnd)) {
+                        warnx("Bind address outside of its segment");
+                        return false;
+                    }
+                    
                     bind_action_t bindAction;
                     bindAction.address = address;
                     bindAction.type = type;
@@ -659,7 +959,9 @@ namespace rotg {
                     bindAction.location = doBindLocation;
                     bindAction.ptrSize = ptrSize;
                     
-                    binding_info->actions.push_back(bindAction);
+                    if (!visitor.visit_bind(bindAction)) {
+                        return true;
+                    }
                     
                     doBindLocation = getOffset((void*)ptr);
                     
@@ -671,275 +973,1271 @@ namespace rotg {
                     uint64_t startNextBind = getOffset((void*)ptr);
                     
                     uint64_t count;
-                    ptr = (const u_int8_t*)read_uleb128(ptr, count);
+                    ptr = read_uleb128(ptr, endAddress, count);
                     if (ptr == NULL) {
                         return false;
                     }
 
                     uint64_t skip;
-                    ptr = (const u_int8_t*)read_uleb128(ptr, skip);
+                    ptr = read_uleb128(ptr, endAddress, skip);
                     if (ptr == NULL) {
                         return false;
                     }
                     
-                    for (uint64_t index = 0; index < count; index++) 
-                    {
-                        bind_action_t bindAction;
-                        bindAction.address = address;
-                        bindAction.type = type;
-                        bindAction.symbolName = symbolName;
-                        bindAction.flags = symbolFlags;
-                        bindAction.addend = addend;
-                        bindAction.libOrdinal = libOrdinal;
-                        bindAction.nodeType = nodeType;
-                        bindAction.location = doBindLocation;
-                        bindAction.ptrSize = ptrSize;
-                        
-                        binding_info->actions.push_back(bindAction);
+                    /* count comes from the file, the whole run has to fit before any of it is bound */
+                    if (!bind_run_in_segment(address, count, skip, ptrSize, segmentStart, segmentEnd)) {
+                        warnx("Bind run outside of its segment");
+                        return false;
+                    }
+                    
+                    bind_action_t bindAction;
+                    bindAction.address = address;
+                    bindAction.type = type;
+                    bindAction.symbolName = symbolName;
+                    bindAction.flags = symbolFlags;
+                    bindAction.addend = addend;
+                    bindAction.libOrdinal = libOrdinal;
+                    bindAction.nodeType = nodeType;
+                    bindAction.location = doBindLocation;
+                    bindAction.ptrSize = ptrSize;
+                    
+                    /* One call for the whole run, the visitor decides whether to expand it */
+                    if (count > 0) {
+                        if (!visitor.visit_bind_run(bindAction, count, ptrSize + skip)) {
+                            return true;
+                        }
                         
                         doBindLocation = startNextBind;
-                        
-                        address += ptrSize + skip;
                     }
+                    
+                    address += count * (ptrSize + skip);
                 } break;
                     
                 default:
                     return false;
             }
+        }
+        
+        return true;
+    }
+    
+    bool MachOFile::visit_binds(BindNodeType nodeType, BindVisitor& visitor) const
+    {
+        const struct dyld_info_command* dyld_info_cmd = m_dyld_info_command_info.cmd;
+        if (dyld_info_cmd == NULL && m_dyld_info_command_info.chained_fixups_cmd == NULL) {
+            return true;
+        }
+        
+        if (m_input.data == NULL) {
+            warnx("Bind opcodes are not read in headers-only mode");
+            return false;
+        }
+        
+        if (m_dyld_info_command_info.chained_fixups_cmd != NULL) {
+            return nodeType != NodeTypeBind || (this->*m_decoders->decode_chained_fixups)(NULL, &visitor);
+        }
+        
+        uint32_t offset;
+        uint32_t size;
+        switch (nodeType) {
+            case NodeTypeBind:
+                offset = read32(dyld_info_cmd->bind_off);
+                size = read32(dyld_info_cmd->bind_size);
+                break;
+                
+            case NodeTypeWeakBind:
+                offset = read32(dyld_info_cmd->weak_bind_off);
+                size = read32(dyld_info_cmd->weak_bind_size);
+                break;
+                
+            case NodeTypeLazyBind:
+                offset = read32(dyld_info_cmd->lazy_bind_off);
+                size = read32(dyld_info_cmd->lazy_bind_size);
+                break;
+                
+            default:
+                return false;
+        }
+        
+        if (offset == 0 || size == 0) {
+            return true;
+        }
+        
+        return (this->*m_decoders->decode_bind_stream)(offset, size, nodeType, getBaseAddress(), visitor);
+    }
+    
+    /* Chained fixups with at least this many pages of chains are walked in parallel when there is a pool */
+    static const size_t kParallelChainedPages = 256;
+    
+    // one page with chains, and where its bytes are
+    typedef struct chained_page {
+        uint32_t        segment;    // index into the walk's chained_segment_t
+        uint32_t        page;
+        const uint8_t*  data;
+        size_t          length;
+    } chained_page_t;
+    
+    typedef struct chained_task {
+        chained_fixups_t        fixups;
+        std::vector<size_t>     page_ends;  // end of each page's fixups
+        bool                    success;
+    } chained_task_t;
+    
+    /* Hand the fixups of one page to the visitors in chain order; false in *stop when one has seen enough */
+    template <typename Arch>
+    static bool deliver_chained_fixups(const MachOFile& file, const ChainedFixups& fixups, const chained_segment_t& segment, const chained_page_t& page,
+                                       const chained_fixup_t* first, const chained_fixup_t* last, uint64_t baseAddress,
+                                       RebaseVisitor* rebases, BindVisitor* binds, bool* stop)
+    {
+        const uint64_t ptrSize = Arch::kPointerSize;
+        const uint8_t* segmentData = page.data - (uint64_t)page.page * segment.pageSize;
+        
+        for (const chained_fixup_t* fixup = first; fixup != last; fixup++) {
+            uint64_t address = baseAddress + segment.segmentOffset + fixup->offset;
             
-            binding_info->opcodes.push_back(bind_op);
+            if (!fixup->bind) {
+                if (rebases == NULL) {
+                    continue;
+                }
+                
+                rebase_run_t run;
+                run.address = address;
+                run.count = 1;
+                run.stride = 0;
+                run.type = REBASE_TYPE_POINTER;
+                
+                if (!rebases->visit_run(run)) {
+                    *stop = true;
+                    return true;
+                }
+            } else {
+                if (binds == NULL) {
+                    continue;
+                }
+                
+                chained_import_t import;
+                if (!fixups.read_import((uint32_t)fixup->target, &import)) {
+                    warnx("Bad chained fixup import %llu", (unsigned long long)fixup->target);
+                    return false;
+                }
+                
+                bind_action_t bindAction;
+                bindAction.address = address;
+                bindAction.type = BIND_TYPE_POINTER;
+                bindAction.symbolName = import.name;
+                bindAction.flags = import.weakImport ? BIND_SYMBOL_FLAGS_WEAK_IMPORT : 0;
+                bindAction.addend = import.addend + fixup->addend;
+                bindAction.libOrdinal = (uint64_t)import.libOrdinal;
+                bindAction.nodeType = NodeTypeBind;
+                bindAction.location = file.getOffset(segmentData + fixup->offset);
+                bindAction.ptrSize = ptrSize;
+                
+                if (!binds->visit_bind(bindAction)) {
+                    *stop = true;
+                    return true;
+                }
+            }
         }
         
         return true;
     }
     
-    bool MachOFile::parse_export_node(export_info_t* exportInfo, const char* prefix, uint64_t location, uint64_t length, uint64_t skipBytes, uint64_t baseAddress)
+    template <typename Arch>
+    bool MachOFile::decode_chained_fixups(RebaseVisitor* rebases, BindVisitor* binds) const
     {
-        const uint8_t* ptr = (const uint8_t*)macho_offset(m_input.data, location + skipBytes, length);
-        if (ptr == NULL) {
+        ChainedFixups fixups = getChainedFixups();
+        if (fixups.empty() || !fixups.init()) {
+            warnx("Malformed chained fixups");
             return false;
         }
         
-        export_opcode_t exportOpcode;
-        exportOpcode.ptr = ptr;
+        uint64_t baseAddress = getBaseAddress();
         
-        uint8_t terminalSize = *ptr;
-        exportOpcode.terminalSize = terminalSize;
-        ptr++;
+        /* The page starts of every segment with chains, and the pages that have any */
+        std::vector<chained_segment_t> segments;
+        std::vector<chained_page_t> pages;
         
-        if (terminalSize != 0) {
-            export_action_t exportAction;
+        for (uint32_t segmentIndex = 0; segmentIndex < m_segment_infos.size(); segmentIndex++) {
+            uint64_t fileoff = m_segment_infos[segmentIndex].fileoff;
+            uint64_t filesize = m_segment_infos[segmentIndex].filesize;
+            
+            if (segmentIndex >= fixups.getSegmentCount()) {
+                break;
+            }
             
-            ptr = (const uint8_t*)read_uleb128(ptr, exportAction.flags);
-            if (ptr == NULL) {
+            chained_segment_t segment;
+            if (!fixups.read_segment(segmentIndex, &segment)) {
+                warnx("Malformed chained fixups");
                 return false;
             }
             
-            uint64_t offset;
-            ptr = (const uint8_t*)read_uleb128(ptr, offset);
-            if (ptr == NULL) {
+            if (segment.pageCount == 0) {
+                continue;
+            }
+            
+            if (fileoff > m_input.length || filesize > m_input.length - fileoff) {
+                warnx("Chained fixups in a segment outside of the file");
                 return false;
             }
-            exportAction.offset = offset;
             
-            exportAction.symbolName = prefix;
-            exportAction.address = baseAddress + offset;
+            for (uint32_t p = 0; p < segment.pageCount; p++) {
+                const uint8_t* start = segment.pageStarts + sizeof(uint16_t) * p;
+                if ((start[0] | (start[1] << 8)) == DYLD_CHAINED_PTR_START_NONE) {
+                    continue;
+                }
+                
+                uint64_t pageOffset = (uint64_t)p * segment.pageSize;
+                if (pageOffset >= filesize) {
+                    warnx("Chained fixups in a page outside of the file");
+                    return false;
+                }
+                
+                chained_page_t page;
+                page.segment = (uint32_t)segments.size();
+                page.page = p;
+                page.data = (const uint8_t*)m_input.data + fileoff + pageOffset;
+                page.length = std::min<uint64_t>(segment.pageSize, filesize - pageOffset);
+                pages.push_back(page);
+            }
             
-            exportInfo->actions.push_back(exportAction);
+            segments.push_back(segment);
         }
         
-        uint8_t childCount = *ptr;
-        exportOpcode.childCount = childCount;
-        ptr++;
+        bool stop = false;
         
-        while (childCount-- > 0) {
-            export_node_t exportNode;
+        if (m_pool == NULL || pages.size() < kParallelChainedPages) {
+            chained_fixups_t pageFixups;
             
-            exportNode.label = (const char*)ptr;
-            ptr += strlen(exportNode.label) + 1;
+            std::vector<chained_page_t>::const_iterator page;
+            for (page = pages.begin(); page != pages.end() && !stop; page++) {
+                const chained_segment_t& segment = segments[page->segment];
+                
+                pageFixups.clear();
+                if (!ChainedFixups::walk_page(segment, page->page, page->data, page->length, baseAddress, pageFixups)) {
+                    warnx("Malformed fixup chain");
+                    return false;
+                }
+                
+                if (!deliver_chained_fixups<Arch>(*this, fixups, segment, *page, pageFixups.data(), pageFixups.data() + pageFixups.size(),
+                                                  baseAddress, rebases, binds, &stop)) {
+                    return false;
+                }
+            }
             
-            uint64_t skip;
-            ptr = (const uint8_t*)read_uleb128(ptr, skip);
-            if (ptr == NULL) {
+            return true;
+        }
+        
+        /* Pages are independent: walk runs of them as tasks, then hand the fixups over in page order */
+        size_t count = std::min(pages.size(), 4 * (m_pool->size() + 1));
+        std::vector<chained_task_t> tasks(count);
+        
+        m_pool->parallel_for(count, [&](size_t t) {
+            chained_task_t& task = tasks[t];
+            task.success = true;
+            
+            size_t first = pages.size() * t / count;
+            size_t last = pages.size() * (t + 1) / count;
+            for (size_t i = first; i < last && task.success; i++) {
+                const chained_page_t& page = pages[i];
+                task.success = ChainedFixups::walk_page(segments[page.segment], page.page, page.data, page.length, baseAddress, task.fixups);
+                task.page_ends.push_back(task.fixups.size());
+            }
+        });
+        
+        for (size_t t = 0; t < count && !stop; t++) {
+            const chained_task_t& task = tasks[t];
+            if (!task.success) {
+                warnx("Malformed fixup chain");
                 return false;
             }
-            exportNode.skip = skip;
             
-            std::string _prefix = prefix;
-            _prefix += exportNode.label;
+            size_t first = pages.size() * t / count;
+            size_t begin = 0;
+            for (size_t i = 0; i < task.page_ends.size() && !stop; i++) {
+                const chained_page_t& page = pages[first + i];
+                const chained_fixup_t* fixup = task.fixups.data();
+                
+                if (!deliver_chained_fixups<Arch>(*this, fixups, segments[page.segment], page, fixup + begin, fixup + task.page_ends[i],
+                                                  baseAddress, rebases, binds, &stop)) {
+                    return false;
+                }
+                
+                begin = task.page_ends[i];
+            }
+        }
+        
+        return true;
+    }
+    
+    /* Export tries at least this large are decoded in parallel when there is a pool */
+    static const size_t kParallelExportTrieSize = 64 * 1024;
+    
+    /* Never split deeper than this many edges below the root */
+    static const uint32_t kMaxExportCutDepth = 8;
+    
+    // subtree of the export trie decoded by a task
+    typedef struct export_cut {
+        export_walk_t   root;           // label is the whole prefix of the subtree
+        size_t          action_index;   // where its actions and opcodes go among the top level ones
+        size_t          opcode_index;
+        size_t          task_action_end;    // end of its actions and opcodes in the task's results
+        size_t          task_opcode_end;
+    } export_cut_t;
+    
+    typedef std::vector<export_cut_t> export_cuts_t;
+    
+    typedef struct export_task {
+        export_info_t       info;
+        std::string         prefix;
+        export_walk_stack_t stack;
+        bool                success;
+    } export_task_t;
+    
+    /* Depth first from root with an explicit stack; prefix holds the path to the current node.
+       With cuts, nodes at cutDepth are recorded there instead of being decoded. */
+    static bool walk_export_trie(const ExportTrie& trie, const export_walk_t& root, uint64_t baseAddress, Arena* arena,
+                                 std::string& prefix, export_walk_stack_t& stack, export_info_t* exportInfo,
+                                 uint32_t cutDepth, export_cuts_t* cuts)
+    {
+        prefix.clear();
+        stack.clear();
+        stack.push_back(root);
+        
+        /* Every node takes at least two bytes, more visits than bytes means a cycle */
+        size_t visits = 0;
+        
+        while (!stack.empty()) {
+            export_walk_t walk = stack.back();
+            stack.pop_back();
+            
+            if (++visits > trie.size()) {
+                warnx("Export trie has a cycle");
+                return false;
+            }
             
-            exportOpcode.nodes.push_back(exportNode);
+            prefix.resize(walk.prefix_length);
+            prefix.append(walk.label, walk.label_length);
+            
+            if (cuts != NULL && walk.depth == cutDepth) {
+                export_cut_t cut;
+                cut.root.offset = walk.offset;
+                cut.root.prefix_length = 0;
+                cut.root.label = arena->copy_string(prefix.data(), prefix.size());
+                cut.root.label_length = prefix.size();
+                cut.root.depth = walk.depth;
+                cut.action_index = exportInfo->actions.size();
+                cut.opcode_index = exportInfo->opcodes.size();
+                
+                cuts->push_back(cut);
+                continue;
+            }
             
-            if (!parse_export_node(exportInfo, _prefix.c_str(), location, length - skip, skip, baseAddress)) {
+            export_trie_node_t node;
+            if (!trie.read_node(walk.offset, &node)) {
+                warnx("Export trie node outside of the trie");
                 return false;
             }
+            
+            export_opcode_t exportOpcode;
+            exportOpcode.ptr = trie.data() + walk.offset;
+            exportOpcode.terminalSize = node.terminal != NULL ? node.terminal_end - node.terminal : 0;
+            exportOpcode.childCount = node.child_count;
+            exportOpcode.nodes = export_nodes_t(arena);
+            
+            if (node.terminal != NULL) {
+                export_symbol_t symbol;
+                if (!ExportTrie::read_terminal(node, &symbol)) {
+                    warnx("Malformed export trie terminal");
+                    return false;
+                }
+                
+                export_action_t exportAction;
+                exportAction.flags = symbol.flags;
+                exportAction.offset = symbol.offset;
+                exportAction.symbolName = arena->copy_string(prefix.data(), prefix.size());
+                exportAction.address = baseAddress + symbol.offset;
+                exportAction.ptr = node.terminal;
+                
+                exportInfo->actions.push_back(exportAction);
+            }
+            
+            size_t firstChild = stack.size();
+            const uint8_t* ptr = node.edges;
+            
+            for (uint8_t i = 0; i < node.child_count; i++) {
+                export_walk_t child;
+                uint64_t skip;
+                if (!trie.read_edge(ptr, &child.label, &child.label_length, &skip)) {
+                    warnx("Malformed export trie edge");
+                    return false;
+                }
+                child.offset = skip;
+                child.prefix_length = prefix.size();
+                child.depth = walk.depth + 1;
+                
+                export_node_t exportNode;
+                exportNode.label = child.label;
+                exportNode.skip = skip;
+                exportOpcode.nodes.push_back(exportNode);
+                
+                stack.push_back(child);
+            }
+            
+            /* Pop the children in edge order, so exports come out in trie order */
+            std::reverse(stack.begin() + firstChild, stack.end());
+            
+            exportInfo->opcodes.push_back(exportOpcode);
         }
         
-        exportInfo->opcodes.push_back(exportOpcode);
-        
         return true;
     }
     
-    bool MachOFile::parse_LC_DYLD_INFO(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    /* Shallowest depth with at least tasks nodes, 0 if the trie is too small or too narrow to split */
+    static uint32_t export_cut_depth(const ExportTrie& trie, size_t tasks)
     {
-        if (cmdsize < sizeof(struct dyld_info_command)) {
-            warnx("Incorrect name size");
+        std::vector<uint64_t> level(1, 0);
+        std::vector<uint64_t> next;
+        
+        for (uint32_t depth = 1; depth <= kMaxExportCutDepth; depth++) {
+            next.clear();
+            
+            std::vector<uint64_t>::const_iterator iter;
+            for (iter = level.begin(); iter != level.end(); iter++) {
+                export_trie_node_t node;
+                if (!trie.read_node(*iter, &node)) {
+                    return 0;
+                }
+                
+                const uint8_t* ptr = node.edges;
+                for (uint8_t i = 0; i < node.child_count; i++) {
+                    const char* label;
+                    size_t length;
+                    uint64_t child;
+                    if (!trie.read_edge(ptr, &label, &length, &child)) {
+                        return 0;
+                    }
+                    next.push_back(child);
+                }
+                
+                if (next.size() >= tasks) {
+                    return depth;
+                }
+            }
+            
+            if (next.empty()) {
+                return 0;
+            }
+            level.swap(next);
+        }
+        
+        return 0;
+    }
+    
+    bool MachOFile::parse_export_trie(export_info_t* exportInfo, const ExportTrie& trie, uint64_t baseAddress)
+    {
+        if (m_pool != NULL && m_pool->size() > 0 && trie.size() >= kParallelExportTrieSize) {
+            uint32_t cutDepth = export_cut_depth(trie, 8 * (m_pool->size() + 1));
+            if (cutDepth > 0) {
+                return parse_export_trie_parallel(exportInfo, trie, cutDepth, baseAddress);
+            }
+        }
+        
+        export_walk_t root = { 0, 0, NULL, 0, 0 };
+        return walk_export_trie(trie, root, baseAddress, m_arena, m_export_prefix, m_export_stack, exportInfo, 0, NULL);
+    }
+    
+    bool MachOFile::parse_export_trie_parallel(export_info_t* exportInfo, const ExportTrie& trie, uint32_t cutDepth, uint64_t baseAddress)
+    {
+        /* The levels above cutDepth are walked here, every node at cutDepth is the root of a task */
+        export_info_t top;
+        top.opcodes = export_opcodes_t(m_arena);
+        top.actions = export_actions_t(m_arena);
+        
+        export_cuts_t cuts;
+        export_walk_t root = { 0, 0, NULL, 0, 0 };
+        if (!walk_export_trie(trie, root, baseAddress, m_arena, m_export_prefix, m_export_stack, &top, cutDepth, &cuts)) {
             return false;
         }
         
-        uint64_t base_addr = 0;
+        /* A few runs of consecutive subtrees per thread, each decoded into an arena of its own */
+        size_t cutCount = cuts.size();
+        size_t count = std::min(cutCount, 4 * (m_pool->size() + 1));
+        while (m_export_arenas.size() < count) {
+            m_export_arenas.push_back(std::unique_ptr<Arena>(new Arena()));
+        }
         
-        /* Iterate over the load commands */
-        load_command_infos_t::iterator iter;
-        for (iter = m_load_command_infos.begin(); iter != m_load_command_infos.end(); iter++) {
+        std::unique_ptr<export_task_t[]> tasks(new export_task_t[count]);
+        
+        m_pool->parallel_for(count, [&](size_t t) {
+            export_task_t& task = tasks[t];
+            Arena* arena = m_export_arenas[t].get();
+            task.info.opcodes = export_opcodes_t(arena);
+            task.info.actions = export_actions_t(arena);
+            task.success = true;
             
-            load_command_info_t* load_cmd_info = &(*iter);
-            uint32_t cmd_type = load_cmd_info->cmd_type;
+            for (size_t i = cutCount * t / count; i < cutCount * (t + 1) / count && task.success; i++) {
+                task.success = walk_export_trie(trie, cuts[i].root, baseAddress, arena, task.prefix, task.stack, &task.info, 0, NULL);
+                cuts[i].task_action_end = task.info.actions.size();
+                cuts[i].task_opcode_end = task.info.opcodes.size();
+            }
+        });
+        
+        size_t totalActions = top.actions.size();
+        size_t totalOpcodes = top.opcodes.size();
+        for (size_t t = 0; t < count; t++) {
+            if (!tasks[t].success) {
+                return false;
+            }
+            totalActions += tasks[t].info.actions.size();
+            totalOpcodes += tasks[t].info.opcodes.size();
+        }
+        
+        exportInfo->actions.reserve(exportInfo->actions.size() + totalActions);
+        exportInfo->opcodes.reserve(exportInfo->opcodes.size() + totalOpcodes);
+        
+        /* Splice the subtrees back in at their preorder positions, so the result is that of a serial walk */
+        size_t action = 0;
+        size_t opcode = 0;
+        
+        for (size_t t = 0; t < count; t++) {
+            const export_info_t& info = tasks[t].info;
+            size_t taskAction = 0;
+            size_t taskOpcode = 0;
             
-            switch (cmd_type) {
-                case LC_SEGMENT: {
-                    struct segment_command const * segment_command = (struct segment_command const *)load_cmd_info->cmd;
-                    if (segment_command->fileoff == 0 && segment_command->filesize != 0)
-                    {
-                        base_addr = segment_command->vmaddr;
-                    }
-                } break;
-                    
-                case LC_SEGMENT_64: {
-                    struct segment_command_64 const * segment_command_64 = (struct segment_command_64 const *)load_cmd_info->cmd;
-                    if (segment_command_64->fileoff == 0 && segment_command_64->filesize != 0)
-                    {
-                        base_addr = segment_command_64->vmaddr;
-                    }
-                    
-                } break;
+            for (size_t i = cutCount * t / count; i < cutCount * (t + 1) / count; i++) {
+                const export_cut_t& cut = cuts[i];
+                
+                exportInfo->actions.insert(exportInfo->actions.end(), top.actions.begin() + action, top.actions.begin() + cut.action_index);
+                exportInfo->actions.insert(exportInfo->actions.end(), info.actions.begin() + taskAction, info.actions.begin() + cut.task_action_end);
+                action = cut.action_index;
+                taskAction = cut.task_action_end;
+                
+                exportInfo->opcodes.insert(exportInfo->opcodes.end(), top.opcodes.begin() + opcode, top.opcodes.begin() + cut.opcode_index);
+                exportInfo->opcodes.insert(exportInfo->opcodes.end(), info.opcodes.begin() + taskOpcode, info.opcodes.begin() + cut.task_opcode_end);
+                opcode = cut.opcode_index;
+                taskOpcode = cut.task_opcode_end;
             }
         }
         
+        exportInfo->actions.insert(exportInfo->actions.end(), top.actions.begin() + action, top.actions.end());
+        exportInfo->opcodes.insert(exportInfo->opcodes.end(), top.opcodes.begin() + opcode, top.opcodes.end());
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_DYLD_INFO(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct dyld_info_command)) {
+            warnx("Incorrect name size");
+            return false;
+        }
+        
         load_cmd_info->cmd_info = &m_dyld_info_command_info;
         
         const struct dyld_info_command* dyld_info_cmd = (const struct dyld_info_command*)load_cmd_info->cmd;
         m_dyld_info_command_info.cmd = dyld_info_cmd;
         m_dyld_info_command_info.cmd_type = cmd_type;
         
-        if (dyld_info_cmd->rebase_off * dyld_info_cmd->rebase_size > 0)
-        {
-            // TODO: createRebaseNode
-            /*
-            if (!parse_rebase_node(input, dyld_info_cmd)) {
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_DYLD_CHAINED_FIXUPS(uint32_t /*cmd_type*/, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct linkedit_data_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        m_dyld_info_command_info.chained_fixups_cmd = (const struct linkedit_data_command*)load_cmd_info->cmd;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_DYLD_EXPORTS_TRIE(uint32_t /*cmd_type*/, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct linkedit_data_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        m_dyld_info_command_info.exports_trie_cmd = (const struct linkedit_data_command*)load_cmd_info->cmd;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_FUNCTION_STARTS(uint32_t /*cmd_type*/, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct linkedit_data_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        m_function_starts_cmd = (const struct linkedit_data_command*)load_cmd_info->cmd;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_CODE_SIGNATURE(uint32_t /*cmd_type*/, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct linkedit_data_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        m_code_signature_cmd = (const struct linkedit_data_command*)load_cmd_info->cmd;
+        
+        return true;
+    }
+    
+    /* The bytes a linkedit_data_command points at, NULL if it is empty, unmapped or outside of the file */
+    const uint8_t* MachOFile::getLinkeditData(const struct linkedit_data_command* cmd, size_t* size) const
+    {
+        if (cmd == NULL || m_input.data == NULL) {
+            return NULL;
+        }
+        
+        uint64_t offset = read32(cmd->dataoff);
+        uint64_t length = read32(cmd->datasize);
+        if (length == 0 || offset + length > m_input.length) {
+            return NULL;
+        }
+        
+        *size = length;
+        return (const uint8_t*)m_input.data + offset;
+    }
+    
+    ChainedFixups MachOFile::getChainedFixups() const
+    {
+        size_t size;
+        const uint8_t* data = getLinkeditData(m_dyld_info_command_info.chained_fixups_cmd, &size);
+        if (data == NULL) {
+            return ChainedFixups();
+        }
+        
+        return ChainedFixups(data, size);
+    }
+    
+    const uint8_t* MachOFile::getFunctionStartsData(size_t* size) const
+    {
+        return getLinkeditData(m_function_starts_cmd, size);
+    }
+    
+    CodeSignature MachOFile::getCodeSignature() const
+    {
+        size_t size;
+        const uint8_t* data = getLinkeditData(m_code_signature_cmd, &size);
+        if (data == NULL) {
+            return CodeSignature();
+        }
+        
+        return CodeSignature(data, size);
+    }
+    
+    /* Code directories with at least this many pages are hashed in parallel when there is a pool */
+    static const uint32_t kParallelCodePages = 64;
+    
+    // one run of pages hashed by a pool task
+    typedef struct code_pages_task {
+        std::vector<uint32_t>   bad_pages;
+        bool                    success;
+    } code_pages_task_t;
+    
+    bool MachOFile::verify_code_pages(const code_directory_t& directory, std::vector<uint32_t>& badPages) const
+    {
+        const uint8_t* image = (const uint8_t*)m_input.data;
+        if (image == NULL || !CodeSignature::can_verify(directory)) {
+            return false;
+        }
+        
+        if (directory.codeLimit > m_input.length) {
+            warnx("Code signature covers more than the file");
+            return false;
+        }
+        
+        uint32_t pages = directory.nCodeSlots;
+        if (m_pool == NULL || m_pool->size() == 0 || pages < kParallelCodePages) {
+            return CodeSignature::verify_pages(directory, image, m_input.length, 0, pages, badPages);
+        }
+        
+        /* Pages are hashed on their own: hash runs of them as tasks, then collect the mismatches in page order */
+        size_t count = std::min((size_t)pages, 4 * (m_pool->size() + 1));
+        std::vector<code_pages_task_t> tasks(count);
+        
+        m_pool->parallel_for(count, [&](size_t t) {
+            uint32_t first = (uint32_t)((uint64_t)pages * t / count);
+            uint32_t last = (uint32_t)((uint64_t)pages * (t + 1) / count);
+            tasks[t].success = CodeSignature::verify_pages(directory, image, m_input.length, first, last, tasks[t].bad_pages);
+        });
+        
+        bool success = true;
+        for (size_t t = 0; t < count; t++) {
+            success = tasks[t].success && success;
+            badPages.insert(badPages.end(), tasks[t].bad_pages.begin(), tasks[t].bad_pages.end());
+        }
+        
+        return success;
+    }
+    
+    uint64_t MachOFile::getBaseAddress() const
+    {
+        uint64_t base_addr = 0;
+        
+        /* Iterate over the segments */
+        segment_infos_t::const_iterator iter;
+        for (iter = m_segment_infos.begin(); iter != m_segment_infos.end(); iter++) {
+            if (iter->fileoff == 0 && iter->filesize != 0) {
+                base_addr = iter->vmaddr;
+            }
+        }
+        
+        return base_addr;
+    }
+    
+    /* Where the export trie is, 0 for the size if there is none */
+    void MachOFile::getExportTrieRange(uint64_t* offset, uint64_t* size) const
+    {
+        const struct linkedit_data_command* exports_trie_cmd = m_dyld_info_command_info.exports_trie_cmd;
+        const struct dyld_info_command* dyld_info_cmd = m_dyld_info_command_info.cmd;
+        
+        if (exports_trie_cmd != NULL) {
+            *offset = read32(exports_trie_cmd->dataoff);
+            *size = read32(exports_trie_cmd->datasize);
+        } else if (dyld_info_cmd != NULL) {
+            *offset = read32(dyld_info_cmd->export_off);
+            *size = read32(dyld_info_cmd->export_size);
+        } else {
+            *offset = 0;
+            *size = 0;
+        }
+    }
+    
+    bool MachOFile::bind_run_fits(const bind_action_t& action, uint64_t count) const
+    {
+        segment_infos_t::const_iterator iter;
+        for (iter = m_segment_infos.begin(); iter != m_segment_infos.end(); iter++) {
+            if (action.address >= iter->vmaddr && action.address - iter->vmaddr < iter->vmsize) {
+                uint64_t fileBytes = iter->fileoff < m_input.length ? std::min(iter->filesize, m_input.length - iter->fileoff) : 0;
+                return action.ptrSize != 0 && count <= fileBytes / action.ptrSize;
+            }
+        }
+        
+        return false;
+    }
+    
+    bool MachOFile::count_exports(uint64_t* count) const
+    {
+        *count = 0;
+        
+        uint64_t exportOffset;
+        uint64_t exportSize;
+        getExportTrieRange(&exportOffset, &exportSize);
+        if (exportSize == 0) {
+            return true;
+        }
+        
+        ExportTrie trie = getExportTrie();
+        if (trie.empty()) {
+            warnx("Export trie outside of the file");
+            return false;
+        }
+        
+        if (!trie.count(count)) {
+            warnx("Malformed export trie");
+            return false;
+        }
+        
+        return true;
+    }
+    
+    ExportTrie MachOFile::getExportTrie() const
+    {
+        if (m_input.data == NULL) {
+            return ExportTrie();
+        }
+        
+        uint64_t offset;
+        uint64_t size;
+        getExportTrieRange(&offset, &size);
+        if (size == 0 || offset + size > m_input.length) {
+            return ExportTrie();
+        }
+        
+        return ExportTrie((const uint8_t*)m_input.data + offset, size);
+    }
+    
+    bool MachOFile::decode_dyld_info()
+    {
+        uint64_t base_addr = getBaseAddress();
+        
+        dynamic_loader_info_t& loader_info = m_dyld_info_command_info.loader_info;
+        
+        /* The bind streams are kept whole, see visit_binds() for decoding them on the fly */
+        RebaseCollector rebases(&loader_info.rebase_runs);
+        BindCollector binds(&loader_info.binding_info, *this);
+        
+        if (m_dyld_info_command_info.chained_fixups_cmd != NULL) {
+            /* One walk of the chains for both */
+            if (!(this->*m_decoders->decode_chained_fixups)(&rebases, &binds)) {
+                return false;
+            }
+        } else {
+            if (!visit_rebases(rebases)) {
+                return false;
+            }
+            
+            if (!visit_binds(NodeTypeBind, binds) || binds.overflowed()) {
                 return false;
             }
-            */
         }
         
-        if (dyld_info_cmd->bind_off * dyld_info_cmd->bind_size > 0)
+        BindCollector weakBinds(&loader_info.weak_binding_info, *this);
+        if (!visit_binds(NodeTypeWeakBind, weakBinds) || weakBinds.overflowed()) {
+            return false;
+        }
+        
+        BindCollector lazyBinds(&loader_info.lazy_binding_info, *this);
+        if (!visit_binds(NodeTypeLazyBind, lazyBinds) || lazyBinds.overflowed()) {
+            return false;
+        }
+        
+        uint64_t exportOffset;
+        uint64_t exportSize;
+        getExportTrieRange(&exportOffset, &exportSize);
+        if (exportSize > 0)
         {
-            if (!parse_binding_node(&m_dyld_info_command_info.loader_info.binding_info, dyld_info_cmd->bind_off, dyld_info_cmd->bind_size, NodeTypeBind, base_addr)) {
+            ExportTrie trie = getExportTrie();
+            if (trie.empty()) {
+                warnx("Export trie outside of the file");
+                return false;
+            }
+            
+            if (!parse_export_trie(&m_dyld_info_command_info.loader_info.export_info, trie, base_addr)) {
                 return false;
             }
         }
+
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_THREAD(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        const struct thread_command* cmd = (const struct thread_command*)load_cmd_info->cmd;
         
-        if (dyld_info_cmd->weak_bind_off * dyld_info_cmd->weak_bind_size > 0)
-        {
-            if (!parse_binding_node(&m_dyld_info_command_info.loader_info.weak_binding_info, dyld_info_cmd->weak_bind_off, dyld_info_cmd->weak_bind_size, NodeTypeWeakBind, base_addr)) {
+        thread_command_info_t* cmd_info = m_arena->make<thread_command_info_t>();
+        cmd_info->cmd_type = cmd_type;
+        cmd_info->cmd = cmd;
+        
+        m_thread_command_infos.push_back(cmd_info);
+        load_cmd_info->cmd_info = cmd_info;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_SYMTAB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct symtab_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        const struct symtab_command * cmd = (const struct symtab_command*)load_cmd_info->cmd;
+        
+        m_symtab_command_info.cmd_type = cmd_type;
+        m_symtab_command_info.cmd = cmd;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_DYSYMTAB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct dysymtab_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        m_dysymtab_command_info.cmd_type = cmd_type;
+        m_dysymtab_command_info.cmd = (const struct dysymtab_command*)load_cmd_info->cmd;
+        
+        return true;
+    }
+    
+    template <typename Arch>
+    bool MachOFile::decode_symtab()
+    {
+        const struct symtab_command * cmd = m_symtab_command_info.cmd;
+        if (cmd == NULL) {
+            return m_dysymtab_command_info.cmd == NULL || decode_dysymtab<Arch>();
+        }
+        
+        uint32_t stroff = Arch::load32(cmd->stroff);
+        uint32_t strsize = Arch::load32(cmd->strsize);
+        uint32_t symoff = Arch::load32(cmd->symoff);
+        uint32_t nsyms = Arch::load32(cmd->nsyms);
+        
+        ByteSpan strings;
+        if (!input_span(stroff, strsize, &strings)) {
+            return false;
+        }
+        const char * strtab = (const char *)strings.data();
+        m_string_table = strtab;
+        
+        /* Drop an unterminated tail, so every n_strx below strsize names a string that ends inside the table */
+        while (strsize > 0 && strtab[strsize - 1] != '\0') {
+            strsize--;
+        }
+        
+        /* One bounds check for the whole nlist array, then a single pass into the columns */
+        typedef typename Arch::nlist_t nlist_t;
+        ByteSpan symbols;
+        if (!input_span(symoff, (uint64_t)nsyms * sizeof(nlist_t), &symbols)) {
+            return false;
+        }
+        const nlist_t * list = (const nlist_t *)symbols.data();
+        m_symtab_command_info.symbols.build<Arch>(list, nsyms, strtab, strsize);
+        
+        /* The dynamic symbol table indexes this one */
+        if (m_dysymtab_command_info.cmd != NULL) {
+            return decode_dysymtab<Arch>();
+        }
+    
+        return true;
+    }
+    
+    template <typename Arch>
+    bool MachOFile::decode_dysymtab()
+    {
+        const struct dysymtab_command* cmd = m_dysymtab_command_info.cmd;
+        dysymtab_command_info_t& info = m_dysymtab_command_info;
+        uint64_t nsyms = m_symtab_command_info.symbols.size();
+        
+        info.ilocalsym = Arch::load32(cmd->ilocalsym);
+        info.nlocalsym = Arch::load32(cmd->nlocalsym);
+        info.iextdefsym = Arch::load32(cmd->iextdefsym);
+        info.nextdefsym = Arch::load32(cmd->nextdefsym);
+        info.iundefsym = Arch::load32(cmd->iundefsym);
+        info.nundefsym = Arch::load32(cmd->nundefsym);
+        
+        if ((uint64_t)info.ilocalsym + info.nlocalsym > nsyms ||
+            (uint64_t)info.iextdefsym + info.nextdefsym > nsyms ||
+            (uint64_t)info.iundefsym + info.nundefsym > nsyms) {
+            warnx("Dynamic symbol range outside of the symbol table");
+            return false;
+        }
+        
+        /* One bounds check per table, then a byte order pass */
+        ByteSpan input(m_input.data, m_input.length);
+        uint32_t nindirectsyms = Arch::load32(cmd->nindirectsyms);
+        if (nindirectsyms > 0) {
+            const uint32_t* indirect = input.array<uint32_t>(Arch::load32(cmd->indirectsymoff), nindirectsyms);
+            if (indirect == NULL) {
+                warnx("Dynamic symbol table outside of the file");
                 return false;
             }
+            
+            info.indirect_symbols.resize(nindirectsyms);
+            for (uint32_t i = 0; i < nindirectsyms; i++) {
+                uint32_t symbol = Arch::load32(indirect[i]);
+                if ((symbol & (INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS)) == 0 && symbol >= nsyms) {
+                    warnx("Indirect symbol outside of the symbol table");
+                    return false;
+                }
+                info.indirect_symbols[i] = symbol;
+            }
         }
         
-        if (dyld_info_cmd->lazy_bind_off * dyld_info_cmd->lazy_bind_size > 0)
-        {
-            if (!parse_binding_node(&m_dyld_info_command_info.loader_info.lazy_binding_info, dyld_info_cmd->lazy_bind_off, dyld_info_cmd->lazy_bind_size, NodeTypeLazyBind, base_addr)) {
+        uint32_t ntoc = Arch::load32(cmd->ntoc);
+        if (ntoc > 0) {
+            const struct dylib_table_of_contents* toc = input.array<struct dylib_table_of_contents>(Arch::load32(cmd->tocoff), ntoc);
+            if (toc == NULL) {
+                warnx("Dynamic symbol table outside of the file");
                 return false;
             }
+            
+            info.toc.resize(ntoc);
+            for (uint32_t i = 0; i < ntoc; i++) {
+                info.toc[i].symbol_index = Arch::load32(toc[i].symbol_index);
+                info.toc[i].module_index = Arch::load32(toc[i].module_index);
+            }
+        }
+        
+        uint32_t nmodtab = Arch::load32(cmd->nmodtab);
+        if (nmodtab > 0) {
+            typedef typename Arch::dylib_module_t dylib_module_t;
+            const dylib_module_t* modules = input.array<dylib_module_t>(Arch::load32(cmd->modtaboff), nmodtab);
+            if (modules == NULL) {
+                warnx("Dynamic symbol table outside of the file");
+                return false;
+            }
+            
+            uint32_t strsize = m_symtab_command_info.symbols.getStringTableSize();
+            
+            info.modules.resize(nmodtab);
+            for (uint32_t i = 0; i < nmodtab; i++) {
+                const dylib_module_t* module = &modules[i];
+                dylib_module_info_t& module_info = info.modules[i];
+                
+                uint32_t name = Arch::load32(module->module_name);
+                module_info.name = name < strsize ? m_string_table + name : "";
+                module_info.iextdefsym = Arch::load32(module->iextdefsym);
+                module_info.nextdefsym = Arch::load32(module->nextdefsym);
+                module_info.irefsym = Arch::load32(module->irefsym);
+                module_info.nrefsym = Arch::load32(module->nrefsym);
+                module_info.ilocalsym = Arch::load32(module->ilocalsym);
+                module_info.nlocalsym = Arch::load32(module->nlocalsym);
+                module_info.iextrel = Arch::load32(module->iextrel);
+                module_info.nextrel = Arch::load32(module->nextrel);
+                module_info.iinit_iterm = Arch::load32(module->iinit_iterm);
+                module_info.ninit_nterm = Arch::load32(module->ninit_nterm);
+                module_info.objc_module_info_addr = Arch::load_word(module->objc_module_info_addr);
+                module_info.objc_module_info_size = Arch::load32(module->objc_module_info_size);
+            }
+        }
+        
+        /* Stubs and symbol pointers, in load command order */
+        typedef typename Arch::segment_command_t segment_command_t;
+        typedef typename Arch::section_t section_t;
+        
+        segment_infos_t::const_iterator iter;
+        for (iter = m_segment_infos.begin(); iter != m_segment_infos.end(); iter++) {
+            /* parse_LC_SEGMENT() has checked the sections fit in the command */
+            const section_t* sections = (const section_t*)((const segment_command_t*)iter->cmd + 1);
+            
+            for (uint32_t i = 0; i < iter->nsects; i++) {
+                if (!add_indirect_section<Arch>(&sections[i])) {
+                    return false;
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    template <typename Arch>
+    bool MachOFile::add_indirect_section(const typename Arch::section_t* section)
+    {
+        indirect_section_t indirect;
+        indirect.type = Arch::load32(section->flags) & SECTION_TYPE;
+        
+        switch (indirect.type) {
+            case S_SYMBOL_STUBS:
+                indirect.stride = Arch::load32(section->reserved2);
+                break;
+                
+            case S_NON_LAZY_SYMBOL_POINTERS:
+            case S_LAZY_SYMBOL_POINTERS:
+            case S_LAZY_DYLIB_SYMBOL_POINTERS:
+            case S_THREAD_LOCAL_VARIABLE_POINTERS:
+                indirect.stride = Arch::kPointerSize;
+                break;
+                
+            default:
+                return true;
+        }
+        
+        if (indirect.stride == 0) {
+            warnx("Symbol stubs without a stub size");
+            return false;
+        }
+        
+        indirect.addr = Arch::load_word(section->addr);
+        indirect.size = Arch::load_word(section->size);
+        indirect.first = Arch::load32(section->reserved1);
+        indirect.count = (uint32_t)std::min<uint64_t>(indirect.size / indirect.stride, UINT32_MAX);
+        indirect.sectname = section->sectname;
+        
+        if ((uint64_t)indirect.first + indirect.count > m_dysymtab_command_info.indirect_symbols.size()) {
+            warnx("Indirect section past the end of the indirect symbol table");
+            return false;
+        }
+        
+        m_dysymtab_command_info.indirect_sections.push_back(indirect);
+        return true;
+    }
+    
+    bool MachOFile::findIndirectSlot(uint64_t address, uint32_t* section, uint32_t* slot) const
+    {
+        const indirect_sections_t& sections = getDysymtabCommandInfo().indirect_sections;
+        
+        for (size_t i = 0; i < sections.size(); i++) {
+            const indirect_section_t& indirect = sections[i];
+            uint64_t offset = address - indirect.addr;
+            if (address >= indirect.addr && offset / indirect.stride < indirect.count) {
+                *section = (uint32_t)i;
+                *slot = (uint32_t)(offset / indirect.stride);
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    void MachOFile::decode_lazy_symtab() const
+    {
+        std::lock_guard<std::mutex> guard(m_lazy_lock);
+        
+        /* Another thread may have finished the job while we waited */
+        if (!m_symtab_pending.load(std::memory_order_relaxed)) {
+            return;
+        }
+        
+        if (!(const_cast<MachOFile*>(this)->*m_decoders->decode_symtab)()) {
+            m_lazy_failed = true;
+        }
+        
+        m_symtab_pending.store(false, std::memory_order_release);
+    }
+    
+    void MachOFile::decode_lazy_dyld_info() const
+    {
+        std::lock_guard<std::mutex> guard(m_lazy_lock);
+        
+        if (!m_dyld_info_pending.load(std::memory_order_relaxed)) {
+            return;
+        }
+        
+        if (!const_cast<MachOFile*>(this)->decode_dyld_info()) {
+            m_lazy_failed = true;
+        }
+        
+        m_dyld_info_pending.store(false, std::memory_order_release);
+    }
+    
+    bool MachOFile::decode_linkedit() const
+    {
+        getSymtabCommandInfo();
+        getDyldInfoCommandInfo();
+        
+        std::lock_guard<std::mutex> guard(m_lazy_lock);
+        return !m_lazy_failed;
+    }
+    
+    bool MachOFile::decode_symbols() const
+    {
+        getSymtabCommandInfo();
+        
+        std::lock_guard<std::mutex> guard(m_lazy_lock);
+        return !m_lazy_failed;
+    }
+    
+    bool MachOFile::parse_LC_UUID(uint32_t /*cmd_type*/, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        if (cmdsize < sizeof(struct uuid_command)) {
+            warnx("Incorrect cmd size");
+            return false;
+        }
+        
+        const struct uuid_command* uuid_cmd = (const struct uuid_command*)load_cmd_info->cmd;
+        m_uuid = uuid_cmd->uuid;
+        
+        return true;
+    }
+    
+    bool MachOFile::parse_LC_VERSION_MIN(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    {
+        m_version_min_info.cmd_type = cmd_type;
+        m_version_min_info.cmd = load_cmd_info->cmd;
+        
+        if (cmd_type == LC_BUILD_VERSION) {
+            if (cmdsize < sizeof(struct build_version_command)) {
+                warnx("Incorrect cmd size");
+                return false;
+            }
+            
+            const struct build_version_command* build_cmd = (const struct build_version_command*)load_cmd_info->cmd;
+            m_version_min_info.platform = read32(build_cmd->platform);
+            m_version_min_info.minos = read32(build_cmd->minos);
+            m_version_min_info.sdk = read32(build_cmd->sdk);
+        } else {
+            if (cmdsize < sizeof(struct version_min_command)) {
+                warnx("Incorrect cmd size");
+                return false;
+            }
+            
+            const struct version_min_command* version_cmd = (const struct version_min_command*)load_cmd_info->cmd;
+            m_version_min_info.minos = read32(version_cmd->version);
+            m_version_min_info.sdk = read32(version_cmd->sdk);
+            
+            switch (cmd_type) {
+                case LC_VERSION_MIN_MACOSX:     m_version_min_info.platform = PLATFORM_MACOS; break;
+                case LC_VERSION_MIN_IPHONEOS:   m_version_min_info.platform = PLATFORM_IOS; break;
+                case LC_VERSION_MIN_TVOS:       m_version_min_info.platform = PLATFORM_TVOS; break;
+                case LC_VERSION_MIN_WATCHOS:    m_version_min_info.platform = PLATFORM_WATCHOS; break;
+            }
         }
         
-        if (dyld_info_cmd->export_off * dyld_info_cmd->export_size > 0)
-        {
-            if (!parse_export_node(&m_dyld_info_command_info.loader_info.export_info, "", dyld_info_cmd->export_off, dyld_info_cmd->export_size, 0, base_addr)) {
-                return false;
-            }
-        }
-
+        load_cmd_info->cmd_info = &m_version_min_info;
+        
         return true;
     }
     
-    bool MachOFile::parse_LC_THREAD(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    bool MachOFile::parse_LC_ENCRYPTION_INFO(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
     {
-        const struct thread_command* cmd = (const struct thread_command*)load_cmd_info->cmd;
-        
-        thread_command_info_t* cmd_info = new thread_command_info_t();
-        if (cmd_info == NULL) {
+        /* encryption_info_command_64 only adds trailing padding */
+        if (cmdsize < sizeof(struct encryption_info_command)) {
+            warnx("Incorrect cmd size");
             return false;
         }
         
-        cmd_info->cmd_type = cmd_type;
-        cmd_info->cmd = cmd;
+        const struct encryption_info_command* encryption_cmd = (const struct encryption_info_command*)load_cmd_info->cmd;
         
-        m_thread_command_infos.push_back(cmd_info);
-        load_cmd_info->cmd_info = cmd_info;
+        m_encryption_info.cmd_type = cmd_type;
+        m_encryption_info.cmd = load_cmd_info->cmd;
+        m_encryption_info.cryptoff = read32(encryption_cmd->cryptoff);
+        m_encryption_info.cryptsize = read32(encryption_cmd->cryptsize);
+        m_encryption_info.cryptid = read32(encryption_cmd->cryptid);
+        
+        load_cmd_info->cmd_info = &m_encryption_info;
         
         return true;
     }
     
-    bool MachOFile::parse_LC_SYMTAB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info)
+    std::string MachOFile::getUUIDString() const
     {
-        const struct symtab_command * cmd = (const struct symtab_command*)load_cmd_info->cmd;
-        
-        m_symtab_command_info.cmd_type = cmd_type;
-        m_symtab_command_info.cmd = cmd;
-        
-        const char * strtab = (const char *)macho_offset(m_input.data, cmd->stroff, cmd->strsize);
-        if (strtab == NULL) {
-            return false;
+        if (m_uuid == NULL) {
+            return std::string();
         }
-        m_string_table = strtab;
         
-        for (uint32_t nsym = 0; nsym < cmd->nsyms; ++nsym)
-        {
-            nlist_info_t nlist_info;
-            
-            if (is64bit())
-            {
-                const struct nlist_64 * list = (const struct nlist_64 *)macho_offset(m_input.data, cmd->symoff + nsym * sizeof(struct nlist_64), sizeof(struct nlist_64));
-                if (list == NULL) {
-                    return false;
-                }
-                
-                nlist_info.nlist = (void *)list;
-                nlist_info.name = strtab + list->n_un.n_strx;
-            }
-            else
-            {
-                const struct nlist * list = (const struct nlist *)macho_offset(m_input.data, cmd->symoff + nsym * sizeof(struct nlist), sizeof(struct nlist));
-                if (list == NULL) {
-                    return false;
-                }
-                
-                nlist_info.nlist = (void *)list;
-                nlist_info.name = strtab + list->n_un.n_strx;
-            }
-            
-            m_symtab_command_info.nlist_infos.push_back(nlist_info);
-        }
+        return format_uuid(m_uuid);
+    }
     
-        return true;
+    std::string MachOFile::format_uuid(const uint8_t* uuid)
+    {
+        char buffer[40];
+        snprintf(buffer, sizeof(buffer), "%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+                 uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7],
+                 uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+        
+        return std::string(buffer);
     }
     
     bool MachOFile::parse_load_commands()
     {
-        const struct load_command* cmd = (const struct load_command*)macho_offset(m_header, m_header_size, sizeof(struct load_command));
-        if (cmd == NULL) {
+        uint32_t ncmds = read32(m_header->ncmds);
+        uint32_t sizeofcmds = read32(m_header->sizeofcmds);
+        
+        /* Check the load command area once, then only that each command fits in what is left of it */
+        const uint8_t* commands = (const uint8_t*)macho_offset(m_header, m_header_size, sizeofcmds);
+        if (commands == NULL) {
             return false;
         }
+        ByteSpan area(commands, sizeofcmds);
         
-        uint32_t ncmds = read32(m_header->ncmds);
+        /* Every command takes at least a load_command, do not trust ncmds beyond that */
+        uint64_t maxcmds = sizeofcmds / sizeof(struct load_command);
+        m_load_command_infos.reserve(ncmds < maxcmds ? ncmds : maxcmds);
         
         /* Get the load commands */
+        uint64_t offset = 0;
         for (uint32_t i = 0; i < ncmds; i++) {
-            /* Load the full command */
+            if (!area.contains(offset, sizeof(struct load_command))) {
+                warnx("Load commands past sizeofcmds");
+                return false;
+            }
+            
+            const struct load_command* cmd = (const struct load_command*)(area.data() + offset);
             uint32_t cmdsize = read32(cmd->cmdsize);
-            cmd = (const struct load_command*)macho_read(cmd, cmdsize);
-            if (cmd == NULL) {
+            if (cmdsize < sizeof(struct load_command) || !area.contains(offset, cmdsize)) {
+                warnx("Load commands past sizeofcmds");
                 return false;
             }
             
@@ -953,11 +2251,7 @@ namespace rotg {
             
             m_load_command_infos.push_back(load_cmd_info);
 
-            /* Load the next command */
-            cmd = (const struct load_command*)macho_offset(cmd, cmdsize, sizeof(struct load_command));
-            if (cmd == NULL) {
-                return false;
-            }
+            offset += cmdsize;
         }
         
         /* Iterate over the load commands */
@@ -970,45 +2264,9 @@ namespace rotg {
             
             switch (cmd_type) {
                 case LC_SEGMENT:
-                {
-                    /*
-                     MATCH_STRUCT(segment_command,location)
-                     node = [self createLCSegmentNode:parent
-                     caption:[NSString stringWithFormat:@"%@ (%s)",
-                     caption, string(segment_command->segname,16).c_str()]
-                     location:location
-                     segment_command:segment_command];
-                     
-                     // preserv segment RVA/size for offset lookup
-                     segmentInfo[segment_command->fileoff + imageOffset] = make_pair(segment_command->vmaddr, segment_command->vmsize);
-                     
-                     // preserv load segment command info for latter use
-                     segments.push_back(segment_command);
-                     
-                     // Section Headers
-                     for (uint32_t nsect = 0; nsect < segment_command->nsects; ++nsect)
-                     {
-                     uint32_t sectionloc = location + sizeof(struct segment_command) + nsect * sizeof(struct section);
-                     MATCH_STRUCT(section,sectionloc)
-                     [self createSectionNode:node
-                     caption:[NSString stringWithFormat:@"Section Header (%s)",
-                     string(section->sectname,16).c_str()]
-                     location:sectionloc
-                     section:section];
-                     
-                     // preserv section fileOffset/sectName for RVA lookup
-                     NSDictionary * userInfo = [self userInfoForSection:section];
-                     insertChild[section->addr] = make_pair(section->offset + imageOffset, userInfo);
-                     
-                     // preserv header info for latter use
-                     sections.push_back(section);
-                     }
-                     */
-                } break;
-                    
                 case LC_SEGMENT_64:
                 {
-                    if (!parse_LC_SEGMENT_64(cmd_type, cmdsize, load_cmd_info)) {
+                    if (!(this->*m_decoders->parse_segment)(cmd_type, cmdsize, load_cmd_info)) {
                         return false;
                     }
                 } break;
@@ -1022,13 +2280,9 @@ namespace rotg {
                     
                 case LC_DYSYMTAB:
                 {
-                    /*
-                     MATCH_STRUCT(dysymtab_command,location)
-                     node = [self createLCDysymtabNode:parent
-                     caption:caption
-                     location:location
-                     dysymtab_command:dysymtab_command];
-                     */
+                    if (!parse_LC_DYSYMTAB(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
                 } break;
                     
                 case LC_TWOLEVEL_HINTS:
@@ -1067,13 +2321,9 @@ namespace rotg {
                     
                 case LC_UUID:
                 {
-                    /*
-                     MATCH_STRUCT(uuid_command,location)
-                     node = [self createLCUUIDNode:parent
-                     caption:caption
-                     location:location
-                     uuid_command:uuid_command];
-                     */
+                    if (!parse_LC_UUID(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
                 } break;
                     
                 case LC_THREAD:
@@ -1089,9 +2339,7 @@ namespace rotg {
                 case LC_LOAD_WEAK_DYLIB:
                 case LC_REEXPORT_DYLIB:
                 case LC_LAZY_LOAD_DYLIB:
-#ifdef __MAC_10_7
                 case LC_LOAD_UPWARD_DYLIB:
-#endif
                 {
                     if (!parse_LC_DYLIB(cmd_type, cmdsize, load_cmd_info)) {
                         return false;
@@ -1099,10 +2347,13 @@ namespace rotg {
                 } break;
                     
                 case LC_CODE_SIGNATURE:
+                {
+                    if (!parse_LC_CODE_SIGNATURE(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
+                } break;
+                    
                 case LC_SEGMENT_SPLIT_INFO:
-#ifdef __MAC_10_7
-                case LC_FUNCTION_STARTS:
-#endif
                 {
                     /*
                      MATCH_STRUCT(linkedit_data_command,location)
@@ -1114,14 +2365,11 @@ namespace rotg {
                 } break;
                     
                 case LC_ENCRYPTION_INFO:
+                case LC_ENCRYPTION_INFO_64:
                 {
-                    /*
-                     MATCH_STRUCT(encryption_info_command, location)
-                     node = [self createLCEncryptionInfoNode:parent
-                     caption:caption
-                     location:location
-                     encryption_info_command:encryption_info_command];
-                     */
+                    if (!parse_LC_ENCRYPTION_INFO(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
                 } break;
                     
                 case LC_RPATH:
@@ -1205,33 +2453,93 @@ namespace rotg {
                     }
                 } break;
                     
-#ifdef __MAC_10_7
+                case LC_DYLD_CHAINED_FIXUPS:
+                {
+                    if (!parse_LC_DYLD_CHAINED_FIXUPS(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
+                } break;
+                    
+                case LC_DYLD_EXPORTS_TRIE:
+                {
+                    if (!parse_LC_DYLD_EXPORTS_TRIE(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
+                } break;
+                    
+                case LC_FUNCTION_STARTS:
+                {
+                    if (!parse_LC_FUNCTION_STARTS(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
+                } break;
+                    
                 case LC_VERSION_MIN_MACOSX:
                 case LC_VERSION_MIN_IPHONEOS:
+                case LC_VERSION_MIN_TVOS:
+                case LC_VERSION_MIN_WATCHOS:
+                case LC_BUILD_VERSION:
                 {
-                    /*
-                     MATCH_STRUCT(version_min_command,location)
-                     node = [self createLCVersionMinNode:parent
-                     caption:caption
-                     location:location
-                     version_min_command:version_min_command];
-                     */
+                    if (!parse_LC_VERSION_MIN(cmd_type, cmdsize, load_cmd_info)) {
+                        return false;
+                    }
                 } break;
-#endif
                     
                 default:
                     break;
             }
         }
         
-        return true;
+        /* The dynamic symbol table may come before LC_SYMTAB and refers to the sections, so
+           the symbols wait for every command too, and decode on first access in lazy mode */
+        if ((m_symtab_command_info.cmd != NULL || m_dysymtab_command_info.cmd != NULL) &&
+            (m_options & ParseOptionHeadersOnly) == 0) {
+            if (m_options & ParseOptionLazyLinkedit) {
+                m_symtab_pending.store(true, std::memory_order_release);
+            } else if (!(this->*m_decoders->decode_symtab)()) {
+                return false;
+            }
+        }
+        
+        /* Chained fixups name segments by index and the exports trie may come before LC_DYLD_INFO,
+           so decoding waits for every command. Nothing is read in headers-only mode, and lazy mode
+           decodes on first access. */
+        if (m_dyld_info_command_info.cmd == NULL && m_dyld_info_command_info.chained_fixups_cmd == NULL &&
+            m_dyld_info_command_info.exports_trie_cmd == NULL) {
+            return true;
+        }
+        
+        if (m_options & ParseOptionHeadersOnly) {
+            return true;
+        }
+        
+        if (m_options & ParseOptionLazyLinkedit) {
+            m_dyld_info_pending.store(true, std::memory_order_release);
+            return true;
+        }
+        
+        return decode_dyld_info();
     }
     
-    uint64_t MachOFile::getOffset(const void* address)
+    uint64_t MachOFile::getOffset(const void* address) const
     {
         return ((uint8_t*)address - (uint8_t*)m_input.data) + m_input.baseOffset;
     }
     
+    template <typename Arch>
+    const MachOFile::decoders_t* MachOFile::get_decoders()
+    {
+        static const decoders_t s_decoders = {
+            &MachOFile::parse_LC_SEGMENT<Arch>,
+            &MachOFile::decode_symtab<Arch>,
+            &MachOFile::decode_rebase_stream<Arch>,
+            &MachOFile::decode_bind_stream<Arch>,
+            &MachOFile::decode_chained_fixups<Arch>,
+        };
+        
+        return &s_decoders;
+    }
+    
     /* Parse a Mach-O header */
     bool MachOFile::parse_macho(const macho_input_t *input) {
         if (m_input.data == NULL) {
@@ -1278,6 +2586,10 @@ namespace rotg {
             case FAT_CIGAM:
             case FAT_MAGIC:
                 m_fat_header = (const struct fat_header*)macho_read(input->data, sizeof(struct fat_header));
+                if (m_fat_header == NULL) {
+                    return false;
+                }
+                
                 m_is_universal = true;
                 break;
                 
@@ -1291,14 +2603,112 @@ namespace rotg {
             return parse_universal();
         }
         
+        /* Everything below runs the decoders for this word size and byte order */
+        if (m_is64bit) {
+            m_decoders = m_is_need_byteswap ? get_decoders<MachO64Swapped>() : get_decoders<MachO64>();
+        } else {
+            m_decoders = m_is_need_byteswap ? get_decoders<MachO32Swapped>() : get_decoders<MachO32>();
+        }
+        
         /* Fetch the arch name */
-        m_archInfo = NXGetArchInfoFromCpuType(read32(m_header->cputype), read32(m_header->cpusubtype));
+        m_archInfo = get_arch_info(read32(m_header->cputype), read32(m_header->cpusubtype));
         
         /* Parse the Mach-O load commands */
         return parse_load_commands();
     }
 
-    bool MachOFile::parse_file(const char* path)
+    bool MachOFile::map_input(uint64_t offset, uint64_t length)
+    {
+        /* mmap wants a page aligned file offset */
+        uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t delta = offset % pageSize;
+        
+        void* data = mmap(NULL, length + delta, PROT_READ, MAP_FILE|MAP_PRIVATE, m_fd, offset - delta);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        
+        m_map_data = data;
+        m_map_length = length + delta;
+        
+        m_input.data = (const uint8_t*)data + delta;
+        m_input.length = length;
+        m_input.baseOffset = offset;
+        m_isInputOwned = true;
+        
+        return true;
+    }
+    
+    bool MachOFile::read_headers(int fd, uint64_t offset, uint64_t length)
+    {
+        /* Start with one page, it holds the load commands of almost every image */
+        size_t size = (size_t)sysconf(_SC_PAGESIZE);
+        if (size > length) {
+            size = (size_t)length;
+        }
+        
+        uint8_t* buffer = (uint8_t*)m_arena->allocate(size > 0 ? size : 1);
+        ssize_t count = size > 0 ? pread(fd, buffer, size, offset) : 0;
+        if (count < 0) {
+            return false;
+        }
+        size_t have = (size_t)count;
+        
+        /* Grow the read to the end of the load commands (or fat arch table) only */
+        uint64_t needed = 0;
+        if (have >= sizeof(struct mach_header)) {
+            const struct mach_header* header = (const struct mach_header*)buffer;
+            switch (header->magic) {
+                case MH_MAGIC:
+                    needed = sizeof(struct mach_header) + header->sizeofcmds;
+                    break;
+                case MH_CIGAM:
+                    needed = sizeof(struct mach_header) + swap32(header->sizeofcmds);
+                    break;
+                case MH_MAGIC_64:
+                    needed = sizeof(struct mach_header_64) + header->sizeofcmds;
+                    break;
+                case MH_CIGAM_64:
+                    needed = sizeof(struct mach_header_64) + swap32(header->sizeofcmds);
+                    break;
+                case FAT_MAGIC:
+                case FAT_CIGAM: {
+                    const struct fat_header* fat_header = (const struct fat_header*)header;
+                    needed = sizeof(struct fat_header) + (uint64_t)big_to_host32(fat_header->nfat_arch) * sizeof(struct fat_arch);
+                } break;
+            }
+        }
+        
+        /* A short buffer is left for parse_macho() to reject */
+        if (needed > have && needed <= length && have == size) {
+            uint8_t* grown = (uint8_t*)m_arena->allocate((size_t)needed);
+            memcpy(grown, buffer, have);
+            buffer = grown;
+            
+            count = pread(fd, buffer + have, (size_t)(needed - have), offset + have);
+            if (count < 0) {
+                return false;
+            }
+            have += (size_t)count;
+        }
+        
+        m_input.data = buffer;
+        m_input.length = have;
+        m_input.baseOffset = offset;
+        
+        return true;
+    }
+    
+    bool MachOFile::load_input(uint64_t offset, uint64_t length)
+    {
+        if (m_options & ParseOptionHeadersOnly) {
+            return read_headers(m_fd, offset, length);
+        }
+        
+        return map_input(offset, length);
+    }
+    
+    bool MachOFile::load_file(const char* path)
     {
         m_fd = open(path, O_RDONLY);
         if (m_fd < 0) {
@@ -1310,16 +2720,216 @@ namespace rotg {
             return false;
         }
         
-        /* mmap */
-        m_input.data = mmap(NULL, stbuf.st_size, PROT_READ, MAP_FILE|MAP_PRIVATE, m_fd, 0);
-        if (m_input.data == MAP_FAILED) {
+        /* mmap, or pread the headers */
+        return load_input(0, stbuf.st_size);
+    }
+    
+    bool MachOFile::parse_file_arch(const char* path, cpu_type_t cputype, cpu_subtype_t cpusubtype)
+    {
+        m_fd = open(path, O_RDONLY);
+        if (m_fd < 0) {
             return false;
         }
         
-        m_input.length = stbuf.st_size;
-        m_isInputOwned = true;
+        struct stat stbuf;
+        if (fstat(m_fd, &stbuf) != 0) {
+            return false;
+        }
+        
+        uint64_t offset = 0;
+        uint64_t length = stbuf.st_size;
+        
+        /* Only the fat header and arch table are read, other slices are never touched */
+        struct fat_header fat_header;
+        if (pread(m_fd, &fat_header, sizeof(fat_header), 0) != sizeof(fat_header)) {
+            warnx("Short read parsing Mach-O input");
+            return false;
+        }
+        
+        if (fat_header.magic == FAT_MAGIC || fat_header.magic == FAT_CIGAM) {
+            uint32_t nfat = big_to_host32(fat_header.nfat_arch);
+            if ((uint64_t)nfat * sizeof(struct fat_arch) + sizeof(struct fat_header) > length) {
+                warnx("Short read parsing Mach-O input");
+                return false;
+            }
+            
+            std::vector<struct fat_arch> archs(nfat);
+            size_t archsSize = nfat * sizeof(struct fat_arch);
+            if (nfat > 0 && pread(m_fd, &archs[0], archsSize, sizeof(struct fat_header)) != (ssize_t)archsSize) {
+                warnx("Short read parsing Mach-O input");
+                return false;
+            }
+            
+            fat_arch_infos_t infos;
+            for (uint32_t i = 0; i < nfat; i++) {
+                fat_arch_info_t fat_arch_info;
+                memset(&fat_arch_info, 0, sizeof(fat_arch_info));
+                fat_arch_info.arch = archs[i];
+                fat_arch_to_host(&fat_arch_info.arch);
+                infos.push_back(fat_arch_info);
+            }
+            
+            const fat_arch_info_t* selected = find_fat_arch(infos, cputype, cpusubtype);
+            if (selected == NULL) {
+                warnx("No matching architecture in universal file");
+                return false;
+            }
+            
+            offset = selected->arch.offset;
+            length = selected->arch.size;
+            if (offset + length > (uint64_t)stbuf.st_size) {
+                warnx("Short read parsing Mach-O input");
+                return false;
+            }
+        }
+        
+        if (!load_input(offset, length)) {
+            return false;
+        }
+        
+        if (!parse_macho(&m_input)) {
+            return false;
+        }
+        
+        /* A thin file has to be the requested architecture itself */
+        if (isUniversal()) {
+            return false;
+        }
+        
+        /* The subtype counts too: the file must be the slice find_fat_arch() would pick from a universal file */
+        if (cputype != CPU_TYPE_ANY) {
+            fat_arch_info_t thin;
+            memset(&thin, 0, sizeof(thin));
+            thin.arch.cputype = read32(m_header->cputype);
+            thin.arch.cpusubtype = read32(m_header->cpusubtype);
+            
+            fat_arch_infos_t infos(1, thin);
+            if (find_fat_arch(infos, cputype, cpusubtype) == NULL) {
+                warnx("No matching architecture");
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    const fat_arch_info_t* MachOFile::find_fat_arch(const fat_arch_infos_t& infos, cpu_type_t cputype, cpu_subtype_t cpusubtype)
+    {
+        if (cputype == CPU_TYPE_ANY) {
+            if (!get_host_cpu_type(&cputype, &cpusubtype)) {
+                return infos.empty() ? NULL : &infos[0];
+            }
+            
+            /* The host's own subtype (or its family's generic one) before any other slice of the family */
+            const fat_arch_info_t* best = find_fat_arch(infos, cputype, cpusubtype);
+            if (best == NULL) {
+                best = find_fat_arch(infos, cputype, CPU_SUBTYPE_MULTIPLE);
+            }
+            
+            if (best == NULL && (cputype & CPU_ARCH_ABI64)) {
+                /* A 64-bit host can still run the 32-bit flavour of its cpu, the generic subtype first again */
+                cpu_type_t cputype32 = cputype & ~CPU_ARCH_MASK;
+                const arch_info_t* archInfo = get_arch_info(cputype32, CPU_SUBTYPE_MULTIPLE);
+                if (archInfo != NULL) {
+                    best = find_fat_arch(infos, cputype32, archInfo->cpusubtype);
+                }
+                if (best == NULL) {
+                    best = find_fat_arch(infos, cputype32, CPU_SUBTYPE_MULTIPLE);
+                }
+            }
+            
+            return best;
+        }
+        
+        const fat_arch_info_t* family = NULL;
+        const fat_arch_info_t* familyAll = NULL;
+        cpu_subtype_t subtype = cpusubtype & ~CPU_SUBTYPE_MASK;
+        
+        fat_arch_infos_t::const_iterator iter;
+        for (iter = infos.begin(); iter != infos.end(); iter++) {
+            if (iter->arch.cputype != cputype) {
+                continue;
+            }
+            
+            cpu_subtype_t archSubtype = iter->arch.cpusubtype & ~CPU_SUBTYPE_MASK;
+            if (cpusubtype != CPU_SUBTYPE_MULTIPLE && archSubtype == subtype) {
+                return &(*iter);
+            }
+            
+            if (family == NULL) {
+                family = &(*iter);
+            }
+            
+            const arch_info_t* archInfo = get_arch_info(cputype, CPU_SUBTYPE_MULTIPLE);
+            if (familyAll == NULL && archInfo != NULL && archSubtype == archInfo->cpusubtype) {
+                familyAll = &(*iter);
+            }
+        }
+        
+        /* Any slice of the family will do when no specific subtype was asked for */
+        if (cpusubtype == CPU_SUBTYPE_MULTIPLE) {
+            return family;
+        }
+        
+        return familyAll;
+    }
+    
+    const fat_arch_info_t* MachOFile::find_fat_arch(cpu_type_t cputype, cpu_subtype_t cpusubtype) const
+    {
+        return find_fat_arch(m_fat_arch_infos, cputype, cpusubtype);
+    }
+    
+    bool MachOFile::parse_slices(macho_files_t& slices, ThreadPool* pool) const
+    {
+        size_t count = m_fat_arch_infos.size();
+        
+        for (size_t i = 0; i < count; i++) {
+            slices.push_back(new MachOFile(m_options));
+            slices.back()->setThreadPool(m_pool);
+        }
+        
+        std::vector<char> results(count, 0);
+        
+        /* Headers-only slices were never read, pread them from our descriptor */
+        bool headersOnly = (m_options & ParseOptionHeadersOnly) != 0;
+        
+        auto parse_slice = [&](size_t i) {
+            const macho_input_t& input = m_fat_arch_infos[i].input;
+            if (headersOnly) {
+                results[i] = slices[i]->read_headers(m_fd, input.baseOffset, input.length) && slices[i]->parse_macho(&slices[i]->m_input);
+            } else {
+                results[i] = slices[i]->parse_macho(&input);
+            }
+        };
+        
+        if (pool != NULL) {
+            pool->parallel_for(count, parse_slice);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                parse_slice(i);
+            }
+        }
+        
+        /* Slices that failed to parse come back as NULL */
+        bool success = true;
+        for (size_t i = 0; i < count; i++) {
+            if (!results[i]) {
+                delete slices[i];
+                slices[i] = NULL;
+                success = false;
+            }
+        }
+        
+        return success;
+    }
+    
+    bool MachOFile::parse_file(const char* path)
+    {
+        if (!load_file(path)) {
+            return false;
+        }
 
-        /* Parse */
+        /* Parse (only the load commands in headers-only mode) */
         return parse_macho(&m_input);
     }
 
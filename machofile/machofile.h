@@ -9,16 +9,21 @@
 #ifndef rotg_machofile_h
 #define rotg_machofile_h
 
-#include <mach-o/loader.h>
-#include <mach-o/getsect.h>
-#include <mach-o/fat.h> // for fat structure decoding
-#include <mach-o/arch.h> // to know which is local arch
-#include <mach-o/nlist.h>
+#include "macho_types.h" // portable mach-o, fat and nlist definitions
+#include "arena.h"
+#include "byte_span.h"
+#include "symbol_table.h"
+#include "export_trie.h"
+#include "chained_fixups.h"
+#include "code_signature.h"
 
 #include <sys/stat.h>
 
 #include <unistd.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <map>
 #include <string>
@@ -31,7 +36,7 @@ namespace rotg {
         void*                       cmd_info;
     } load_command_info_t;
     
-    typedef std::vector<load_command_info_t> load_command_infos_t;
+    typedef std::vector<load_command_info_t, ArenaAllocator<load_command_info_t> > load_command_infos_t;
     
     typedef struct dylib_command_info {
         uint32_t                    cmd_type;
@@ -40,7 +45,7 @@ namespace rotg {
         size_t                      libnamelen;
     } dylib_command_info_t;
     
-    typedef std::vector<dylib_command_info_t*> dylib_command_infos_t;
+    typedef std::vector<dylib_command_info_t*, ArenaAllocator<dylib_command_info_t*> > dylib_command_infos_t;
     
     typedef struct runpath_additions_info {
         uint32_t                    cmd_type;
@@ -49,7 +54,23 @@ namespace rotg {
         size_t                      pathlen;
     } runpath_additions_info_t;
     
-    typedef std::vector<runpath_additions_info_t> runpath_additions_infos_t;
+    typedef std::vector<runpath_additions_info_t, ArenaAllocator<runpath_additions_info_t> > runpath_additions_infos_t;
+    
+    typedef struct version_min_info {
+        uint32_t                    cmd_type;   /* LC_VERSION_MIN_* or LC_BUILD_VERSION, 0 if absent */
+        const struct load_command*  cmd;
+        uint32_t                    platform;   /* PLATFORM_* */
+        uint32_t                    minos;      /* X.Y.Z encoded in nibbles xxxx.yy.zz */
+        uint32_t                    sdk;
+    } version_min_info_t;
+    
+    typedef struct encryption_info {
+        uint32_t                    cmd_type;   /* LC_ENCRYPTION_INFO(_64), 0 if absent */
+        const struct load_command*  cmd;
+        uint32_t                    cryptoff;
+        uint32_t                    cryptsize;
+        uint32_t                    cryptid;    /* 0 means not encrypted yet */
+    } encryption_info_t;
     
     typedef struct macho_input {
         const void* data;
@@ -63,9 +84,9 @@ namespace rotg {
         macho_input_t   input;
     } fat_arch_info_t;
     
-    typedef std::vector<fat_arch_info_t> fat_arch_infos_t;
+    typedef std::vector<fat_arch_info_t, ArenaAllocator<fat_arch_info_t> > fat_arch_infos_t;
     
-    typedef std::vector<const struct section_64*> section_64s_t;
+    typedef std::vector<const struct section_64*, ArenaAllocator<const struct section_64*> > section_64s_t;
     
     typedef struct segment_command_64_info {
         uint32_t                            cmd_type;
@@ -73,7 +94,116 @@ namespace rotg {
         section_64s_t                       section_64s;
     } segment_command_64_info_t;
     
-    typedef std::vector<segment_command_64_info_t*> segment_command_64_infos_t;
+    typedef std::vector<segment_command_64_info_t*, ArenaAllocator<segment_command_64_info_t*> > segment_command_64_infos_t;
+    
+    typedef std::vector<const struct section*, ArenaAllocator<const struct section*> > sections_t;
+    
+    typedef struct segment_command_info {
+        uint32_t                            cmd_type;
+        const struct segment_command*       cmd;
+        sections_t                          sections;
+    } segment_command_info_t;
+    
+    typedef std::vector<segment_command_info_t*, ArenaAllocator<segment_command_info_t*> > segment_command_infos_t;
+    
+    // LC_SEGMENT or LC_SEGMENT_64 in host byte order, whatever the image's word size and byte order.
+    // In load command order, which is how the LINKEDIT numbers segments.
+    typedef struct segment_info {
+        uint32_t                    cmd_type;
+        const struct load_command*  cmd;
+        const char*                 segname;    // 16 chars, not NUL terminated when all are used
+        uint64_t                    vmaddr;
+        uint64_t                    vmsize;
+        uint64_t                    fileoff;
+        uint64_t                    filesize;
+        uint32_t                    maxprot;
+        uint32_t                    initprot;
+        uint32_t                    nsects;
+        uint32_t                    flags;
+    } segment_info_t;
+    
+    typedef std::vector<segment_info_t, ArenaAllocator<segment_info_t> > segment_infos_t;
+    
+    // Pointers the rebase stream slides: count of them from address, stride bytes apart
+    typedef struct rebase_run {
+        uint64_t        address;    // of the first pointer
+        uint64_t        count;
+        uint64_t        stride;     // 0 for a single pointer
+        uint32_t        type;       // REBASE_TYPE_*
+    } rebase_run_t;
+    
+    typedef std::vector<rebase_run_t, ArenaAllocator<rebase_run_t> > rebase_runs_t;
+    
+    // Receives the rebase stream while it is decoded, see MachOFile::visit_rebases().
+    // Returning false stops the walk.
+    class RebaseVisitor
+    {
+    public:
+        virtual ~RebaseVisitor() {}
+    
+        // One run per DO_REBASE opcode, never expanded
+        virtual bool visit_run(const rebase_run_t& run) = 0;
+    };
+    
+    // Keeps the runs, joining each to the last one when it continues it, which is
+    // how getDyldInfoCommandInfo() gets its rebase_runs_t
+    class RebaseCollector : public RebaseVisitor
+    {
+    public:
+        explicit RebaseCollector(rebase_runs_t* runs)
+            : m_runs(runs)
+        {
+        }
+    
+        bool visit_run(const rebase_run_t& run);
+    
+    private:
+        rebase_runs_t* m_runs;
+    };
+    
+    // Expands runs into one address at a time
+    class RebaseAddressIterator
+    {
+    public:
+        RebaseAddressIterator(const rebase_run_t* runs, size_t count)
+            : m_run(runs)
+            , m_end(runs + count)
+            , m_index(0)
+        {
+        }
+    
+        explicit RebaseAddressIterator(const rebase_runs_t& runs)
+            : m_run(runs.data())
+            , m_end(runs.data() + runs.size())
+            , m_index(0)
+        {
+        }
+    
+        // The next pointer to slide; false after the last one. type may be NULL.
+        bool next(uint64_t* address, uint32_t* type) {
+            while (m_run != m_end && m_index >= m_run->count) {
+                m_run++;
+                m_index = 0;
+            }
+            
+            if (m_run == m_end) {
+                return false;
+            }
+            
+            *address = m_run->address + m_index * m_run->stride;
+            if (type != NULL) {
+                *type = m_run->type;
+            }
+            
+            m_index++;
+            return true;
+        }
+        
+    private:
+        const rebase_run_t* m_run;
+        const rebase_run_t* m_end;
+        uint64_t            m_index;
+    };
     
     typedef struct bind_opcode {
         uint8_t         opcode;
@@ -81,7 +211,7 @@ namespace rotg {
         const uint8_t*  ptr;
     } bind_opcode_t;
     
-    typedef std::vector<bind_opcode_t> bind_opcodes_t;
+    typedef std::vector<bind_opcode_t, ArenaAllocator<bind_opcode_t> > bind_opcodes_t;
 
     enum BindNodeType {NodeTypeBind, NodeTypeWeakBind, NodeTypeLazyBind};
     
@@ -97,38 +227,116 @@ namespace rotg {
         uint64_t        ptrSize;
     } bind_action_t;
     
-    typedef std::vector<bind_action_t> bind_actions_t;
+    typedef std::vector<bind_action_t, ArenaAllocator<bind_action_t> > bind_actions_t;
     
     typedef struct binding_info {
         bind_opcodes_t opcodes;
         bind_actions_t actions;
     } binding_info_t;
     
+    // Receives a bind stream while it is decoded, see MachOFile::visit_binds().
+    // Returning false stops the walk.
+    class BindVisitor
+    {
+    public:
+        virtual ~BindVisitor() {}
+        
+        // Every opcode, before the binds it does
+        virtual bool visit_opcode(const bind_opcode_t& /*opcode*/) {
+            return true;
+        }
+        
+        // Every bind
+        virtual bool visit_bind(const bind_action_t& action) = 0;
+        
+        // The count binds of BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB, stride bytes apart from
+        // action.address. Every bind of the run has action.location. Override it to take the run as
+        // one; by default it is expanded into visit_bind() calls.
+        virtual bool visit_bind_run(const bind_action_t& action, uint64_t count, uint64_t stride) {
+            bind_action_t bind = action;
+            for (uint64_t index = 0; index < count; index++) {
+                if (!visit_bind(bind)) {
+                    return false;
+                }
+                bind.address += stride;
+            }
+            return true;
+        }
+    };
+    
+    class MachOFile;
+    
+    // Keeps the whole stream, which is how getDyldInfoCommandInfo() gets its binding_info_t.
+    // Runs are expanded, so a run with more binds than its segment has file bytes for
+    // pointers is refused: the walk stops and overflowed() says why.
+    class BindCollector : public BindVisitor
+    {
+    public:
+        BindCollector(binding_info_t* binding_info, const MachOFile& file)
+            : m_binding_info(binding_info)
+            , m_file(file)
+            , m_overflowed(false)
+        {
+        }
+        
+        bool visit_opcode(const bind_opcode_t& opcode) {
+            m_binding_info->opcodes.push_back(opcode);
+            return true;
+        }
+        
+        bool visit_bind(const bind_action_t& action) {
+            m_binding_info->actions.push_back(action);
+            return true;
+        }
+        
+        bool visit_bind_run(const bind_action_t& action, uint64_t count, uint64_t stride);
+        
+        bool overflowed() const {
+            return m_overflowed;
+        }
+        
+    private:
+        binding_info_t*     m_binding_info;
+        const MachOFile&    m_file;
+        bool                m_overflowed;
+    };
+    
     typedef struct export_node {
         const char* label;
         uint64_t    skip;
     } export_node_t;
     
-    typedef std::vector<export_node_t> export_nodes_t;
+    typedef std::vector<export_node_t, ArenaAllocator<export_node_t> > export_nodes_t;
     
     typedef struct export_opcode {
-        uint8_t         terminalSize;
+        uint64_t        terminalSize;
         uint8_t         childCount;
         export_nodes_t  nodes;
         const uint8_t*  ptr;
     } export_opcode_t;
     
-    typedef std::vector<export_opcode_t> export_opcodes_t;
+    typedef std::vector<export_opcode_t, ArenaAllocator<export_opcode_t> > export_opcodes_t;
     
     typedef struct export_action {
         uint64_t        flags;
         uint64_t        offset;
-        std::string     symbolName;
+        const char*     symbolName;
         uint64_t        address;
         const uint8_t*  ptr;
     } export_action_t;
     
-    typedef std::vector<export_action_t> export_actions_t;
+    typedef std::vector<export_action_t, ArenaAllocator<export_action_t> > export_actions_t;
+    
+    // pending node of the export trie walk
+    typedef struct export_walk {
+        uint64_t        offset;
+        size_t          prefix_length;  // of the parent's prefix
+        const char*     label;          // edge from the parent, in the trie
+        size_t          label_length;
+        uint32_t        depth;          // edges from the root
+    } export_walk_t;
+    
+    typedef std::vector<export_walk_t> export_walk_stack_t;
     
     typedef struct export_info {
         export_opcodes_t    opcodes;
@@ -136,6 +344,7 @@ namespace rotg {
     } export_info_t;
     
     typedef struct dynamic_loader_info {
+        rebase_runs_t   rebase_runs;
         binding_info_t  binding_info;
         binding_info_t  weak_binding_info;
         binding_info_t  lazy_binding_info;
@@ -145,6 +354,8 @@ namespace rotg {
     typedef struct dylib_info_command_info {
         uint32_t                        cmd_type;
         const struct dyld_info_command* cmd;
+        const struct linkedit_data_command* chained_fixups_cmd;    // LC_DYLD_CHAINED_FIXUPS, which replaces the rebase and bind streams
+        const struct linkedit_data_command* exports_trie_cmd;      // LC_DYLD_EXPORTS_TRIE, which replaces export_off/export_size
         dynamic_loader_info_t           loader_info;
     } dyld_info_command_info_t;
         
@@ -153,21 +364,62 @@ namespace rotg {
         const struct thread_command*    cmd;
     } thread_command_info_t;
     
-    typedef std::vector<thread_command_info_t*> thread_command_infos_t;
-    
-    typedef struct nlist_info {
-        void *          nlist; // cast to 'struct nlist' or 'struct nlist_64' based on architecture
-        const char *    name;
-    } nlist_info_t;
-    
-    typedef std::vector<nlist_info_t> nlist_infos_t;
+    typedef std::vector<thread_command_info_t*, ArenaAllocator<thread_command_info_t*> > thread_command_infos_t;
     
     typedef struct symtab_command_info {
         uint32_t                        cmd_type;
         const struct symtab_command*    cmd;
-        nlist_infos_t                   nlist_infos;
+        SymbolTable                     symbols;
     } symtab_command_info_t;
     
+    // A section whose slots are named by the indirect symbol table: stubs and symbol pointers
+    typedef struct indirect_section {
+        uint64_t                        addr;
+        uint64_t                        size;
+        uint32_t                        stride;     // bytes per slot, the stub size or the pointer size
+        uint32_t                        first;      // indirect_symbols index of the first slot (reserved1)
+        uint32_t                        count;      // slots
+        uint8_t                         type;       // S_SYMBOL_STUBS or one of the S_*_POINTERS types
+        const char*                     sectname;   // 16 chars, not NUL terminated when all are used
+    } indirect_section_t;
+    
+    typedef std::vector<indirect_section_t, ArenaAllocator<indirect_section_t> > indirect_sections_t;
+    
+    // dylib_module or dylib_module_64, in host byte order
+    typedef struct dylib_module_info {
+        const char*                     name;       // "" when module_name is outside the string table
+        uint32_t                        iextdefsym;
+        uint32_t                        nextdefsym;
+        uint32_t                        irefsym;
+        uint32_t                        nrefsym;
+        uint32_t                        ilocalsym;
+        uint32_t                        nlocalsym;
+        uint32_t                        iextrel;
+        uint32_t                        nextrel;
+        uint32_t                        iinit_iterm;
+        uint32_t                        ninit_nterm;
+        uint64_t                        objc_module_info_addr;
+        uint32_t                        objc_module_info_size;
+    } dylib_module_info_t;
+    
+    typedef std::vector<dylib_module_info_t, ArenaAllocator<dylib_module_info_t> > dylib_module_infos_t;
+    typedef std::vector<struct dylib_table_of_contents, ArenaAllocator<struct dylib_table_of_contents> > dylib_tocs_t;
+    
+    typedef struct dysymtab_command_info {
+        uint32_t                        cmd_type;
+        const struct dysymtab_command*  cmd;
+        uint32_t                        ilocalsym;      // the local, defined external and undefined
+        uint32_t                        nlocalsym;      // ranges of the symbol table, checked against it
+        uint32_t                        iextdefsym;
+        uint32_t                        nextdefsym;
+        uint32_t                        iundefsym;
+        uint32_t                        nundefsym;
+        symbol_indices_t                indirect_symbols;   // host byte order, in range unless INDIRECT_SYMBOL_LOCAL/ABS
+        indirect_sections_t             indirect_sections;  // slots checked against indirect_symbols
+        dylib_tocs_t                    toc;                // host byte order
+        dylib_module_infos_t            modules;
+    } dysymtab_command_info_t;
+    
     ////////////////////////////////////////////////////////////////////////////////
     
     /*
@@ -185,32 +437,115 @@ namespace rotg {
     typedef std::map<uint32_t,std::pair<uint32_t,uint64_t> >    RelocMap;           // fileOffset --> <length,value>
     */
     
-    typedef std::map<uint64_t, std::pair<uint64_t, uint64_t> >  SegmentInfoMap;     // fileOffset --> <address,size>
+    typedef std::map<uint64_t, std::pair<uint64_t, uint64_t>, std::less<uint64_t>,
+                     ArenaAllocator<std::pair<const uint64_t, std::pair<uint64_t, uint64_t> > > > SegmentInfoMap; // fileOffset --> <address,size>
     
     //typedef std::map<uint64_t,std::pair<uint32_t,NSDictionary *> >  SectionInfoMap;     // address    --> <fileOffset,sectionUserInfo>
     //typedef std::map<uint64_t,uint64_t>                             ExceptionFrameMap;  // LSDA_addr  --> PCBegin_addr
 
     ////////////////////////////////////////////////////////////////////////////////
     
+    class ThreadPool;
+    
+    typedef std::vector<MachOFile*> macho_files_t;
+    
+    enum ParseOptions {
+        ParseOptionNone         = 0,
+        ParseOptionLazyLinkedit = 1 << 0,   // decode symbols, binds and exports on first access
+        ParseOptionHeadersOnly  = 1 << 1,   // pread the header and load commands only, map nothing
+    };
+    
     class MachOFile
     {
     public:
-        MachOFile();
+        // Parse results live in arena, or in an arena of our own when it is NULL.
+        // A caller supplied arena must outlive this file.
+        explicit MachOFile(uint32_t options = ParseOptionNone, Arena* arena = NULL);
         ~MachOFile();
         
+        // Moving leaves other empty, as after reset(). Not while another thread uses either file.
+        MachOFile(MachOFile&& other);
+        MachOFile& operator=(MachOFile&& other);
+        
+        // Unmap the input and forget the parse so the next file can be parsed
+        // into this object. An owned arena is rewound, keeping its blocks, and
+        // the containers get their previous capacity back from it; with a caller
+        // supplied arena rewinding is up to the caller.
+        void reset();
+        
+        uint32_t getParseOptions() const {
+            return m_options;
+        }
+        
+        // Split the decoding of large export tries into tasks for pool, which
+        // must outlive the parse. Their export names then live in per-task arenas
+        // of this file rather than the parse arena. Kept across reset(); NULL
+        // decodes serially.
+        void setThreadPool(ThreadPool* pool) {
+            m_pool = pool;
+        }
+        
+        ThreadPool* getThreadPool() const {
+            return m_pool;
+        }
+        
+        // Force the deferred LINKEDIT decoding of a lazy parse, false if it is malformed
+        bool decode_linkedit() const;
+        
+        // Only the symbol table part of decode_linkedit(): binds and exports stay undecoded
+        bool decode_symbols() const;
+        
         bool parse_macho(const macho_input_t *input);
         bool parse_file(const char* path);
         
-        uint64_t getOffset(const void* address);
+        // open and map a file without parsing it, parse_file() is load_file() + parse_macho().
+        // With ParseOptionHeadersOnly only the header and load commands are read.
+        bool load_file(const char* path);
+        
+        // Parse only the slice matching cputype/cpusubtype of a universal (or thin) file.
+        // Only that slice is mapped. CPU_TYPE_ANY picks the best slice for the host. A
+        // thin file must be what find_fat_arch() would have picked, subtype included.
+        bool parse_file_arch(const char* path, cpu_type_t cputype, cpu_subtype_t cpusubtype);
+        
+        // Best slice for cputype/cpusubtype: exact subtype, then the family's generic
+        // subtype (any subtype if cpusubtype is CPU_SUBTYPE_MULTIPLE). CPU_TYPE_ANY is the
+        // host: its own subtype first, any other slice of its family only after that
+        static const fat_arch_info_t* find_fat_arch(const fat_arch_infos_t& infos, cpu_type_t cputype, cpu_subtype_t cpusubtype);
+        const fat_arch_info_t* find_fat_arch(cpu_type_t cputype, cpu_subtype_t cpusubtype) const;
+        
+        // Parse every slice of a universal file, concurrently when a pool is given.
+        // Slices that fail to parse are NULL. The caller deletes the returned
+        // slices, which must not outlive this file. In headers-only mode the slices
+        // are read from this file's descriptor, so it must come from load_file().
+        // The slices decode on this file's setThreadPool() pool, if any.
+        bool parse_slices(macho_files_t& slices, ThreadPool* pool = NULL) const;
+        
+        uint64_t getOffset(const void* address) const;
         
         uint32_t read32(uint32_t input) const {
             if (isNeedByteSwap()) {
-                return OSSwapInt32(input);
+                return swap32(input);
             }
             
             return input;
         }
         
+        uint64_t read64(uint64_t input) const {
+            if (isNeedByteSwap()) {
+                return swap64(input);
+            }
+            
+            return input;
+        }
+        
+        Arena* getArena() const {
+            return m_arena;
+        }
+        
+        const macho_input_t& getInput() const {
+            return m_input;
+        }
+        
         const struct mach_header* getHeader() const {
             return m_header;
         }
@@ -243,7 +578,7 @@ namespace rotg {
             return m_is_need_byteswap;
         }
         
-        const NXArchInfo* getArchInfo() const {
+        const arch_info_t* getArchInfo() const {
             return m_archInfo;
         }
         
@@ -251,10 +586,42 @@ namespace rotg {
             return m_segment_command_64_infos;
         }
         
+        const segment_command_infos_t& getSegmentCommandInfos() const {
+            return m_segment_command_infos;
+        }
+        
+        // Every segment of either word size, see segment_info_t
+        const segment_infos_t& getSegmentInfos() const {
+            return m_segment_infos;
+        }
+        
         const dylib_command_infos_t& getDylibCommandInfos() const {
             return m_dylib_command_infos;
         }
         
+        const runpath_additions_infos_t& getRunpathAdditionsInfos() const {
+            return m_runpath_additions_infos;
+        }
+        
+        // 16 bytes of LC_UUID, NULL if the image has none
+        const uint8_t* getUUID() const {
+            return m_uuid;
+        }
+        
+        // canonical 8-4-4-4-12 form, empty if the image has no LC_UUID
+        std::string getUUIDString() const;
+        
+        // canonical form of 16 UUID bytes
+        static std::string format_uuid(const uint8_t* uuid);
+        
+        const version_min_info_t& getVersionMinInfo() const {
+            return m_version_min_info;
+        }
+        
+        const encryption_info_t& getEncryptionInfo() const {
+            return m_encryption_info;
+        }
+        
         const fat_arch_infos_t& getFatArchInfos() const {
             return m_fat_arch_infos;
         }
@@ -267,44 +634,173 @@ namespace rotg {
             return m_section_64s;
         }
         
+        const sections_t& getSections() const {
+            return m_sections;
+        }
+        
         const dyld_info_command_info_t& getDyldInfoCommandInfo() const {
+            if (m_dyld_info_pending.load(std::memory_order_acquire)) {
+                decode_lazy_dyld_info();
+            }
             return m_dyld_info_command_info;
         }
         
+        // The export trie read in place, from LC_DYLD_EXPORTS_TRIE or else LC_DYLD_INFO; empty if there
+        // is none or in headers-only mode. Needs no decoding, so it is what to use for a few lookups in lazy mode.
+        ExportTrie getExportTrie() const;
+        
+        // The LC_DYLD_CHAINED_FIXUPS payload read in place, unchecked (see ChainedFixups::init()).
+        // Empty if there is none or in headers-only mode.
+        ChainedFixups getChainedFixups() const;
+        
+        // The LC_FUNCTION_STARTS payload (ULEB128 deltas, see FunctionStarts), NULL if
+        // there is none or in headers-only mode
+        const uint8_t* getFunctionStartsData(size_t* size) const;
+        
+        // The LC_CODE_SIGNATURE payload read in place, unchecked (see CodeSignature::init()).
+        // Empty if there is none or in headers-only mode.
+        CodeSignature getCodeSignature() const;
+        
+        // Hash the pages directory covers and compare them with its code slots, on the
+        // pool when there are enough of them; the pages that do not match are appended
+        // to badPages in order. False if directory cannot be checked against this image.
+        bool verify_code_pages(const code_directory_t& directory, std::vector<uint32_t>& badPages) const;
+        
+        // vmaddr of the segment that maps the start of the file, exports are relative to it
+        uint64_t getBaseAddress() const;
+        
+        // Decode one of the LC_DYLD_INFO bind streams straight into visitor, storing
+        // nothing, so counting imports or looking for one ordinal runs in constant
+        // memory. Needs no other decoding, so it suits lazy mode. False if the
+        // stream is malformed or was not read (headers-only mode). With chained
+        // fixups every bind is a NodeTypeBind one and comes from the chains.
+        bool visit_binds(BindNodeType nodeType, BindVisitor& visitor) const;
+        
+        // The same for the rebase stream: one run per DO_REBASE opcode, so a
+        // DO_REBASE_ULEB_TIMES of any count costs one call and no allocation.
+        bool visit_rebases(RebaseVisitor& visitor) const;
+        
+        // Whether count binds from action.address fit as pointers in the file bytes of the
+        // segment holding it. Visitors that keep or count every bind of a run check it first.
+        bool bind_run_fits(const bind_action_t& action, uint64_t count) const;
+        
+        // Names in the export trie, checked as getDyldInfoCommandInfo() checks them but
+        // without decoding anything else. False if the trie is malformed or was not read.
+        bool count_exports(uint64_t* count) const;
+        
         const symtab_command_info_t& getSymtabCommandInfo() const {
+            if (m_symtab_pending.load(std::memory_order_acquire)) {
+                decode_lazy_symtab();
+            }
             return m_symtab_command_info;
         }
         
+        // Decoded along with the symbol table
+        const dysymtab_command_info_t& getDysymtabCommandInfo() const {
+            if (m_symtab_pending.load(std::memory_order_acquire)) {
+                decode_lazy_symtab();
+            }
+            return m_dysymtab_command_info;
+        }
+        
+        // Symbol table index of slot of indirect_sections[section], or INDIRECT_SYMBOL_LOCAL
+        // and/or INDIRECT_SYMBOL_ABS when the slot has no symbol. Both must be in range.
+        uint32_t getIndirectSymbol(uint32_t section, uint32_t slot) const {
+            const dysymtab_command_info_t& info = getDysymtabCommandInfo();
+            return info.indirect_symbols[info.indirect_sections[section].first + slot];
+        }
+        
+        // The stub or symbol pointer at address as (section, slot), false if no indirect section holds it.
+        // There are a handful of indirect sections, so this is a short scan and a division.
+        bool findIndirectSlot(uint64_t address, uint32_t* section, uint32_t* slot) const;
+        
         const char * getStringTable() const {
-            return m_string_table;
+            return getSymtabCommandInfo().cmd ? m_string_table : NULL;
         }
         
     private:
-        MachOFile operator=(MachOFile&);    // declare only, do not allow assign
-        MachOFile(MachOFile&);              // declare only, do not allow copy
+        MachOFile& operator=(const MachOFile&);   // declare only, do not allow assign
+        MachOFile(const MachOFile&);              // declare only, do not allow copy
         
-        const void* macho_read(const void *address, size_t length);
-        const void* macho_offset(const void *address, size_t offset, size_t length);
-        const void* read_sleb128(const void *address, int64_t& result);
-        const void* read_uleb128(const void *address, uint64_t& result);
+        // The decoders instantiated for the image's word size and byte order, picked once
+        // from its magic so none of them tests either (see macho_traits.h)
+        typedef struct decoders {
+            bool (MachOFile::*parse_segment)(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+            bool (MachOFile::*decode_symtab)();
+            bool (MachOFile::*decode_rebase_stream)(uint64_t location, uint32_t length, uint64_t baseAddress, RebaseVisitor& visitor) const;
+            bool (MachOFile::*decode_bind_stream)(uint64_t location, uint32_t length, BindNodeType nodeType, uint64_t baseAddress, BindVisitor& visitor) const;
+            bool (MachOFile::*decode_chained_fixups)(RebaseVisitor* rebases, BindVisitor* binds) const;
+        } decoders_t;
+        
+        template <typename Arch>
+        static const decoders_t* get_decoders();
+        
+        void take(MachOFile& other);
+        void release_input();
+        
+        const void* macho_read(const void *address, size_t length) const;
+        const void* macho_offset(const void *address, size_t offset, size_t length) const;
+        bool input_span(uint64_t offset, uint64_t length, ByteSpan* span) const;
+        
+        void init_containers();
+        
+        bool map_input(uint64_t offset, uint64_t length);
+        bool read_headers(int fd, uint64_t offset, uint64_t length);
+        bool load_input(uint64_t offset, uint64_t length);
         
         bool parse_universal();
         bool parse_load_commands();
         
-        bool parse_LC_SEGMENT_64(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        template <typename Arch>
+        bool parse_LC_SEGMENT(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        segment_command_64_info_t* add_segment_command(uint32_t cmd_type, const struct segment_command_64* cmd, const struct section_64* sections, uint32_t nsects);
+        segment_command_info_t* add_segment_command(uint32_t cmd_type, const struct segment_command* cmd, const struct section* sections, uint32_t nsects);
         bool parse_LC_RPATH(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
         bool parse_LC_DYLIB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
         bool parse_LC_DYLD_INFO(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_DYLD_CHAINED_FIXUPS(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_DYLD_EXPORTS_TRIE(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_FUNCTION_STARTS(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_CODE_SIGNATURE(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_DYSYMTAB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        const uint8_t* getLinkeditData(const struct linkedit_data_command* cmd, size_t* size) const;
         bool parse_LC_THREAD(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
         bool parse_LC_SYMTAB(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_UUID(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_VERSION_MIN(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        bool parse_LC_ENCRYPTION_INFO(uint32_t cmd_type, uint32_t cmdsize, load_command_info_t* load_cmd_info);
+        
+        // LINKEDIT decoding, run from parse_load_commands or on first access in lazy mode
+        template <typename Arch>
+        bool decode_symtab();
+        template <typename Arch>
+        bool decode_dysymtab();
+        template <typename Arch>
+        bool add_indirect_section(const typename Arch::section_t* section);
+        bool decode_dyld_info();
+        void decode_lazy_symtab() const;
+        void decode_lazy_dyld_info() const;
 
         // dylib related parsing
-        bool parse_rebase_node(const struct dyld_info_command* dyld_info_cmd, uint64_t baseAddress);
-        bool parse_binding_node(binding_info_t* binding_info, uint64_t location, uint32_t length, BindNodeType nodeType, uint64_t baseAddress);
-        bool parse_export_node(export_info_t* exportInfo, const char* prefix, uint64_t location, uint64_t length, uint64_t skipBytes, uint64_t baseAddress);
+        template <typename Arch>
+        bool decode_rebase_stream(uint64_t location, uint32_t length, uint64_t baseAddress, RebaseVisitor& visitor) const;
+        template <typename Arch>
+        bool decode_bind_stream(uint64_t location, uint32_t length, BindNodeType nodeType, uint64_t baseAddress, BindVisitor& visitor) const;
+        template <typename Arch>
+        bool decode_chained_fixups(RebaseVisitor* rebases, BindVisitor* binds) const;
+        void getExportTrieRange(uint64_t* offset, uint64_t* size) const;
+        bool parse_export_trie(export_info_t* exportInfo, const ExportTrie& trie, uint64_t baseAddress);
+        bool parse_export_trie_parallel(export_info_t* exportInfo, const ExportTrie& trie, uint32_t cutDepth, uint64_t baseAddress);
         
+        std::unique_ptr<Arena>          m_owned_arena;      // declared first, everything below may live in it
+        Arena*                          m_arena;
+        
+        uint32_t                        m_options;
+        ThreadPool*                     m_pool;
         int                             m_fd;
         bool                            m_isInputOwned;
+        void*                           m_map_data;
+        size_t                          m_map_length;
         macho_input_t                   m_input;
         
         const struct mach_header*       m_header;
@@ -313,22 +809,40 @@ namespace rotg {
         const struct fat_header*        m_fat_header;
         bool                            m_is64bit;
         bool                            m_is_universal;
-        const NXArchInfo*               m_archInfo;
+        const arch_info_t*              m_archInfo;
         bool                            m_is_need_byteswap;
+        const decoders_t*               m_decoders;         // NULL until a thin image is parsed
         
         load_command_infos_t            m_load_command_infos;
         segment_command_64_infos_t      m_segment_command_64_infos;
+        segment_command_infos_t         m_segment_command_infos;
+        segment_infos_t                 m_segment_infos;
         dyld_info_command_info_t        m_dyld_info_command_info;
         thread_command_infos_t          m_thread_command_infos;
         dylib_command_infos_t           m_dylib_command_infos;
         runpath_additions_infos_t       m_runpath_additions_infos;
         fat_arch_infos_t                m_fat_arch_infos;
         symtab_command_info_t           m_symtab_command_info;
+        dysymtab_command_info_t         m_dysymtab_command_info;
         const char *                    m_string_table;
+        const uint8_t*                  m_uuid;
+        const struct linkedit_data_command* m_function_starts_cmd;
+        const struct linkedit_data_command* m_code_signature_cmd;
+        version_min_info_t              m_version_min_info;
+        encryption_info_t               m_encryption_info;
         
         section_64s_t                   m_section_64s;
+        sections_t                      m_sections;
         
         SegmentInfoMap                  m_segmentInfo;      // segment info lookup table by offset
+        std::string                     m_export_prefix;    // export trie walk scratch, kept across reset()
+        export_walk_stack_t             m_export_stack;
+        std::vector<std::unique_ptr<Arena> > m_export_arenas; // per task of a parallel export decode, rewound by reset()
+        
+        mutable std::mutex              m_lazy_lock;        // serializes the deferred decoding
+        mutable std::atomic<bool>       m_symtab_pending;
+        mutable std::atomic<bool>       m_dyld_info_pending;
+        mutable bool                    m_lazy_failed;
     };
     
 }
@@ -6,11 +6,20 @@
 //  Copyright (c) 2012 Glenn. All rights reserved.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "machofile.h"
+#include "address_index.h"
+#include "function_starts.h"
+#include "batch_scanner.h"
+#include "name_index.h"
+#include "thread_pool.h"
 
 using namespace rotg;
 
@@ -85,7 +94,7 @@ static void printHeader(MachOFile& machoFile)
         printf("Type: Universal\n");
     }
     
-    const NXArchInfo* archInfo = machoFile.getArchInfo();
+    const arch_info_t* archInfo = machoFile.getArchInfo();
     if (archInfo) {
         printf("Architecture: %s\n\n", archInfo->name);
     }
@@ -124,7 +133,7 @@ static void printHeader(MachOFile& machoFile)
     printf("CPU Type\n");
     printf("\tOffset: 0x%08llx\n", machoFile.getOffset((void*)&header->cputype));
     printf("\tData  : 0x%X\n", header->cputype);
-    printf("\tValue : %s", getCPUTypeString(header->cputype));
+    printf("\tValue : %s", getCPUTypeString(machoFile.read32(header->cputype)));
     printf("\n");
     
     printf("CPU SubType\n");
@@ -135,7 +144,7 @@ static void printHeader(MachOFile& machoFile)
     printf("\tOffset: 0x%08llx\n", machoFile.getOffset((void*)&header->filetype));
     printf("\tData  : 0x%X\n", header->filetype);
     printf("\tValue : ");
-    switch (header->filetype) {
+    switch (machoFile.read32(header->filetype)) {
         case MH_OBJECT:
             printf("MH_OBJECT");
             break;
@@ -189,12 +198,12 @@ static void printHeader(MachOFile& machoFile)
     printf("Number of Load Commands\n");
     printf("\tOffset: 0x%08llx\n", machoFile.getOffset((void*)&header->ncmds));
     printf("\tData  : 0x%X\n", header->ncmds);
-    printf("\tValue : %d\n", header->ncmds);
+    printf("\tValue : %d\n", machoFile.read32(header->ncmds));
     
     printf("Size of Load Commands\n");
     printf("\tOffset: 0x%08llx\n", machoFile.getOffset((void*)&header->sizeofcmds));
     printf("\tData  : 0x%X\n", header->sizeofcmds);
-    printf("\tValue : %d\n", header->sizeofcmds);
+    printf("\tValue : %d\n", machoFile.read32(header->sizeofcmds));
     
     printf("Flags\n");
     printf("\tOffset: 0x%08llx\n", machoFile.getOffset((void*)&header->flags));
@@ -211,6 +220,126 @@ static void printHeader(MachOFile& machoFile)
     printf("\n");
 }
 
+static void printSegmentCommand(MachOFile& machofile, const segment_command_info_t* info)
+{
+    printf("LC_SEGMENT (%s)\n", info->cmd->segname);
+    
+    printf("\tCommand\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmd));
+    printf("\t\tData  : 0x%X\n", info->cmd->cmd);
+    printf("\t\tValue : LC_SEGMENT\n");
+    
+    printf("\tCommand Size\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmdsize));
+    printf("\t\tData  : 0x%X\n", info->cmd->cmdsize);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->cmdsize));
+    
+    printf("\tSegment Name\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->segname));
+    printf("\t\tValue : %s\n", info->cmd->segname);
+    
+    printf("\tVM Address\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->vmaddr));
+    printf("\t\tData  : 0x%X\n", info->cmd->vmaddr);
+    printf("\t\tValue : %u\n", machofile.read32(info->cmd->vmaddr));
+    
+    printf("\tVM Size\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->vmsize));
+    printf("\t\tData  : 0x%X\n", info->cmd->vmsize);
+    printf("\t\tValue : %u\n", machofile.read32(info->cmd->vmsize));
+    
+    printf("\tFile Offset\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->fileoff));
+    printf("\t\tData  : 0x%X\n", info->cmd->fileoff);
+    printf("\t\tValue : %u\n", machofile.read32(info->cmd->fileoff));
+    
+    printf("\tFile Size\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->filesize));
+    printf("\t\tData  : 0x%X\n", info->cmd->filesize);
+    printf("\t\tValue : %u\n", machofile.read32(info->cmd->filesize));
+    
+    printf("\tMaximum VM Protection\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->maxprot));
+    printf("\t\tData  : 0x%X\n", info->cmd->maxprot);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->maxprot));
+    
+    printf("\tInitial VM Protection\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->initprot));
+    printf("\t\tData  : 0x%X\n", info->cmd->initprot);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->initprot));
+    
+    printf("\tNumber of Sections\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->nsects));
+    printf("\t\tData  : 0x%X\n", info->cmd->nsects);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->nsects));
+    
+    printf("\tFlags\n");
+    printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->flags));
+    printf("\t\tData  : 0x%X\n", info->cmd->flags);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->flags));
+    
+    uint32_t nsect;
+    for (nsect=0; nsect < info->sections.size(); nsect++) {
+        const struct section* section = info->sections[nsect];
+        printf("\n\tSection Header (%s)\n", section->sectname);
+        
+        printf("\t\tSection Name\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->sectname));
+        printf("\t\t\tValue : %s\n", section->sectname);
+        
+        printf("\t\tSegment Name\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->segname));
+        printf("\t\t\tValue : %s\n", section->segname);
+        
+        printf("\t\tAddress\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->addr));
+        printf("\t\t\tData  : 0x%X\n", section->addr);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->addr));
+        
+        printf("\t\tSize\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->size));
+        printf("\t\t\tData  : 0x%X\n", section->size);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->size));
+        
+        printf("\t\tOffset\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->offset));
+        printf("\t\t\tData  : 0x%X\n", section->offset);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->offset));
+        
+        printf("\t\tAlignment\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->align));
+        printf("\t\t\tData  : 0x%X\n", section->align);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->align));
+        
+        printf("\t\tRelocations Offset\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reloff));
+        printf("\t\t\tData  : 0x%X\n", section->reloff);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reloff));
+        
+        printf("\t\tNumber of Relocations\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->nreloc));
+        printf("\t\t\tData  : 0x%X\n", section->nreloc);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->nreloc));
+        
+        printf("\t\tFlags\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->flags));
+        printf("\t\t\tData  : 0x%X\n", section->flags);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->flags));
+        
+        printf("\t\tReserved1\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reserved1));
+        printf("\t\t\tData  : 0x%X\n", section->reserved1);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reserved1));
+        
+        printf("\t\tReserved2\n");
+        printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reserved2));
+        printf("\t\t\tData  : 0x%X\n", section->reserved2);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reserved2));
+    }
+    
+    printf("\n");
+}
+
 static void printSegmentCommand64(MachOFile& machofile, const segment_command_64_info_t* info)
 {
     printf("LC_SEGMENT_64 (%s)\n", info->cmd->segname);
@@ -223,7 +352,7 @@ static void printSegmentCommand64(MachOFile& machofile, const segment_command_64
     printf("\tCommand Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmdsize));
     printf("\t\tData  : 0x%X\n", info->cmd->cmdsize);
-    printf("\t\tValue : %d\n", info->cmd->cmdsize);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->cmdsize));
     
     printf("\tSegment Name\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->segname));
@@ -232,45 +361,45 @@ static void printSegmentCommand64(MachOFile& machofile, const segment_command_64
     printf("\tVM Address\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->vmaddr));
     printf("\t\tData  : 0x%llX\n", info->cmd->vmaddr);
-    printf("\t\tValue : %lld\n", info->cmd->vmaddr);
+    printf("\t\tValue : %lld\n", machofile.read64(info->cmd->vmaddr));
     
     printf("\tVM Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->vmsize));
     printf("\t\tData  : 0x%llX\n", info->cmd->vmsize);
-    printf("\t\tValue : %lld\n", info->cmd->vmsize);
+    printf("\t\tValue : %lld\n", machofile.read64(info->cmd->vmsize));
     
     printf("\tFile Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->fileoff));
     printf("\t\tData  : 0x%llX\n", info->cmd->fileoff);
-    printf("\t\tValue : %lld\n", info->cmd->fileoff);
+    printf("\t\tValue : %lld\n", machofile.read64(info->cmd->fileoff));
     
     printf("\tFile Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->filesize));
     printf("\t\tData  : 0x%llX\n", info->cmd->filesize);
-    printf("\t\tValue : %lld\n", info->cmd->filesize);
+    printf("\t\tValue : %lld\n", machofile.read64(info->cmd->filesize));
     
     printf("\tMaximum VM Protection\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->maxprot));
     printf("\t\tData  : 0x%X\n", info->cmd->maxprot);
-    printf("\t\tValue : 0x%X\n", info->cmd->maxprot);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->maxprot));
     
     printf("\tInitial VM Protection\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->initprot));
     printf("\t\tData  : 0x%X\n", info->cmd->initprot);
-    printf("\t\tValue : 0x%X\n", info->cmd->initprot);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->initprot));
     
     printf("\tNumber of Sections\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->nsects));
     printf("\t\tData  : 0x%X\n", info->cmd->nsects);
-    printf("\t\tValue : %d\n", info->cmd->nsects);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->nsects));
     
     printf("\tFlags\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->flags));
     printf("\t\tData  : 0x%X\n", info->cmd->flags);
-    printf("\t\tValue : 0x%X\n", info->cmd->flags);
+    printf("\t\tValue : 0x%X\n", machofile.read32(info->cmd->flags));
     
     uint32_t nsect;
-    for (nsect=0; nsect < info->cmd->nsects; nsect++) {
+    for (nsect=0; nsect < info->section_64s.size(); nsect++) {
         const struct section_64* section = info->section_64s[nsect];
         printf("\n\tSection64 Header (%s)\n", section->sectname);
         
@@ -286,52 +415,52 @@ static void printSegmentCommand64(MachOFile& machofile, const segment_command_64
         printf("\t\tAddress\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->addr));
         printf("\t\t\tData  : 0x%llX\n", section->addr);
-        printf("\t\t\tValue : %llu\n", section->addr);
+        printf("\t\t\tValue : %llu\n", machofile.read64(section->addr));
         
         printf("\t\tSize\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->size));
         printf("\t\t\tData  : 0x%llX\n", section->size);
-        printf("\t\t\tValue : %llu\n", section->size);
+        printf("\t\t\tValue : %llu\n", machofile.read64(section->size));
         
         printf("\t\tOffset\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->offset));
         printf("\t\t\tData  : 0x%X\n", section->offset);
-        printf("\t\t\tValue : %u\n", section->offset);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->offset));
         
         printf("\t\tAlignment\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->align));
         printf("\t\t\tData  : 0x%X\n", section->align);
-        printf("\t\t\tValue : %u\n", section->align);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->align));
         
         printf("\t\tRelocations Offset\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reloff));
         printf("\t\t\tData  : 0x%X\n", section->reloff);
-        printf("\t\t\tValue : %u\n", section->reloff);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reloff));
         
         printf("\t\tNumber of Relocations\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->nreloc));
         printf("\t\t\tData  : 0x%X\n", section->nreloc);
-        printf("\t\t\tValue : %u\n", section->nreloc);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->nreloc));
         
         printf("\t\tFlags\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->flags));
         printf("\t\t\tData  : 0x%X\n", section->flags);
-        printf("\t\t\tValue : %u\n", section->flags);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->flags));
         
         printf("\t\tReserved1\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reserved1));
         printf("\t\t\tData  : 0x%X\n", section->reserved1);
-        printf("\t\t\tValue : %u\n", section->reserved1);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reserved1));
         
         printf("\t\tReserved2\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reserved2));
         printf("\t\t\tData  : 0x%X\n", section->reserved2);
-        printf("\t\t\tValue : %u\n", section->reserved2);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reserved2));
         
         printf("\t\tReserved3\n");
         printf("\t\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&section->reserved3));
         printf("\t\t\tData  : 0x%X\n", section->reserved3);
-        printf("\t\t\tValue : %u\n", section->reserved3);
+        printf("\t\t\tValue : %u\n", machofile.read32(section->reserved3));
     }
     
     printf("\n");
@@ -360,57 +489,57 @@ static void printDyldInfo(MachOFile& machofile, const dyld_info_command_info_t*
     printf("\tCommand Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmdsize));
     printf("\t\tData  : 0x%X\n", info->cmd->cmdsize);
-    printf("\t\tValue : %d\n", info->cmd->cmdsize);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->cmdsize));
     
     printf("\tRebase Info Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->rebase_off));
     printf("\t\tData  : 0x%X\n", info->cmd->rebase_off);
-    printf("\t\tValue : %d\n", info->cmd->rebase_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->rebase_off));
     
     printf("\tRebase Info Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->rebase_size));
     printf("\t\tData  : 0x%X\n", info->cmd->rebase_size);
-    printf("\t\tValue : %d\n", info->cmd->rebase_size);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->rebase_size));
     
     printf("\tBinding Info Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->bind_off));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tBinding Info Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->bind_off));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tWeak Binding Info Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->weak_bind_off));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tWeak Binding Info Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->weak_bind_size));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tLazy Binding Info Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->lazy_bind_off));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tLazy Binding Info Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->lazy_bind_size));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tExport Info Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->export_off));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\tExport Info Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->export_size));
     printf("\t\tData  : 0x%X\n", info->cmd->bind_off);
-    printf("\t\tValue : %d\n", info->cmd->bind_off);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->bind_off));
     
     printf("\n");
 }
@@ -438,10 +567,10 @@ static void printThreadCommand(MachOFile& machofile, const thread_command_info_t
     printf("\tCommand Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmdsize));
     printf("\t\tData  : 0x%X\n", info->cmd->cmdsize);
-    printf("\t\tValue : %d\n", info->cmd->cmdsize);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->cmdsize));
     
-    const struct mach_header* header = machofile.getHeader();
-    if (header->cputype == CPU_TYPE_X86 || header->cputype == CPU_TYPE_X86_64) {
+    cpu_type_t cputype = machofile.read32(machofile.getHeader()->cputype);
+    if (cputype == CPU_TYPE_X86 || cputype == CPU_TYPE_X86_64) {
         const x86_thread_state* state = (const x86_thread_state*)((uint8_t*)info->cmd + sizeof(struct thread_command));
         
         printf("\tFlavor\n");
@@ -700,28 +829,30 @@ static void printLoadDylib(MachOFile& machofile, const dylib_command_info_t* inf
     printf("\tCommand Size\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->cmdsize));
     printf("\t\tData  : 0x%X\n", info->cmd->cmdsize);
-    printf("\t\tValue : %d\n", info->cmd->cmdsize);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->cmdsize));
     
     printf("\tStr Offset\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->dylib.name.offset));
     printf("\t\tData  : 0x%X\n", info->cmd->dylib.name.offset);
-    printf("\t\tValue : %d\n", info->cmd->dylib.name.offset);
+    printf("\t\tValue : %d\n", machofile.read32(info->cmd->dylib.name.offset));
     
     printf("\tTime Stamp\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->dylib.timestamp));
     printf("\t\tData  : 0x%X\n", info->cmd->dylib.timestamp);
-    time_t time = (time_t)info->cmd->dylib.timestamp;
+    time_t time = (time_t)machofile.read32(info->cmd->dylib.timestamp);
     printf("\t\tValue : %s", ctime(&time));
     
     printf("\tCurrent Version\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->dylib.current_version));
     printf("\t\tData  : 0x%X\n", info->cmd->dylib.current_version);
-    printf("\t\tValue : %u.%u.%u\n", (info->cmd->dylib.current_version >> 16), ((info->cmd->dylib.current_version >> 8) & 0xff), (info->cmd->dylib.current_version & 0xff));
+    uint32_t current_version = machofile.read32(info->cmd->dylib.current_version);
+    printf("\t\tValue : %u.%u.%u\n", (current_version >> 16), ((current_version >> 8) & 0xff), (current_version & 0xff));
     
     printf("\tCompatibility Version\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)&info->cmd->dylib.compatibility_version));
     printf("\t\tData  : 0x%X\n", info->cmd->dylib.compatibility_version);
-    printf("\t\tValue : %u.%u.%u\n", (info->cmd->dylib.compatibility_version >> 16), ((info->cmd->dylib.compatibility_version >> 8) & 0xff), (info->cmd->dylib.compatibility_version & 0xff));
+    uint32_t compatibility_version = machofile.read32(info->cmd->dylib.compatibility_version);
+    printf("\t\tValue : %u.%u.%u\n", (compatibility_version >> 16), ((compatibility_version >> 8) & 0xff), (compatibility_version & 0xff));
     
     printf("\tName\n");
     printf("\t\tOffset: 0x%08llx\n", machofile.getOffset((void*)info->libname));
@@ -730,6 +861,98 @@ static void printLoadDylib(MachOFile& machofile, const dylib_command_info_t* inf
     printf("\n");
 }
 
+static void printVersion(const char* label, uint32_t version)
+{
+    printf("\t%s: %u.%u.%u\n", label, (version >> 16), ((version >> 8) & 0xff), (version & 0xff));
+}
+
+static void printVersionMin(MachOFile& machofile, const char* cmd_name, const version_min_info_t* info)
+{
+    printf("%s\n", cmd_name);
+    printf("\tPlatform   : %s\n", get_platform_name(info->platform));
+    printVersion("Minimum OS ", info->minos);
+    printVersion("SDK        ", info->sdk);
+    printf("\n");
+}
+
+static void printEncryptionInfo(MachOFile& machofile, const char* cmd_name, const encryption_info_t* info)
+{
+    printf("%s\n", cmd_name);
+    printf("\tCrypt Offset: 0x%X\n", info->cryptoff);
+    printf("\tCrypt Size  : %u\n", info->cryptsize);
+    printf("\tCrypt ID    : %u\n", info->cryptid);
+    printf("\n");
+}
+
+static void printDysymtab(MachOFile& machofile, const dysymtab_command_info_t& info)
+{
+    printf("LC_DYSYMTAB\n");
+    printf("\tLocal Symbols      : %u at %u\n", info.nlocalsym, info.ilocalsym);
+    printf("\tExternal Symbols   : %u at %u\n", info.nextdefsym, info.iextdefsym);
+    printf("\tUndefined Symbols  : %u at %u\n", info.nundefsym, info.iundefsym);
+    printf("\tIndirect Symbols   : %zu\n", info.indirect_symbols.size());
+    printf("\tTable of Contents  : %zu\n", info.toc.size());
+    printf("\tModules            : %zu\n", info.modules.size());
+    printf("\n");
+}
+
+static const char* getHashTypeString(uint8_t hashType)
+{
+    switch (hashType) {
+        case CS_HASHTYPE_SHA1:
+            return "SHA-1";
+        case CS_HASHTYPE_SHA256:
+            return "SHA-256";
+        case CS_HASHTYPE_SHA256_TRUNCATED:
+            return "SHA-256 (truncated)";
+        case CS_HASHTYPE_SHA384:
+            return "SHA-384";
+        default:
+            return "unknown";
+    }
+}
+
+static void printCodeSignature(MachOFile& machofile, const struct linkedit_data_command* cmd)
+{
+    printf("LC_CODE_SIGNATURE\n");
+    printf("\tData Offset : %u\n", machofile.read32(cmd->dataoff));
+    printf("\tData Size   : %u\n", machofile.read32(cmd->datasize));
+    
+    CodeSignature signature = machofile.getCodeSignature();
+    if (signature.empty()) {
+        printf("\n");
+        return;
+    }
+    
+    if (!signature.init()) {
+        printf("\tMalformed signature\n\n");
+        return;
+    }
+    
+    const code_directories_t& directories = signature.getCodeDirectories();
+    code_directories_t::const_iterator iter;
+    for (iter = directories.begin(); iter != directories.end(); iter++) {
+        printf("\tCode Directory (slot 0x%X)\n", iter->slot);
+        printf("\t\tIdentifier    : %s\n", iter->identifier);
+        if (iter->teamID != NULL) {
+            printf("\t\tTeam ID       : %s\n", iter->teamID);
+        }
+        printf("\t\tVersion       : 0x%X\n", iter->version);
+        printf("\t\tFlags         : 0x%X\n", iter->flags);
+        printf("\t\tHash Type     : %s\n", getHashTypeString(iter->hashType));
+        printf("\t\tPage Size     : %llu\n", iter->pageShift != 0 ? 1ULL << iter->pageShift : (unsigned long long)iter->codeLimit);
+        printf("\t\tCode Limit    : %llu\n", (unsigned long long)iter->codeLimit);
+        printf("\t\tCode Slots    : %u\n", iter->nCodeSlots);
+        printf("\t\tSpecial Slots : %u\n", iter->nSpecialSlots);
+        if (iter->version >= CS_SUPPORTSEXECSEG) {
+            printf("\t\tExec Segment  : base 0x%llx limit 0x%llx flags 0x%llx\n", (unsigned long long)iter->execSegBase,
+                   (unsigned long long)iter->execSegLimit, (unsigned long long)iter->execSegFlags);
+        }
+    }
+    
+    printf("\n");
+}
+
 static void printLoadCommands(MachOFile& machofile)
 {
     printf("\n***** Load Commands *****\n");
@@ -741,11 +964,19 @@ static void printLoadCommands(MachOFile& machofile)
         
         switch (info.cmd_type) {
             case LC_SEGMENT:
-                printf("LC_SEGMENT (TODO: Details)\n\n");
+                if (info.cmd_info != NULL) {
+                    printSegmentCommand(machofile, (const segment_command_info_t*)info.cmd_info);
+                } else {
+                    printf("LC_SEGMENT (ignored in a 64-bit image)\n\n");
+                }
                 break;
                 
             case LC_SEGMENT_64:
-                printSegmentCommand64(machofile, (const segment_command_64_info_t*)info.cmd_info);
+                if (info.cmd_info != NULL) {
+                    printSegmentCommand64(machofile, (const segment_command_64_info_t*)info.cmd_info);
+                } else {
+                    printf("LC_SEGMENT_64 (ignored in a 32-bit image)\n\n");
+                }
                 break;
                 
             case LC_SYMTAB:
@@ -753,7 +984,7 @@ static void printLoadCommands(MachOFile& machofile)
                 break;
                 
             case LC_DYSYMTAB:
-                printf("LC_DYSYMTAB (TODO: Details)\n\n");
+                printDysymtab(machofile, machofile.getDysymtabCommandInfo());
                 break;
                 
             case LC_TWOLEVEL_HINTS:
@@ -773,7 +1004,8 @@ static void printLoadCommands(MachOFile& machofile)
                 break;
                 
             case LC_UUID:
-                printf("LC_UUID (TODO: Details)\n\n");
+                printf("LC_UUID\n");
+                printf("\tUUID: %s\n\n", machofile.getUUIDString().c_str());
                 break;
                 
             case LC_THREAD:
@@ -792,34 +1024,36 @@ static void printLoadCommands(MachOFile& machofile)
                 printf("LC_LAZY_LOAD_DYLIB (TODO: Details)\n\n");
                 break;
                 
-#ifdef __MAC_10_7
             case LC_LOAD_UPWARD_DYLIB:
                 printf("LC_LOAD_UPWARD_DYLIB (TODO: Details)\n\n");
                 break;
-#endif
                 
             case LC_CODE_SIGNATURE:
-                printf("LC_CODE_SIGNATURE (TODO: Details)\n\n");
+                printCodeSignature(machofile, (const struct linkedit_data_command*)info.cmd);
                 break;
                 
             case LC_SEGMENT_SPLIT_INFO:
                 printf("LC_SEGMENT_SPLIT_INFO (TODO: Details)\n\n");
                 break;
 
-#ifdef __MAC_10_7
             case LC_FUNCTION_STARTS:
                 printf("LC_FUNCTION_STARTS (TODO: Details)\n\n");
                 break;
-#endif
                 
             case LC_ENCRYPTION_INFO:
-                printf("LC_ENCRYPTION_INFO (TODO: Details)\n\n");
+                printEncryptionInfo(machofile, "LC_ENCRYPTION_INFO", (const encryption_info_t*)info.cmd_info);
                 break;
                 
-            case LC_RPATH:
-                printf("LC_RPATH (TODO: Details)\n\n");
+            case LC_ENCRYPTION_INFO_64:
+                printEncryptionInfo(machofile, "LC_ENCRYPTION_INFO_64", (const encryption_info_t*)info.cmd_info);
                 break;
                 
+            case LC_RPATH: {
+                const struct rpath_command* rpath_cmd = (const struct rpath_command*)info.cmd;
+                printf("LC_RPATH\n");
+                printf("\tPath: %s\n\n", (const char*)rpath_cmd + machofile.read32(rpath_cmd->path.offset));
+            } break;
+                
             case LC_ROUTINES:
                 printf("LC_ROUTINES (TODO: Details)\n\n");
                 break;
@@ -849,15 +1083,33 @@ static void printLoadCommands(MachOFile& machofile)
                 printDyldInfo(machofile, (const dyld_info_command_info_t*)info.cmd_info);
                 break;
                 
-#ifdef __MAC_10_7
+            case LC_DYLD_CHAINED_FIXUPS:
+                printf("LC_DYLD_CHAINED_FIXUPS (TODO: Details)\n\n");
+                break;
+                
+            case LC_DYLD_EXPORTS_TRIE:
+                printf("LC_DYLD_EXPORTS_TRIE (TODO: Details)\n\n");
+                break;
+                
             case LC_VERSION_MIN_MACOSX:
-                printf("LC_VERSION_MIN_MACOSX (TODO: Details)\n\n");
+                printVersionMin(machofile, "LC_VERSION_MIN_MACOSX", (const version_min_info_t*)info.cmd_info);
                 break;
                 
             case LC_VERSION_MIN_IPHONEOS:
-                printf("LC_VERSION_MIN_IPHONEOS (TODO: Details)\n\n");
+                printVersionMin(machofile, "LC_VERSION_MIN_IPHONEOS", (const version_min_info_t*)info.cmd_info);
+                break;
+                
+            case LC_VERSION_MIN_TVOS:
+                printVersionMin(machofile, "LC_VERSION_MIN_TVOS", (const version_min_info_t*)info.cmd_info);
+                break;
+                
+            case LC_VERSION_MIN_WATCHOS:
+                printVersionMin(machofile, "LC_VERSION_MIN_WATCHOS", (const version_min_info_t*)info.cmd_info);
+                break;
+                
+            case LC_BUILD_VERSION:
+                printVersionMin(machofile, "LC_BUILD_VERSION", (const version_min_info_t*)info.cmd_info);
                 break;
-#endif
             
             default:
                 printf("Unsupported/Unknown command\n");
@@ -870,6 +1122,23 @@ static void printLoadCommands(MachOFile& machofile)
     printf("\n");
 }
 
+static void printRebaseInfo(MachOFile& machoFile, const rebase_runs_t& rebase_runs)
+{
+    printf("\t\tActions\n");
+    
+    RebaseAddressIterator iter(rebase_runs);
+    uint64_t address;
+    uint32_t type;
+    while (iter.next(&address, &type)) {
+        const char* typeName = type == REBASE_TYPE_POINTER ? "pointer"
+                             : type == REBASE_TYPE_TEXT_ABSOLUTE32 ? "text absolute32"
+                             : type == REBASE_TYPE_TEXT_PCREL32 ? "text pcrel32" : "unknown";
+        printf("\t\t\t0x%08llX\t%s\n", (unsigned long long)address, typeName);
+    }
+    
+    printf("\n");
+}
+
 static void printBindingInfo(MachOFile& machoFile, const binding_info_t& binding_info)
 {
     printf("\t\tActions\n");
@@ -890,7 +1159,7 @@ static void printExportInfo(MachOFile& machoFile, const export_info_t& export_in
     export_actions_t::const_iterator iter;
     for (iter = export_info.actions.begin(); iter != export_info.actions.end(); iter++) {
         const export_action_t& action = *iter;
-        printf("\t\t\t0x%08llX\t%s\n", action.address, action.symbolName.c_str());
+        printf("\t\t\t0x%08llX\t%s\n", action.address, action.symbolName);
     }
     
     printf("\n");
@@ -904,6 +1173,16 @@ static void printDynamicLoaderInfo(MachOFile& machoFile)
     
     const dynamic_loader_info_t& loader_info = dylib_info_cmd_info.loader_info;
     
+    if (loader_info.rebase_runs.size() > 0) {
+        if (printHeader) {
+            printf("Dynamic Loader Info\n");
+            printHeader = false;
+        }
+        
+        printf("\tRebase Info\n");
+        printRebaseInfo(machoFile, loader_info.rebase_runs);
+    }
+    
     if (loader_info.binding_info.actions.size() > 0) {
         if (printHeader) {
             printf("Dynamic Loader Info\n");
@@ -939,30 +1218,51 @@ static void printSymbols(MachOFile& machoFile)
 {
     const symtab_command_info_t& symtab_cmd_info = machoFile.getSymtabCommandInfo();
     
-    const nlist_infos_t& infos = symtab_cmd_info.nlist_infos;
+    const SymbolTable& symbols = symtab_cmd_info.symbols;
     
-    if (infos.size() > 0) {
+    if (symbols.size() > 0) {
         printf("Symbols\n");
     }
     
-    nlist_infos_t::const_iterator iter;
-    for (iter = infos.begin(); iter != infos.end(); iter++) {
-        const nlist_info_t& nlist_info = *iter;
-        printf("\t%s\n", nlist_info.name);
+    for (size_t i = 0; i < symbols.size(); i++) {
+        printf("\t%s\n", symbols.name(i));
+        printf("\t\tSection Index: %d\n", symbols.sect(i));
+        printf("\t\tType         : 0x%X\n", symbols.type(i));
         if (machoFile.is64bit()) {
-            struct nlist_64 * nlst = (struct nlist_64 *)nlist_info.nlist;
-            printf("\t\tSection Index: %d\n", nlst->n_sect);
-            printf("\t\tType         : 0x%X\n", nlst->n_type);
-            printf("\t\tValue        : (0x%08llX) %lld\n", nlst->n_value, nlst->n_value);
+            printf("\t\tValue        : (0x%08llX) %lld\n", (unsigned long long)symbols.value(i), (long long)symbols.value(i));
         } else {
-            struct nlist * nlst = (struct nlist *)nlist_info.nlist;
-            printf("\t\tSection Index: %d\n", nlst->n_sect);
-            printf("\t\tType         : 0x%X\n", nlst->n_type);
-            printf("\t\tValue        : (0x%08X) %d\n", nlst->n_value, nlst->n_value);
+            printf("\t\tValue        : (0x%08X) %d\n", (uint32_t)symbols.value(i), (int32_t)symbols.value(i));
         }
     }
 }
 
+static void printIndirectSymbols(MachOFile& machoFile)
+{
+    const dysymtab_command_info_t& info = machoFile.getDysymtabCommandInfo();
+    const SymbolTable& symbols = machoFile.getSymtabCommandInfo().symbols;
+    
+    if (info.indirect_sections.empty()) {
+        return;
+    }
+    
+    printf("Indirect Symbols\n");
+    
+    for (uint32_t section = 0; section < info.indirect_sections.size(); section++) {
+        const indirect_section_t& indirect = info.indirect_sections[section];
+        printf("\t%.16s\n", indirect.sectname);
+        
+        for (uint32_t slot = 0; slot < indirect.count; slot++) {
+            uint32_t symbol = machoFile.getIndirectSymbol(section, slot);
+            const char* name = (symbol & INDIRECT_SYMBOL_LOCAL) ? "LOCAL"
+                             : (symbol & INDIRECT_SYMBOL_ABS) ? "ABSOLUTE"
+                             : symbol < symbols.size() ? symbols.name(symbol) : "?";
+            printf("\t\t0x%08llX\t%s\n", (unsigned long long)(indirect.addr + (uint64_t)slot * indirect.stride), name);
+        }
+    }
+    
+    printf("\n");
+}
+
 static void printMachODetails(MachOFile& machoFile);
 
 static void parseUniversal(MachOFile& machoFile)
@@ -988,17 +1288,20 @@ static void parseUniversal(MachOFile& machoFile)
     
     printf("\n");
     
+    /* Slices are independent, parse them all at once and print in order */
+    macho_files_t slices;
+    machoFile.parse_slices(slices, machoFile.getThreadPool());
+    
     archNum = 1;
-    for (iter=infos.begin(); iter!=infos.end(); iter++) {
+    macho_files_t::iterator slice_iter;
+    for (slice_iter=slices.begin(); slice_iter!=slices.end(); slice_iter++) {
         printf("********** Arch %d **********\n", archNum++);
         
-        const fat_arch_info_t& fat_arch_info = *iter;
-        
-        MachOFile machoFile;
-        
-        if (machoFile.parse_macho(&(fat_arch_info.input))) {
-            printMachODetails(machoFile);
+        if (*slice_iter) {
+            printMachODetails(**slice_iter);
         }
+        
+        delete *slice_iter;
     }
 }
 
@@ -1007,30 +1310,357 @@ static void printMachODetails(MachOFile& machoFile)
     if (machoFile.isUniversal()) {
         parseUniversal(machoFile);
     }
-    else if (machoFile.is64bit())
+    else
     {
         printHeader(machoFile);
         printLoadCommands(machoFile);
         printDynamicLoaderInfo(machoFile);
         printSymbols(machoFile);
+        printIndirectSymbols(machoFile);
     }
-    else if (machoFile.is32bit())
-    {
-        printf("TODO: support 32-bit mach-o format\n\n");
+}
+
+static void usage(const char* progname)
+{
+    fprintf(stderr, "usage: %s [-H] [-a arch|host] [-s address]... [-n symbol]... [-x symbol]... [-V] <file>\n", progname);
+    fprintf(stderr, "       %s -r [-H] [-j threads] [-q max-in-flight] [-P] [-C cache] <directory>\n", progname);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -H  headers only: read just the header and load commands, nothing is mapped\n");
+    fprintf(stderr, "  -a  only parse the slice for arch (e.g. x86_64, arm64) or the host's best match\n");
+    fprintf(stderr, "  -s  print symbol+offset for an address instead of dumping the file, sub_<start>+offset in stripped functions\n");
+    fprintf(stderr, "  -n  print the symtab entry and export called symbol instead of dumping the file\n");
+    fprintf(stderr, "  -x  look symbol up in the export trie in place, without decoding the LINKEDIT\n");
+    fprintf(stderr, "  -V  verify the page hashes of every code directory against the file, on all cpus\n");
+    fprintf(stderr, "  -r  batch mode: scan every file below <directory>, one line per image\n");
+    fprintf(stderr, "  -j  worker threads (default: one per cpu)\n");
+    fprintf(stderr, "  -q  files in flight between the walker and the output (default: 4 per thread)\n");
+    fprintf(stderr, "  -P  do not prefault files in the read stage\n");
+    fprintf(stderr, "  -C  answer unchanged files from the parse cache file and refresh it\n");
+}
+
+static int symbolicate(MachOFile& machoFile, const std::vector<uint64_t>& addresses)
+{
+    if (machoFile.isUniversal()) {
+        fprintf(stderr, "universal file, pick a slice with -a\n");
+        return 1;
     }
+    
+    AddressIndex index;
+    index.build(machoFile);
+    
+    /* Stripped functions have no symbol of their own, name them after their start */
+    FunctionStarts functions;
+    functions.build(machoFile);
+    
+    std::vector<uint64_t>::const_iterator iter;
+    for (iter = addresses.begin(); iter != addresses.end(); iter++) {
+        uint64_t offset;
+        const address_symbol_t* symbol = index.lookup(*iter, &offset);
+        
+        uint64_t start;
+        uint64_t end;
+        bool inFunction = functions.function_containing(*iter, &start, &end);
+        
+        if (inFunction && (symbol == NULL || start > *iter - offset)) {
+            printf("0x%016llx\tsub_%llx + %llu\n", (unsigned long long)*iter, (unsigned long long)start, (unsigned long long)(*iter - start));
+        } else if (symbol == NULL) {
+            printf("0x%016llx\t???\n", (unsigned long long)*iter);
+        } else {
+            printf("0x%016llx\t%s + %llu\n", (unsigned long long)*iter, symbol->name, (unsigned long long)offset);
+        }
+    }
+    
+    return 0;
+}
+
+static int lookupNames(MachOFile& machoFile, const std::vector<const char*>& names)
+{
+    if (machoFile.isUniversal()) {
+        fprintf(stderr, "universal file, pick a slice with -a\n");
+        return 1;
+    }
+    
+    NameIndex index;
+    index.build(machoFile);
+    
+    const SymbolTable& symbols = machoFile.getSymtabCommandInfo().symbols;
+    
+    std::vector<const char*>::const_iterator iter;
+    for (iter = names.begin(); iter != names.end(); iter++) {
+        printf("%s", *iter);
+        
+        size_t symbol;
+        if (index.find_symbol(*iter, &symbol)) {
+            printf("\tsymbol #%zu type=0x%X sect=%u value=0x%llx", symbol, symbols.type(symbol), symbols.sect(symbol), (unsigned long long)symbols.value(symbol));
+        } else {
+            printf("\tno symbol");
+        }
+        
+        const export_action_t* exported = index.find_export(*iter);
+        if (exported != NULL) {
+            printf("\texport flags=0x%llx address=0x%llx\n", (unsigned long long)exported->flags, (unsigned long long)exported->address);
+        } else {
+            printf("\tnot exported\n");
+        }
+    }
+    
+    return 0;
+}
+
+static bool verifySlice(MachOFile& machoFile)
+{
+    CodeSignature signature = machoFile.getCodeSignature();
+    if (signature.empty()) {
+        printf("not signed\n");
+        return false;
+    }
+    
+    if (!signature.init()) {
+        printf("malformed code signature\n");
+        return false;
+    }
+    
+    /* Every directory is checked, a modified image may still match the one the loader ignores */
+    bool valid = true;
+    const code_directories_t& directories = signature.getCodeDirectories();
+    code_directories_t::const_iterator iter;
+    for (iter = directories.begin(); iter != directories.end(); iter++) {
+        printf("%s\t%u pages", getHashTypeString(iter->hashType), iter->nCodeSlots);
+        
+        std::vector<uint32_t> badPages;
+        std::vector<uint32_t> badSlots;
+        if (!machoFile.verify_code_pages(*iter, badPages) || !signature.verify_special_slots(*iter, badSlots)) {
+            printf("\tnot checked\n");
+            valid = false;
+            continue;
+        }
+        
+        if (badPages.empty() && badSlots.empty()) {
+            printf("\tvalid\n");
+            continue;
+        }
+        
+        printf("\tmodified");
+        for (size_t i = 0; i < badPages.size(); i++) {
+            printf(" page %u", badPages[i]);
+        }
+        for (size_t i = 0; i < badSlots.size(); i++) {
+            printf(" slot -%u", badSlots[i]);
+        }
+        printf("\n");
+        valid = false;
+    }
+    
+    return valid;
+}
+
+static int verifyCodeSignature(MachOFile& machoFile)
+{
+    if (!machoFile.isUniversal()) {
+        return verifySlice(machoFile) ? 0 : 2;
+    }
+    
+    /* Each slice has its own signature */
+    macho_files_t slices;
+    machoFile.parse_slices(slices, machoFile.getThreadPool());
+    
+    const fat_arch_infos_t& infos = machoFile.getFatArchInfos();
+    bool valid = true;
+    
+    for (size_t i = 0; i < slices.size(); i++) {
+        const arch_info_t* archInfo = get_arch_info(infos[i].arch.cputype, infos[i].arch.cpusubtype);
+        printf("%s:\n", archInfo != NULL ? archInfo->name : getCPUTypeString(infos[i].arch.cputype));
+        
+        if (slices[i] == NULL) {
+            printf("not parsed\n");
+            valid = false;
+        } else {
+            valid = verifySlice(*slices[i]) && valid;
+        }
+        
+        delete slices[i];
+    }
+    
+    return valid ? 0 : 2;
+}
+
+static bool nameLess(const char* a, const char* b)
+{
+    return strcmp(a, b) < 0;
+}
+
+static int lookupExports(MachOFile& machoFile, const std::vector<const char*>& names)
+{
+    if (machoFile.isUniversal()) {
+        fprintf(stderr, "universal file, pick a slice with -a\n");
+        return 1;
+    }
+    
+    /* One walk for all names, in strcmp order */
+    std::vector<const char*> sorted(names);
+    std::sort(sorted.begin(), sorted.end(), nameLess);
+    
+    std::vector<export_symbol_t> symbols(sorted.size());
+    std::unique_ptr<bool[]> found(new bool[sorted.size()]);
+    machoFile.getExportTrie().lookup_sorted(sorted.data(), sorted.size(), symbols.data(), found.get());
+    
+    uint64_t baseAddress = machoFile.getBaseAddress();
+    
+    std::vector<const char*>::const_iterator iter;
+    for (iter = names.begin(); iter != names.end(); iter++) {
+        size_t i = std::lower_bound(sorted.begin(), sorted.end(), *iter, nameLess) - sorted.begin();
+        
+        const export_symbol_t& symbol = symbols[i];
+        if (!found[i]) {
+            printf("%s\tnot exported\n", *iter);
+        } else if (symbol.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+            printf("%s\tre-export flags=0x%llx dylib=%llu name=%s\n", *iter, (unsigned long long)symbol.flags, (unsigned long long)symbol.other,
+                   symbol.importName[0] != '\0' ? symbol.importName : *iter);
+        } else {
+            printf("%s\texport flags=0x%llx address=0x%llx\n", *iter, (unsigned long long)symbol.flags, (unsigned long long)(baseAddress + symbol.offset));
+        }
+    }
+    
+    return 0;
+}
+
+static int runBatch(int argc, const char * argv[])
+{
+    batch_options_t options;
+    BatchScanner::default_options(&options);
+    
+    const char* root = NULL;
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            options.max_in_flight = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-P") == 0) {
+            options.prefault = false;
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            options.cache_path = argv[++i];
+        } else if (strcmp(argv[i], "-H") == 0) {
+            options.parse_options |= ParseOptionHeadersOnly;
+        } else if (root == NULL) {
+            root = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (root == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    BatchScanner scanner(options);
+    bool success = scanner.scan(root, stdout);
+    scanner.printStats(stderr);
+    
+    return success ? 0 : 2;
 }
 
 int main(int argc, const char * argv[])
 {
-    MachOFile machoFile;
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    if (strcmp(argv[1], "-r") == 0) {
+        return runBatch(argc, argv);
+    }
+    
+    const char* path = NULL;
+    const char* archName = NULL;
+    uint32_t options = ParseOptionNone;
+    std::vector<uint64_t> addresses;
+    std::vector<const char*> names;
+    std::vector<const char*> exportNames;
+    bool verify = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            archName = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            addresses.push_back(strtoull(argv[++i], NULL, 0));
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            names.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            exportNames.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-V") == 0) {
+            verify = true;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            options |= ParseOptionHeadersOnly;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (path == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    /* The trie and the signature are read in place, there is nothing to decode up front */
+    if ((!exportNames.empty() || verify) && addresses.empty() && names.empty()) {
+        options |= ParseOptionLazyLinkedit;
+    }
+    
+    /* Every page is hashed, so the file has to be mapped */
+    if (verify) {
+        options &= ~ParseOptionHeadersOnly;
+    }
+    
+    /* Shared by the slices of a universal file, the decoding of large export tries and page hashing */
+    ThreadPool pool;
+    
+    MachOFile machoFile(options);
+    machoFile.setThreadPool(&pool);
+    bool parsed;
+    
+    if (archName == NULL) {
+        parsed = machoFile.parse_file(path);
+    } else if (strcmp(archName, "host") == 0) {
+        parsed = machoFile.parse_file_arch(path, CPU_TYPE_ANY, CPU_SUBTYPE_MULTIPLE);
+    } else {
+        const arch_info_t* archInfo = get_arch_info_by_name(archName);
+        if (archInfo == NULL) {
+            fprintf(stderr, "unknown architecture %s\n", archName);
+            return 1;
+        }
+        
+        parsed = machoFile.parse_file_arch(path, archInfo->cputype, archInfo->cpusubtype);
+    }
+    
+    if (parsed && !addresses.empty()) {
+        return symbolicate(machoFile, addresses);
+    }
+    
+    if (parsed && !names.empty()) {
+        return lookupNames(machoFile, names);
+    }
+    
+    if (parsed && !exportNames.empty()) {
+        return lookupExports(machoFile, exportNames);
+    }
+    
+    if (parsed && verify) {
+        return verifyCodeSignature(machoFile);
+    }
     
-    if (machoFile.parse_file(argv[1])) {
-        printf("File: %s\n", argv[1]);
+    if (parsed) {
+        printf("File: %s\n", path);
         printMachODetails(machoFile);
     }
     else
     {
-        printf("error parsing %s", argv[1]);
+        printf("error parsing %s", path);
     }
 
     return 0;
@@ -0,0 +1,156 @@
+//
+//  name_index.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include "name_index.h"
+
+namespace rotg {
+
+    static const uint32_t kExportBit = 0x80000000u;
+
+    uint64_t hash_name(const char* name, size_t length)
+    {
+        const uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+        uint64_t hash = length * kMultiplier;
+
+        while (length >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, name, 8);
+            hash = (hash ^ chunk) * kMultiplier;
+            hash ^= hash >> 29;
+            name += 8;
+            length -= 8;
+        }
+
+        if (length > 0) {
+            uint64_t chunk = 0;
+            memcpy(&chunk, name, length);
+            hash = (hash ^ chunk) * kMultiplier;
+        }
+
+        /* final avalanche (murmur3 fmix64) */
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ULL;
+        hash ^= hash >> 33;
+
+        return hash;
+    }
+
+    NameIndex::NameIndex()
+        : m_mask(0)
+        , m_count(0)
+        , m_symbols(NULL)
+        , m_exports(NULL)
+    {
+    }
+
+    void NameIndex::build(const MachOFile& file)
+    {
+        m_symbols = &file.getSymtabCommandInfo().symbols;
+        m_exports = &file.getDyldInfoCommandInfo().loader_info.export_info.actions;
+
+        /* Keep the table at most half full */
+        size_t entries = m_symbols->size() + m_exports->size();
+        size_t capacity = 16;
+        while (capacity < 2 * entries) {
+            capacity *= 2;
+        }
+
+        m_slots.assign(capacity, name_slot_t());
+        m_mask = capacity - 1;
+        m_count = 0;
+
+        /* Symbols in table order, so a probe meets the first of equal names first */
+        const char* strtab = m_symbols->getStringTable();
+        uint32_t strsize = m_symbols->getStringTableSize();
+        for (size_t i = 0; i < m_symbols->size(); i++) {
+            uint32_t strx = m_symbols->strx(i);
+            if ((m_symbols->type(i) & N_STAB) != 0 || strx == 0 || strx >= strsize) {
+                continue;
+            }
+
+            const char* name = strtab + strx;
+            size_t length = strnlen(name, strsize - strx);
+            insert(hash_name(name, length), (uint32_t)i + 1);
+        }
+
+        for (size_t i = 0; i < m_exports->size(); i++) {
+            const char* name = (*m_exports)[i].symbolName;
+            insert(hash_name(name, strlen(name)), ((uint32_t)i + 1) | kExportBit);
+        }
+    }
+
+    void NameIndex::insert(uint64_t hash, uint32_t ref)
+    {
+        size_t slot = (size_t)hash & m_mask;
+        while (m_slots[slot].ref != 0) {
+            slot = (slot + 1) & m_mask;
+        }
+
+        m_slots[slot].tag = (uint32_t)(hash >> 32);
+        m_slots[slot].ref = ref;
+        m_count++;
+    }
+
+    const char* NameIndex::name_of(uint32_t ref) const
+    {
+        uint32_t index = (ref & ~kExportBit) - 1;
+        if (ref & kExportBit) {
+            return (*m_exports)[index].symbolName;
+        }
+
+        return m_symbols->name(index);
+    }
+
+    uint32_t NameIndex::find(const char* name, bool exported) const
+    {
+        if (m_slots.empty()) {
+            return 0;
+        }
+
+        uint64_t hash = hash_name(name, strlen(name));
+        uint32_t tag = (uint32_t)(hash >> 32);
+        uint32_t kind = exported ? kExportBit : 0;
+
+        size_t slot = (size_t)hash & m_mask;
+        while (m_slots[slot].ref != 0) {
+            const name_slot_t& entry = m_slots[slot];
+            if (entry.tag == tag && (entry.ref & kExportBit) == kind && strcmp(name_of(entry.ref), name) == 0) {
+                return entry.ref;
+            }
+            slot = (slot + 1) & m_mask;
+        }
+
+        return 0;
+    }
+
+    bool NameIndex::find_symbol(const char* name, size_t* index) const
+    {
+        uint32_t ref = find(name, false);
+        if (ref == 0) {
+            return false;
+        }
+
+        if (index != NULL) {
+            *index = ref - 1;
+        }
+
+        return true;
+    }
+
+    const export_action_t* NameIndex::find_export(const char* name) const
+    {
+        uint32_t ref = find(name, true);
+        if (ref == 0) {
+            return NULL;
+        }
+
+        return &(*m_exports)[(ref & ~kExportBit) - 1];
+    }
+
+}
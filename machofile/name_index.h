@@ -0,0 +1,64 @@
+//
+//  name_index.h
+//  machofile
+//
+//  Symbol name to symtab entry / export lookup. An open addressing table
+//  (linear probing, power of two size, at most half full) of small slots
+//  that refer back to the file, so names are never copied.
+//
+
+#ifndef rotg_name_index_h
+#define rotg_name_index_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "machofile.h"
+
+namespace rotg {
+
+    // Fast non-cryptographic hash, 8 bytes per step
+    uint64_t hash_name(const char* name, size_t length);
+
+    class NameIndex
+    {
+    public:
+        NameIndex();
+
+        // Index the symtab names (except stabs) and the export names of file,
+        // which must stay alive and unchanged while the index is used
+        void build(const MachOFile& file);
+
+        // First symtab entry called name, false if there is none
+        bool find_symbol(const char* name, size_t* index) const;
+
+        // Export called name, NULL if there is none
+        const export_action_t* find_export(const char* name) const;
+
+        size_t size() const {
+            return m_count;
+        }
+
+    private:
+        typedef struct name_slot {
+            uint32_t    tag;    // high half of the hash, checked before any strcmp
+            uint32_t    ref;    // 0 = empty, else entry index + 1 with kExportBit for exports
+        } name_slot_t;
+
+        void insert(uint64_t hash, uint32_t ref);
+        const char* name_of(uint32_t ref) const;
+        uint32_t find(const char* name, bool exported) const;
+
+        std::vector<name_slot_t>    m_slots;
+        size_t                      m_mask;
+        size_t                      m_count;
+
+        const SymbolTable*          m_symbols;
+        const export_actions_t*     m_exports;
+    };
+
+}
+
+#endif
@@ -0,0 +1,723 @@
+//
+//  parse_cache.cpp
+//  machofile
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "parse_cache.h"
+#include "bind_table.h"
+#include "byte_span.h"
+#include "name_index.h"
+
+namespace rotg {
+
+    /* Entries, their tables and the index are 8 byte aligned */
+    static const size_t kParseCacheAlignment = 8;
+
+    static inline uint64_t mix64(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    /* Builds one entry: the header, the image array, the tables of each image, then the string pool */
+    class EntryEncoder
+    {
+    public:
+        explicit EntryEncoder(std::string& out)
+            : m_out(out)
+        {
+        }
+
+        /* Append zeroed room for count records of size bytes, returns its offset */
+        size_t reserve(size_t count, size_t size)
+        {
+            size_t offset = m_out.size();
+            size_t length = count * size;
+            length = (length + kParseCacheAlignment - 1) & ~(kParseCacheAlignment - 1);
+            m_out.append(length, '\0');
+            return offset;
+        }
+
+        /* The buffer moves as it grows, so records are copied in rather than written through pointers */
+        template <typename T>
+        void put(size_t offset, size_t index, const T& record)
+        {
+            memcpy(&m_out[offset + index * sizeof(T)], &record, sizeof(T));
+        }
+
+        /* A symbol is named again by its binds and exports, so each name is stored once per entry */
+        uint32_t intern(const char* string)
+        {
+            if (string == NULL) {
+                string = "";
+            }
+
+            /* Keep the index at most half full */
+            if (2 * (m_offsets.size() + 1) > m_index.size()) {
+                grow_index();
+            }
+
+            size_t length = strlen(string);
+            size_t mask = m_index.size() - 1;
+            size_t slot = (size_t)hash_name(string, length) & mask;
+
+            while (m_index[slot] != 0) {
+                uint32_t offset = m_offsets[m_index[slot] - 1];
+                if (strcmp(&m_strings[offset], string) == 0) {
+                    return offset;
+                }
+                slot = (slot + 1) & mask;
+            }
+
+            uint32_t offset = (uint32_t)m_strings.size();
+            m_strings.append(string, length + 1);
+            m_offsets.push_back(offset);
+            m_index[slot] = (uint32_t)m_offsets.size();
+
+            return offset;
+        }
+
+        const std::string& strings() const {
+            return m_strings;
+        }
+
+    private:
+        void grow_index()
+        {
+            size_t capacity = m_index.empty() ? 256 : 2 * m_index.size();
+            m_index.assign(capacity, 0);
+
+            size_t mask = capacity - 1;
+            for (size_t i = 0; i < m_offsets.size(); i++) {
+                const char* string = &m_strings[m_offsets[i]];
+                size_t slot = (size_t)hash_name(string, strlen(string)) & mask;
+                while (m_index[slot] != 0) {
+                    slot = (slot + 1) & mask;
+                }
+                m_index[slot] = (uint32_t)i + 1;
+            }
+        }
+
+        std::string&            m_out;
+        std::string             m_strings;
+        std::vector<uint32_t>   m_offsets;  // of each distinct string in m_strings
+        std::vector<uint32_t>   m_index;    // m_offsets index + 1 by hash, 0 = empty
+    };
+
+    static parse_cache_ref_t make_ref(size_t offset, size_t count)
+    {
+        parse_cache_ref_t ref;
+        ref.offset = (uint32_t)offset;
+        ref.count = (uint32_t)count;
+        return ref;
+    }
+
+    static void encode_sections(EntryEncoder& encoder, const MachOFile& file, parse_cache_image_t* image)
+    {
+        const section_64s_t& section64s = file.getSection64s();
+        const sections_t& sections = file.getSections();
+        size_t count = file.is64bit() ? section64s.size() : sections.size();
+        size_t offset = encoder.reserve(count, sizeof(parse_cache_section_t));
+
+        for (size_t i = 0; i < count; i++) {
+            parse_cache_section_t record;
+            memset(&record, 0, sizeof(record));
+
+            if (file.is64bit()) {
+                const struct section_64* section = section64s[i];
+                memcpy(record.sectname, section->sectname, sizeof(record.sectname));
+                memcpy(record.segname, section->segname, sizeof(record.segname));
+                record.addr = file.read64(section->addr);
+                record.size = file.read64(section->size);
+                record.offset = file.read32(section->offset);
+                record.align = file.read32(section->align);
+                record.reloff = file.read32(section->reloff);
+                record.nreloc = file.read32(section->nreloc);
+                record.flags = file.read32(section->flags);
+                record.reserved1 = file.read32(section->reserved1);
+                record.reserved2 = file.read32(section->reserved2);
+                record.reserved3 = file.read32(section->reserved3);
+            } else {
+                const struct section* section = sections[i];
+                memcpy(record.sectname, section->sectname, sizeof(record.sectname));
+                memcpy(record.segname, section->segname, sizeof(record.segname));
+                record.addr = file.read32(section->addr);
+                record.size = file.read32(section->size);
+                record.offset = file.read32(section->offset);
+                record.align = file.read32(section->align);
+                record.reloff = file.read32(section->reloff);
+                record.nreloc = file.read32(section->nreloc);
+                record.flags = file.read32(section->flags);
+                record.reserved1 = file.read32(section->reserved1);
+                record.reserved2 = file.read32(section->reserved2);
+            }
+
+            encoder.put(offset, i, record);
+        }
+
+        image->sections = make_ref(offset, count);
+    }
+
+    static bool encode_binds(EntryEncoder& encoder, const MachOFile& file, parse_cache_image_t* image)
+    {
+        const BindNodeType nodeTypes[] = { NodeTypeBind, NodeTypeWeakBind, NodeTypeLazyBind };
+        const size_t count = sizeof(nodeTypes) / sizeof(nodeTypes[0]);
+
+        /* Decode each stream straight into runs, then lay the three out one after the other */
+        BindTable tables[count];
+        size_t runs = 0;
+        size_t targets = 0;
+        image->bind_count = 0;
+
+        for (size_t s = 0; s < count; s++) {
+            if (!tables[s].build(file, nodeTypes[s])) {
+                return false;
+            }
+
+            runs += tables[s].getRecords().size();
+            targets += tables[s].getTargets().size();
+            image->bind_count += tables[s].getBindCount();
+        }
+
+        size_t runsOffset = encoder.reserve(runs, sizeof(parse_cache_bind_run_t));
+        size_t targetsOffset = encoder.reserve(targets, sizeof(parse_cache_bind_target_t));
+        size_t runIndex = 0;
+        size_t targetBase = 0;
+
+        for (size_t s = 0; s < count; s++) {
+            const std::vector<bind_record_t>& records = tables[s].getRecords();
+            for (size_t i = 0; i < records.size(); i++) {
+                parse_cache_bind_run_t run;
+                memset(&run, 0, sizeof(run));
+                run.address = records[i].address;
+                run.target = (uint32_t)(targetBase + records[i].target);
+                run.count = records[i].count;
+                run.stride = records[i].stride;
+                run.type = records[i].type;
+                run.flags = records[i].flags;
+                run.nodeType = (uint8_t)nodeTypes[s];
+                encoder.put(runsOffset, runIndex++, run);
+            }
+
+            const std::vector<bind_target_t>& bindTargets = tables[s].getTargets();
+            for (size_t i = 0; i < bindTargets.size(); i++) {
+                parse_cache_bind_target_t target;
+                target.name = encoder.intern(tables[s].name(bindTargets[i]));
+                target.libOrdinal = bindTargets[i].libOrdinal;
+                target.addend = bindTargets[i].addend;
+                encoder.put(targetsOffset, targetBase + i, target);
+            }
+            targetBase += bindTargets.size();
+        }
+
+        image->bind_runs = make_ref(runsOffset, runs);
+        image->bind_targets = make_ref(targetsOffset, targets);
+        return true;
+    }
+
+    static bool encode_image(EntryEncoder& encoder, const MachOFile& file, size_t imageOffset)
+    {
+        parse_cache_image_t image;
+        memset(&image, 0, sizeof(image));
+
+        const struct mach_header* header = file.getHeader();
+        image.cputype = file.read32(header->cputype);
+        image.cpusubtype = file.read32(header->cpusubtype);
+        image.filetype = file.read32(header->filetype);
+        image.ncmds = file.read32(header->ncmds);
+        image.flags = file.read32(header->flags);
+        image.is64 = file.is64bit();
+
+        const version_min_info_t& version = file.getVersionMinInfo();
+        image.version_cmd = version.cmd_type;
+        image.platform = version.platform;
+        image.minos = version.minos;
+        image.sdk = version.sdk;
+        image.cryptid = file.getEncryptionInfo().cryptid;
+
+        if (file.getUUID() != NULL) {
+            image.has_uuid = 1;
+            memcpy(image.uuid, file.getUUID(), sizeof(image.uuid));
+        }
+
+        /* Segments */
+        const segment_infos_t& segments = file.getSegmentInfos();
+        size_t offset = encoder.reserve(segments.size(), sizeof(parse_cache_segment_t));
+        for (size_t i = 0; i < segments.size(); i++) {
+            const segment_info_t& segment = segments[i];
+            parse_cache_segment_t record;
+            memset(&record, 0, sizeof(record));
+            memcpy(record.segname, segment.segname, sizeof(record.segname));
+            record.vmaddr = segment.vmaddr;
+            record.vmsize = segment.vmsize;
+            record.fileoff = segment.fileoff;
+            record.filesize = segment.filesize;
+            record.maxprot = segment.maxprot;
+            record.initprot = segment.initprot;
+            record.nsects = segment.nsects;
+            record.flags = segment.flags;
+            encoder.put(offset, i, record);
+        }
+        image.segments = make_ref(offset, segments.size());
+
+        encode_sections(encoder, file, &image);
+
+        /* Dylibs and run paths */
+        const dylib_command_infos_t& dylibs = file.getDylibCommandInfos();
+        offset = encoder.reserve(dylibs.size(), sizeof(parse_cache_dylib_t));
+        for (size_t i = 0; i < dylibs.size(); i++) {
+            const dylib_command_info_t* info = dylibs[i];
+            parse_cache_dylib_t record;
+            record.cmd_type = info->cmd_type;
+            record.name = encoder.intern(info->libname);
+            record.timestamp = file.read32(info->cmd->dylib.timestamp);
+            record.current_version = file.read32(info->cmd->dylib.current_version);
+            record.compatibility_version = file.read32(info->cmd->dylib.compatibility_version);
+            encoder.put(offset, i, record);
+        }
+        image.dylibs = make_ref(offset, dylibs.size());
+
+        const runpath_additions_infos_t& rpaths = file.getRunpathAdditionsInfos();
+        offset = encoder.reserve(rpaths.size(), sizeof(parse_cache_rpath_t));
+        for (size_t i = 0; i < rpaths.size(); i++) {
+            parse_cache_rpath_t record;
+            record.path = encoder.intern(rpaths[i].path);
+            encoder.put(offset, i, record);
+        }
+        image.rpaths = make_ref(offset, rpaths.size());
+
+        /* Symbols, binds and exports, none of which a headers-only parse has */
+        const SymbolTable& symbols = file.getSymtabCommandInfo().symbols;
+        offset = encoder.reserve(symbols.size(), sizeof(parse_cache_symbol_t));
+        for (size_t i = 0; i < symbols.size(); i++) {
+            parse_cache_symbol_t record;
+            record.value = symbols.value(i);
+            record.name = encoder.intern(symbols.name(i));
+            record.type = symbols.type(i);
+            record.sect = symbols.sect(i);
+            record.desc = symbols.desc(i);
+            encoder.put(offset, i, record);
+        }
+        image.symbols = make_ref(offset, symbols.size());
+
+        if ((file.getParseOptions() & ParseOptionHeadersOnly) == 0 && !encode_binds(encoder, file, &image)) {
+            return false;
+        }
+
+        const dynamic_loader_info_t& loader_info = file.getDyldInfoCommandInfo().loader_info;
+
+        const export_actions_t& exports = loader_info.export_info.actions;
+        offset = encoder.reserve(exports.size(), sizeof(parse_cache_export_t));
+        for (size_t i = 0; i < exports.size(); i++) {
+            parse_cache_export_t record;
+            memset(&record, 0, sizeof(record));
+            record.address = exports[i].address;
+            record.offset = exports[i].offset;
+            record.flags = exports[i].flags;
+            record.name = encoder.intern(exports[i].symbolName);
+            encoder.put(offset, i, record);
+        }
+        image.exports = make_ref(offset, exports.size());
+
+        encoder.put(imageOffset, 0, image);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    ParseCache::ParseCache()
+        : m_data(NULL)
+        , m_size(0)
+        , m_header(NULL)
+        , m_buckets(NULL)
+    {
+    }
+
+    ParseCache::~ParseCache()
+    {
+        close();
+    }
+
+    bool ParseCache::open(const char* path)
+    {
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat stbuf;
+        if (fstat(fd, &stbuf) != 0 || (uint64_t)stbuf.st_size < sizeof(parse_cache_header_t)) {
+            ::close(fd);
+            return false;
+        }
+
+        size_t size = (size_t)stbuf.st_size;
+        void* data = mmap(NULL, size, PROT_READ, MAP_FILE|MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        m_data = (const uint8_t*)data;
+        m_size = size;
+
+        const parse_cache_header_t* header = (const parse_cache_header_t*)m_data;
+        uint32_t buckets = header->bucket_count;
+        if (header->magic != kParseCacheMagic || header->version != kParseCacheVersion || header->file_size != m_size ||
+            buckets == 0 || (buckets & (buckets - 1)) != 0 || header->index_offset % kParseCacheAlignment != 0 ||
+            header->index_offset < sizeof(parse_cache_header_t) ||
+            !ByteSpan(m_data, m_size).contains(header->index_offset, (uint64_t)buckets * sizeof(uint64_t))) {
+            close();
+            return false;
+        }
+
+        m_header = header;
+        m_buckets = (const uint64_t*)(m_data + header->index_offset);
+        return true;
+    }
+
+    void ParseCache::close()
+    {
+        if (m_data != NULL) {
+            munmap((void*)m_data, m_size);
+        }
+
+        m_data = NULL;
+        m_size = 0;
+        m_header = NULL;
+        m_buckets = NULL;
+    }
+
+    const parse_cache_entry_t* ParseCache::find(const parse_cache_key_t& key, uint32_t parseOptions) const
+    {
+        if (m_header == NULL) {
+            return NULL;
+        }
+
+        uint32_t mask = m_header->bucket_count - 1;
+        uint64_t hash = hash_key(key);
+
+        for (uint32_t probe = 0; probe <= mask; probe++) {
+            uint64_t offset = m_buckets[(hash + probe) & mask];
+            if (offset == 0) {
+                return NULL;
+            }
+
+            /* A damaged index misses rather than reads outside of the entries */
+            if (offset % kParseCacheAlignment != 0 || offset < sizeof(parse_cache_header_t) ||
+                !ByteSpan(m_data, m_header->index_offset).contains(offset, sizeof(parse_cache_entry_t))) {
+                return NULL;
+            }
+
+            const parse_cache_entry_t* entry = (const parse_cache_entry_t*)(m_data + offset);
+            if (!same_key(entry->key, key)) {
+                continue;
+            }
+
+            if ((entry->parse_options & ParseOptionHeadersOnly) != (parseOptions & ParseOptionHeadersOnly) ||
+                entry->size > m_header->index_offset - offset || !check_entry(entry)) {
+                return NULL;
+            }
+
+            return entry;
+        }
+
+        return NULL;
+    }
+
+    static bool ref_inside(const ByteSpan& span, const parse_cache_ref_t& ref, size_t size)
+    {
+        return ref.offset % kParseCacheAlignment == 0 && span.contains(ref.offset, (uint64_t)ref.count * size);
+    }
+
+    bool ParseCache::check_entry(const parse_cache_entry_t* entry) const
+    {
+        if (entry->size < sizeof(parse_cache_entry_t) || entry->size % kParseCacheAlignment != 0) {
+            return false;
+        }
+
+        ByteSpan span(entry, entry->size);
+
+        /* Every name offset below the pool size has to end inside the pool */
+        if (!ref_inside(span, entry->strings, 1) ||
+            (entry->strings.count != 0 && span.data()[entry->strings.offset + entry->strings.count - 1] != '\0')) {
+            return false;
+        }
+
+        if (!ref_inside(span, entry->images, sizeof(parse_cache_image_t))) {
+            return false;
+        }
+
+        const parse_cache_image_t* images = ParseCache::images(entry);
+        for (uint32_t i = 0; i < entry->images.count; i++) {
+            const parse_cache_image_t& image = images[i];
+            if (!ref_inside(span, image.segments, sizeof(parse_cache_segment_t)) ||
+                !ref_inside(span, image.sections, sizeof(parse_cache_section_t)) ||
+                !ref_inside(span, image.dylibs, sizeof(parse_cache_dylib_t)) ||
+                !ref_inside(span, image.rpaths, sizeof(parse_cache_rpath_t)) ||
+                !ref_inside(span, image.symbols, sizeof(parse_cache_symbol_t)) ||
+                !ref_inside(span, image.bind_runs, sizeof(parse_cache_bind_run_t)) ||
+                !ref_inside(span, image.bind_targets, sizeof(parse_cache_bind_target_t)) ||
+                !ref_inside(span, image.exports, sizeof(parse_cache_export_t))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void ParseCache::make_key(const struct stat& stbuf, parse_cache_key_t* key)
+    {
+        memset(key, 0, sizeof(*key));
+        key->dev = (uint64_t)stbuf.st_dev;
+        key->ino = (uint64_t)stbuf.st_ino;
+        key->size = (uint64_t)stbuf.st_size;
+        key->mtime_sec = (int64_t)stbuf.st_mtime;
+#if defined(__APPLE__)
+        key->mtime_nsec = (int64_t)stbuf.st_mtimespec.tv_nsec;
+#else
+        key->mtime_nsec = (int64_t)stbuf.st_mtim.tv_nsec;
+#endif
+    }
+
+    uint64_t ParseCache::hash_key(const parse_cache_key_t& key)
+    {
+        uint64_t hash = mix64(key.dev ^ 0x9E3779B97F4A7C15ULL);
+        hash = mix64(hash ^ key.ino);
+        hash = mix64(hash ^ key.size);
+        hash = mix64(hash ^ (uint64_t)key.mtime_sec);
+        return mix64(hash ^ (uint64_t)key.mtime_nsec);
+    }
+
+    bool ParseCache::same_key(const parse_cache_key_t& a, const parse_cache_key_t& b)
+    {
+        return a.dev == b.dev && a.ino == b.ino && a.size == b.size && a.mtime_sec == b.mtime_sec && a.mtime_nsec == b.mtime_nsec;
+    }
+
+    bool ParseCache::encode(const parse_cache_key_t& key, const MachOFile& file, const macho_files_t& slices, std::string& entry)
+    {
+        entry.clear();
+        EntryEncoder encoder(entry);
+
+        size_t headerOffset = encoder.reserve(1, sizeof(parse_cache_entry_t));
+
+        /* A universal file is its slices, a thin one itself */
+        size_t count = file.isUniversal() ? slices.size() : 1;
+        size_t imagesOffset = encoder.reserve(count, sizeof(parse_cache_image_t));
+
+        for (size_t i = 0; i < count; i++) {
+            const MachOFile& image = file.isUniversal() ? *slices[i] : file;
+            if (!encode_image(encoder, image, imagesOffset + i * sizeof(parse_cache_image_t))) {
+                entry.clear();
+                return false;
+            }
+        }
+
+        size_t stringsOffset = encoder.reserve(encoder.strings().size(), 1);
+        entry.replace(stringsOffset, encoder.strings().size(), encoder.strings());
+
+        if (entry.size() > UINT32_MAX) {
+            entry.clear();
+            return false;
+        }
+
+        parse_cache_entry_t header;
+        memset(&header, 0, sizeof(header));
+        header.size = (uint32_t)entry.size();
+        header.status = ParseCacheImage;
+        header.parse_options = file.getParseOptions() & ParseOptionHeadersOnly;
+        header.key = key;
+        header.images = make_ref(imagesOffset, count);
+        header.strings = make_ref(stringsOffset, encoder.strings().size());
+        encoder.put(headerOffset, 0, header);
+
+        return true;
+    }
+
+    void ParseCache::encode_status(const parse_cache_key_t& key, ParseCacheStatus status, uint32_t parseOptions, std::string& entry)
+    {
+        parse_cache_entry_t header;
+        memset(&header, 0, sizeof(header));
+        header.size = sizeof(header);
+        header.status = status;
+        header.parse_options = parseOptions & ParseOptionHeadersOnly;
+        header.key = key;
+        header.images = make_ref(sizeof(header), 0);
+        header.strings = make_ref(sizeof(header), 0);
+
+        entry.assign((const char*)&header, sizeof(header));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+
+    ParseCacheWriter::ParseCacheWriter(const char* path, const ParseCache& previous)
+        : m_path(path)
+        , m_previous(previous)
+        , m_file(NULL)
+        , m_failed(false)
+        , m_offset(0)
+    {
+    }
+
+    ParseCacheWriter::~ParseCacheWriter()
+    {
+        /* Not finished, drop the partial file */
+        if (m_file != NULL) {
+            fclose(m_file);
+            unlink(m_temp_path.c_str());
+        }
+    }
+
+    bool ParseCacheWriter::add(const parse_cache_entry_t* entry)
+    {
+        if (m_file == NULL) {
+            m_pending.push_back(entry);
+            return !m_failed;
+        }
+
+        m_offsets.push_back(m_offset);
+        m_hashes.push_back(ParseCache::hash_key(entry->key));
+        return write(entry, entry->size);
+    }
+
+    bool ParseCacheWriter::add(const std::string& entry)
+    {
+        if (entry.size() < sizeof(parse_cache_entry_t) || !start()) {
+            return false;
+        }
+
+        /* The string's buffer need not be aligned for the header */
+        parse_cache_entry_t header;
+        memcpy(&header, entry.data(), sizeof(header));
+
+        m_offsets.push_back(m_offset);
+        m_hashes.push_back(ParseCache::hash_key(header.key));
+        return write(entry.data(), entry.size());
+    }
+
+    bool ParseCacheWriter::start()
+    {
+        if (m_file != NULL || m_failed) {
+            return !m_failed;
+        }
+
+        /* Unique next to the cache, so the rename is atomic and concurrent scans do not collide */
+        std::string temp = m_path + ".XXXXXX";
+        int fd = mkstemp(&temp[0]);
+        if (fd < 0) {
+            m_failed = true;
+            return false;
+        }
+
+        /* mkstemp() makes it private, keep the mode of the cache being replaced */
+        struct stat stbuf;
+        if (stat(m_path.c_str(), &stbuf) == 0) {
+            fchmod(fd, stbuf.st_mode & 0777);
+        }
+
+        m_file = fdopen(fd, "wb");
+        if (m_file == NULL) {
+            close(fd);
+            unlink(temp.c_str());
+            m_failed = true;
+            return false;
+        }
+        m_temp_path = temp;
+
+        /* The header is written last, once the index is known */
+        parse_cache_header_t header;
+        memset(&header, 0, sizeof(header));
+        write(&header, sizeof(header));
+
+        std::vector<const parse_cache_entry_t*> pending;
+        pending.swap(m_pending);
+
+        std::vector<const parse_cache_entry_t*>::const_iterator iter;
+        for (iter = pending.begin(); iter != pending.end(); iter++) {
+            add(*iter);
+        }
+
+        return !m_failed;
+    }
+
+    bool ParseCacheWriter::write(const void* data, size_t size)
+    {
+        if (!m_failed && fwrite(data, 1, size, m_file) != size) {
+            m_failed = true;
+        }
+
+        m_offset += size;
+        return !m_failed;
+    }
+
+    bool ParseCacheWriter::finish()
+    {
+        /* Nothing new and nothing dropped, the cache on disk is still exact */
+        if (m_file == NULL && !m_failed && m_previous.size() == m_pending.size()) {
+            m_pending.clear();
+            return true;
+        }
+
+        if (!start()) {
+            return false;
+        }
+
+        /* Open addressing, at most half full */
+        uint32_t buckets = 8;
+        while (buckets < 2 * m_offsets.size()) {
+            buckets *= 2;
+        }
+
+        std::vector<uint64_t> index(buckets, 0);
+        uint32_t mask = buckets - 1;
+        for (size_t i = 0; i < m_offsets.size(); i++) {
+            uint64_t slot = m_hashes[i] & mask;
+            while (index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            index[slot] = m_offsets[i];
+        }
+
+        parse_cache_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.magic = kParseCacheMagic;
+        header.version = kParseCacheVersion;
+        header.entry_count = (uint32_t)m_offsets.size();
+        header.index_offset = m_offset;
+        header.bucket_count = buckets;
+
+        write(&index[0], index.size() * sizeof(uint64_t));
+        header.file_size = m_offset;
+
+        if (!m_failed && (fseek(m_file, 0, SEEK_SET) != 0 || fwrite(&header, 1, sizeof(header), m_file) != sizeof(header))) {
+            m_failed = true;
+        }
+
+        if (fclose(m_file) != 0) {
+            m_failed = true;
+        }
+        m_file = NULL;
+
+        if (m_failed || rename(m_temp_path.c_str(), m_path.c_str()) != 0) {
+            unlink(m_temp_path.c_str());
+            m_failed = true;
+            return false;
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,294 @@
+//
+//  parse_cache.h
+//  machofile
+//
+//  Persistent cache of parse results, so a rescan of a tree that barely
+//  changed does not parse it again. One file holds an entry per scanned
+//  file, keyed by (device, inode, size, mtime), with what MachOFile
+//  decoded from each image: header fields, segments, sections, dylibs,
+//  run paths, symbols, binds (as BindTable runs) and exports, in host
+//  byte order.
+//
+//  Every offset in an entry is from the start of that entry, so entries
+//  are copied between cache files as they are, and a cache is used by
+//  mapping it: find() hashes the key into the index at the end of the
+//  file and returns the entry in place, with nothing deserialized.
+//
+//  Layout: parse_cache_header_t, the entries (8 byte aligned), then
+//  bucket_count uint64_t entry offsets, 0 for an empty bucket. The magic
+//  is stored in host byte order, so a cache from a host of the other byte
+//  order is rejected, as is one of another version.
+//
+
+#ifndef rotg_parse_cache_h
+#define rotg_parse_cache_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "machofile.h"
+
+namespace rotg {
+
+    static const uint64_t kParseCacheMagic = 0x4548434143504F4DULL;   // "MOPCACHE" on a little endian host
+    static const uint32_t kParseCacheVersion = 1;
+
+    // What became of the file an entry was made from
+    enum ParseCacheStatus {
+        ParseCacheImage     = 0,    // parsed, one parse_cache_image_t per image (per slice for universal files)
+        ParseCacheNotMachO  = 1,    // no Mach-O magic, skipped by the scan
+        ParseCacheMalformed = 2     // the parse failed
+    };
+
+    // Identity of a file from one stat(), the entry is stale when any of it changes
+    typedef struct parse_cache_key {
+        uint64_t    dev;
+        uint64_t    ino;
+        uint64_t    size;
+        int64_t     mtime_sec;
+        int64_t     mtime_nsec;
+    } parse_cache_key_t;
+
+    // count records at offset bytes from the start of the entry
+    typedef struct parse_cache_ref {
+        uint32_t    offset;
+        uint32_t    count;
+    } parse_cache_ref_t;
+
+    typedef struct parse_cache_header {
+        uint64_t    magic;          // kParseCacheMagic
+        uint32_t    version;        // kParseCacheVersion
+        uint32_t    entry_count;
+        uint64_t    file_size;
+        uint64_t    index_offset;
+        uint32_t    bucket_count;   // a power of two
+        uint32_t    reserved;
+    } parse_cache_header_t;
+
+    typedef struct parse_cache_entry {
+        uint32_t            size;           // bytes, this header included, a multiple of 8
+        uint32_t            status;         // ParseCacheStatus
+        uint32_t            parse_options;  // ParseOptionHeadersOnly if nothing below the load commands was read
+        uint32_t            reserved;
+        parse_cache_key_t   key;
+        parse_cache_ref_t   images;         // parse_cache_image_t
+        parse_cache_ref_t   strings;        // bytes of the string pool the name fields index, NUL terminated
+    } parse_cache_entry_t;
+
+    typedef struct parse_cache_image {
+        uint32_t            cputype;
+        uint32_t            cpusubtype;
+        uint32_t            filetype;
+        uint32_t            ncmds;
+        uint32_t            flags;
+        uint32_t            is64;
+        uint32_t            version_cmd;    // LC_VERSION_MIN_* or LC_BUILD_VERSION, 0 if absent
+        uint32_t            platform;
+        uint32_t            minos;
+        uint32_t            sdk;
+        uint32_t            cryptid;
+        uint32_t            has_uuid;
+        uint8_t             uuid[16];
+        uint64_t            bind_count;     // binds of all three streams, with every run expanded
+        parse_cache_ref_t   segments;       // parse_cache_segment_t
+        parse_cache_ref_t   sections;       // parse_cache_section_t
+        parse_cache_ref_t   dylibs;         // parse_cache_dylib_t
+        parse_cache_ref_t   rpaths;         // parse_cache_rpath_t
+        parse_cache_ref_t   symbols;        // parse_cache_symbol_t, empty in a headers-only entry
+        parse_cache_ref_t   bind_runs;      // parse_cache_bind_run_t, bind then weak then lazy stream
+        parse_cache_ref_t   bind_targets;   // parse_cache_bind_target_t
+        parse_cache_ref_t   exports;        // parse_cache_export_t
+    } parse_cache_image_t;
+
+    typedef struct parse_cache_segment {
+        char        segname[16];    // not NUL terminated when all are used
+        uint64_t    vmaddr;
+        uint64_t    vmsize;
+        uint64_t    fileoff;
+        uint64_t    filesize;
+        uint32_t    maxprot;
+        uint32_t    initprot;
+        uint32_t    nsects;
+        uint32_t    flags;
+    } parse_cache_segment_t;
+
+    typedef struct parse_cache_section {
+        char        sectname[16];
+        char        segname[16];
+        uint64_t    addr;
+        uint64_t    size;
+        uint32_t    offset;
+        uint32_t    align;
+        uint32_t    reloff;
+        uint32_t    nreloc;
+        uint32_t    flags;
+        uint32_t    reserved1;
+        uint32_t    reserved2;
+        uint32_t    reserved3;
+    } parse_cache_section_t;
+
+    typedef struct parse_cache_dylib {
+        uint32_t    cmd_type;       // LC_ID_DYLIB, LC_LOAD_DYLIB, ...
+        uint32_t    name;           // offset into the string pool
+        uint32_t    timestamp;
+        uint32_t    current_version;
+        uint32_t    compatibility_version;
+    } parse_cache_dylib_t;
+
+    typedef struct parse_cache_rpath {
+        uint32_t    path;
+    } parse_cache_rpath_t;
+
+    typedef struct parse_cache_symbol {
+        uint64_t    value;
+        uint32_t    name;
+        uint8_t     type;
+        uint8_t     sect;
+        uint16_t    desc;
+    } parse_cache_symbol_t;
+
+    // Binds are kept the way BindTable (bind_table.h) keeps them: a run of binds of
+    // one target at a fixed stride is one record
+    typedef struct parse_cache_bind_run {
+        uint64_t    address;        // of the first bind
+        uint32_t    target;         // index into bind_targets
+        uint32_t    count;          // binds in the run
+        uint32_t    stride;         // bytes from one bind to the next, 0 for a single bind
+        uint8_t     type;           // BIND_TYPE_*
+        uint8_t     flags;          // BIND_SYMBOL_FLAGS_*
+        uint8_t     nodeType;       // BindNodeType of the stream
+        uint8_t     reserved;
+    } parse_cache_bind_run_t;
+
+    typedef struct parse_cache_bind_target {
+        uint32_t    name;
+        int32_t     libOrdinal;     // negative for the BIND_SPECIAL_DYLIB_* ordinals
+        int64_t     addend;
+    } parse_cache_bind_target_t;
+
+    typedef struct parse_cache_export {
+        uint64_t    address;
+        uint64_t    offset;
+        uint64_t    flags;
+        uint32_t    name;
+        uint32_t    reserved;
+    } parse_cache_export_t;
+
+    class ParseCache
+    {
+    public:
+        ParseCache();
+        ~ParseCache();
+
+        // Map the cache at path. False if there is none or it is unusable (other
+        // version or byte order, truncated), which leaves the cache empty.
+        bool open(const char* path);
+        void close();
+
+        bool empty() const {
+            return m_header == NULL || m_header->entry_count == 0;
+        }
+
+        size_t size() const {
+            return m_header != NULL ? m_header->entry_count : 0;
+        }
+
+        // The entry for key made with the same headers-only setting as parseOptions, NULL
+        // if there is none. Its tables are checked to lie inside it, so they can be read
+        // directly with table() and string(); the records themselves are not looked at,
+        // so check a run's target against bind_targets.count before following it.
+        const parse_cache_entry_t* find(const parse_cache_key_t& key, uint32_t parseOptions) const;
+
+        static void make_key(const struct stat& stbuf, parse_cache_key_t* key);
+
+        static uint64_t hash_key(const parse_cache_key_t& key);
+
+        static bool same_key(const parse_cache_key_t& a, const parse_cache_key_t& b);
+
+        template <typename T>
+        static const T* table(const parse_cache_entry_t* entry, const parse_cache_ref_t& ref) {
+            return (const T*)((const uint8_t*)entry + ref.offset);
+        }
+
+        static const parse_cache_image_t* images(const parse_cache_entry_t* entry) {
+            return table<parse_cache_image_t>(entry, entry->images);
+        }
+
+        // "" for an offset outside of the pool
+        static const char* string(const parse_cache_entry_t* entry, uint32_t offset) {
+            return offset < entry->strings.count ? (const char*)entry + entry->strings.offset + offset : "";
+        }
+
+        // Serialize the parse of file into entry: the file itself, or each of slices
+        // when it is universal. False if it does not fit the format's 32-bit offsets
+        // or a bind stream does not decode.
+        static bool encode(const parse_cache_key_t& key, const MachOFile& file, const macho_files_t& slices, std::string& entry);
+
+        // An entry with no images, for files that are not Mach-O or did not parse
+        static void encode_status(const parse_cache_key_t& key, ParseCacheStatus status, uint32_t parseOptions, std::string& entry);
+
+    private:
+        ParseCache(const ParseCache&);              // declare only, do not allow copy
+        ParseCache& operator=(const ParseCache&);   // declare only, do not allow assign
+
+        bool check_entry(const parse_cache_entry_t* entry) const;
+
+        const uint8_t*              m_data;
+        size_t                      m_size;
+        const parse_cache_header_t* m_header;
+        const uint64_t*             m_buckets;
+    };
+
+    // Writes a new cache next to path and renames it over path, so readers
+    // of the old one keep their mapping. Entries of the cache being replaced
+    // are added by pointer; while nothing new has been added they are only
+    // noted, and a scan that found every entry it needed and no others
+    // leaves the file as it is.
+    class ParseCacheWriter
+    {
+    public:
+        ParseCacheWriter(const char* path, const ParseCache& previous);
+        ~ParseCacheWriter();
+
+        // Add an entry of previous
+        bool add(const parse_cache_entry_t* entry);
+
+        // Add an entry made by ParseCache::encode() or encode_status()
+        bool add(const std::string& entry);
+
+        // Write the index and replace the cache. False if any write failed, the
+        // old cache is left in place then.
+        bool finish();
+
+        uint64_t getEntryCount() const {
+            return m_offsets.size() + m_pending.size();
+        }
+
+    private:
+        ParseCacheWriter(const ParseCacheWriter&);              // declare only, do not allow copy
+        ParseCacheWriter& operator=(const ParseCacheWriter&);   // declare only, do not allow assign
+
+        bool start();
+        bool write(const void* data, size_t size);
+
+        std::string                         m_path;
+        std::string                         m_temp_path;
+        const ParseCache&                   m_previous;
+        FILE*                               m_file;
+        bool                                m_failed;
+        uint64_t                            m_offset;
+
+        std::vector<const parse_cache_entry_t*> m_pending;  // entries of previous, not written yet
+        std::vector<uint64_t>               m_offsets;      // of the entries written
+        std::vector<uint64_t>               m_hashes;       // of their keys
+    };
+
+}
+
+#endif
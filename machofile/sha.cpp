@@ -0,0 +1,370 @@
+//
+//  sha.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define ROTG_SHA_NI 1
+#endif
+
+#include "sha.h"
+
+namespace rotg {
+
+    /* Compress blocks 64 byte blocks of data into state */
+    typedef void (*sha_blocks_t)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+    static const uint32_t s_sha256_k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static inline uint32_t rotl32(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    static inline uint32_t rotr32(uint32_t value, int bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    static inline uint32_t load_be32(const uint8_t* p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static inline void store_be32(uint8_t* p, uint32_t value)
+    {
+        p[0] = (uint8_t)(value >> 24);
+        p[1] = (uint8_t)(value >> 16);
+        p[2] = (uint8_t)(value >> 8);
+        p[3] = (uint8_t)value;
+    }
+
+    static void sha1_blocks_portable(uint32_t* state, const uint8_t* data, size_t blocks)
+    {
+        for (; blocks > 0; blocks--, data += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++) {
+                w[i] = load_be32(data + 4 * i);
+            }
+            for (int i = 16; i < 80; i++) {
+                w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+/* One round, five of them bring the variables back to their names */
+#define SHA1_ROUND(a, b, c, d, e, f, k, i) \
+    e += rotl32(a, 5) + (f) + (k) + w[i]; \
+    b = rotl32(b, 30);
+
+/* Five rounds, f written in terms of x, y and z */
+#define SHA1_ROUNDS5(f, k, i) \
+    { uint32_t x, y, z; \
+    x = b; y = c; z = d; SHA1_ROUND(a, b, c, d, e, f, k, i) \
+    x = a; y = b; z = c; SHA1_ROUND(e, a, b, c, d, f, k, i + 1) \
+    x = e; y = a; z = b; SHA1_ROUND(d, e, a, b, c, f, k, i + 2) \
+    x = d; y = e; z = a; SHA1_ROUND(c, d, e, a, b, f, k, i + 3) \
+    x = c; y = d; z = e; SHA1_ROUND(b, c, d, e, a, f, k, i + 4) }
+
+            for (int i = 0; i < 20; i += 5) {
+                SHA1_ROUNDS5(z ^ (x & (y ^ z)), 0x5a827999, i)
+            }
+            for (int i = 20; i < 40; i += 5) {
+                SHA1_ROUNDS5(x ^ y ^ z, 0x6ed9eba1, i)
+            }
+            for (int i = 40; i < 60; i += 5) {
+                SHA1_ROUNDS5((x & y) | (z & (x | y)), 0x8f1bbcdc, i)
+            }
+            for (int i = 60; i < 80; i += 5) {
+                SHA1_ROUNDS5(x ^ y ^ z, 0xca62c1d6, i)
+            }
+
+#undef SHA1_ROUNDS5
+#undef SHA1_ROUND
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    static void sha256_blocks_portable(uint32_t* state, const uint8_t* data, size_t blocks)
+    {
+        for (; blocks > 0; blocks--, data += 64) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++) {
+                w[i] = load_be32(data + 4 * i);
+            }
+            for (int i = 16; i < 64; i++) {
+                uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+/* One round, eight of them bring the variables back to their names */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i) \
+    { uint32_t t = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + (g ^ (e & (f ^ g))) + s_sha256_k[i] + w[i]; \
+    d += t; \
+    h = t + (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) | (c & (a | b))); }
+
+            for (int i = 0; i < 64; i += 8) {
+                SHA256_ROUND(a, b, c, d, e, f, g, h, i)
+                SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1)
+                SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2)
+                SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3)
+                SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4)
+                SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5)
+                SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6)
+                SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7)
+            }
+
+#undef SHA256_ROUND
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+#if defined(ROTG_SHA_NI)
+
+    static bool cpu_has_sha_ni()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSE4_1) == 0) {
+            return false;
+        }
+
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+
+        return (ebx & bit_SHA) != 0;
+    }
+
+/* Four rounds with the message words in w: e is rotated from the state four rounds back */
+#define SHA1_NI_ROUNDS(w, func) \
+    e = _mm_sha1nexte_epu32(last, w); \
+    last = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, func);
+
+/* The next four message words from the last sixteen, m0 the oldest */
+#define SHA1_NI_SCHEDULE() \
+    next = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3); \
+    m0 = m1; \
+    m1 = m2; \
+    m2 = m3; \
+    m3 = next;
+
+    __attribute__((target("sha,sse4.1")))
+    static void sha1_blocks_sha_ni(uint32_t* state, const uint8_t* data, size_t blocks)
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+        /* a in the top lane, e alone in the top lane of its own register */
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+        __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+        for (; blocks > 0; blocks--, data += 64) {
+            __m128i abcdSave = abcd;
+            __m128i e0Save = e0;
+            __m128i e, last, next;
+
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 0)), byteSwap);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), byteSwap);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), byteSwap);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), byteSwap);
+
+            e = _mm_add_epi32(e0, m0);
+            last = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+            SHA1_NI_ROUNDS(m1, 0)
+            SHA1_NI_ROUNDS(m2, 0)
+            SHA1_NI_ROUNDS(m3, 0)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 0)
+
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 1)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 1)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 1)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 1)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 1)
+
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 2)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 2)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 2)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 2)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 2)
+
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 3)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 3)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 3)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 3)
+            SHA1_NI_SCHEDULE() SHA1_NI_ROUNDS(m3, 3)
+
+            e0 = _mm_sha1nexte_epu32(last, e0Save);
+            abcd = _mm_add_epi32(abcd, abcdSave);
+        }
+
+        _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+        state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+    }
+
+#undef SHA1_NI_ROUNDS
+#undef SHA1_NI_SCHEDULE
+
+    __attribute__((target("sha,sse4.1")))
+    static void sha256_blocks_sha_ni(uint32_t* state, const uint8_t* data, size_t blocks)
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        /* sha256rnds2 wants the state as abef and cdgh */
+        __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xb1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1b);
+        __m128i abef = _mm_alignr_epi8(dcba, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, dcba, 0xf0);
+
+        for (; blocks > 0; blocks--, data += 64) {
+            __m128i abefSave = abef;
+            __m128i cdghSave = cdgh;
+
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 0)), byteSwap);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), byteSwap);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), byteSwap);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), byteSwap);
+
+            /* Four rounds per step, the message words for step i + 4 come from steps i to i + 3 */
+            for (int i = 0; i < 16; i++) {
+                __m128i wk = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i*)&s_sha256_k[4 * i]));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+
+                __m128i next = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3);
+                m0 = m1;
+                m1 = m2;
+                m2 = m3;
+                m3 = next;
+            }
+
+            abef = _mm_add_epi32(abef, abefSave);
+            cdgh = _mm_add_epi32(cdgh, cdghSave);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+    }
+
+#endif
+
+    typedef struct sha_functions {
+        sha_blocks_t    sha1;
+        sha_blocks_t    sha256;
+        const char*     name;
+    } sha_functions_t;
+
+    static sha_functions_t select_sha_functions()
+    {
+        sha_functions_t functions = { sha1_blocks_portable, sha256_blocks_portable, "portable" };
+
+#if defined(ROTG_SHA_NI)
+        if (cpu_has_sha_ni()) {
+            functions.sha1 = sha1_blocks_sha_ni;
+            functions.sha256 = sha256_blocks_sha_ni;
+            functions.name = "sha-ni";
+        }
+#endif
+
+        return functions;
+    }
+
+    static const sha_functions_t& sha_functions()
+    {
+        static const sha_functions_t s_functions = select_sha_functions();
+        return s_functions;
+    }
+
+    /* Compress the whole blocks in place, then the rest with the padding and the length in bits */
+    static void sha_finish(sha_blocks_t compress, uint32_t* state, size_t stateWords, const uint8_t* data, size_t size, uint8_t* digest, size_t digestSize)
+    {
+        size_t blocks = size / 64;
+        compress(state, data, blocks);
+
+        uint8_t tail[128];
+        size_t rest = size - blocks * 64;
+        size_t tailSize = rest + 9 > 64 ? 128 : 64;
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, data + blocks * 64, rest);
+        tail[rest] = 0x80;
+
+        uint64_t bits = (uint64_t)size * 8;
+        store_be32(tail + tailSize - 8, (uint32_t)(bits >> 32));
+        store_be32(tail + tailSize - 4, (uint32_t)bits);
+        compress(state, tail, tailSize / 64);
+
+        for (size_t i = 0; i < stateWords && 4 * i < digestSize; i++) {
+            store_be32(digest + 4 * i, state[i]);
+        }
+    }
+
+    static void sha1_with(sha_blocks_t compress, const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize])
+    {
+        uint32_t state[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        sha_finish(compress, state, 5, data, size, digest, kSHA1DigestSize);
+    }
+
+    static void sha256_with(sha_blocks_t compress, const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize])
+    {
+        uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        sha_finish(compress, state, 8, data, size, digest, kSHA256DigestSize);
+    }
+
+    void sha1(const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize])
+    {
+        sha1_with(sha_functions().sha1, data, size, digest);
+    }
+
+    void sha256(const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize])
+    {
+        sha256_with(sha_functions().sha256, data, size, digest);
+    }
+
+    void sha1_portable(const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize])
+    {
+        sha1_with(sha1_blocks_portable, data, size, digest);
+    }
+
+    void sha256_portable(const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize])
+    {
+        sha256_with(sha256_blocks_portable, data, size, digest);
+    }
+
+    const char* sha_implementation()
+    {
+        return sha_functions().name;
+    }
+
+}
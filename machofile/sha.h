@@ -0,0 +1,34 @@
+//
+//  sha.h
+//  machofile
+//
+//  SHA-1 and SHA-256 for checking code signature page hashes. On x86 CPUs
+//  with the SHA extensions the compression functions use them, picked once
+//  at run time, otherwise a portable version runs; both give the same
+//  digests.
+//
+
+#ifndef rotg_sha_h
+#define rotg_sha_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rotg {
+
+    static const size_t kSHA1DigestSize = 20;
+    static const size_t kSHA256DigestSize = 32;
+
+    void sha1(const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize]);
+    void sha256(const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize]);
+
+    // The portable versions, whatever the cpu, to check the SHA extensions against
+    void sha1_portable(const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize]);
+    void sha256_portable(const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize]);
+
+    // "sha-ni" or "portable", whichever the digests above use on this cpu
+    const char* sha_implementation();
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+//
+//  symbol_table.cpp
+//  machofile
+//
+
+#include <string.h>
+
+#include "macho_traits.h"
+#include "symbol_table.h"
+
+namespace rotg {
+
+    SymbolTable::SymbolTable()
+        : m_strtab(NULL)
+        , m_strsize(0)
+    {
+    }
+
+    SymbolTable::SymbolTable(Arena* arena)
+        : m_values(arena)
+        , m_types(arena)
+        , m_sects(arena)
+        , m_descs(arena)
+        , m_strxs(arena)
+        , m_strtab(NULL)
+        , m_strsize(0)
+    {
+    }
+
+    template <typename Arch>
+    void SymbolTable::build(const typename Arch::nlist_t* nlists, uint32_t count, const char* strtab, uint32_t strsize)
+    {
+        m_strtab = strtab;
+        m_strsize = strsize;
+
+        if (count == 0) {
+            return;
+        }
+
+        size_t base = size();
+        m_values.resize(base + count);
+        m_types.resize(base + count);
+        m_sects.resize(base + count);
+        m_descs.resize(base + count);
+        m_strxs.resize(base + count);
+
+        uint64_t* values = &m_values[base];
+        uint8_t* types = &m_types[base];
+        uint8_t* sects = &m_sects[base];
+        uint16_t* descs = &m_descs[base];
+        uint32_t* strxs = &m_strxs[base];
+
+        for (uint32_t i = 0; i < count; i++) {
+            /* The table is only 4-byte aligned in a 32-bit image, copy each entry out */
+            typename Arch::nlist_t entry;
+            memcpy(&entry, &nlists[i], sizeof(entry));
+
+            values[i] = Arch::load_word(entry.n_value);
+            types[i] = entry.n_type;
+            sects[i] = entry.n_sect;
+            descs[i] = Arch::load16((uint16_t)entry.n_desc);
+            strxs[i] = Arch::load32(entry.n_un.n_strx);
+        }
+    }
+
+    template void SymbolTable::build<MachO32>(const struct nlist*, uint32_t, const char*, uint32_t);
+    template void SymbolTable::build<MachO32Swapped>(const struct nlist*, uint32_t, const char*, uint32_t);
+    template void SymbolTable::build<MachO64>(const struct nlist_64*, uint32_t, const char*, uint32_t);
+    template void SymbolTable::build<MachO64Swapped>(const struct nlist_64*, uint32_t, const char*, uint32_t);
+
+    void SymbolTable::clear()
+    {
+        m_values.clear();
+        m_types.clear();
+        m_sects.clear();
+        m_descs.clear();
+        m_strxs.clear();
+        m_strtab = NULL;
+        m_strsize = 0;
+    }
+
+    void SymbolTable::reserve(size_t count)
+    {
+        m_values.reserve(count);
+        m_types.reserve(count);
+        m_sects.reserve(count);
+        m_descs.reserve(count);
+        m_strxs.reserve(count);
+    }
+
+    size_t SymbolTable::filter(uint8_t typeMask, uint8_t typeValue, uint8_t sect, symbol_indices_t& indices) const
+    {
+        size_t count = size();
+        size_t base = indices.size();
+        indices.resize(base + count);
+
+        const uint8_t* types = m_types.data();
+        const uint8_t* sects = m_sects.data();
+        uint32_t* out = indices.data() + base;
+        size_t found = 0;
+
+        /* Branch free: always store, advance only on a match */
+        if (sect == AnySection) {
+            for (size_t i = 0; i < count; i++) {
+                out[found] = (uint32_t)i;
+                found += (types[i] & typeMask) == typeValue;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                out[found] = (uint32_t)i;
+                found += ((types[i] & typeMask) == typeValue) & (sects[i] == sect);
+            }
+        }
+
+        indices.resize(base + found);
+        return found;
+    }
+
+    size_t SymbolTable::count(uint8_t typeMask, uint8_t typeValue, uint8_t sect) const
+    {
+        size_t count = size();
+        const uint8_t* types = m_types.data();
+        const uint8_t* sects = m_sects.data();
+        size_t found = 0;
+
+        if (sect == AnySection) {
+            for (size_t i = 0; i < count; i++) {
+                found += (types[i] & typeMask) == typeValue;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                found += ((types[i] & typeMask) == typeValue) & (sects[i] == sect);
+            }
+        }
+
+        return found;
+    }
+
+}
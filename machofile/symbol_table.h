@@ -0,0 +1,117 @@
+//
+//  symbol_table.h
+//  machofile
+//
+//  Column oriented copy of an LC_SYMTAB nlist array. Each nlist field gets
+//  its own array, normalized to host byte order and 64-bit values, so
+//  filters only touch the narrow columns they test.
+//
+
+#ifndef rotg_symbol_table_h
+#define rotg_symbol_table_h
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "arena.h"
+
+namespace rotg {
+
+    typedef std::vector<uint32_t, ArenaAllocator<uint32_t> > symbol_indices_t;
+
+    class SymbolTable
+    {
+    public:
+        // NO_SECT as a filter section matches any section
+        static const uint8_t AnySection = 0;
+
+        SymbolTable();
+        explicit SymbolTable(Arena* arena);
+
+        // Fill the columns in one pass over count entries of nlists, laid out and
+        // byte ordered as Arch says (see macho_traits.h), which the caller has
+        // bounds checked. Names are resolved lazily against strtab, whose size
+        // bounds every n_strx.
+        template <typename Arch>
+        void build(const typename Arch::nlist_t* nlists, uint32_t count, const char* strtab, uint32_t strsize);
+
+        void clear();
+        void reserve(size_t count);
+
+        size_t size() const {
+            return m_values.size();
+        }
+
+        size_t capacity() const {
+            return m_values.capacity();
+        }
+
+        uint64_t value(size_t index) const {
+            return m_values[index];
+        }
+
+        uint8_t type(size_t index) const {
+            return m_types[index];
+        }
+
+        uint8_t sect(size_t index) const {
+            return m_sects[index];
+        }
+
+        uint16_t desc(size_t index) const {
+            return m_descs[index];
+        }
+
+        uint32_t strx(size_t index) const {
+            return m_strxs[index];
+        }
+
+        // "" when n_strx points outside the string table
+        const char* name(size_t index) const {
+            uint32_t strx = m_strxs[index];
+            return strx < m_strsize ? m_strtab + strx : "";
+        }
+
+        // Raw columns for custom scans, size() entries each
+        const uint64_t* values() const { return m_values.data(); }
+        const uint8_t* types() const { return m_types.data(); }
+        const uint8_t* sects() const { return m_sects.data(); }
+        const uint16_t* descs() const { return m_descs.data(); }
+        const uint32_t* strxs() const { return m_strxs.data(); }
+
+        const char* getStringTable() const {
+            return m_strtab;
+        }
+
+        uint32_t getStringTableSize() const {
+            return m_strsize;
+        }
+
+        // Append to indices every symbol with (n_type & typeMask) == typeValue,
+        // in section sect unless it is AnySection. External defined symbols of
+        // section 1: filter(N_EXT | N_TYPE, N_EXT | N_SECT, 1, indices).
+        size_t filter(uint8_t typeMask, uint8_t typeValue, uint8_t sect, symbol_indices_t& indices) const;
+
+        // How many symbols filter() would return
+        size_t count(uint8_t typeMask, uint8_t typeValue, uint8_t sect) const;
+
+    private:
+        typedef std::vector<uint64_t, ArenaAllocator<uint64_t> > values_t;
+        typedef std::vector<uint8_t, ArenaAllocator<uint8_t> >   bytes_t;
+        typedef std::vector<uint16_t, ArenaAllocator<uint16_t> > descs_t;
+        typedef std::vector<uint32_t, ArenaAllocator<uint32_t> > strxs_t;
+
+        values_t        m_values;
+        bytes_t         m_types;
+        bytes_t         m_sects;
+        descs_t         m_descs;
+        strxs_t         m_strxs;
+
+        const char*     m_strtab;
+        uint32_t        m_strsize;
+    };
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+//
+//  thread_pool.cpp
+//  machofile
+//
+
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+
+#include "thread_pool.h"
+
+namespace rotg {
+
+    /* Identifies the pool and deque owned by the current worker thread */
+    static thread_local ThreadPool* t_current_pool = NULL;
+    static thread_local size_t      t_current_index = 0;
+
+    size_t ThreadPool::hardware_threads()
+    {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        if (count <= 0) {
+            count = std::thread::hardware_concurrency();
+        }
+
+        return (count > 0) ? (size_t)count : 1;
+    }
+
+    ThreadPool::ThreadPool(size_t threads)
+        : m_queued(0)
+        , m_pending(0)
+        , m_stopping(false)
+        , m_next_queue(0)
+    {
+        if (threads == 0) {
+            threads = hardware_threads();
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+            m_queues.push_back(new worker_queue_t());
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+            m_workers.push_back(std::thread(&ThreadPool::worker_main, this, i));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stopping = true;
+        }
+        m_work_available.notify_all();
+
+        std::vector<std::thread>::iterator thread_iter;
+        for (thread_iter = m_workers.begin(); thread_iter != m_workers.end(); thread_iter++) {
+            thread_iter->join();
+        }
+
+        std::vector<worker_queue_t*>::iterator queue_iter;
+        for (queue_iter = m_queues.begin(); queue_iter != m_queues.end(); queue_iter++) {
+            delete *queue_iter;
+        }
+    }
+
+    void ThreadPool::submit(const task_t& task)
+    {
+        size_t index;
+        if (t_current_pool == this) {
+            index = t_current_index;
+        } else {
+            index = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        }
+
+        /* Count the task before it becomes visible so pop_task never underflows */
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_queued++;
+            m_pending++;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(m_queues[index]->lock);
+            m_queues[index]->tasks.push_back(task);
+        }
+
+        m_work_available.notify_one();
+    }
+
+    bool ThreadPool::pop_task(size_t index, task_t& task)
+    {
+        size_t count = m_queues.size();
+
+        for (size_t i = 0; i < count; i++) {
+            worker_queue_t* queue = m_queues[(index + i) % count];
+            std::lock_guard<std::mutex> guard(queue->lock);
+
+            if (queue->tasks.empty()) {
+                continue;
+            }
+
+            if (i == 0) {
+                /* Own deque: oldest first, keeps submission order roughly intact */
+                task = queue->tasks.front();
+                queue->tasks.pop_front();
+            } else {
+                /* Steal from the other end to stay out of the owner's way */
+                task = queue->tasks.back();
+                queue->tasks.pop_back();
+            }
+
+            std::lock_guard<std::mutex> count_guard(m_lock);
+            m_queued--;
+            return true;
+        }
+
+        return false;
+    }
+
+    void ThreadPool::finish_task()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (--m_pending == 0) {
+            m_all_done.notify_all();
+        }
+    }
+
+    bool ThreadPool::run_pending_task()
+    {
+        size_t index = (t_current_pool == this) ? t_current_index : 0;
+
+        task_t task;
+        if (!pop_task(index, task)) {
+            return false;
+        }
+
+        task();
+        finish_task();
+
+        return true;
+    }
+
+    void ThreadPool::worker_main(size_t index)
+    {
+        t_current_pool = this;
+        t_current_index = index;
+
+        while (true) {
+            task_t task;
+            if (pop_task(index, task)) {
+                task();
+                finish_task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_lock);
+            while (!m_stopping && m_queued == 0) {
+                m_work_available.wait(lock);
+            }
+
+            if (m_stopping && m_queued == 0) {
+                break;
+            }
+        }
+
+        t_current_pool = NULL;
+    }
+
+    void ThreadPool::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        while (m_pending > 0) {
+            m_all_done.wait(lock);
+        }
+    }
+
+    typedef struct parallel_for_state {
+        std::atomic<size_t>     next;
+        size_t                  count;
+        std::mutex              lock;
+        std::condition_variable done;
+        size_t                  running_helpers;
+    } parallel_for_state_t;
+
+    static void parallel_for_drain(parallel_for_state_t* state, const std::function<void(size_t)>& fn)
+    {
+        size_t index;
+        while ((index = state->next.fetch_add(1)) < state->count) {
+            fn(index);
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        size_t helpers = count - 1;
+        if (helpers > m_workers.size()) {
+            helpers = m_workers.size();
+        }
+
+        if (helpers == 0) {
+            for (size_t i = 0; i < count; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::shared_ptr<parallel_for_state_t> state(new parallel_for_state_t());
+        state->next = 0;
+        state->count = count;
+        state->running_helpers = helpers;
+
+        const std::function<void(size_t)>* body = &fn;
+        for (size_t i = 0; i < helpers; i++) {
+            submit([state, body]() {
+                parallel_for_drain(state.get(), *body);
+
+                std::lock_guard<std::mutex> guard(state->lock);
+                if (--state->running_helpers == 0) {
+                    state->done.notify_all();
+                }
+            });
+        }
+
+        parallel_for_drain(state.get(), fn);
+
+        /* Help out with queued work (possibly our own helpers) until they finish */
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(state->lock);
+                if (state->running_helpers == 0) {
+                    break;
+                }
+            }
+
+            if (run_pending_task()) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(state->lock);
+            if (state->running_helpers != 0) {
+                state->done.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+}
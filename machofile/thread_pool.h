@@ -0,0 +1,82 @@
+//
+//  thread_pool.h
+//  machofile
+//
+//  Work-stealing thread pool shared by the batch scanner and the
+//  parallel decoders.
+//
+
+#ifndef rotg_thread_pool_h
+#define rotg_thread_pool_h
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rotg {
+
+    typedef std::function<void()> task_t;
+
+    class ThreadPool
+    {
+    public:
+        // threads == 0 uses the number of online cpus
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        size_t size() const {
+            return m_workers.size();
+        }
+
+        // Queue a task. Tasks submitted from a worker go to that worker's
+        // own deque, others are spread round-robin; idle workers steal.
+        void submit(const task_t& task);
+
+        // Block until every submitted task has finished.
+        void wait();
+
+        // Run fn(0) .. fn(count - 1) across the pool and return when all
+        // are done. The calling thread takes part, so this is safe to use
+        // from inside a task.
+        void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+        // Run one queued task on the calling thread, if there is one.
+        bool run_pending_task();
+
+        static size_t hardware_threads();
+
+    private:
+        ThreadPool(const ThreadPool&);              // declare only, do not allow copy
+        ThreadPool& operator=(const ThreadPool&);   // declare only, do not allow assign
+
+        typedef struct worker_queue {
+            std::mutex          lock;
+            std::deque<task_t>  tasks;
+        } worker_queue_t;
+
+        void worker_main(size_t index);
+        bool pop_task(size_t index, task_t& task);
+        void finish_task();
+
+        std::vector<std::thread>        m_workers;
+        std::vector<worker_queue_t*>    m_queues;
+
+        std::mutex                      m_lock;
+        std::condition_variable         m_work_available;
+        std::condition_variable         m_all_done;
+        size_t                          m_queued;       // tasks sitting in a deque, guarded by m_lock
+        size_t                          m_pending;      // queued + running, guarded by m_lock
+        bool                            m_stopping;
+
+        std::atomic<size_t>             m_next_queue;
+    };
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+//
+//  chained_fixups_test.cpp
+//  machofile
+//
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "macho_builder.h"
+#include "macho_types.h"
+#include "machofile.h"
+#include "test.h"
+#include "thread_pool.h"
+
+using namespace rotg;
+
+namespace {
+
+    /* Past kParallelChainedPages, so a file with a pool walks them as tasks */
+    const uint32_t kPageCount = 300;
+    const uint32_t kImportCount = 16;
+
+    const size_t kStartsInImageOffset = 32;
+    const size_t kStartsInSegmentOffset = kStartsInImageOffset + 4 * sizeof(uint32_t);
+    const size_t kStartsInSegmentSize = 22;
+
+    typedef struct fixup {
+        uint64_t    address;
+        bool        bind;
+        std::string name;
+        int64_t     addend;
+        uint64_t    libOrdinal;
+        uint64_t    flags;
+        uint64_t    location;
+    } fixup_t;
+
+    std::string import_name(uint32_t index)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "_import_%u", index);
+        return name;
+    }
+
+    /*
+     * Every page but each tenth has one DYLD_CHAINED_PTR_64 chain of 1 to 5
+     * pointers 16 bytes apart, starting at a different offset per page; every
+     * third pointer is a bind to one of kImportCount imports with a small
+     * addend, the others are rebases. expected gets them in page order.
+     */
+    std::vector<uint8_t> build_image(std::vector<fixup_t>* expected)
+    {
+        std::vector<uint8_t> data(kPageCount * MachOBuilder::kPageSize);
+        std::vector<uint16_t> pageStarts(kPageCount, DYLD_CHAINED_PTR_START_NONE);
+
+        for (uint32_t p = 0; p < kPageCount; p++) {
+            if (p % 10 == 9) {
+                continue;
+            }
+
+            uint32_t start = (p % 8) * 8;
+            uint32_t count = 1 + p % 5;
+            pageStarts[p] = (uint16_t)start;
+
+            for (uint32_t j = 0; j < count; j++) {
+                uint64_t offset = p * MachOBuilder::kPageSize + start + 16 * j;
+                uint64_t next = j + 1 < count ? 4 : 0;     // in 4 byte strides
+                uint64_t value = next << 51;
+
+                fixup_t fixup;
+                fixup.address = MachOBuilder::kDataAddress + offset;
+                fixup.bind = (p + j) % 3 == 0;
+                fixup.location = MachOBuilder::kPageSize + offset;
+
+                if (fixup.bind) {
+                    uint32_t import = (p * 7 + j) % kImportCount;
+                    fixup.name = import_name(import);
+                    fixup.addend = (p + j) % 4;
+                    fixup.libOrdinal = 1 + import % 3;
+                    fixup.flags = import % 5 == 0 ? BIND_SYMBOL_FLAGS_WEAK_IMPORT : 0;
+                    value |= 1ULL << 63 | (uint64_t)fixup.addend << 24 | import;
+                } else {
+                    fixup.addend = 0;
+                    fixup.libOrdinal = 0;
+                    fixup.flags = 0;
+                    value |= 0x2000 + offset;
+                }
+
+                store_le(data, offset, value, 8);
+                expected->push_back(fixup);
+            }
+        }
+
+        /* Header, starts in image (__TEXT, __DATA, __LINKEDIT), starts in __DATA, imports, symbols */
+        size_t segmentSize = kStartsInSegmentSize + sizeof(uint16_t) * kPageCount;
+        size_t importsOffset = (kStartsInSegmentOffset + segmentSize + 3) & ~3;
+        size_t symbolsOffset = importsOffset + sizeof(uint32_t) * kImportCount;
+
+        std::vector<uint8_t> fixups(symbolsOffset);
+        store_le(fixups, offsetof(struct dyld_chained_fixups_header, starts_offset), kStartsInImageOffset, 4);
+        store_le(fixups, offsetof(struct dyld_chained_fixups_header, imports_offset), importsOffset, 4);
+        store_le(fixups, offsetof(struct dyld_chained_fixups_header, symbols_offset), symbolsOffset, 4);
+        store_le(fixups, offsetof(struct dyld_chained_fixups_header, imports_count), kImportCount, 4);
+        store_le(fixups, offsetof(struct dyld_chained_fixups_header, imports_format), DYLD_CHAINED_IMPORT, 4);
+
+        store_le(fixups, kStartsInImageOffset, 3, 4);
+        store_le(fixups, kStartsInImageOffset + 8, kStartsInSegmentOffset - kStartsInImageOffset, 4);
+
+        size_t segment = kStartsInSegmentOffset;
+        store_le(fixups, segment + offsetof(struct dyld_chained_starts_in_segment, size), segmentSize, 4);
+        store_le(fixups, segment + offsetof(struct dyld_chained_starts_in_segment, page_size), MachOBuilder::kPageSize, 2);
+        store_le(fixups, segment + offsetof(struct dyld_chained_starts_in_segment, pointer_format), DYLD_CHAINED_PTR_64, 2);
+        store_le(fixups, segment + offsetof(struct dyld_chained_starts_in_segment, segment_offset), MachOBuilder::kDataAddress, 8);
+        store_le(fixups, segment + offsetof(struct dyld_chained_starts_in_segment, page_count), kPageCount, 2);
+        for (uint32_t p = 0; p < kPageCount; p++) {
+            store_le(fixups, segment + kStartsInSegmentSize + sizeof(uint16_t) * p, pageStarts[p], 2);
+        }
+
+        for (uint32_t i = 0; i < kImportCount; i++) {
+            uint64_t nameOffset = fixups.size() - symbolsOffset;
+            uint64_t weak = i % 5 == 0 ? 1 : 0;
+            store_le(fixups, importsOffset + sizeof(uint32_t) * i, (1 + i % 3) | weak << 8 | nameOffset << 9, 4);
+
+            std::string name = import_name(i);
+            fixups.insert(fixups.end(), name.begin(), name.end());
+            fixups.push_back(0);
+        }
+
+        MachOBuilder builder;
+        builder.setData(data);
+        builder.setChainedFixups(fixups);
+        return builder.build();
+    }
+
+    /* Both streams in the order the visitors see them */
+    class FixupRecorder : public RebaseVisitor, public BindVisitor
+    {
+    public:
+        bool visit_run(const rebase_run_t& run) {
+            for (uint64_t i = 0; i < run.count; i++) {
+                fixup_t fixup;
+                fixup.address = run.address + i * run.stride;
+                fixup.bind = false;
+                fixup.addend = 0;
+                fixup.libOrdinal = 0;
+                fixup.flags = 0;
+                fixup.location = 0;
+                m_rebases.push_back(fixup);
+            }
+            return true;
+        }
+
+        bool visit_bind(const bind_action_t& action) {
+            fixup_t fixup;
+            fixup.address = action.address;
+            fixup.bind = true;
+            fixup.name = action.symbolName;
+            fixup.addend = action.addend;
+            fixup.libOrdinal = action.libOrdinal;
+            fixup.flags = action.flags;
+            fixup.location = action.location;
+            m_binds.push_back(fixup);
+            return true;
+        }
+
+        std::vector<fixup_t> m_rebases;
+        std::vector<fixup_t> m_binds;
+    };
+
+    void record_fixups(const std::vector<uint8_t>& image, ThreadPool* pool, FixupRecorder* recorder)
+    {
+        macho_input_t input;
+        input.data = image.data();
+        input.length = image.size();
+        input.baseOffset = 0;
+
+        MachOFile file;
+        file.setThreadPool(pool);
+        CHECK(file.parse_macho(&input));
+        CHECK(file.visit_rebases(*recorder));
+        CHECK(file.visit_binds(NodeTypeBind, *recorder));
+    }
+
+    void check_fixups(const std::vector<fixup_t>& actual, const std::vector<fixup_t>& expected)
+    {
+        CHECK(actual.size() == expected.size());
+
+        for (size_t i = 0; i < actual.size() && i < expected.size(); i++) {
+            CHECK(actual[i].address == expected[i].address);
+            CHECK(actual[i].name == expected[i].name);
+            CHECK(actual[i].addend == expected[i].addend);
+            CHECK(actual[i].libOrdinal == expected[i].libOrdinal);
+            CHECK(actual[i].flags == expected[i].flags);
+            CHECK(actual[i].location == expected[i].location);
+        }
+    }
+
+}
+
+TEST(chained_fixups, parallel_walk_matches_serial)
+{
+    std::vector<fixup_t> fixups;
+    std::vector<uint8_t> image = build_image(&fixups);
+
+    std::vector<fixup_t> rebases;
+    std::vector<fixup_t> binds;
+    for (size_t i = 0; i < fixups.size(); i++) {
+        if (fixups[i].bind) {
+            binds.push_back(fixups[i]);
+        } else {
+            fixups[i].location = 0;
+            rebases.push_back(fixups[i]);
+        }
+    }
+
+    FixupRecorder serial;
+    record_fixups(image, NULL, &serial);
+    check_fixups(serial.m_rebases, rebases);
+    check_fixups(serial.m_binds, binds);
+
+    ThreadPool pool(4);
+    FixupRecorder parallel;
+    record_fixups(image, &pool, &parallel);
+    check_fixups(parallel.m_rebases, rebases);
+    check_fixups(parallel.m_binds, binds);
+}
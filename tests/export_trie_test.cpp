@@ -0,0 +1,187 @@
+//
+//  export_trie_test.cpp
+//  machofile
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "macho_builder.h"
+#include "machofile.h"
+#include "test.h"
+#include "thread_pool.h"
+
+using namespace rotg;
+
+namespace {
+
+    typedef struct trie_node {
+        bool                        terminal;
+        uint64_t                    address;
+        std::vector<std::string>    labels;
+        std::vector<size_t>         children;   // indexes into the preorder node list
+    } trie_node_t;
+
+    /* Build the compressed trie of names[lo, hi), which share their first depth characters */
+    size_t add_trie_node(const std::vector<std::string>& names, size_t lo, size_t hi, size_t depth, std::vector<trie_node_t>& nodes)
+    {
+        size_t index = nodes.size();
+        nodes.push_back(trie_node_t());
+        nodes[index].terminal = false;
+        nodes[index].address = 0;
+
+        if (lo < hi && names[lo].size() == depth) {
+            nodes[index].terminal = true;
+            nodes[index].address = 0x1000 + 16 * lo;
+            lo++;
+        }
+
+        while (lo < hi) {
+            /* The names starting with the same character share one edge, as long as their common prefix */
+            size_t end = lo + 1;
+            while (end < hi && names[end][depth] == names[lo][depth]) {
+                end++;
+            }
+
+            const std::string& first = names[lo];
+            const std::string& last = names[end - 1];
+            size_t common = depth + 1;
+            while (common < first.size() && common < last.size() && first[common] == last[common]) {
+                common++;
+            }
+
+            std::string label = first.substr(depth, common - depth);
+            size_t child = add_trie_node(names, lo, end, common, nodes);
+            nodes[index].labels.push_back(label);
+            nodes[index].children.push_back(child);
+            lo = end;
+        }
+
+        return index;
+    }
+
+    /* Serialize the nodes in preorder, growing child offsets until their ULEB128 sizes settle */
+    std::vector<uint8_t> encode_trie(const std::vector<trie_node_t>& nodes)
+    {
+        std::vector<uint64_t> offsets(nodes.size(), 0);
+        std::vector<uint8_t> trie;
+
+        for (bool changed = true; changed; ) {
+            changed = false;
+            trie.clear();
+
+            for (size_t i = 0; i < nodes.size(); i++) {
+                if (offsets[i] != trie.size()) {
+                    offsets[i] = trie.size();
+                    changed = true;
+                }
+
+                const trie_node_t& node = nodes[i];
+                if (node.terminal) {
+                    std::vector<uint8_t> terminal;
+                    append_uleb128(terminal, 0);  // flags
+                    append_uleb128(terminal, node.address);
+                    append_uleb128(trie, terminal.size());
+                    trie.insert(trie.end(), terminal.begin(), terminal.end());
+                } else {
+                    trie.push_back(0);
+                }
+
+                trie.push_back((uint8_t)node.children.size());
+                for (size_t c = 0; c < node.children.size(); c++) {
+                    trie.insert(trie.end(), node.labels[c].begin(), node.labels[c].end());
+                    trie.push_back(0);
+                    append_uleb128(trie, offsets[node.children[c]]);
+                }
+            }
+        }
+
+        return trie;
+    }
+
+    std::vector<uint8_t> build_image(std::vector<std::string>* names)
+    {
+        /* Enough names for a trie past kParallelExportTrieSize, sharing prefixes at several depths */
+        static const char* const kWords[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta" };
+
+        char name[64];
+        for (int i = 0; i < 12000; i++) {
+            snprintf(name, sizeof(name), "_%s_%s_%d", kWords[i % 8], kWords[(i / 8) % 8], i);
+            names->push_back(name);
+        }
+        std::sort(names->begin(), names->end());
+
+        std::vector<trie_node_t> nodes;
+        add_trie_node(*names, 0, names->size(), 0, nodes);
+
+        MachOBuilder builder;
+        builder.setExportsTrie(encode_trie(nodes));
+        return builder.build();
+    }
+
+    bool parse_image(const std::vector<uint8_t>& image, ThreadPool* pool, MachOFile& file)
+    {
+        macho_input_t input;
+        input.data = image.data();
+        input.length = image.size();
+        input.baseOffset = 0;
+
+        file.setThreadPool(pool);
+        return file.parse_macho(&input);
+    }
+
+}
+
+TEST(export_trie, parallel_decode_matches_serial)
+{
+    std::vector<std::string> names;
+    std::vector<uint8_t> image = build_image(&names);
+
+    MachOFile serial;
+    CHECK(parse_image(image, NULL, serial));
+    CHECK(serial.getExportTrie().size() >= 64 * 1024);
+
+    ThreadPool pool(4);
+    MachOFile parallel;
+    CHECK(parse_image(image, &pool, parallel));
+
+    const export_info_t& serialInfo = serial.getDyldInfoCommandInfo().loader_info.export_info;
+    const export_info_t& parallelInfo = parallel.getDyldInfoCommandInfo().loader_info.export_info;
+
+    /* Terminals come out in preorder, which for this trie is strcmp order */
+    CHECK(serialInfo.actions.size() == names.size());
+    CHECK(parallelInfo.actions.size() == names.size());
+
+    for (size_t i = 0; i < names.size() && i < serialInfo.actions.size() && i < parallelInfo.actions.size(); i++) {
+        const export_action_t& expected = serialInfo.actions[i];
+        const export_action_t& action = parallelInfo.actions[i];
+
+        CHECK(names[i] == expected.symbolName);
+        CHECK(expected.address == 0x1000 + 16 * i);
+        CHECK(strcmp(action.symbolName, expected.symbolName) == 0);
+        CHECK(action.address == expected.address);
+        CHECK(action.flags == expected.flags);
+        CHECK(action.offset == expected.offset);
+    }
+
+    CHECK(serialInfo.opcodes.size() == parallelInfo.opcodes.size());
+
+    for (size_t i = 0; i < serialInfo.opcodes.size() && i < parallelInfo.opcodes.size(); i++) {
+        const export_opcode_t& expected = serialInfo.opcodes[i];
+        const export_opcode_t& opcode = parallelInfo.opcodes[i];
+
+        CHECK(opcode.ptr == expected.ptr);
+        CHECK(opcode.terminalSize == expected.terminalSize);
+        CHECK(opcode.childCount == expected.childCount);
+        CHECK(opcode.nodes.size() == expected.nodes.size());
+
+        for (size_t n = 0; n < opcode.nodes.size() && n < expected.nodes.size(); n++) {
+            CHECK(strcmp(opcode.nodes[n].label, expected.nodes[n].label) == 0);
+            CHECK(opcode.nodes[n].skip == expected.nodes[n].skip);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+# Runs COMMAND with ARGS ('|' separated) and compares what it writes to
+# stdout with the file GOLDEN. The exit status must be RESULT (default 0).
+# On a mismatch the output is left in ACTUAL for diffing.
+# With MACHOFILE_UPDATE_GOLDEN=1 in the environment GOLDEN is rewritten
+# from the output instead.
+
+string(REPLACE "|" ";" args "${ARGS}")
+if(NOT DEFINED RESULT)
+    set(RESULT 0)
+endif()
+
+execute_process(COMMAND ${COMMAND} ${args}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+
+if(NOT "${result}" STREQUAL "${RESULT}")
+    message(FATAL_ERROR "${COMMAND} ${args}: exit status ${result}, expected ${RESULT}\n${errors}")
+endif()
+
+if("$ENV{MACHOFILE_UPDATE_GOLDEN}" STREQUAL "1")
+    file(WRITE "${GOLDEN}" "${output}")
+    return()
+endif()
+
+file(READ "${GOLDEN}" expected)
+if(NOT output STREQUAL expected)
+    file(WRITE "${ACTUAL}" "${output}")
+    message(FATAL_ERROR "${COMMAND} ${args}: output differs from ${GOLDEN}, see ${ACTUAL}\n${errors}")
+endif()
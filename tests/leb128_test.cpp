@@ -0,0 +1,130 @@
+//
+//  leb128_test.cpp
+//  machofile
+//
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "leb128.h"
+#include "test.h"
+
+using namespace rotg;
+
+namespace {
+
+    typedef struct leb128_vector {
+        uint8_t     bytes[12];
+        size_t      length;
+        bool        valid;      // false: the readers must return NULL
+        uint64_t    value;      // the ULEB128 value, or the SLEB128 value's bits
+    } leb128_vector_t;
+
+    const leb128_vector_t kULEB128Vectors[] = {
+        { { 0x00 }, 1, true, 0 },
+        { { 0x7f }, 1, true, 127 },
+        { { 0x80, 0x01 }, 2, true, 128 },
+        { { 0xff, 0x7f }, 2, true, 0x3fff },
+        { { 0x80, 0x80, 0x01 }, 3, true, 0x4000 },
+        /* 8 bytes, the longest value the one-load path decodes */
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f }, 8, true, (1ULL << 56) - 1 },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 }, 9, true, 1ULL << 56 },
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f }, 9, true, (1ULL << 63) - 1 },
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 }, 10, true, UINT64_MAX },
+        /* Overlong encodings of values that fit are accepted */
+        { { 0x80, 0x00 }, 2, true, 0 },
+        { { 0xff, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 }, 10, true, 0x7f },
+        /* Bits past 63, or an eleventh byte, do not fit */
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02 }, 10, false, 0 },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 }, 11, false, 0 },
+        /* No terminating byte before the end */
+        { { 0x80 }, 1, false, 0 },
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }, 8, false, 0 },
+    };
+
+    const leb128_vector_t kSLEB128Vectors[] = {
+        { { 0x00 }, 1, true, 0 },
+        { { 0x7f }, 1, true, (uint64_t)-1 },
+        { { 0x3f }, 1, true, 63 },
+        { { 0x40 }, 1, true, (uint64_t)-64 },
+        { { 0xc0, 0x00 }, 2, true, 64 },
+        { { 0xbf, 0x7f }, 2, true, (uint64_t)-65 },
+        /* 8 bytes, the longest value the one-load path decodes */
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3f }, 8, true, (1ULL << 55) - 1 },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40 }, 8, true, (uint64_t)-(1LL << 55) },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 }, 9, true, 1ULL << 56 },
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 }, 10, true, (uint64_t)INT64_MAX },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7f }, 10, true, (uint64_t)INT64_MIN },
+        /* Overlong encodings are accepted */
+        { { 0xff, 0x7f }, 2, true, (uint64_t)-1 },
+        { { 0x80, 0x80, 0x00 }, 3, true, 0 },
+        /* An eleventh byte is too long, even for a value that fits */
+        { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f }, 11, false, 0 },
+        /* No terminating byte before the end */
+        { { 0xc0 }, 1, false, 0 },
+        { { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 }, 8, false, 0 },
+    };
+
+    /*
+     * Each vector is read three ways: followed by continuation bytes, so the
+     * one-load path sees it whenever it is short enough; at the very end of
+     * the buffer, where only the byte loop may look; and by the byte loop
+     * itself. All three must agree.
+     */
+    template <typename Value, typename Reader>
+    void check_vector(const leb128_vector_t& vector, Reader read, Reader readSlow)
+    {
+        std::vector<uint8_t> padded(vector.bytes, vector.bytes + vector.length);
+        padded.resize(vector.length + 16, 0x80);
+
+        /* An invalid vector only fails once the buffer ends where it does */
+        const uint8_t* paddedEnd = vector.valid ? padded.data() + padded.size() : padded.data() + vector.length;
+
+        const uint8_t* buffers[2] = { padded.data(), vector.bytes };
+        const uint8_t* ends[2] = { paddedEnd, vector.bytes + vector.length };
+
+        for (int b = 0; b < 2; b++) {
+            Value value = 0;
+            Value slowValue = 0;
+            const uint8_t* next = read(buffers[b], ends[b], value);
+            const uint8_t* slowNext = readSlow(buffers[b], ends[b], slowValue);
+
+            if (!vector.valid) {
+                CHECK(next == NULL);
+                CHECK(slowNext == NULL);
+                continue;
+            }
+
+            CHECK(next == buffers[b] + vector.length);
+            CHECK(slowNext == buffers[b] + vector.length);
+            CHECK((uint64_t)value == vector.value);
+            CHECK((uint64_t)slowValue == vector.value);
+        }
+    }
+
+}
+
+TEST(leb128, uleb128_vectors)
+{
+    for (size_t i = 0; i < sizeof(kULEB128Vectors) / sizeof(kULEB128Vectors[0]); i++) {
+        check_vector<uint64_t>(kULEB128Vectors[i], read_uleb128, read_uleb128_slow);
+    }
+}
+
+TEST(leb128, sleb128_vectors)
+{
+    for (size_t i = 0; i < sizeof(kSLEB128Vectors) / sizeof(kSLEB128Vectors[0]); i++) {
+        check_vector<int64_t>(kSLEB128Vectors[i], read_sleb128, read_sleb128_slow);
+    }
+}
+
+TEST(leb128, empty_stream)
+{
+    uint8_t byte = 0;
+    uint64_t value = 0;
+    int64_t signedValue = 0;
+
+    CHECK(read_uleb128(&byte, &byte, value) == NULL);
+    CHECK(read_sleb128(&byte, &byte, signedValue) == NULL);
+}
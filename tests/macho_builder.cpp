@@ -0,0 +1,146 @@
+//
+//  macho_builder.cpp
+//  machofile
+//
+
+#include <stddef.h>
+#include <string.h>
+
+#include "macho_builder.h"
+#include "macho_types.h"
+
+namespace rotg {
+
+    static const char kInstallName[] = "/usr/lib/libtest.dylib";
+
+    /* vm_prot_t bits; macho_types.h does not carry them */
+    static const uint32_t kProtRead = 1;
+    static const uint32_t kProtWrite = 2;
+    static const uint32_t kProtExecute = 4;
+
+    static uint64_t page_align(uint64_t size)
+    {
+        return (size + MachOBuilder::kPageSize - 1) & ~(MachOBuilder::kPageSize - 1);
+    }
+
+    void append_uleb128(std::vector<uint8_t>& bytes, uint64_t value)
+    {
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            bytes.push_back(value != 0 ? byte | 0x80 : byte);
+        } while (value != 0);
+    }
+
+    void store_le(std::vector<uint8_t>& bytes, size_t offset, uint64_t value, size_t size)
+    {
+        for (size_t i = 0; i < size; i++) {
+            bytes[offset + i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+
+    /* Append a load command of size bytes, zero filled, and return its offset */
+    static size_t append_command(std::vector<uint8_t>& image, uint32_t cmd, size_t size)
+    {
+        size_t offset = image.size();
+        image.resize(offset + size);
+        store_le(image, offset + offsetof(struct load_command, cmd), cmd, 4);
+        store_le(image, offset + offsetof(struct load_command, cmdsize), size, 4);
+        return offset;
+    }
+
+    static void append_segment(std::vector<uint8_t>& image, const char* name, uint64_t vmaddr, uint64_t vmsize,
+                               uint64_t fileoff, uint64_t filesize, uint32_t prot)
+    {
+        size_t offset = append_command(image, LC_SEGMENT_64, sizeof(struct segment_command_64));
+        memcpy(&image[offset + offsetof(struct segment_command_64, segname)], name, strlen(name));
+        store_le(image, offset + offsetof(struct segment_command_64, vmaddr), vmaddr, 8);
+        store_le(image, offset + offsetof(struct segment_command_64, vmsize), vmsize, 8);
+        store_le(image, offset + offsetof(struct segment_command_64, fileoff), fileoff, 8);
+        store_le(image, offset + offsetof(struct segment_command_64, filesize), filesize, 8);
+        store_le(image, offset + offsetof(struct segment_command_64, maxprot), prot, 4);
+        store_le(image, offset + offsetof(struct segment_command_64, initprot), prot, 4);
+    }
+
+    static void append_linkedit_data(std::vector<uint8_t>& image, uint32_t cmd, uint64_t dataoff, uint64_t datasize)
+    {
+        size_t offset = append_command(image, cmd, sizeof(struct linkedit_data_command));
+        store_le(image, offset + offsetof(struct linkedit_data_command, dataoff), dataoff, 4);
+        store_le(image, offset + offsetof(struct linkedit_data_command, datasize), datasize, 4);
+    }
+
+    MachOBuilder::MachOBuilder()
+    {
+    }
+
+    void MachOBuilder::setData(const std::vector<uint8_t>& data)
+    {
+        m_data = data;
+        m_data.resize(page_align(data.size()));
+    }
+
+    void MachOBuilder::setExportsTrie(const std::vector<uint8_t>& trie)
+    {
+        m_exports_trie = trie;
+    }
+
+    void MachOBuilder::setChainedFixups(const std::vector<uint8_t>& fixups)
+    {
+        m_chained_fixups = fixups;
+    }
+
+    std::vector<uint8_t> MachOBuilder::build() const
+    {
+        /* __LINKEDIT: the chained fixups, then the trie, 8 byte aligned */
+        uint64_t linkeditOffset = kPageSize + m_data.size();
+        uint64_t fixupsOffset = linkeditOffset;
+        uint64_t trieOffset = fixupsOffset + ((m_chained_fixups.size() + 7) & ~7);
+        uint64_t linkeditSize = trieOffset + m_exports_trie.size() - linkeditOffset;
+
+        std::vector<uint8_t> image(sizeof(struct mach_header_64));
+        uint32_t ncmds = 0;
+
+        append_segment(image, "__TEXT", 0, kPageSize, 0, kPageSize, kProtRead | kProtExecute);
+        ncmds++;
+
+        if (!m_data.empty()) {
+            append_segment(image, "__DATA", kDataAddress, m_data.size(), kPageSize, m_data.size(), kProtRead | kProtWrite);
+            ncmds++;
+        }
+
+        append_segment(image, "__LINKEDIT", linkeditOffset, page_align(linkeditSize), linkeditOffset, linkeditSize, kProtRead);
+        ncmds++;
+
+        size_t dylibSize = (sizeof(struct dylib_command) + sizeof(kInstallName) + 7) & ~7;
+        size_t dylib = append_command(image, LC_ID_DYLIB, dylibSize);
+        store_le(image, dylib + offsetof(struct dylib_command, dylib.name), sizeof(struct dylib_command), 4);
+        memcpy(&image[dylib + sizeof(struct dylib_command)], kInstallName, sizeof(kInstallName));
+        ncmds++;
+
+        if (!m_chained_fixups.empty()) {
+            append_linkedit_data(image, LC_DYLD_CHAINED_FIXUPS, fixupsOffset, m_chained_fixups.size());
+            ncmds++;
+        }
+
+        if (!m_exports_trie.empty()) {
+            append_linkedit_data(image, LC_DYLD_EXPORTS_TRIE, trieOffset, m_exports_trie.size());
+            ncmds++;
+        }
+
+        store_le(image, offsetof(struct mach_header_64, magic), MH_MAGIC_64, 4);
+        store_le(image, offsetof(struct mach_header_64, cputype), CPU_TYPE_X86_64, 4);
+        store_le(image, offsetof(struct mach_header_64, cpusubtype), CPU_SUBTYPE_X86_64_ALL, 4);
+        store_le(image, offsetof(struct mach_header_64, filetype), MH_DYLIB, 4);
+        store_le(image, offsetof(struct mach_header_64, ncmds), ncmds, 4);
+        store_le(image, offsetof(struct mach_header_64, sizeofcmds), image.size() - sizeof(struct mach_header_64), 4);
+
+        image.resize(kPageSize);
+        image.insert(image.end(), m_data.begin(), m_data.end());
+        image.insert(image.end(), m_chained_fixups.begin(), m_chained_fixups.end());
+        image.resize(trieOffset);
+        image.insert(image.end(), m_exports_trie.begin(), m_exports_trie.end());
+
+        return image;
+    }
+
+}
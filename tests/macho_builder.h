@@ -0,0 +1,54 @@
+//
+//  macho_builder.h
+//  machofile
+//
+//  Lays out a minimal little-endian x86_64 MH_DYLIB in memory for the unit
+//  tests: __TEXT (one page, the load commands), an optional __DATA whose
+//  bytes the test supplies, and __LINKEDIT holding the export trie and the
+//  chained fixups payload, each behind its own linkedit_data_command.
+//
+
+#ifndef rotg_macho_builder_h
+#define rotg_macho_builder_h
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace rotg {
+
+    class MachOBuilder
+    {
+    public:
+        static const uint64_t kPageSize = 0x1000;
+        static const uint64_t kDataAddress = kPageSize;    // __DATA follows the __TEXT page
+
+        MachOBuilder();
+
+        // Contents of __DATA, padded to whole pages; none if empty
+        void setData(const std::vector<uint8_t>& data);
+
+        // Payload of LC_DYLD_EXPORTS_TRIE
+        void setExportsTrie(const std::vector<uint8_t>& trie);
+
+        // Payload of LC_DYLD_CHAINED_FIXUPS
+        void setChainedFixups(const std::vector<uint8_t>& fixups);
+
+        // The image, ready for MachOFile::parse_macho()
+        std::vector<uint8_t> build() const;
+
+    private:
+        std::vector<uint8_t>    m_data;
+        std::vector<uint8_t>    m_exports_trie;
+        std::vector<uint8_t>    m_chained_fixups;
+    };
+
+    // Append value as ULEB128
+    void append_uleb128(std::vector<uint8_t>& bytes, uint64_t value);
+
+    // Store value little-endian at bytes[offset]
+    void store_le(std::vector<uint8_t>& bytes, size_t offset, uint64_t value, size_t size);
+
+}
+
+#endif
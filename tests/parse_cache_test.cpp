@@ -0,0 +1,220 @@
+//
+//  parse_cache_test.cpp
+//  machofile
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "bind_table.h"
+#include "machofile.h"
+#include "parse_cache.h"
+#include "test.h"
+
+using namespace rotg;
+
+namespace {
+
+    /* Scratch files go to the working directory, which ctest makes the build directory */
+    const char kImagePath[] = "parse_cache_test.dylib";
+    const char kCachePath[] = "parse_cache_test.cache";
+
+    bool copy_file(const char* from, const char* to)
+    {
+        FILE* in = fopen(from, "rb");
+        if (in == NULL) {
+            return false;
+        }
+
+        FILE* out = fopen(to, "wb");
+        if (out == NULL) {
+            fclose(in);
+            return false;
+        }
+
+        char buffer[4096];
+        size_t length;
+        bool success = true;
+        while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            success = success && fwrite(buffer, 1, length, out) == length;
+        }
+
+        fclose(in);
+        return fclose(out) == 0 && success;
+    }
+
+    bool stat_key(const char* path, parse_cache_key_t* key)
+    {
+        struct stat stbuf;
+        if (stat(path, &stbuf) != 0) {
+            return false;
+        }
+
+        ParseCache::make_key(stbuf, key);
+        return true;
+    }
+
+    std::string segment_name(const char* segname)
+    {
+        return std::string(segname, strnlen(segname, 16));
+    }
+
+    /* The entry holds what the MachOFile decoded */
+    void check_entry(const parse_cache_entry_t* entry, const MachOFile& file)
+    {
+        CHECK(entry->status == ParseCacheImage);
+        CHECK(entry->images.count == 1);
+        if (entry->status != ParseCacheImage || entry->images.count != 1) {
+            return;
+        }
+
+        const parse_cache_image_t& image = ParseCache::images(entry)[0];
+        CHECK(image.cputype == file.read32(file.getHeader()->cputype));
+        CHECK(image.filetype == file.read32(file.getHeader()->filetype));
+        CHECK(image.ncmds == file.read32(file.getHeader()->ncmds));
+        CHECK(image.is64 == (uint32_t)file.is64bit());
+
+        const segment_infos_t& segments = file.getSegmentInfos();
+        const parse_cache_segment_t* segmentRecords = ParseCache::table<parse_cache_segment_t>(entry, image.segments);
+        CHECK(image.segments.count == segments.size());
+        for (size_t i = 0; i < image.segments.count && i < segments.size(); i++) {
+            CHECK(segment_name(segmentRecords[i].segname) == segment_name(segments[i].segname));
+            CHECK(segmentRecords[i].vmaddr == segments[i].vmaddr);
+            CHECK(segmentRecords[i].filesize == segments[i].filesize);
+        }
+
+        const dylib_command_infos_t& dylibs = file.getDylibCommandInfos();
+        const parse_cache_dylib_t* dylibRecords = ParseCache::table<parse_cache_dylib_t>(entry, image.dylibs);
+        CHECK(image.dylibs.count == dylibs.size());
+        for (size_t i = 0; i < image.dylibs.count && i < dylibs.size(); i++) {
+            CHECK(std::string(ParseCache::string(entry, dylibRecords[i].name)) == std::string(dylibs[i]->libname));
+        }
+
+        const SymbolTable& symbols = file.getSymtabCommandInfo().symbols;
+        const parse_cache_symbol_t* symbolRecords = ParseCache::table<parse_cache_symbol_t>(entry, image.symbols);
+        CHECK(symbols.size() > 0);
+        CHECK(image.symbols.count == symbols.size());
+        for (size_t i = 0; i < image.symbols.count && i < symbols.size(); i++) {
+            CHECK(strcmp(ParseCache::string(entry, symbolRecords[i].name), symbols.name(i)) == 0);
+            CHECK(symbolRecords[i].value == symbols.value(i));
+        }
+
+        BindTable binds;
+        CHECK(binds.build(file, NodeTypeBind));
+        CHECK(binds.getBindCount() > 0);
+
+        uint64_t bindCount = 0;
+        const parse_cache_bind_run_t* runs = ParseCache::table<parse_cache_bind_run_t>(entry, image.bind_runs);
+        for (size_t i = 0; i < image.bind_runs.count; i++) {
+            CHECK(runs[i].target < image.bind_targets.count);
+            bindCount += runs[i].count;
+        }
+        CHECK(bindCount == image.bind_count);
+        CHECK(image.bind_count >= binds.getBindCount());
+
+        const export_actions_t& exports = file.getDyldInfoCommandInfo().loader_info.export_info.actions;
+        const parse_cache_export_t* exportRecords = ParseCache::table<parse_cache_export_t>(entry, image.exports);
+        CHECK(exports.size() > 0);
+        CHECK(image.exports.count == exports.size());
+        for (size_t i = 0; i < image.exports.count && i < exports.size(); i++) {
+            CHECK(strcmp(ParseCache::string(entry, exportRecords[i].name), exports[i].symbolName) == 0);
+            CHECK(exportRecords[i].address == exports[i].address);
+        }
+    }
+
+}
+
+TEST(parse_cache, round_trip_and_stale_key)
+{
+    CHECK(copy_file(MACHOFILE_FIXTURES "/op_x86_64.dylib", kImagePath));
+
+    parse_cache_key_t key;
+    CHECK(stat_key(kImagePath, &key));
+
+    MachOFile file;
+    CHECK(file.parse_file(kImagePath));
+
+    std::string entry;
+    CHECK(ParseCache::encode(key, file, macho_files_t(), entry));
+
+    /* A second entry that is not an image, as a scan records a non-Mach-O file */
+    parse_cache_key_t otherKey = key;
+    otherKey.ino++;
+    std::string otherEntry;
+    ParseCache::encode_status(otherKey, ParseCacheNotMachO, ParseOptionNone, otherEntry);
+
+    ParseCache empty;
+    unlink(kCachePath);
+    CHECK(!empty.open(kCachePath));
+
+    ParseCacheWriter writer(kCachePath, empty);
+    CHECK(writer.add(entry));
+    CHECK(writer.add(otherEntry));
+    CHECK(writer.finish());
+
+    ParseCache cache;
+    CHECK(cache.open(kCachePath));
+    CHECK(cache.size() == 2);
+
+    const parse_cache_entry_t* found = cache.find(key, ParseOptionNone);
+    CHECK(found != NULL);
+    if (found != NULL) {
+        CHECK(found->size == entry.size());
+        CHECK(memcmp(found, entry.data(), entry.size()) == 0);
+        check_entry(found, file);
+    }
+
+    const parse_cache_entry_t* other = cache.find(otherKey, ParseOptionNone);
+    CHECK(other != NULL && other->status == ParseCacheNotMachO && other->images.count == 0);
+
+    /* An entry made from a full parse does not answer a headers-only lookup */
+    CHECK(cache.find(key, ParseOptionHeadersOnly) == NULL);
+
+    /* Any change to the stat makes the entry stale */
+    parse_cache_key_t changed = key;
+    changed.size++;
+    CHECK(cache.find(changed, ParseOptionNone) == NULL);
+
+    struct timespec times[2];
+    times[0].tv_sec = key.mtime_sec + 60;
+    times[0].tv_nsec = 0;
+    times[1] = times[0];
+    CHECK(utimensat(AT_FDCWD, kImagePath, times, 0) == 0);
+
+    parse_cache_key_t touched;
+    CHECK(stat_key(kImagePath, &touched));
+    CHECK(!ParseCache::same_key(touched, key));
+    CHECK(cache.find(touched, ParseOptionNone) == NULL);
+
+    /* Entries carried over from the previous cache come back byte for byte */
+    std::string touchedEntry;
+    ParseCache::encode_status(touched, ParseCacheMalformed, ParseOptionNone, touchedEntry);
+
+    ParseCacheWriter rewriter(kCachePath, cache);
+    CHECK(found == NULL || rewriter.add(found));
+    CHECK(rewriter.add(touchedEntry));
+    CHECK(rewriter.finish());
+
+    ParseCache rewritten;
+    CHECK(rewritten.open(kCachePath));
+    CHECK(rewritten.size() == 2);
+    CHECK(rewritten.find(otherKey, ParseOptionNone) == NULL);
+
+    const parse_cache_entry_t* kept = rewritten.find(key, ParseOptionNone);
+    CHECK(kept != NULL && kept->size == entry.size() && memcmp(kept, entry.data(), entry.size()) == 0);
+
+    const parse_cache_entry_t* malformed = rewritten.find(touched, ParseOptionNone);
+    CHECK(malformed != NULL && malformed->status == ParseCacheMalformed);
+
+    rewritten.close();
+    cache.close();
+    unlink(kCachePath);
+    unlink(kImagePath);
+}
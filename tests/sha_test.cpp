@@ -0,0 +1,107 @@
+//
+//  sha_test.cpp
+//  machofile
+//
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "sha.h"
+#include "test.h"
+
+using namespace rotg;
+
+namespace {
+
+    typedef struct sha_vector {
+        size_t      length;     // of the message, byte i is i * 7 + 1
+        const char* sha1;
+        const char* sha256;
+    } sha_vector_t;
+
+    /* 55 and 56 bytes are the last that pad into one block and the first that need two; 63 to 65 cross the block edge */
+    const sha_vector_t kVectors[] = {
+        { 0, "da39a3ee5e6b4b0d3255bfef95601890afd80709", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { 55, "04bb34aef4880b625e6b1564a014abd25fc02bfe", "16fa57a0a3423a715d594516339f36189d6b5f93754a9714fef202616a9fabfe" },
+        { 56, "83b9fcb6d3e3b20f376ab989a1b6353bcc6c0f44", "c37b44e5f1b18554b36966f4f8e08bfbf3164c4b6c10374d12d89850892073c5" },
+        { 63, "ab15090e8dbe512f3733350f9623ab11f9b5165b", "bbba992d2c85af960fb2987a1fd05e0aa82a3db3c740dd8982a9e273b75e36a3" },
+        { 64, "54305ee7e4c7bc5a96afc6d1994fc52d9bcb665f", "66bd4633ed6f71c4ecfa4763bf7ba1c8ec7612de9aa6c0578a7b675207c71e0b" },
+        { 65, "5985422a25357371ebd2a7f6ecd7eebed43db42c", "9f7dc47107b750a1f3d35db5d9547f24ef40da5b731b9540d4f43710a154f6c9" },
+        { 4096, "b83d7c7625f84edd02f6ac033721a56ea3fbd122", "7ecf00110b5840e7f2f024397da0d75c802246514224faff4455c7547308e336" },
+    };
+
+    std::string hex(const uint8_t* digest, size_t size)
+    {
+        std::string text;
+        char byte[3];
+        for (size_t i = 0; i < size; i++) {
+            snprintf(byte, sizeof(byte), "%02x", digest[i]);
+            text += byte;
+        }
+        return text;
+    }
+
+    typedef void (*sha1_t)(const uint8_t* data, size_t size, uint8_t digest[kSHA1DigestSize]);
+    typedef void (*sha256_t)(const uint8_t* data, size_t size, uint8_t digest[kSHA256DigestSize]);
+
+    typedef struct sha_implementation {
+        sha1_t      sha1;
+        sha256_t    sha256;
+    } sha_implementation_t;
+
+    /* What this cpu picked, and the portable code it falls back to: the same on cpus without the SHA extensions */
+    const sha_implementation_t kImplementations[] = {
+        { sha1, sha256 },
+        { sha1_portable, sha256_portable },
+    };
+
+    std::string sha1_hex(const sha_implementation_t& implementation, const uint8_t* data, size_t size)
+    {
+        uint8_t digest[kSHA1DigestSize];
+        implementation.sha1(data, size, digest);
+        return hex(digest, sizeof(digest));
+    }
+
+    std::string sha256_hex(const sha_implementation_t& implementation, const uint8_t* data, size_t size)
+    {
+        uint8_t digest[kSHA256DigestSize];
+        implementation.sha256(data, size, digest);
+        return hex(digest, sizeof(digest));
+    }
+
+}
+
+TEST(sha, block_boundary_vectors)
+{
+    for (size_t i = 0; i < sizeof(kVectors) / sizeof(kVectors[0]); i++) {
+        std::vector<uint8_t> message(kVectors[i].length + 1);
+        for (size_t b = 0; b < message.size(); b++) {
+            message[b] = (uint8_t)(b * 7 + 1);
+        }
+
+        /* One past the end, which must not be read, differs from the vector */
+        message.back() ^= 0xff;
+
+        for (size_t m = 0; m < sizeof(kImplementations) / sizeof(kImplementations[0]); m++) {
+            CHECK(sha1_hex(kImplementations[m], message.data(), kVectors[i].length) == kVectors[i].sha1);
+            CHECK(sha256_hex(kImplementations[m], message.data(), kVectors[i].length) == kVectors[i].sha256);
+        }
+    }
+}
+
+TEST(sha, fips_180_vectors)
+{
+    const uint8_t* abc = (const uint8_t*)"abc";
+    const uint8_t* twoBlocks = (const uint8_t*)"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+    for (size_t m = 0; m < sizeof(kImplementations) / sizeof(kImplementations[0]); m++) {
+        const sha_implementation_t& implementation = kImplementations[m];
+
+        CHECK(sha1_hex(implementation, abc, 3) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+        CHECK(sha256_hex(implementation, abc, 3) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        CHECK(sha1_hex(implementation, twoBlocks, 56) == "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+        CHECK(sha256_hex(implementation, twoBlocks, 56) == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    }
+}
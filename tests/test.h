@@ -0,0 +1,39 @@
+//
+//  test.h
+//  machofile
+//
+//  A minimal test registry for machofile_tests. TEST(suite, name) defines
+//  a test and CHECK() records a failed expression and carries on. ctest
+//  runs each suite in a process of its own: machofile_tests <suite>.
+//
+
+#ifndef rotg_test_h
+#define rotg_test_h
+
+namespace rotg {
+
+    typedef void (*test_function_t)();
+
+    class TestRegistration
+    {
+    public:
+        TestRegistration(const char* suite, const char* name, test_function_t function);
+    };
+
+    void test_check_failed(const char* file, int line, const char* expression);
+
+}
+
+#define TEST(suite, name) \
+    static void test_##suite##_##name(); \
+    static rotg::TestRegistration register_##suite##_##name(#suite, #name, test_##suite##_##name); \
+    static void test_##suite##_##name()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            rotg::test_check_failed(__FILE__, __LINE__, #expression); \
+        } \
+    } while (0)
+
+#endif
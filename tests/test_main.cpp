@@ -0,0 +1,77 @@
+//
+//  test_main.cpp
+//  machofile
+//
+//  machofile_tests [suite]: runs the tests of suite, or all of them.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "test.h"
+
+namespace rotg {
+
+    typedef struct test_case {
+        const char*     suite;
+        const char*     name;
+        test_function_t function;
+    } test_case_t;
+
+    /* Registered from static constructors, so built on first use */
+    static std::vector<test_case_t>& test_cases()
+    {
+        static std::vector<test_case_t> cases;
+        return cases;
+    }
+
+    static size_t s_failed_checks = 0;
+
+    TestRegistration::TestRegistration(const char* suite, const char* name, test_function_t function)
+    {
+        test_case_t test = { suite, name, function };
+        test_cases().push_back(test);
+    }
+
+    void test_check_failed(const char* file, int line, const char* expression)
+    {
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+        s_failed_checks++;
+    }
+
+}
+
+int main(int argc, const char* argv[])
+{
+    using namespace rotg;
+
+    const char* suite = argc > 1 ? argv[1] : NULL;
+    size_t run = 0;
+    size_t failed = 0;
+
+    std::vector<test_case_t>::const_iterator iter;
+    for (iter = test_cases().begin(); iter != test_cases().end(); iter++) {
+        if (suite != NULL && strcmp(suite, iter->suite) != 0) {
+            continue;
+        }
+
+        size_t checks = s_failed_checks;
+        iter->function();
+        run++;
+
+        if (s_failed_checks != checks) {
+            fprintf(stderr, "FAILED %s.%s\n", iter->suite, iter->name);
+            failed++;
+        }
+    }
+
+    if (run == 0) {
+        fprintf(stderr, "No tests in suite %s\n", suite != NULL ? suite : "(all)");
+        return 1;
+    }
+
+    printf("%zu tests, %zu failed\n", run, failed);
+    return failed == 0 ? 0 : 1;
+}